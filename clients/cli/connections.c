@@ -246,7 +246,7 @@ static void
 usage (void)
 {
 	g_printerr (_("Usage: nmcli connection { COMMAND | help }\n\n"
-	              "COMMAND := { show | up | down | add | modify | edit | delete | reload | load }\n\n"
+	              "COMMAND := { show | up | down | add | modify | edit | delete | reload | load | import }\n\n"
 	              "  show [--active] [--order <order spec>]\n"
 	              "  show [--active] [--show-secrets] [id | uuid | path | apath] <ID> ...\n\n"
 	              "  up [[id | uuid | path] <ID>] [ifname <ifname>] [ap <BSSID>] [passwd-file <file with passwords>]\n\n"
@@ -257,7 +257,8 @@ usage (void)
 	              "  edit [type <new_con_type>] [con-name <new_con_name>]\n\n"
 	              "  delete [id | uuid | path] <ID>\n\n"
 	              "  reload\n\n"
-	              "  load <filename> [ <filename>... ]\n\n"));
+	              "  load <filename> [ <filename>... ]\n\n"
+	              "  import [--temporary] [--bulk] <filename> [ <filename>... ]\n\n"));
 }
 
 static void
@@ -464,6 +465,20 @@ usage_connection_load (void)
 	              "state.\n\n"));
 }
 
+static void
+usage_connection_import (void)
+{
+	g_printerr (_("Usage: nmcli connection import { ARGUMENTS | help }\n"
+	              "\n"
+	              "ARGUMENTS := [--temporary] [--bulk] <filename> [<filename>...]\n"
+	              "\n"
+	              "Add the connection profiles stored in the files. Each file contains an array\n"
+	              "of connection settings in GVariant text format (type 'aa{sa{sv}}'), as used\n"
+	              "by NetworkManager's D-Bus API. With --temporary, the profiles are not saved\n"
+	              "to disk. With --bulk, the profiles are sent to NetworkManager in large\n"
+	              "batches, which is much faster for many profiles.\n\n"));
+}
+
 static gboolean
 usage_connection_second_level (const char *cmd)
 {
@@ -487,6 +502,8 @@ usage_connection_second_level (const char *cmd)
 		usage_connection_reload ();
 	else if (matches (cmd, "load") == 0)
 		usage_connection_load ();
+	else if (matches (cmd, "import") == 0)
+		usage_connection_import ();
 	else
 		ret = FALSE;
 	return ret;
@@ -8986,6 +9003,220 @@ do_connection_load (NmCli *nmc, int argc, char **argv)
 	return nmc->return_value;
 }
 
+/* Number of connections sent in one AddConnections() call */
+#define IMPORT_BULK_SIZE 500
+
+typedef struct {
+	NmCli *nmc;
+	GPtrArray *connections;
+	guint next;
+	guint n_batch;
+	guint n_failed;
+	gboolean temporary;
+	gboolean bulk;
+} ImportInfo;
+
+static void import_next (ImportInfo *info);
+
+static void
+import_done (ImportInfo *info, GError *error)
+{
+	NmCli *nmc = info->nmc;
+
+	if (error) {
+		g_string_printf (nmc->return_text, _("Error: failed to import connections: %s"),
+		                 error->message);
+		nmc->return_value = NMC_RESULT_ERROR_UNKNOWN;
+	} else if (info->n_failed) {
+		g_string_printf (nmc->return_text, _("Error: %u of %u connections could not be imported."),
+		                 info->n_failed, info->connections->len);
+		nmc->return_value = NMC_RESULT_ERROR_UNKNOWN;
+	} else
+		g_print (_("%u connections successfully imported.\n"), info->connections->len);
+
+	g_ptr_array_unref (info->connections);
+	g_slice_free (ImportInfo, info);
+	quit ();
+}
+
+static void
+import_failed (ImportInfo *info, NMConnection *connection, const char *message)
+{
+	g_printerr (_("Error: Failed to add '%s' connection: %s\n"),
+	            nm_connection_get_id (connection), message);
+	info->n_failed++;
+}
+
+static void
+import_bulk_cb (GObject *client,
+                GAsyncResult *result,
+                gpointer user_data)
+{
+	ImportInfo *info = user_data;
+	char **errors = NULL;
+	GError *error = NULL;
+	guint i;
+
+	if (!nm_client_add_connections_finish (NM_CLIENT (client), NULL, &errors, result, &error)) {
+		import_done (info, error);
+		g_error_free (error);
+		return;
+	}
+
+	for (i = 0; errors && errors[i] && i < info->n_batch; i++) {
+		if (errors[i][0])
+			import_failed (info, info->connections->pdata[info->next + i], errors[i]);
+	}
+	g_strfreev (errors);
+
+	info->next += info->n_batch;
+	import_next (info);
+}
+
+static void
+import_single_cb (GObject *client,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+	ImportInfo *info = user_data;
+	NMRemoteConnection *connection;
+	GError *error = NULL;
+
+	connection = nm_client_add_connection_finish (NM_CLIENT (client), result, &error);
+	if (connection)
+		g_object_unref (connection);
+	else {
+		import_failed (info, info->connections->pdata[info->next], error->message);
+		g_error_free (error);
+	}
+
+	info->next++;
+	import_next (info);
+}
+
+static void
+import_next (ImportInfo *info)
+{
+	NmCli *nmc = info->nmc;
+
+	if (info->next >= info->connections->len) {
+		import_done (info, NULL);
+		return;
+	}
+
+	if (info->bulk) {
+		GPtrArray *batch;
+		guint i;
+
+		info->n_batch = MIN (IMPORT_BULK_SIZE, info->connections->len - info->next);
+		batch = g_ptr_array_sized_new (info->n_batch);
+		for (i = 0; i < info->n_batch; i++)
+			g_ptr_array_add (batch, info->connections->pdata[info->next + i]);
+		nm_client_add_connections_async (nmc->client, batch, !info->temporary,
+		                                 NULL, import_bulk_cb, info);
+		g_ptr_array_unref (batch);
+	} else {
+		add_new_connection (!info->temporary, nmc->client,
+		                    info->connections->pdata[info->next],
+		                    import_single_cb, info);
+	}
+}
+
+static gboolean
+import_read_file (const char *filename, GPtrArray *connections, GError **error)
+{
+	char *contents = NULL;
+	GVariant *variant;
+	GVariantIter iter;
+	GVariant *dict;
+
+	if (!g_file_get_contents (filename, &contents, NULL, error))
+		return FALSE;
+
+	variant = g_variant_parse (G_VARIANT_TYPE ("aa{sa{sv}}"), contents, NULL, NULL, error);
+	g_free (contents);
+	if (!variant) {
+		g_prefix_error (error, "'%s': ", filename);
+		return FALSE;
+	}
+
+	g_variant_iter_init (&iter, variant);
+	while ((dict = g_variant_iter_next_value (&iter))) {
+		NMConnection *connection;
+
+		connection = nm_simple_connection_new_from_dbus (dict, error);
+		g_variant_unref (dict);
+		if (!connection) {
+			g_prefix_error (error, "'%s', connection %u: ", filename, connections->len);
+			g_variant_unref (variant);
+			return FALSE;
+		}
+		g_ptr_array_add (connections, connection);
+	}
+	g_variant_unref (variant);
+	return TRUE;
+}
+
+static NMCResultCode
+do_connection_import (NmCli *nmc, int argc, char **argv)
+{
+	ImportInfo *info;
+	GPtrArray *connections;
+	gboolean temporary = FALSE, bulk = FALSE;
+	GError *error = NULL;
+
+	nmc->return_value = NMC_RESULT_SUCCESS;
+	nmc->should_wait = FALSE;
+
+	if (!nm_client_get_nm_running (nmc->client)) {
+		g_string_printf (nmc->return_text, _("Error: NetworkManager is not running."));
+		nmc->return_value = NMC_RESULT_ERROR_NM_NOT_RUNNING;
+		return nmc->return_value;
+	}
+
+	for (; argc > 0; next_arg (&argc, &argv)) {
+		if (!temporary && nmc_arg_is_option (*argv, "temporary"))
+			temporary = TRUE;
+		else if (!bulk && nmc_arg_is_option (*argv, "bulk"))
+			bulk = TRUE;
+		else
+			break;
+	}
+
+	if (argc == 0) {
+		g_string_printf (nmc->return_text, _("Error: No file specified."));
+		nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+		return nmc->return_value;
+	}
+
+	connections = g_ptr_array_new_with_free_func (g_object_unref);
+	for (; argc > 0; next_arg (&argc, &argv)) {
+		if (!import_read_file (*argv, connections, &error)) {
+			g_string_printf (nmc->return_text, _("Error: failed to read connections: %s."),
+			                 error->message);
+			nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+			g_error_free (error);
+			g_ptr_array_unref (connections);
+			return nmc->return_value;
+		}
+	}
+
+	if (connections->len == 0) {
+		g_ptr_array_unref (connections);
+		return nmc->return_value;
+	}
+
+	info = g_slice_new0 (ImportInfo);
+	info->nmc = nmc;
+	info->connections = connections;
+	info->temporary = temporary;
+	info->bulk = bulk;
+
+	nmc->should_wait = TRUE;
+	import_next (info);
+	return nmc->return_value;
+}
+
 
 typedef struct {
 	NmCli *nmc;
@@ -9249,6 +9480,8 @@ do_connections (NmCli *nmc, int argc, char **argv)
 			nmc->return_value = do_connection_reload (nmc, argc-1, argv+1);
 		} else if (matches(*argv, "load") == 0) {
 			nmc->return_value = do_connection_load (nmc, argc-1, argv+1);
+		} else if (matches (*argv, "import") == 0) {
+			nmc->return_value = do_connection_import (nmc, argc-1, argv+1);
 		} else if (matches (*argv, "modify") == 0) {
 			gboolean temporary = FALSE;
 
@@ -75,6 +75,36 @@ static NmcOutputField nmc_fields_nm_logging[] = {
 #define NMC_FIELDS_NM_LOGGING_ALL     "LEVEL,DOMAINS"
 #define NMC_FIELDS_NM_LOGGING_COMMON  "LEVEL,DOMAINS"
 
+/* Available fields for 'general stats' */
+static NmcOutputField nmc_fields_nm_stats[] = {
+	{"DEVICE-TYPE", N_("DEVICE-TYPE"), 14},  /* 0 */
+	{"STAGE",       N_("STAGE"),       19},  /* 1 */
+	{"COUNT",       N_("COUNT"),        7},  /* 2 */
+	{"AVG-MS",      N_("AVG-MS"),       8},  /* 3 */
+	{"MAX-MS",      N_("MAX-MS"),       8},  /* 4 */
+	{"HISTOGRAM",   N_("HISTOGRAM"),   40},  /* 5 */
+	{NULL,          NULL,               0}
+};
+#define NMC_FIELDS_NM_STATS_ALL     "DEVICE-TYPE,STAGE,COUNT,AVG-MS,MAX-MS,HISTOGRAM"
+#define NMC_FIELDS_NM_STATS_COMMON  "DEVICE-TYPE,STAGE,COUNT,AVG-MS,MAX-MS"
+
+/* Available fields for 'general stats scheduler' */
+static NmcOutputField nmc_fields_nm_scheduler_stats[] = {
+	{"RESOURCE",    N_("RESOURCE"),    10},  /* 0 */
+	{"LIMIT",       N_("LIMIT"),        7},  /* 1 */
+	{"IN-FLIGHT",   N_("IN-FLIGHT"),   11},  /* 2 */
+	{"QUEUED",      N_("QUEUED"),       8},  /* 3 */
+	{"QUEUED-MAX",  N_("QUEUED-MAX"),  12},  /* 4 */
+	{"GRANTED",     N_("GRANTED"),      9},  /* 5 */
+	{"AVG-WAIT-MS", N_("AVG-WAIT-MS"), 13},  /* 6 */
+	{"MAX-WAIT-MS", N_("MAX-WAIT-MS"), 13},  /* 7 */
+	{"AVG-HOLD-MS", N_("AVG-HOLD-MS"), 13},  /* 8 */
+	{"MAX-HOLD-MS", N_("MAX-HOLD-MS"), 13},  /* 9 */
+	{NULL,          NULL,               0}
+};
+#define NMC_FIELDS_NM_SCHEDULER_STATS_ALL     "RESOURCE,LIMIT,IN-FLIGHT,QUEUED,QUEUED-MAX,GRANTED,AVG-WAIT-MS,MAX-WAIT-MS,AVG-HOLD-MS,MAX-HOLD-MS"
+#define NMC_FIELDS_NM_SCHEDULER_STATS_COMMON  "RESOURCE,LIMIT,IN-FLIGHT,QUEUED,GRANTED,AVG-WAIT-MS,MAX-WAIT-MS"
+
 
 /* glib main loop variable - defined in nmcli.c */
 extern GMainLoop *loop;
@@ -84,11 +114,12 @@ static void
 usage_general (void)
 {
 	g_printerr (_("Usage: nmcli general { COMMAND | help }\n\n"
-	              "COMMAND := { status | hostname | permissions | logging }\n\n"
+	              "COMMAND := { status | hostname | permissions | logging | stats }\n\n"
 	              "  status\n\n"
 	              "  hostname [<hostname>]\n\n"
 	              "  permissions\n\n"
-	              "  logging [level <log level>] [domains <log domains>]\n\n"));
+	              "  logging [level <log level>] [domains <log domains>]\n\n"
+	              "  stats [scheduler]\n\n"));
 }
 
 static void
@@ -133,6 +164,21 @@ usage_general_logging (void)
 	              "for the list of possible logging domains.\n\n"));
 }
 
+static void
+usage_general_stats (void)
+{
+	g_printerr (_("Usage: nmcli general stats { ARGUMENTS | help }\n"
+	              "\n"
+	              "ARGUMENTS := [scheduler]\n"
+	              "\n"
+	              "Show how long the phases of device activations took since NetworkManager\n"
+	              "was started, per device type. The HISTOGRAM field lists the number of\n"
+	              "activations per duration range in milliseconds.\n"
+	              "With 'scheduler', show how many activations use or wait for each resource\n"
+	              "limited in the [activation] section of NetworkManager.conf, and how long\n"
+	              "they waited for and held it.\n\n"));
+}
+
 static void
 usage_networking (void)
 {
@@ -548,6 +594,228 @@ show_general_logging (NmCli *nmc)
 	return TRUE;
 }
 
+static char *
+stats_histogram_to_string (GVariant *buckets)
+{
+	GString *str = g_string_new (NULL);
+	const guint32 *counts;
+	gsize n, i;
+
+	counts = g_variant_get_fixed_array (buckets, &n, sizeof (guint32));
+	for (i = 0; i < n; i++) {
+		if (!counts[i])
+			continue;
+		if (str->len)
+			g_string_append_c (str, ' ');
+		/* Bucket i counts durations below 2^i ms; the last one is open-ended */
+		if (i + 1 < n)
+			g_string_append_printf (str, "<%u:%u", 1u << i, counts[i]);
+		else
+			g_string_append_printf (str, ">=%u:%u", i ? 1u << (i - 1) : 0u, counts[i]);
+	}
+	return g_string_free (str, FALSE);
+}
+
+/* Calls @method of the Stats interface and returns its aa{sv} result */
+static GVariant *
+get_stats (NmCli *nmc, const char *method)
+{
+	GError *error = NULL;
+	GDBusConnection *bus;
+	GVariant *ret, *stats;
+
+	nmc->get_client (nmc); /* create NMClient */
+
+	if (!nm_client_get_nm_running (nmc->client)) {
+		g_string_printf (nmc->return_text, _("Error: NetworkManager is not running."));
+		nmc->return_value = NMC_RESULT_ERROR_NM_NOT_RUNNING;
+		return NULL;
+	}
+
+	/* The statistics are not part of the libnm object model; ask for them
+	 * directly.
+	 */
+	bus = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (bus) {
+		ret = g_dbus_connection_call_sync (bus,
+		                                   NM_DBUS_SERVICE,
+		                                   NM_DBUS_PATH_STATS,
+		                                   NM_DBUS_INTERFACE_STATS,
+		                                   method,
+		                                   NULL,
+		                                   G_VARIANT_TYPE ("(aa{sv})"),
+		                                   G_DBUS_CALL_FLAGS_NONE, -1,
+		                                   NULL, &error);
+		g_object_unref (bus);
+	} else
+		ret = NULL;
+	if (!ret) {
+		g_dbus_error_strip_remote_error (error);
+		g_string_printf (nmc->return_text, _("Error: failed to get statistics: %s"), error->message);
+		g_error_free (error);
+		nmc->return_value = NMC_RESULT_ERROR_UNKNOWN;
+		return NULL;
+	}
+
+	stats = g_variant_get_child_value (ret, 0);
+	g_variant_unref (ret);
+	return stats;
+}
+
+static gboolean
+show_general_stats (NmCli *nmc)
+{
+	GError *error = NULL;
+	const char *fields_str;
+	const char *fields_all =    NMC_FIELDS_NM_STATS_ALL;
+	const char *fields_common = NMC_FIELDS_NM_STATS_COMMON;
+	NmcOutputField *tmpl, *arr;
+	size_t tmpl_len;
+	GVariant *stats;
+	GVariantIter iter;
+	GVariant *entry;
+
+	if (!nmc->required_fields || strcasecmp (nmc->required_fields, "common") == 0)
+		fields_str = fields_common;
+	else if (!nmc->required_fields || strcasecmp (nmc->required_fields, "all") == 0)
+		fields_str = fields_all;
+	else
+		fields_str = nmc->required_fields;
+
+	tmpl = nmc_fields_nm_stats;
+	tmpl_len = sizeof (nmc_fields_nm_stats);
+	nmc->print_fields.indices = parse_output_fields (fields_str, tmpl, FALSE, NULL, &error);
+
+	if (error) {
+		g_string_printf (nmc->return_text, _("Error: 'general stats': %s"), error->message);
+		g_error_free (error);
+		nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+		return FALSE;
+	}
+
+	stats = get_stats (nmc, "GetActivationStats");
+	if (!stats)
+		return FALSE;
+
+	nmc->print_fields.header_name = _("NetworkManager activation statistics");
+	arr = nmc_dup_fields_array (tmpl, tmpl_len, NMC_OF_FLAG_MAIN_HEADER_ADD | NMC_OF_FLAG_FIELD_NAMES);
+	g_ptr_array_add (nmc->output_data, arr);
+
+	g_variant_iter_init (&iter, stats);
+	while ((entry = g_variant_iter_next_value (&iter))) {
+		char *device_type = NULL, *stage = NULL;
+		guint64 count = 0, total_ms = 0, max_ms = 0;
+		GVariant *buckets;
+
+		g_variant_lookup (entry, "device-type", "s", &device_type);
+		g_variant_lookup (entry, "stage", "s", &stage);
+		g_variant_lookup (entry, "count", "t", &count);
+		g_variant_lookup (entry, "total-ms", "t", &total_ms);
+		g_variant_lookup (entry, "max-ms", "t", &max_ms);
+		buckets = g_variant_lookup_value (entry, "buckets", G_VARIANT_TYPE ("au"));
+
+		arr = nmc_dup_fields_array (tmpl, tmpl_len, 0);
+		set_val_str  (arr, 0, device_type);
+		set_val_str  (arr, 1, stage);
+		set_val_str  (arr, 2, g_strdup_printf ("%" G_GUINT64_FORMAT, count));
+		set_val_str  (arr, 3, g_strdup_printf ("%" G_GUINT64_FORMAT, count ? total_ms / count : 0));
+		set_val_str  (arr, 4, g_strdup_printf ("%" G_GUINT64_FORMAT, max_ms));
+		set_val_str  (arr, 5, buckets ? stats_histogram_to_string (buckets) : g_strdup (""));
+		g_ptr_array_add (nmc->output_data, arr);
+
+		if (buckets)
+			g_variant_unref (buckets);
+		g_variant_unref (entry);
+	}
+	g_variant_unref (stats);
+
+	print_data (nmc);  /* Print all data */
+
+	return TRUE;
+}
+
+static gboolean
+show_general_scheduler_stats (NmCli *nmc)
+{
+	GError *error = NULL;
+	const char *fields_str;
+	const char *fields_all =    NMC_FIELDS_NM_SCHEDULER_STATS_ALL;
+	const char *fields_common = NMC_FIELDS_NM_SCHEDULER_STATS_COMMON;
+	NmcOutputField *tmpl, *arr;
+	size_t tmpl_len;
+	GVariant *stats;
+	GVariantIter iter;
+	GVariant *entry;
+
+	if (!nmc->required_fields || strcasecmp (nmc->required_fields, "common") == 0)
+		fields_str = fields_common;
+	else if (!nmc->required_fields || strcasecmp (nmc->required_fields, "all") == 0)
+		fields_str = fields_all;
+	else
+		fields_str = nmc->required_fields;
+
+	tmpl = nmc_fields_nm_scheduler_stats;
+	tmpl_len = sizeof (nmc_fields_nm_scheduler_stats);
+	nmc->print_fields.indices = parse_output_fields (fields_str, tmpl, FALSE, NULL, &error);
+
+	if (error) {
+		g_string_printf (nmc->return_text, _("Error: 'general stats scheduler': %s"), error->message);
+		g_error_free (error);
+		nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+		return FALSE;
+	}
+
+	stats = get_stats (nmc, "GetSchedulerStats");
+	if (!stats)
+		return FALSE;
+
+	nmc->print_fields.header_name = _("NetworkManager activation scheduler");
+	arr = nmc_dup_fields_array (tmpl, tmpl_len, NMC_OF_FLAG_MAIN_HEADER_ADD | NMC_OF_FLAG_FIELD_NAMES);
+	g_ptr_array_add (nmc->output_data, arr);
+
+	g_variant_iter_init (&iter, stats);
+	while ((entry = g_variant_iter_next_value (&iter))) {
+		char *resource = NULL;
+		guint32 limit = 0, in_flight = 0, queued = 0, queued_max = 0;
+		guint64 granted = 0, wait_total = 0, wait_max = 0, hold_total = 0, hold_max = 0;
+		guint64 released;
+
+		g_variant_lookup (entry, "resource", "s", &resource);
+		g_variant_lookup (entry, "limit", "u", &limit);
+		g_variant_lookup (entry, "in-flight", "u", &in_flight);
+		g_variant_lookup (entry, "queued", "u", &queued);
+		g_variant_lookup (entry, "queued-max", "u", &queued_max);
+		g_variant_lookup (entry, "granted", "t", &granted);
+		g_variant_lookup (entry, "wait-total-us", "t", &wait_total);
+		g_variant_lookup (entry, "wait-max-us", "t", &wait_max);
+		g_variant_lookup (entry, "hold-total-us", "t", &hold_total);
+		g_variant_lookup (entry, "hold-max-us", "t", &hold_max);
+
+		/* Hold times are only known for requests that were released */
+		released = granted > in_flight ? granted - in_flight : 0;
+
+		arr = nmc_dup_fields_array (tmpl, tmpl_len, 0);
+		set_val_str  (arr, 0, resource);
+		set_val_str  (arr, 1, limit ? g_strdup_printf ("%u", limit) : g_strdup (_("none")));
+		set_val_str  (arr, 2, g_strdup_printf ("%u", in_flight));
+		set_val_str  (arr, 3, g_strdup_printf ("%u", queued));
+		set_val_str  (arr, 4, g_strdup_printf ("%u", queued_max));
+		set_val_str  (arr, 5, g_strdup_printf ("%" G_GUINT64_FORMAT, granted));
+		set_val_str  (arr, 6, g_strdup_printf ("%" G_GUINT64_FORMAT, granted ? wait_total / granted / 1000 : 0));
+		set_val_str  (arr, 7, g_strdup_printf ("%" G_GUINT64_FORMAT, wait_max / 1000));
+		set_val_str  (arr, 8, g_strdup_printf ("%" G_GUINT64_FORMAT, released ? hold_total / released / 1000 : 0));
+		set_val_str  (arr, 9, g_strdup_printf ("%" G_GUINT64_FORMAT, hold_max / 1000));
+		g_ptr_array_add (nmc->output_data, arr);
+
+		g_variant_unref (entry);
+	}
+	g_variant_unref (stats);
+
+	print_data (nmc);  /* Print all data */
+
+	return TRUE;
+}
+
 static void
 save_hostname_cb (GObject *object, GAsyncResult *result, gpointer user_data)
 {
@@ -676,6 +944,25 @@ do_general (NmCli *nmc, int argc, char **argv)
 				}
 			}
 		}
+		else if (matches (*argv, "stats") == 0) {
+			if (nmc_arg_is_help (*(argv+1))) {
+				usage_general_stats ();
+				goto finish;
+			}
+			if (!nmc_terse_option_check (nmc->print_output, nmc->required_fields, &error)) {
+				g_string_printf (nmc->return_text, _("Error: %s."), error->message);
+				nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+				goto finish;
+			}
+			if (*(argv+1) && matches (*(argv+1), "scheduler") == 0)
+				show_general_scheduler_stats (nmc);
+			else if (*(argv+1)) {
+				usage_general_stats ();
+				g_string_printf (nmc->return_text, _("Error: 'general stats' argument '%s' is not valid."), *(argv+1));
+				nmc->return_value = NMC_RESULT_ERROR_USER_INPUT;
+			} else
+				show_general_stats (nmc);
+		}
 		else {
 			usage_general ();
 			g_string_printf (nmc->return_text, _("Error: 'general' command '%s' is not valid."), *argv);
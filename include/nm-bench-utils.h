@@ -0,0 +1,142 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301 USA.
+ *
+ * Copyright 2015 Red Hat, Inc.
+ */
+
+#ifndef __NM_BENCH_UTILS_H__
+#define __NM_BENCH_UTILS_H__
+
+/*******************************************************************************
+ * Header-only helpers for the benchmarks (make benchmark).
+ *
+ * A benchmark is run for several rounds, doubling the size of its workload
+ * in each round, and one line of JSON is printed per timing and round:
+ *
+ *   {"name": "...", "round": R, <workload>, "iterations": I,
+ *    "mean-us": M, "min-us": M, "max-us": M, "growth": G}
+ *
+ * "growth" is the ratio of the mean time to that of the previous round;
+ * for an operation that is linear in the workload it stays around 2,
+ * while quadratic behavior shows up as 4.
+ ******************************************************************************/
+
+#include <glib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "gsystem-local-alloc.h"
+
+/* Timings below this are too noisy to judge the growth */
+#define NM_BENCH_GROWTH_MIN_US 1000
+
+typedef struct {
+	const char *name;
+	gint64 total_us;
+	gint64 min_us;
+	gint64 max_us;
+	guint count;
+} NMBenchTiming;
+
+typedef struct {
+	/* the mean time of each timing in the previous round, by name */
+	GHashTable *last_means;
+
+	/* if positive, a growth beyond this sets growth_exceeded */
+	double max_growth;
+	gboolean growth_exceeded;
+} NMBench;
+
+inline static void
+nm_bench_init (NMBench *bench, double max_growth)
+{
+	memset (bench, 0, sizeof (*bench));
+	bench->last_means = g_hash_table_new (g_str_hash, g_str_equal);
+	bench->max_growth = max_growth;
+}
+
+inline static void
+nm_bench_clear (NMBench *bench)
+{
+	g_clear_pointer (&bench->last_means, g_hash_table_unref);
+}
+
+inline static void
+nm_bench_timing_init (NMBenchTiming *t, const char *name)
+{
+	memset (t, 0, sizeof (*t));
+	t->name = name;
+	t->min_us = G_MAXINT64;
+}
+
+/* Adds the time since @start_us, taken with g_get_monotonic_time() */
+inline static void
+nm_bench_timing_add (NMBenchTiming *t, gint64 start_us)
+{
+	gint64 duration = g_get_monotonic_time () - start_us;
+
+	t->total_us += duration;
+	t->min_us = MIN (t->min_us, duration);
+	t->max_us = MAX (t->max_us, duration);
+	t->count++;
+}
+
+/* Prints @t as one line of JSON. @workload_fmt gives the JSON members that
+ * describe the workload size, e.g. "\"count\": %u". */
+inline static void
+nm_bench_timing_report (NMBench *bench, const NMBenchTiming *t, guint round, const char *workload_fmt, ...) G_GNUC_PRINTF (4, 5);
+
+inline static void
+nm_bench_timing_report (NMBench *bench, const NMBenchTiming *t, guint round, const char *workload_fmt, ...)
+{
+	gint64 mean = t->count ? t->total_us / t->count : 0;
+	gs_free char *workload = NULL;
+	gpointer last;
+	char growth[32] = "null";
+	va_list args;
+
+	va_start (args, workload_fmt);
+	workload = g_strdup_vprintf (workload_fmt, args);
+	va_end (args);
+
+	if (g_hash_table_lookup_extended (bench->last_means, t->name, NULL, &last)) {
+		gint64 last_mean = GPOINTER_TO_SIZE (last);
+
+		if (last_mean > 0) {
+			double g = (double) mean / (double) last_mean;
+
+			g_snprintf (growth, sizeof (growth), "%.2f", g);
+			if (   bench->max_growth > 0
+			    && last_mean >= NM_BENCH_GROWTH_MIN_US
+			    && g > bench->max_growth) {
+				g_printerr ("%s: %s grew by %.2f in round %u (%s)\n",
+				            g_get_prgname (), t->name, g, round, workload);
+				bench->growth_exceeded = TRUE;
+			}
+		}
+	}
+	g_hash_table_insert (bench->last_means, (gpointer) t->name, GSIZE_TO_POINTER (mean));
+
+	g_print ("{\"name\": \"%s\", \"round\": %u, %s, "
+	         "\"iterations\": %u, \"mean-us\": %" G_GINT64_FORMAT ", "
+	         "\"min-us\": %" G_GINT64_FORMAT ", \"max-us\": %" G_GINT64_FORMAT ", "
+	         "\"growth\": %s}\n",
+	         t->name, round, workload, t->count,
+	         mean, t->count ? t->min_us : 0, t->max_us, growth);
+}
+
+#endif /* __NM_BENCH_UTILS_H__ */
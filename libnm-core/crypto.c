@@ -28,6 +28,7 @@
 #include <strings.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <glib/gi18n-lib.h>
 
 #include "crypto.h"
@@ -305,6 +306,8 @@ parse_pkcs8_key_file (const guint8 *data,
 	return key;
 }
 
+static guint file_read_count;
+
 static GByteArray *
 file_to_g_byte_array (const char *filename, GError **error)
 {
@@ -312,6 +315,8 @@ file_to_g_byte_array (const char *filename, GError **error)
 	GByteArray *array = NULL;
 	gsize length = 0;
 
+	g_atomic_int_inc (&file_read_count);
+
 	if (g_file_get_contents (filename, &contents, &length, error)) {
 		array = g_byte_array_sized_new (length);
 		g_byte_array_append (array, (guint8 *) contents, length);
@@ -321,6 +326,185 @@ file_to_g_byte_array (const char *filename, GError **error)
 	return array;
 }
 
+/*****************************************************************************/
+
+/* Cache of the results of verifying certificate and private key files,
+ * so that activating the same 802.1x connection again doesn't read and
+ * decrypt the files again. An entry is keyed by the path and only used
+ * while the file's device, inode, size and modification time are the
+ * same. Private key contents are never kept; the results for a private
+ * key are indexed by a salted checksum of the password.
+ */
+
+#define FILE_CACHE_MAX_ENTRIES 64
+
+typedef struct {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	gint64 mtime_ns;
+} FileId;
+
+typedef struct {
+	NMCryptoFileFormat format;
+	gboolean is_encrypted;
+	GError *error;
+} KeyResult;
+
+typedef struct {
+	FileId id;
+
+	gboolean cert_valid;
+	GByteArray *cert;
+	NMCryptoFileFormat cert_format;
+	GError *cert_error;
+
+	gboolean pkcs12_valid;
+	gboolean is_pkcs12;
+	GError *pkcs12_error;
+
+	GHashTable *keys;  /* password checksum -> KeyResult */
+} FileCacheEntry;
+
+G_LOCK_DEFINE_STATIC (file_cache);
+static GHashTable *file_cache;
+static guint8 password_salt[16];
+static gboolean password_salt_set;
+
+static void
+key_result_free (KeyResult *result)
+{
+	g_clear_error (&result->error);
+	g_slice_free (KeyResult, result);
+}
+
+static void
+file_cache_entry_free (FileCacheEntry *entry)
+{
+	if (entry->cert)
+		g_byte_array_free (entry->cert, TRUE);
+	g_clear_error (&entry->cert_error);
+	g_clear_error (&entry->pkcs12_error);
+	g_hash_table_unref (entry->keys);
+	g_slice_free (FileCacheEntry, entry);
+}
+
+static gboolean
+file_id_get (const char *path, FileId *id)
+{
+	struct stat st;
+
+	if (stat (path, &st) != 0 || !S_ISREG (st.st_mode))
+		return FALSE;
+
+	memset (id, 0, sizeof (*id));
+	id->dev = st.st_dev;
+	id->ino = st.st_ino;
+	id->size = st.st_size;
+	id->mtime_ns = (gint64) st.st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000) + st.st_mtim.tv_nsec;
+	return TRUE;
+}
+
+/* Must be called with the file_cache lock held */
+static FileCacheEntry *
+file_cache_get (const char *path, const FileId *id, gboolean create)
+{
+	FileCacheEntry *entry = NULL;
+
+	if (file_cache)
+		entry = g_hash_table_lookup (file_cache, path);
+
+	if (entry && memcmp (&entry->id, id, sizeof (*id)) != 0) {
+		/* The file changed */
+		g_hash_table_remove (file_cache, path);
+		entry = NULL;
+	}
+
+	if (!entry && create) {
+		if (!file_cache) {
+			file_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+			                                    (GDestroyNotify) file_cache_entry_free);
+		} else if (g_hash_table_size (file_cache) >= FILE_CACHE_MAX_ENTRIES)
+			g_hash_table_remove_all (file_cache);
+
+		entry = g_slice_new0 (FileCacheEntry);
+		entry->id = *id;
+		entry->keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+		                                     (GDestroyNotify) key_result_free);
+		g_hash_table_insert (file_cache, g_strdup (path), entry);
+	}
+
+	return entry;
+}
+
+/* Must be called with the file_cache lock held */
+static char *
+password_checksum (const char *password)
+{
+	GChecksum *sum;
+	char *result;
+
+	if (!password_salt_set) {
+		if (!crypto_randomize (password_salt, sizeof (password_salt), NULL)) {
+			guint i;
+
+			for (i = 0; i < sizeof (password_salt); i++)
+				password_salt[i] = g_random_int_range (0, 256);
+		}
+		password_salt_set = TRUE;
+	}
+
+	sum = g_checksum_new (G_CHECKSUM_SHA256);
+	g_checksum_update (sum, password_salt, sizeof (password_salt));
+	if (password) {
+		/* distinguish a %NULL password from an empty one */
+		g_checksum_update (sum, (const guchar *) "p", 1);
+		g_checksum_update (sum, (const guchar *) password, strlen (password));
+	}
+	result = g_strdup (g_checksum_get_string (sum));
+	g_checksum_free (sum);
+	return result;
+}
+
+/* Only errors about the contents are cached; if the file can't be read,
+ * it doesn't have an entry either.
+ */
+static gboolean
+error_is_cacheable (GError *error)
+{
+	return !error || error->domain != G_FILE_ERROR;
+}
+
+/**
+ * crypto_file_cache_invalidate:
+ * @path: (allow-none): the certificate or key file that changed, or %NULL
+ *   to drop all cached results
+ *
+ * Drops the cached results of verifying @path. Files that are replaced
+ * or modified are noticed by their inode and modification time anyway;
+ * this is for writers that know they changed a file.
+ */
+void
+crypto_file_cache_invalidate (const char *path)
+{
+	G_LOCK (file_cache);
+	if (file_cache) {
+		if (path)
+			g_hash_table_remove (file_cache, path);
+		else
+			g_hash_table_remove_all (file_cache);
+	}
+	G_UNLOCK (file_cache);
+}
+
+guint
+_crypto_file_read_count (void)
+{
+	return g_atomic_int_get (&file_read_count);
+}
+
+/*****************************************************************************/
+
 /*
  * Convert a hex string into bytes.
  */
@@ -589,20 +773,13 @@ done:
 	return cert;
 }
 
-GByteArray *
-crypto_load_and_verify_certificate (const char *file,
-                                    NMCryptoFileFormat *out_file_format,
-                                    GError **error)
+static GByteArray *
+load_and_verify_certificate (const char *file,
+                             NMCryptoFileFormat *out_file_format,
+                             GError **error)
 {
 	GByteArray *array, *contents;
 
-	g_return_val_if_fail (file != NULL, NULL);
-	g_return_val_if_fail (out_file_format != NULL, NULL);
-	g_return_val_if_fail (*out_file_format == NM_CRYPTO_FILE_FORMAT_UNKNOWN, NULL);
-
-	if (!crypto_init (error))
-		return NULL;
-
 	contents = file_to_g_byte_array (file, error);
 	if (!contents)
 		return NULL;
@@ -635,6 +812,68 @@ crypto_load_and_verify_certificate (const char *file,
 	return contents;
 }
 
+static GByteArray *
+byte_array_dup (const GByteArray *array)
+{
+	GByteArray *copy;
+
+	copy = g_byte_array_sized_new (array->len);
+	g_byte_array_append (copy, array->data, array->len);
+	return copy;
+}
+
+GByteArray *
+crypto_load_and_verify_certificate (const char *file,
+                                    NMCryptoFileFormat *out_file_format,
+                                    GError **error)
+{
+	FileCacheEntry *entry;
+	GByteArray *contents;
+	NMCryptoFileFormat format = NM_CRYPTO_FILE_FORMAT_UNKNOWN;
+	GError *local = NULL;
+	FileId id;
+	gboolean have_id;
+
+	g_return_val_if_fail (file != NULL, NULL);
+	g_return_val_if_fail (out_file_format != NULL, NULL);
+	g_return_val_if_fail (*out_file_format == NM_CRYPTO_FILE_FORMAT_UNKNOWN, NULL);
+
+	if (!crypto_init (error))
+		return NULL;
+
+	have_id = file_id_get (file, &id);
+	if (have_id) {
+		G_LOCK (file_cache);
+		entry = file_cache_get (file, &id, FALSE);
+		if (entry && entry->cert_valid) {
+			*out_file_format = entry->cert_format;
+			contents = entry->cert ? byte_array_dup (entry->cert) : NULL;
+			if (entry->cert_error)
+				g_propagate_error (error, g_error_copy (entry->cert_error));
+			G_UNLOCK (file_cache);
+			return contents;
+		}
+		G_UNLOCK (file_cache);
+	}
+
+	contents = load_and_verify_certificate (file, &format, &local);
+
+	if (have_id && error_is_cacheable (local)) {
+		G_LOCK (file_cache);
+		entry = file_cache_get (file, &id, TRUE);
+		entry->cert_valid = TRUE;
+		entry->cert_format = format;
+		entry->cert = contents ? byte_array_dup (contents) : NULL;
+		entry->cert_error = local ? g_error_copy (local) : NULL;
+		G_UNLOCK (file_cache);
+	}
+
+	*out_file_format = format;
+	if (local)
+		g_propagate_error (error, local);
+	return contents;
+}
+
 gboolean
 crypto_is_pkcs12_data (const guint8 *data,
                        gsize data_len,
@@ -665,19 +904,49 @@ crypto_is_pkcs12_data (const guint8 *data,
 gboolean
 crypto_is_pkcs12_file (const char *file, GError **error)
 {
+	FileCacheEntry *entry;
 	GByteArray *contents;
 	gboolean success = FALSE;
+	GError *local = NULL;
+	FileId id;
+	gboolean have_id;
 
 	g_return_val_if_fail (file != NULL, FALSE);
 
 	if (!crypto_init (error))
 		return FALSE;
 
-	contents = file_to_g_byte_array (file, error);
+	have_id = file_id_get (file, &id);
+	if (have_id) {
+		G_LOCK (file_cache);
+		entry = file_cache_get (file, &id, FALSE);
+		if (entry && entry->pkcs12_valid) {
+			success = entry->is_pkcs12;
+			if (entry->pkcs12_error)
+				g_propagate_error (error, g_error_copy (entry->pkcs12_error));
+			G_UNLOCK (file_cache);
+			return success;
+		}
+		G_UNLOCK (file_cache);
+	}
+
+	contents = file_to_g_byte_array (file, &local);
 	if (contents) {
-		success = crypto_is_pkcs12_data (contents->data, contents->len, error);
+		success = crypto_is_pkcs12_data (contents->data, contents->len, &local);
 		g_byte_array_free (contents, TRUE);
 	}
+
+	if (have_id && error_is_cacheable (local)) {
+		G_LOCK (file_cache);
+		entry = file_cache_get (file, &id, TRUE);
+		entry->pkcs12_valid = TRUE;
+		entry->is_pkcs12 = success;
+		entry->pkcs12_error = local ? g_error_copy (local) : NULL;
+		G_UNLOCK (file_cache);
+	}
+
+	if (local)
+		g_propagate_error (error, local);
 	return success;
 }
 
@@ -745,19 +1014,66 @@ crypto_verify_private_key (const char *filename,
                            gboolean *out_is_encrypted,
                            GError **error)
 {
+	FileCacheEntry *entry;
 	GByteArray *contents;
 	NMCryptoFileFormat format = NM_CRYPTO_FILE_FORMAT_UNKNOWN;
+	gboolean is_encrypted = FALSE;
+	GError *local = NULL;
+	char *checksum = NULL;
+	KeyResult *result;
+	FileId id;
+	gboolean have_id;
 
 	g_return_val_if_fail (filename != NULL, NM_CRYPTO_FILE_FORMAT_UNKNOWN);
+	g_return_val_if_fail (out_is_encrypted == NULL || *out_is_encrypted == FALSE, NM_CRYPTO_FILE_FORMAT_UNKNOWN);
 
 	if (!crypto_init (error))
 		return NM_CRYPTO_FILE_FORMAT_UNKNOWN;
 
-	contents = file_to_g_byte_array (filename, error);
+	have_id = file_id_get (filename, &id);
+	if (have_id) {
+		G_LOCK (file_cache);
+		checksum = password_checksum (password);
+		entry = file_cache_get (filename, &id, FALSE);
+		result = entry ? g_hash_table_lookup (entry->keys, checksum) : NULL;
+		if (result) {
+			if (out_is_encrypted)
+				*out_is_encrypted = result->is_encrypted;
+			if (result->error)
+				g_propagate_error (error, g_error_copy (result->error));
+			format = result->format;
+			G_UNLOCK (file_cache);
+			g_free (checksum);
+			return format;
+		}
+		G_UNLOCK (file_cache);
+	}
+
+	contents = file_to_g_byte_array (filename, &local);
 	if (contents) {
-		format = crypto_verify_private_key_data (contents->data, contents->len, password, out_is_encrypted, error);
+		format = crypto_verify_private_key_data (contents->data, contents->len, password, &is_encrypted, &local);
+		/* Don't leave key data around */
+		memset (contents->data, 0, contents->len);
 		g_byte_array_free (contents, TRUE);
 	}
+
+	if (have_id && error_is_cacheable (local)) {
+		G_LOCK (file_cache);
+		entry = file_cache_get (filename, &id, TRUE);
+		result = g_slice_new0 (KeyResult);
+		result->format = format;
+		result->is_encrypted = is_encrypted;
+		result->error = local ? g_error_copy (local) : NULL;
+		g_hash_table_replace (entry->keys, checksum, result);
+		checksum = NULL;
+		G_UNLOCK (file_cache);
+	}
+	g_free (checksum);
+
+	if (out_is_encrypted)
+		*out_is_encrypted = is_encrypted;
+	if (local)
+		g_propagate_error (error, local);
 	return format;
 }
 
@@ -76,6 +76,8 @@ NMCryptoFileFormat crypto_verify_private_key (const char *file,
                                               gboolean *out_is_encrypted,
                                               GError **error);
 
+void crypto_file_cache_invalidate (const char *path);
+
 /* Internal utils API bits for crypto providers */
 
 void crypto_md5_hash (const char *salt,
@@ -130,4 +132,7 @@ gboolean crypto_verify_pkcs8 (const guint8 *data,
                               const char *password,
                               GError **error);
 
+/* For testcases only! */
+guint _crypto_file_read_count (void);
+
 #endif  /* __CRYPTO_H__ */
@@ -1963,6 +1963,76 @@ nm_setting_ip_config_init (NMSettingIPConfig *setting)
 	priv->routes = g_ptr_array_new_with_free_func ((GDestroyNotify) nm_ip_route_unref);
 }
 
+static gboolean
+compare_strings (GPtrArray *a, GPtrArray *b)
+{
+	guint i;
+
+	if (a->len != b->len)
+		return FALSE;
+	for (i = 0; i < a->len; i++) {
+		if (strcmp (a->pdata[i], b->pdata[i]) != 0)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+compare_property (NMSetting *setting,
+                  NMSetting *other,
+                  const GParamSpec *prop_spec,
+                  NMSettingCompareFlags flags)
+{
+	NMSettingIPConfigPrivate *a_priv = NM_SETTING_IP_CONFIG_GET_PRIVATE (setting);
+	NMSettingIPConfigPrivate *b_priv = NM_SETTING_IP_CONFIG_GET_PRIVATE (other);
+	guint i;
+
+	/* The D-Bus representation of these properties is expensive to build
+	 * for large configurations. Compare the same fields it contains; since
+	 * all addresses are kept in canonical form, comparing the strings is
+	 * the same as comparing the binary addresses.
+	 */
+	if (!strcmp (prop_spec->name, NM_SETTING_IP_CONFIG_DNS))
+		return compare_strings (a_priv->dns, b_priv->dns);
+
+	if (!strcmp (prop_spec->name, NM_SETTING_IP_CONFIG_ADDRESSES)) {
+		if (a_priv->addresses->len != b_priv->addresses->len)
+			return FALSE;
+		for (i = 0; i < a_priv->addresses->len; i++) {
+			NMIPAddress *a_addr = a_priv->addresses->pdata[i];
+			NMIPAddress *b_addr = b_priv->addresses->pdata[i];
+
+			if (   a_addr->family != b_addr->family
+			    || a_addr->prefix != b_addr->prefix
+			    || strcmp (a_addr->address, b_addr->address) != 0)
+				return FALSE;
+		}
+		/* The gateway is sent along with the first address */
+		return    a_priv->addresses->len == 0
+		       || g_strcmp0 (a_priv->gateway, b_priv->gateway) == 0;
+	}
+
+	if (!strcmp (prop_spec->name, NM_SETTING_IP_CONFIG_ROUTES)) {
+		if (a_priv->routes->len != b_priv->routes->len)
+			return FALSE;
+		for (i = 0; i < a_priv->routes->len; i++) {
+			NMIPRoute *a_route = a_priv->routes->pdata[i];
+			NMIPRoute *b_route = b_priv->routes->pdata[i];
+
+			/* The old routes format uses "0" for default, not "-1" */
+			if (   a_route->family != b_route->family
+			    || a_route->prefix != b_route->prefix
+			    || MAX (0, a_route->metric) != MAX (0, b_route->metric)
+			    || strcmp (a_route->dest, b_route->dest) != 0
+			    || g_strcmp0 (a_route->next_hop, b_route->next_hop) != 0)
+				return FALSE;
+		}
+		return TRUE;
+	}
+
+	return NM_SETTING_CLASS (nm_setting_ip_config_parent_class)->compare_property (setting, other, prop_spec, flags);
+}
+
 static void
 finalize (GObject *object)
 {
@@ -2131,6 +2201,7 @@ nm_setting_ip_config_class_init (NMSettingIPConfigClass *setting_class)
 	object_class->get_property = get_property;
 	object_class->finalize     = finalize;
 	parent_class->verify       = verify;
+	parent_class->compare_property = compare_property;
 
 	/* Properties */
 
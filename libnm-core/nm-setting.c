@@ -303,6 +303,7 @@ typedef struct {
 
 static GQuark setting_property_overrides_quark;
 static GQuark setting_properties_quark;
+static GQuark setting_properties_hash_quark;
 
 static NMSettingProperty *
 find_property (GArray *properties, const char *name)
@@ -524,6 +525,7 @@ nm_setting_class_ensure_properties (NMSettingClass *setting_class)
 	GType type = G_TYPE_FROM_CLASS (setting_class), otype;
 	NMSettingProperty property, *override;
 	GArray *overrides, *type_overrides, *properties;
+	GHashTable *properties_hash;
 	GParamSpec **property_specs;
 	guint n_property_specs, i;
 
@@ -565,7 +567,15 @@ nm_setting_class_ensure_properties (NMSettingClass *setting_class)
 	}
 	g_array_unref (overrides);
 
+	/* The array is never modified again, so the hash can point into it */
+	properties_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < properties->len; i++) {
+		override = &g_array_index (properties, NMSettingProperty, i);
+		g_hash_table_insert (properties_hash, (gpointer) override->name, override);
+	}
+
 	g_type_set_qdata (type, setting_properties_quark, properties);
+	g_type_set_qdata (type, setting_properties_hash_quark, properties_hash);
 	return properties;
 }
 
@@ -583,10 +593,10 @@ nm_setting_class_get_properties (NMSettingClass *setting_class, guint *n_propert
 static const NMSettingProperty *
 nm_setting_class_find_property (NMSettingClass *setting_class, const char *property_name)
 {
-	GArray *properties;
-
-	properties = nm_setting_class_ensure_properties (setting_class);
-	return find_property (properties, property_name);
+	nm_setting_class_ensure_properties (setting_class);
+	return g_hash_table_lookup (g_type_get_qdata (G_TYPE_FROM_CLASS (setting_class),
+	                                              setting_properties_hash_quark),
+	                            property_name);
 }
 
 /*************************************************************/
@@ -1006,6 +1016,76 @@ _nm_setting_verify (NMSetting *setting, NMConnection *connection, GError **error
 	return NM_SETTING_VERIFY_SUCCESS;
 }
 
+static gboolean
+compare_strv (const char *const *strv1, const char *const *strv2)
+{
+	guint i;
+
+	/* %NULL is sent as empty array */
+	if (!strv1 || !strv2)
+		return (!strv1 || !strv1[0]) && (!strv2 || !strv2[0]);
+
+	for (i = 0; strv1[i] && strv2[i]; i++) {
+		if (strcmp (strv1[i], strv2[i]) != 0)
+			return FALSE;
+	}
+	return !strv1[i] && !strv2[i];
+}
+
+/* Compare two property values of the types that get_property_for_dbus()
+ * converts generically, without building their #GVariant. Equality must be
+ * the same as nm_property_compare() of the D-Bus values would give.
+ * Returns -1 if the type isn't handled here. */
+static int
+compare_property_value (const GValue *value1, const GValue *value2)
+{
+	GType type = G_VALUE_TYPE (value1);
+
+	switch (G_TYPE_FUNDAMENTAL (type)) {
+	case G_TYPE_BOOLEAN:
+		return !g_value_get_boolean (value1) == !g_value_get_boolean (value2);
+	case G_TYPE_UCHAR:
+		return g_value_get_uchar (value1) == g_value_get_uchar (value2);
+	case G_TYPE_INT:
+		return g_value_get_int (value1) == g_value_get_int (value2);
+	case G_TYPE_UINT:
+		return g_value_get_uint (value1) == g_value_get_uint (value2);
+	case G_TYPE_INT64:
+		return g_value_get_int64 (value1) == g_value_get_int64 (value2);
+	case G_TYPE_UINT64:
+		return g_value_get_uint64 (value1) == g_value_get_uint64 (value2);
+	case G_TYPE_DOUBLE:
+		return g_value_get_double (value1) == g_value_get_double (value2);
+	case G_TYPE_ENUM:
+		return g_value_get_enum (value1) == g_value_get_enum (value2);
+	case G_TYPE_FLAGS:
+		return g_value_get_flags (value1) == g_value_get_flags (value2);
+	case G_TYPE_STRING:
+		/* %NULL is sent as empty string */
+		return strcmp (g_value_get_string (value1) ? : "",
+		               g_value_get_string (value2) ? : "") == 0;
+	case G_TYPE_BOXED:
+		if (type == G_TYPE_STRV)
+			return compare_strv (g_value_get_boxed (value1), g_value_get_boxed (value2));
+		if (type == G_TYPE_BYTES) {
+			GBytes *bytes1 = g_value_get_boxed (value1);
+			GBytes *bytes2 = g_value_get_boxed (value2);
+
+			/* %NULL is sent as empty array */
+			if (!bytes1 || !bytes2) {
+				return   (!bytes1 || !g_bytes_get_size (bytes1))
+				      && (!bytes2 || !g_bytes_get_size (bytes2));
+			}
+			return g_bytes_equal (bytes1, bytes2);
+		}
+		break;
+	default:
+		break;
+	}
+
+	return -1;
+}
+
 static gboolean
 compare_property (NMSetting *setting,
                   NMSetting *other,
@@ -1047,6 +1127,24 @@ compare_property (NMSetting *setting,
 	property = nm_setting_class_find_property (NM_SETTING_GET_CLASS (setting), prop_spec->name);
 	g_return_val_if_fail (property != NULL, FALSE);
 
+	/* Properties with a custom D-Bus representation can only be compared
+	 * in that representation. */
+	if (!property->get_func && !property->to_dbus && !property->dbus_type) {
+		GValue prop_value1 = G_VALUE_INIT, prop_value2 = G_VALUE_INIT;
+		int same;
+
+		g_value_init (&prop_value1, prop_spec->value_type);
+		g_value_init (&prop_value2, prop_spec->value_type);
+		g_object_get_property (G_OBJECT (setting), prop_spec->name, &prop_value1);
+		g_object_get_property (G_OBJECT (other), prop_spec->name, &prop_value2);
+		same = compare_property_value (&prop_value1, &prop_value2);
+		g_value_unset (&prop_value1);
+		g_value_unset (&prop_value2);
+
+		if (same >= 0)
+			return same;
+	}
+
 	value1 = get_property_for_dbus (setting, property, FALSE);
 	value2 = get_property_for_dbus (other, property, FALSE);
 
@@ -1075,8 +1173,8 @@ nm_setting_compare (NMSetting *a,
                     NMSetting *b,
                     NMSettingCompareFlags flags)
 {
-	GParamSpec **property_specs;
-	guint n_property_specs;
+	const NMSettingProperty *properties;
+	guint n_properties;
 	gint same = TRUE;
 	guint i;
 
@@ -1088,9 +1186,13 @@ nm_setting_compare (NMSetting *a,
 		return FALSE;
 
 	/* And now all properties */
-	property_specs = g_object_class_list_properties (G_OBJECT_GET_CLASS (a), &n_property_specs);
-	for (i = 0; i < n_property_specs && same; i++) {
-		GParamSpec *prop_spec = property_specs[i];
+	properties = nm_setting_class_get_properties (NM_SETTING_GET_CLASS (a), &n_properties);
+	for (i = 0; i < n_properties && same; i++) {
+		GParamSpec *prop_spec = properties[i].param_spec;
+
+		/* D-Bus only properties are compared through their GObject counterparts */
+		if (!prop_spec)
+			continue;
 
 		/* Fuzzy compare ignores secrets and properties defined with the FUZZY_IGNORE flag */
 		if (   (flags & NM_SETTING_COMPARE_FLAG_FUZZY)
@@ -1106,7 +1208,6 @@ nm_setting_compare (NMSetting *a,
 
 		same = NM_SETTING_GET_CLASS (a)->compare_property (a, b, prop_spec, flags);
 	}
-	g_free (property_specs);
 
 	return same;
 }
@@ -1192,8 +1293,8 @@ nm_setting_diff (NMSetting *a,
                  gboolean invert_results,
                  GHashTable **results)
 {
-	GParamSpec **property_specs;
-	guint n_property_specs;
+	const NMSettingProperty *properties;
+	guint n_properties;
 	guint i;
 	NMSettingDiffResult a_result = NM_SETTING_DIFF_RESULT_IN_A;
 	NMSettingDiffResult b_result = NM_SETTING_DIFF_RESULT_IN_B;
@@ -1236,12 +1337,15 @@ nm_setting_diff (NMSetting *a,
 	}
 
 	/* And now all properties */
-	property_specs = g_object_class_list_properties (G_OBJECT_GET_CLASS (a), &n_property_specs);
+	properties = nm_setting_class_get_properties (NM_SETTING_GET_CLASS (a), &n_properties);
 
-	for (i = 0; i < n_property_specs; i++) {
-		GParamSpec *prop_spec = property_specs[i];
+	for (i = 0; i < n_properties; i++) {
+		GParamSpec *prop_spec = properties[i].param_spec;
 		NMSettingDiffResult r = NM_SETTING_DIFF_RESULT_UNKNOWN;
 
+		if (!prop_spec)
+			continue;
+
 		/* Handle compare flags */
 		if (!should_compare_prop (a, prop_spec->name, flags, prop_spec->flags))
 			continue;
@@ -1303,7 +1407,6 @@ nm_setting_diff (NMSetting *a,
 				g_hash_table_insert (*results, g_strdup (prop_spec->name), GUINT_TO_POINTER (r));
 		}
 	}
-	g_free (property_specs);
 
 	/* Don't return an empty hash table */
 	if (results_created && !g_hash_table_size (*results)) {
@@ -1857,6 +1960,8 @@ nm_setting_class_init (NMSettingClass *setting_class)
 		setting_property_overrides_quark = g_quark_from_static_string ("nm-setting-property-overrides");
 	if (!setting_properties_quark)
 		setting_properties_quark = g_quark_from_static_string ("nm-setting-properties");
+	if (!setting_properties_hash_quark)
+		setting_properties_hash_quark = g_quark_from_static_string ("nm-setting-properties-hash");
 
 	g_type_class_add_private (setting_class, sizeof (NMSettingPrivate));
 
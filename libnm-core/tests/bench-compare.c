@@ -0,0 +1,269 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ *
+ */
+
+/* Benchmarks for nm_connection_compare() and nm_connection_diff() of
+ * connections with many IPv4 and IPv6 addresses and routes.
+ *
+ * Every benchmark is run for several rounds, doubling the number of
+ * addresses and routes in each round, and one line of JSON is printed per
+ * benchmark and round, see nm-bench-utils.h.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "nm-simple-connection.h"
+#include "nm-setting-connection.h"
+#include "nm-setting-wired.h"
+#include "nm-setting-ip4-config.h"
+#include "nm-setting-ip6-config.h"
+#include "nm-utils.h"
+
+#include "nm-test-utils.h"
+#include "nm-bench-utils.h"
+
+static struct {
+	guint count;
+	guint rounds;
+	guint iterations;
+} opts = {
+	.count = 64,
+	.rounds = 4,
+	.iterations = 20,
+};
+
+static NMBench bench;
+
+/*****************************************************************************/
+
+static void
+timing_report (const NMBenchTiming *t, guint round, guint count)
+{
+	nm_bench_timing_report (&bench, t, round, "\"count\": %u", count);
+}
+
+/*****************************************************************************/
+
+static void
+add_ip4 (NMSettingIPConfig *s_ip4, guint count)
+{
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		char dest[INET_ADDRSTRLEN];
+		in_addr_t a;
+		NMIPAddress *addr;
+		NMIPRoute *route;
+
+		a = htonl ((10u << 24) | (i + 1));
+		inet_ntop (AF_INET, &a, dest, sizeof (dest));
+		addr = nm_ip_address_new (AF_INET, dest, 8, NULL);
+		nm_setting_ip_config_add_address (s_ip4, addr);
+		nm_ip_address_unref (addr);
+
+		a = htonl ((172u << 24) | (i << 8));
+		inet_ntop (AF_INET, &a, dest, sizeof (dest));
+		route = nm_ip_route_new (AF_INET, dest, 24, "10.0.0.1", 100, NULL);
+		nm_setting_ip_config_add_route (s_ip4, route);
+		nm_ip_route_unref (route);
+	}
+}
+
+static void
+add_ip6 (NMSettingIPConfig *s_ip6, guint count)
+{
+	guint i;
+
+	for (i = 0; i < count; i++) {
+		char buf[64];
+		NMIPAddress *addr;
+		NMIPRoute *route;
+
+		g_snprintf (buf, sizeof (buf), "2001:db8::%x", i + 1);
+		addr = nm_ip_address_new (AF_INET6, buf, 64, NULL);
+		nm_setting_ip_config_add_address (s_ip6, addr);
+		nm_ip_address_unref (addr);
+
+		g_snprintf (buf, sizeof (buf), "2001:db8:%x::", i + 1);
+		route = nm_ip_route_new (AF_INET6, buf, 48, "2001:db8::ffff", 100, NULL);
+		nm_setting_ip_config_add_route (s_ip6, route);
+		nm_ip_route_unref (route);
+	}
+}
+
+static NMConnection *
+build_connection (guint count)
+{
+	NMConnection *connection;
+	NMSettingConnection *s_con;
+	NMSetting *s_ip4, *s_ip6;
+
+	connection = nmtst_create_minimal_connection ("bench-compare", NULL, NM_SETTING_WIRED_SETTING_NAME, &s_con);
+
+	s_ip4 = nm_setting_ip4_config_new ();
+	g_object_set (s_ip4,
+	              NM_SETTING_IP_CONFIG_METHOD, NM_SETTING_IP4_CONFIG_METHOD_MANUAL,
+	              NM_SETTING_IP_CONFIG_GATEWAY, "10.0.0.1",
+	              NULL);
+	add_ip4 (NM_SETTING_IP_CONFIG (s_ip4), count);
+	nm_connection_add_setting (connection, s_ip4);
+
+	s_ip6 = nm_setting_ip6_config_new ();
+	g_object_set (s_ip6,
+	              NM_SETTING_IP_CONFIG_METHOD, NM_SETTING_IP6_CONFIG_METHOD_MANUAL,
+	              NULL);
+	add_ip6 (NM_SETTING_IP_CONFIG (s_ip6), count);
+	nm_connection_add_setting (connection, s_ip6);
+
+	nmtst_connection_normalize (connection);
+	return connection;
+}
+
+/*****************************************************************************/
+
+/* nm_connection_compare() of two equal connections, and of connections
+ * that differ only in the last route, which has to walk everything too.
+ */
+static void
+bench_compare (guint round, guint count)
+{
+	gs_unref_object NMConnection *a = build_connection (count);
+	gs_unref_object NMConnection *b = nm_simple_connection_new_clone (a);
+	gs_unref_object NMConnection *c = nm_simple_connection_new_clone (a);
+	NMSettingIPConfig *s_ip6 = nm_connection_get_setting_ip6_config (c);
+	NMIPRoute *route;
+	NMBenchTiming same, different;
+	guint it;
+
+	route = nm_ip_route_new (AF_INET6, "2001:db9::", 48, NULL, 200, NULL);
+	nm_setting_ip_config_remove_route (s_ip6, nm_setting_ip_config_get_num_routes (s_ip6) - 1);
+	nm_setting_ip_config_add_route (s_ip6, route);
+	nm_ip_route_unref (route);
+
+	nm_bench_timing_init (&same, "connection-compare-same");
+	nm_bench_timing_init (&different, "connection-compare-different");
+
+	for (it = 0; it < opts.iterations; it++) {
+		gint64 start;
+
+		start = g_get_monotonic_time ();
+		g_assert (nm_connection_compare (a, b, NM_SETTING_COMPARE_FLAG_EXACT));
+		nm_bench_timing_add (&same, start);
+
+		start = g_get_monotonic_time ();
+		g_assert (!nm_connection_compare (a, c, NM_SETTING_COMPARE_FLAG_EXACT));
+		nm_bench_timing_add (&different, start);
+	}
+
+	timing_report (&same, round, count);
+	timing_report (&different, round, count);
+}
+
+/* nm_connection_diff() as done for detecting changes of a connection */
+static void
+bench_diff (guint round, guint count)
+{
+	gs_unref_object NMConnection *a = build_connection (count);
+	gs_unref_object NMConnection *b = nm_simple_connection_new_clone (a);
+	NMBenchTiming same, different;
+	guint it;
+
+	nm_bench_timing_init (&same, "connection-diff-same");
+	nm_bench_timing_init (&different, "connection-diff-different");
+
+	for (it = 0; it < opts.iterations; it++) {
+		GHashTable *results = NULL;
+		gint64 start;
+
+		start = g_get_monotonic_time ();
+		g_assert (nm_connection_diff (a, b, NM_SETTING_COMPARE_FLAG_EXACT, &results));
+		nm_bench_timing_add (&same, start);
+		g_assert (!results);
+	}
+
+	g_object_set (nm_connection_get_setting_ip4_config (b),
+	              NM_SETTING_IP_CONFIG_GATEWAY, "10.0.0.2",
+	              NULL);
+
+	for (it = 0; it < opts.iterations; it++) {
+		GHashTable *results = NULL;
+		gint64 start;
+
+		start = g_get_monotonic_time ();
+		g_assert (!nm_connection_diff (a, b, NM_SETTING_COMPARE_FLAG_EXACT, &results));
+		nm_bench_timing_add (&different, start);
+		g_assert (results);
+		g_hash_table_destroy (results);
+	}
+
+	timing_report (&same, round, count);
+	timing_report (&different, round, count);
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	GOptionEntry entries[] = {
+		{ "count", 0, 0, G_OPTION_ARG_INT, &opts.count, "Addresses and routes per family in the first round (default 64)", "N" },
+		{ "rounds", 0, 0, G_OPTION_ARG_INT, &opts.rounds, "Number of rounds, doubling the count each time (default 4)", "R" },
+		{ "iterations", 0, 0, G_OPTION_ARG_INT, &opts.iterations, "Iterations per benchmark and round (default 20)", "I" },
+		{ NULL }
+	};
+	GOptionContext *context;
+	GError *error = NULL;
+	guint round;
+
+	nmtst_init (&argc, &argv, TRUE);
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context, "Benchmark comparing connections with many addresses and routes.");
+	g_option_context_add_main_entries (context, entries, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("bench-compare: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (   opts.count < 1 || opts.rounds < 1 || opts.iterations < 1
+	    || ((guint64) opts.count << (opts.rounds - 1)) > 0xFFFF) {
+		g_printerr ("bench-compare: invalid workload size\n");
+		return EXIT_FAILURE;
+	}
+
+	nm_bench_init (&bench, 0);
+
+	for (round = 0; round < opts.rounds; round++) {
+		guint count = opts.count << round;
+
+		bench_compare (round, count);
+		bench_diff (round, count);
+	}
+
+	nm_bench_clear (&bench);
+	return EXIT_SUCCESS;
+}
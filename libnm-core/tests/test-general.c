@@ -2436,6 +2436,65 @@ test_setting_compare_timestamp (void)
 	g_assert (success);
 }
 
+/* The typed comparison must give the same result as comparing the
+ * D-Bus representation of the properties. */
+static void
+test_setting_compare_typed (void)
+{
+	gs_unref_object NMSetting *s_con1 = NULL, *s_con2 = NULL;
+	gs_unref_object NMSetting *s_ip1 = NULL, *s_ip2 = NULL;
+	NMIPAddress *addr;
+	NMIPRoute *route;
+	GHashTable *results = NULL;
+	GError *error = NULL;
+
+	s_con1 = nm_setting_connection_new ();
+	g_object_set (s_con1,
+	              NM_SETTING_CONNECTION_ID, "compare typed",
+	              NM_SETTING_CONNECTION_ZONE, NULL,
+	              NULL);
+	s_con2 = nm_setting_duplicate (s_con1);
+
+	/* %NULL and "" are both sent as "" */
+	g_object_set (s_con2, NM_SETTING_CONNECTION_ZONE, "", NULL);
+	g_assert (nm_setting_compare (s_con1, s_con2, NM_SETTING_COMPARE_FLAG_EXACT));
+	g_object_set (s_con2, NM_SETTING_CONNECTION_ZONE, "public", NULL);
+	g_assert (!nm_setting_compare (s_con1, s_con2, NM_SETTING_COMPARE_FLAG_EXACT));
+
+	s_ip1 = nm_setting_ip4_config_new ();
+	g_object_set (s_ip1,
+	              NM_SETTING_IP_CONFIG_METHOD, NM_SETTING_IP4_CONFIG_METHOD_MANUAL,
+	              NM_SETTING_IP_CONFIG_GATEWAY, "192.168.1.1",
+	              NULL);
+	addr = nm_ip_address_new (AF_INET, "192.168.1.5", 24, &error);
+	g_assert_no_error (error);
+	nm_setting_ip_config_add_address (NM_SETTING_IP_CONFIG (s_ip1), addr);
+	nm_ip_address_unref (addr);
+	route = nm_ip_route_new (AF_INET, "10.0.0.0", 8, "192.168.1.2", -1, &error);
+	g_assert_no_error (error);
+	nm_setting_ip_config_add_route (NM_SETTING_IP_CONFIG (s_ip1), route);
+	nm_ip_route_unref (route);
+	s_ip2 = nm_setting_duplicate (s_ip1);
+	g_assert (nm_setting_compare (s_ip1, s_ip2, NM_SETTING_COMPARE_FLAG_EXACT));
+
+	/* The old routes format can't tell the default metric from 0 */
+	nm_setting_ip_config_clear_routes (NM_SETTING_IP_CONFIG (s_ip2));
+	route = nm_ip_route_new (AF_INET, "10.0.0.0", 8, "192.168.1.2", 0, &error);
+	g_assert_no_error (error);
+	nm_setting_ip_config_add_route (NM_SETTING_IP_CONFIG (s_ip2), route);
+	nm_ip_route_unref (route);
+	g_assert (nm_setting_compare (s_ip1, s_ip2, NM_SETTING_COMPARE_FLAG_EXACT));
+
+	/* The gateway is part of the addresses */
+	g_object_set (s_ip2, NM_SETTING_IP_CONFIG_GATEWAY, "192.168.1.254", NULL);
+	g_assert (!nm_setting_diff (s_ip1, s_ip2, NM_SETTING_COMPARE_FLAG_EXACT, FALSE, &results));
+	g_assert (results);
+	g_assert (g_hash_table_contains (results, NM_SETTING_IP_CONFIG_GATEWAY));
+	g_assert (g_hash_table_contains (results, NM_SETTING_IP_CONFIG_ADDRESSES));
+	g_assert (!g_hash_table_contains (results, NM_SETTING_IP_CONFIG_ROUTES));
+	g_hash_table_destroy (results);
+}
+
 typedef struct {
 	NMSettingSecretFlags secret_flags;
 	NMSettingCompareFlags comp_flags;
@@ -4241,6 +4300,7 @@ int main (int argc, char **argv)
 	g_test_add_func ("/core/general/test_setting_to_dbus_enum", test_setting_to_dbus_enum);
 	g_test_add_func ("/core/general/test_setting_compare_id", test_setting_compare_id);
 	g_test_add_func ("/core/general/test_setting_compare_timestamp", test_setting_compare_timestamp);
+	g_test_add_func ("/core/general/test_setting_compare_typed", test_setting_compare_typed);
 #define ADD_FUNC(func, secret_flags, comp_flags, remove_secret) \
 	g_test_add_data_func_full ("/core/general/" G_STRINGIFY (func), \
 	                           test_data_compare_secrets_new (secret_flags, comp_flags, remove_secret), \
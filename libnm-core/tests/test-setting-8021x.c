@@ -23,11 +23,13 @@
 
 #include <glib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <nm-utils.h>
 
 #include "nm-setting-connection.h"
 #include "nm-setting-8021x.h"
+#include "crypto.h"
 
 #include "nm-test-utils.h"
 
@@ -434,6 +436,94 @@ do_8021x_test (gconstpointer test_data)
 	g_strfreev (parts);
 }
 
+static void
+verify_key_and_cert (const char *path, const char *password)
+{
+	NMSetting8021x *s_8021x;
+	NMSetting8021xCKFormat format = NM_SETTING_802_1X_CK_FORMAT_UNKNOWN;
+	GError *error = NULL;
+	gboolean success;
+
+	s_8021x = (NMSetting8021x *) nm_setting_802_1x_new ();
+
+	success = nm_setting_802_1x_set_ca_cert (s_8021x, path, NM_SETTING_802_1X_CK_SCHEME_PATH, &format, &error);
+	g_assert_no_error (error);
+	g_assert (success);
+	g_assert_cmpint (format, ==, NM_SETTING_802_1X_CK_FORMAT_X509);
+
+	format = NM_SETTING_802_1X_CK_FORMAT_UNKNOWN;
+	success = nm_setting_802_1x_set_private_key (s_8021x, path, password, NM_SETTING_802_1X_CK_SCHEME_PATH, &format, &error);
+	g_assert_no_error (error);
+	g_assert (success);
+	g_assert_cmpint (format, ==, NM_SETTING_802_1X_CK_FORMAT_RAW_KEY);
+	g_assert_cmpint (nm_setting_802_1x_get_private_key_format (s_8021x), ==, NM_SETTING_802_1X_CK_FORMAT_RAW_KEY);
+
+	g_object_unref (s_8021x);
+}
+
+static void
+rewrite_file (const char *path, const char *contents, gsize len)
+{
+	GError *error = NULL;
+
+	g_file_set_contents (path, contents, len, &error);
+	g_assert_no_error (error);
+}
+
+static void
+test_file_cache (void)
+{
+	char *orig_path, *contents = NULL, *path = NULL;
+	gsize len = 0;
+	GError *error = NULL;
+	guint reads;
+	int fd, i;
+
+	orig_path = g_build_filename (TEST_CERT_DIR, "test_key_and_cert.pem", NULL);
+	g_file_get_contents (orig_path, &contents, &len, &error);
+	g_assert_no_error (error);
+
+	fd = g_file_open_tmp ("test-8021x-XXXXXX.pem", &path, &error);
+	g_assert_no_error (error);
+	close (fd);
+	rewrite_file (path, contents, len);
+
+	/* The first activation reads the file */
+	reads = _crypto_file_read_count ();
+	verify_key_and_cert (path, "test");
+	g_assert_cmpint (_crypto_file_read_count (), >, reads);
+
+	/* Activating again uses the cached results */
+	reads = _crypto_file_read_count ();
+	for (i = 0; i < 10; i++)
+		verify_key_and_cert (path, "test");
+	g_assert_cmpint (_crypto_file_read_count (), ==, reads);
+
+	/* A different password isn't answered from the cache */
+	g_assert_cmpint (crypto_verify_private_key (path, "wrong", NULL, NULL), ==, NM_CRYPTO_FILE_FORMAT_UNKNOWN);
+	g_assert_cmpint (_crypto_file_read_count (), ==, reads + 1);
+
+	/* Replacing the file is noticed */
+	rewrite_file (path, contents, len);
+	reads = _crypto_file_read_count ();
+	verify_key_and_cert (path, "test");
+	g_assert_cmpint (_crypto_file_read_count (), >, reads);
+
+	reads = _crypto_file_read_count ();
+	verify_key_and_cert (path, "test");
+	g_assert_cmpint (_crypto_file_read_count (), ==, reads);
+
+	/* ... and so is explicit invalidation */
+	crypto_file_cache_invalidate (path);
+	verify_key_and_cert (path, "test");
+	g_assert_cmpint (_crypto_file_read_count (), >, reads);
+
+	unlink (path);
+	g_free (path);
+	g_free (contents);
+	g_free (orig_path);
+}
+
 NMTST_DEFINE ();
 
 int
@@ -453,6 +543,7 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/libnm/setting-8021x/pkcs12",
 	                      "test-cert.p12, test",
 	                      do_8021x_test);
+	g_test_add_func ("/libnm/setting-8021x/file-cache", test_file_cache);
 
 	return g_test_run ();
 }
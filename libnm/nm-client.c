@@ -1322,6 +1322,232 @@ nm_client_add_connection_finish (NMClient *client,
 		return g_object_ref (g_simple_async_result_get_op_res_gpointer (simple));
 }
 
+typedef struct {
+	char **paths;
+	char **errors;
+} AddConnectionsResult;
+
+static void
+add_connections_result_free (AddConnectionsResult *res)
+{
+	g_strfreev (res->paths);
+	g_strfreev (res->errors);
+	g_slice_free (AddConnectionsResult, res);
+}
+
+static void
+add_connections_cb (GObject *object,
+                    GAsyncResult *result,
+                    gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+	AddConnectionsResult *res;
+	GError *error = NULL;
+
+	res = g_slice_new0 (AddConnectionsResult);
+	if (nm_remote_settings_add_connections_finish (NM_REMOTE_SETTINGS (object),
+	                                               &res->paths, &res->errors,
+	                                               result, &error))
+		g_simple_async_result_set_op_res_gpointer (simple, res, (GDestroyNotify) add_connections_result_free);
+	else {
+		add_connections_result_free (res);
+		g_simple_async_result_take_error (simple, error);
+	}
+
+	g_simple_async_result_complete (simple);
+	g_object_unref (simple);
+}
+
+/**
+ * nm_client_add_connections_async:
+ * @client: the %NMClient
+ * @connections: (element-type NMConnection): the connections to add. Only
+ *   their settings are used
+ * @save_to_disk: whether to immediately save the connections to disk
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: (scope async): callback to be called when the add operation completes
+ * @user_data: (closure): caller-specific data passed to @callback
+ *
+ * Requests that the remote settings service add many connections at once.
+ * This is much faster than adding them one by one with
+ * nm_client_add_connection_async(): the request is authorized once and the
+ * connections are written to disk together.
+ *
+ * Each connection is added or rejected on its own. Unlike
+ * nm_client_add_connection_async(), this does not wait for the new
+ * #NMRemoteConnection objects; they appear in @client's connections array
+ * later.
+ *
+ * Since: 1.2
+ **/
+void
+nm_client_add_connections_async (NMClient *client,
+                                 const GPtrArray *connections,
+                                 gboolean save_to_disk,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data)
+{
+	GSimpleAsyncResult *simple;
+	GError *error = NULL;
+
+	g_return_if_fail (NM_IS_CLIENT (client));
+	g_return_if_fail (connections != NULL);
+
+	if (!_nm_client_check_nm_running (client, &error)) {
+		g_simple_async_report_take_gerror_in_idle (G_OBJECT (client), callback, user_data, error);
+		return;
+	}
+
+	simple = g_simple_async_result_new (G_OBJECT (client), callback, user_data,
+	                                    nm_client_add_connections_async);
+	nm_remote_settings_add_connections_async (NM_CLIENT_GET_PRIVATE (client)->settings,
+	                                          connections, save_to_disk,
+	                                          cancellable, add_connections_cb, simple);
+}
+
+/**
+ * nm_client_add_connections_finish:
+ * @client: an #NMClient
+ * @paths: (out) (transfer full) (allow-none): on return, the D-Bus paths of
+ *   the new connections in the order of the request, "/" for the connections
+ *   that were not added
+ * @errors: (out) (transfer full) (allow-none): on return, for each requested
+ *   connection the reason why it was not added, or an empty string
+ * @result: the result passed to the #GAsyncReadyCallback
+ * @error: location for a #GError, or %NULL
+ *
+ * Gets the result of a call to nm_client_add_connections_async().
+ *
+ * Returns: %TRUE if NetworkManager processed the request, %FALSE if the
+ *   request as a whole failed (eg, permission denied), in which case @error
+ *   will be set.
+ *
+ * Since: 1.2
+ **/
+gboolean
+nm_client_add_connections_finish (NMClient *client,
+                                  char ***paths,
+                                  char ***errors,
+                                  GAsyncResult *result,
+                                  GError **error)
+{
+	GSimpleAsyncResult *simple;
+	AddConnectionsResult *res;
+
+	g_return_val_if_fail (NM_IS_CLIENT (client), FALSE);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (result), FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+
+	res = g_simple_async_result_get_op_res_gpointer (simple);
+	if (paths)
+		*paths = g_strdupv (res->paths);
+	if (errors)
+		*errors = g_strdupv (res->errors);
+	return TRUE;
+}
+
+static void
+update_connections_cb (GObject *object,
+                       GAsyncResult *result,
+                       gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+	GError *error = NULL;
+	char **errors = NULL;
+
+	if (nm_remote_settings_update_connections_finish (NM_REMOTE_SETTINGS (object),
+	                                                  &errors, result, &error))
+		g_simple_async_result_set_op_res_gpointer (simple, errors, (GDestroyNotify) g_strfreev);
+	else
+		g_simple_async_result_take_error (simple, error);
+
+	g_simple_async_result_complete (simple);
+	g_object_unref (simple);
+}
+
+/**
+ * nm_client_update_connections_async:
+ * @client: the %NMClient
+ * @connections: (element-type NMConnection): the new settings of the
+ *   connections to update. The connection to update is the one with the
+ *   same UUID
+ * @save_to_disk: whether to immediately save the changes to disk
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: (scope async): callback to be called when the update operation completes
+ * @user_data: (closure): caller-specific data passed to @callback
+ *
+ * Requests that the remote settings service update many connections at
+ * once, like nm_remote_connection_commit_changes_async() does for a single
+ * one. Each connection is updated or rejected on its own.
+ *
+ * Since: 1.2
+ **/
+void
+nm_client_update_connections_async (NMClient *client,
+                                    const GPtrArray *connections,
+                                    gboolean save_to_disk,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+	GSimpleAsyncResult *simple;
+	GError *error = NULL;
+
+	g_return_if_fail (NM_IS_CLIENT (client));
+	g_return_if_fail (connections != NULL);
+
+	if (!_nm_client_check_nm_running (client, &error)) {
+		g_simple_async_report_take_gerror_in_idle (G_OBJECT (client), callback, user_data, error);
+		return;
+	}
+
+	simple = g_simple_async_result_new (G_OBJECT (client), callback, user_data,
+	                                    nm_client_update_connections_async);
+	nm_remote_settings_update_connections_async (NM_CLIENT_GET_PRIVATE (client)->settings,
+	                                             connections, save_to_disk,
+	                                             cancellable, update_connections_cb, simple);
+}
+
+/**
+ * nm_client_update_connections_finish:
+ * @client: an #NMClient
+ * @errors: (out) (transfer full) (allow-none): on return, for each requested
+ *   connection the reason why it was not updated, or an empty string
+ * @result: the result passed to the #GAsyncReadyCallback
+ * @error: location for a #GError, or %NULL
+ *
+ * Gets the result of a call to nm_client_update_connections_async().
+ *
+ * Returns: %TRUE if NetworkManager processed the request, %FALSE if the
+ *   request as a whole failed (eg, permission denied), in which case @error
+ *   will be set.
+ *
+ * Since: 1.2
+ **/
+gboolean
+nm_client_update_connections_finish (NMClient *client,
+                                     char ***errors,
+                                     GAsyncResult *result,
+                                     GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (NM_IS_CLIENT (client), FALSE);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (result), FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+
+	if (errors)
+		*errors = g_strdupv (g_simple_async_result_get_op_res_gpointer (simple));
+	return TRUE;
+}
+
 /**
  * nm_client_load_connections:
  * @client: the %NMClient
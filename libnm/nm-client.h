@@ -310,6 +310,33 @@ NMRemoteConnection *nm_client_add_connection_finish (NMClient *client,
                                                      GAsyncResult *result,
                                                      GError **error);
 
+NM_AVAILABLE_IN_1_2
+void     nm_client_add_connections_async     (NMClient *client,
+                                             const GPtrArray *connections,
+                                             gboolean save_to_disk,
+                                             GCancellable *cancellable,
+                                             GAsyncReadyCallback callback,
+                                             gpointer user_data);
+NM_AVAILABLE_IN_1_2
+gboolean nm_client_add_connections_finish    (NMClient *client,
+                                             char ***paths,
+                                             char ***errors,
+                                             GAsyncResult *result,
+                                             GError **error);
+
+NM_AVAILABLE_IN_1_2
+void     nm_client_update_connections_async  (NMClient *client,
+                                             const GPtrArray *connections,
+                                             gboolean save_to_disk,
+                                             GCancellable *cancellable,
+                                             GAsyncReadyCallback callback,
+                                             gpointer user_data);
+NM_AVAILABLE_IN_1_2
+gboolean nm_client_update_connections_finish (NMClient *client,
+                                             char ***errors,
+                                             GAsyncResult *result,
+                                             GError **error);
+
 gboolean nm_client_load_connections        (NMClient *client,
                                             char **filenames,
                                             char ***failures,
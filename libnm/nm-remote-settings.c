@@ -355,6 +355,168 @@ nm_remote_settings_add_connection_finish (NMRemoteSettings *settings,
 		return g_object_ref (g_simple_async_result_get_op_res_gpointer (simple));
 }
 
+typedef struct {
+	char **paths;
+	char **errors;
+} BatchResult;
+
+static void
+batch_result_free (BatchResult *batch)
+{
+	g_strfreev (batch->paths);
+	g_strfreev (batch->errors);
+	g_slice_free (BatchResult, batch);
+}
+
+static GVariant *
+connections_to_dbus (const GPtrArray *connections)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sa{sv}}"));
+	for (i = 0; i < connections->len; i++) {
+		g_variant_builder_add_value (&builder,
+		                             nm_connection_to_dbus (connections->pdata[i],
+		                                                    NM_CONNECTION_SERIALIZE_ALL));
+	}
+	return g_variant_builder_end (&builder);
+}
+
+static void
+add_connections_cb (GObject *proxy, GAsyncResult *result, gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+	GError *error = NULL;
+	BatchResult *batch;
+
+	batch = g_slice_new0 (BatchResult);
+	if (nmdbus_settings_call_add_connections_finish (NMDBUS_SETTINGS (proxy),
+	                                                 &batch->paths, &batch->errors,
+	                                                 result, &error))
+		g_simple_async_result_set_op_res_gpointer (simple, batch, (GDestroyNotify) batch_result_free);
+	else {
+		batch_result_free (batch);
+		g_dbus_error_strip_remote_error (error);
+		g_simple_async_result_take_error (simple, error);
+	}
+
+	g_simple_async_result_complete (simple);
+	g_object_unref (simple);
+}
+
+void
+nm_remote_settings_add_connections_async (NMRemoteSettings *settings,
+                                          const GPtrArray *connections,
+                                          gboolean save_to_disk,
+                                          GCancellable *cancellable,
+                                          GAsyncReadyCallback callback,
+                                          gpointer user_data)
+{
+	NMRemoteSettingsPrivate *priv;
+	GSimpleAsyncResult *simple;
+
+	g_return_if_fail (NM_IS_REMOTE_SETTINGS (settings));
+	g_return_if_fail (connections != NULL);
+
+	priv = NM_REMOTE_SETTINGS_GET_PRIVATE (settings);
+
+	simple = g_simple_async_result_new (G_OBJECT (settings), callback, user_data,
+	                                    nm_remote_settings_add_connections_async);
+
+	nmdbus_settings_call_add_connections (priv->proxy,
+	                                      connections_to_dbus (connections),
+	                                      save_to_disk,
+	                                      cancellable, add_connections_cb, simple);
+}
+
+gboolean
+nm_remote_settings_add_connections_finish (NMRemoteSettings *settings,
+                                           char ***paths,
+                                           char ***errors,
+                                           GAsyncResult *result,
+                                           GError **error)
+{
+	GSimpleAsyncResult *simple;
+	BatchResult *batch;
+
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, G_OBJECT (settings), nm_remote_settings_add_connections_async), FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+
+	batch = g_simple_async_result_get_op_res_gpointer (simple);
+	if (paths)
+		*paths = g_strdupv (batch->paths);
+	if (errors)
+		*errors = g_strdupv (batch->errors);
+	return TRUE;
+}
+
+static void
+update_connections_cb (GObject *proxy, GAsyncResult *result, gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+	GError *error = NULL;
+	char **errors = NULL;
+
+	if (nmdbus_settings_call_update_connections_finish (NMDBUS_SETTINGS (proxy),
+	                                                    &errors, result, &error))
+		g_simple_async_result_set_op_res_gpointer (simple, errors, (GDestroyNotify) g_strfreev);
+	else {
+		g_dbus_error_strip_remote_error (error);
+		g_simple_async_result_take_error (simple, error);
+	}
+
+	g_simple_async_result_complete (simple);
+	g_object_unref (simple);
+}
+
+void
+nm_remote_settings_update_connections_async (NMRemoteSettings *settings,
+                                             const GPtrArray *connections,
+                                             gboolean save_to_disk,
+                                             GCancellable *cancellable,
+                                             GAsyncReadyCallback callback,
+                                             gpointer user_data)
+{
+	NMRemoteSettingsPrivate *priv;
+	GSimpleAsyncResult *simple;
+
+	g_return_if_fail (NM_IS_REMOTE_SETTINGS (settings));
+	g_return_if_fail (connections != NULL);
+
+	priv = NM_REMOTE_SETTINGS_GET_PRIVATE (settings);
+
+	simple = g_simple_async_result_new (G_OBJECT (settings), callback, user_data,
+	                                    nm_remote_settings_update_connections_async);
+
+	nmdbus_settings_call_update_connections (priv->proxy,
+	                                         connections_to_dbus (connections),
+	                                         save_to_disk,
+	                                         cancellable, update_connections_cb, simple);
+}
+
+gboolean
+nm_remote_settings_update_connections_finish (NMRemoteSettings *settings,
+                                              char ***errors,
+                                              GAsyncResult *result,
+                                              GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, G_OBJECT (settings), nm_remote_settings_update_connections_async), FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+
+	if (errors)
+		*errors = g_strdupv (g_simple_async_result_get_op_res_gpointer (simple));
+	return TRUE;
+}
+
 gboolean
 nm_remote_settings_load_connections (NMRemoteSettings *settings,
                                      char **filenames,
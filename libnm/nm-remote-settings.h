@@ -83,6 +83,29 @@ NMRemoteConnection *nm_remote_settings_add_connection_finish (NMRemoteSettings *
                                                               GAsyncResult *result,
                                                               GError **error);
 
+void     nm_remote_settings_add_connections_async     (NMRemoteSettings *settings,
+                                                      const GPtrArray *connections,
+                                                      gboolean save_to_disk,
+                                                      GCancellable *cancellable,
+                                                      GAsyncReadyCallback callback,
+                                                      gpointer user_data);
+gboolean nm_remote_settings_add_connections_finish    (NMRemoteSettings *settings,
+                                                      char ***paths,
+                                                      char ***errors,
+                                                      GAsyncResult *result,
+                                                      GError **error);
+
+void     nm_remote_settings_update_connections_async  (NMRemoteSettings *settings,
+                                                      const GPtrArray *connections,
+                                                      gboolean save_to_disk,
+                                                      GCancellable *cancellable,
+                                                      GAsyncReadyCallback callback,
+                                                      gpointer user_data);
+gboolean nm_remote_settings_update_connections_finish (NMRemoteSettings *settings,
+                                                      char ***errors,
+                                                      GAsyncResult *result,
+                                                      GError **error);
+
 gboolean nm_remote_settings_load_connections        (NMRemoteSettings *settings,
                                                      char **filenames,
                                                      char ***failures,
@@ -285,6 +285,141 @@ nm_utils_modprobe (GError **error, const char *arg1, ...)
 	return exit_status;
 }
 
+/**
+ * nm_utils_iptables_rule_to_cmd:
+ * @rule: the rule
+ * @add: whether to insert or to delete the rule
+ *
+ * Returns: the iptables command line that inserts or deletes @rule on its
+ *   own.
+ */
+char *
+nm_utils_iptables_rule_to_cmd (const NMUtilsIPTablesRule *rule, gboolean add)
+{
+	g_return_val_if_fail (rule, NULL);
+
+	return g_strdup_printf ("%s --table %s %s %s",
+	                        IPTABLES_PATH,
+	                        rule->table,
+	                        add ? "--insert" : "--delete",
+	                        rule->rule);
+}
+
+/**
+ * nm_utils_iptables_rules_to_restore_script:
+ * @rules: (element-type NMUtilsIPTablesRule): the rules
+ * @add: whether to insert or to delete the rules
+ *
+ * Builds input for "iptables-restore --noflush" that has the same effect
+ * as running nm_utils_iptables_rule_to_cmd() for each rule of @rules in
+ * order, or in reverse order when deleting. Rules are grouped per table,
+ * keeping their relative order, so each table is committed only once.
+ *
+ * Returns: the script
+ */
+char *
+nm_utils_iptables_rules_to_restore_script (const GSList *rules, gboolean add)
+{
+	GString *script;
+	GSList *list, *iter, *tables = NULL, *titer;
+
+	list = g_slist_copy ((GSList *) rules);
+	if (!add)
+		list = g_slist_reverse (list);
+
+	for (iter = list; iter; iter = iter->next) {
+		const NMUtilsIPTablesRule *rule = iter->data;
+
+		if (!g_slist_find_custom (tables, rule->table, (GCompareFunc) strcmp))
+			tables = g_slist_append (tables, rule->table);
+	}
+
+	script = g_string_new (NULL);
+	for (titer = tables; titer; titer = titer->next) {
+		const char *table = titer->data;
+
+		g_string_append_printf (script, "*%s\n", table);
+		for (iter = list; iter; iter = iter->next) {
+			const NMUtilsIPTablesRule *rule = iter->data;
+
+			if (!strcmp (rule->table, table)) {
+				g_string_append_printf (script, "%s %s\n",
+				                        add ? "--insert" : "--delete",
+				                        rule->rule);
+			}
+		}
+		g_string_append (script, "COMMIT\n");
+	}
+
+	g_slist_free (tables);
+	g_slist_free (list);
+	return g_string_free (script, FALSE);
+}
+
+/**
+ * nm_utils_iptables_restore:
+ * @script: input for iptables-restore
+ * @error: location to store the error on failure
+ *
+ * Feeds @script to "iptables-restore --noflush" and waits for it to
+ * finish. iptables-restore applies each table atomically: if one rule of
+ * a table fails, none of the rules of that table are applied.
+ *
+ * Returns: %TRUE if iptables-restore succeeded
+ */
+gboolean
+nm_utils_iptables_restore (const char *script, GError **error)
+{
+	char *argv[] = { IPTABLES_RESTORE_PATH, "--noflush", NULL };
+	GPid pid;
+	int fd, status;
+	gsize len, written = 0;
+	ssize_t n;
+
+	g_return_val_if_fail (script, FALSE);
+
+	if (!g_spawn_async_with_pipes ("/", argv, NULL,
+	                               G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+	                               NULL, NULL, &pid, &fd, NULL, NULL, error))
+		return FALSE;
+
+	len = strlen (script);
+	while (written < len) {
+		n = write (fd, script + written, len - written);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		written += n;
+	}
+	close (fd);
+
+	while (waitpid (pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			int errsv = errno;
+
+			g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+			             "failed to wait for %s: %s", argv[0], g_strerror (errsv));
+			return FALSE;
+		}
+	}
+
+	if (!WIFEXITED (status) || WEXITSTATUS (status)) {
+		g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+		             "%s exited with status %d", argv[0],
+		             WIFEXITED (status) ? WEXITSTATUS (status) : -1);
+		return FALSE;
+	}
+	if (written < len) {
+		g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+		             "failed to write rules to %s", argv[0]);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 /**
  * nm_utils_get_start_time_for_pid:
  * @pid: the process identifier
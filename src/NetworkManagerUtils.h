@@ -53,6 +53,15 @@ int nm_spawn_process (const char *args, GError **error);
 
 int nm_utils_modprobe (GError **error, const char *arg1, ...) G_GNUC_NULL_TERMINATED;
 
+typedef struct {
+	char *table;
+	char *rule;      /* chain name followed by the rule specification */
+} NMUtilsIPTablesRule;
+
+char *nm_utils_iptables_rule_to_cmd (const NMUtilsIPTablesRule *rule, gboolean add);
+char *nm_utils_iptables_rules_to_restore_script (const GSList *rules, gboolean add);
+gboolean nm_utils_iptables_restore (const char *script, GError **error);
+
 /* check if @flags has exactly one flag (@check) set. You should call this
  * only with @check being a compile time constant and a power of two. */
 #define NM_FLAGS_HAS(flags, check)  \
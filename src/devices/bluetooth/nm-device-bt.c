@@ -88,12 +88,6 @@ enum {
 	LAST_PROP
 };
 
-enum {
-	PPP_STATS,
-
-	LAST_SIGNAL
-};
-static guint signals[LAST_SIGNAL] = { 0 };
 
 
 guint32 nm_device_bt_get_capabilities (NMDeviceBt *self)
@@ -350,15 +344,6 @@ complete_connection (NMDevice *device,
 /*****************************************************************************/
 /* IP method PPP */
 
-static void
-ppp_stats (NMModem *modem,
-		   guint32 in_bytes,
-		   guint32 out_bytes,
-		   gpointer user_data)
-{
-	g_signal_emit (NM_DEVICE_BT (user_data), signals[PPP_STATS], 0, in_bytes, out_bytes);
-}
-
 static void
 ppp_failed (NMModem *modem, NMDeviceStateReason reason, gpointer user_data)
 {
@@ -653,7 +638,6 @@ component_added (NMDevice *device, GObject *component)
 	}
 
 	priv->modem = g_object_ref (modem);
-	g_signal_connect (modem, NM_MODEM_PPP_STATS, G_CALLBACK (ppp_stats), self);
 	g_signal_connect (modem, NM_MODEM_PPP_FAILED, G_CALLBACK (ppp_failed), self);
 	g_signal_connect (modem, NM_MODEM_PREPARE_RESULT, G_CALLBACK (modem_prepare_result), self);
 	g_signal_connect (modem, NM_MODEM_IP4_CONFIG_RESULT, G_CALLBACK (modem_ip4_config_result), self);
@@ -1221,16 +1205,6 @@ nm_device_bt_class_init (NMDeviceBtClass *klass)
 		                      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
 		                      G_PARAM_STATIC_STRINGS));
 
-	/* Signals */
-	signals[PPP_STATS] =
-		g_signal_new ("ppp-stats",
-		              G_OBJECT_CLASS_TYPE (object_class),
-		              G_SIGNAL_RUN_FIRST,
-		              G_STRUCT_OFFSET (NMDeviceBtClass, ppp_stats),
-		              NULL, NULL, NULL,
-		              G_TYPE_NONE, 2,
-		              G_TYPE_UINT, G_TYPE_UINT);
-
 	nm_dbus_manager_register_exported_type (nm_dbus_manager_get (),
 	                                        G_TYPE_FROM_CLASS (klass),
 	                                        &dbus_glib_nm_device_bt_object_info);
@@ -44,9 +44,6 @@ typedef struct {
 
 typedef struct {
 	NMDeviceClass parent;
-
-	/* Signals */
-	void (*ppp_stats) (NMDeviceBt *device, guint32 in_bytes, guint32 out_bytes);
 } NMDeviceBtClass;
 
 GType nm_device_bt_get_type (void);
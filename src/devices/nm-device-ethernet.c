@@ -322,11 +322,9 @@ update_permanent_hw_address (NMDevice *dev)
 
 	g_return_if_fail (priv->perm_hw_addr == NULL);
 
-	fd = socket (PF_INET, SOCK_DGRAM, 0);
-	if (fd < 0) {
-		_LOGW (LOGD_HW, "couldn't open control socket.");
+	fd = nm_platform_ioctl_socket ();
+	if (fd < 0)
 		return;
-	}
 
 	/* Get permanent MAC address */
 	memset (&req, 0, sizeof (struct ifreq));
@@ -353,7 +351,6 @@ update_permanent_hw_address (NMDevice *dev)
 	priv->perm_hw_addr = nm_utils_hwaddr_ntoa (epaddr->data, ETH_ALEN);
 
 	g_free (epaddr);
-	close (fd);
 }
 
 static void
@@ -1573,21 +1570,16 @@ get_link_speed (NMDevice *device)
 	guint32 speed;
 	int fd;
 
-	fd = socket (PF_INET, SOCK_DGRAM, 0);
-	if (fd < 0) {
-		_LOGW (LOGD_HW | LOGD_ETHER, "couldn't open ethtool control socket.");
+	fd = nm_platform_ioctl_socket ();
+	if (fd < 0)
 		return;
-	}
 
 	memset (&ifr, 0, sizeof (struct ifreq));
 	strncpy (ifr.ifr_name, nm_device_get_iface (device), IFNAMSIZ);
 	ifr.ifr_data = (char *) &edata;
 
-	if (ioctl (fd, SIOCETHTOOL, &ifr) < 0) {
-		close (fd);
+	if (ioctl (fd, SIOCETHTOOL, &ifr) < 0)
 		return;
-	}
-	close (fd);
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,27)
 	speed = edata.speed;
@@ -70,6 +70,8 @@
 #include "nm-core-internal.h"
 #include "nm-default-route-manager.h"
 #include "nm-route-manager.h"
+#include "nm-activation-scheduler.h"
+#include "nm-stats.h"
 
 #include "nm-device-logging.h"
 _LOG_DECLARE_SELF (NMDevice);
@@ -130,6 +132,9 @@ enum {
 	PROP_MASTER,
 	PROP_HW_ADDRESS,
 	PROP_HAS_PENDING_ACTION,
+	PROP_REFRESH_RATE_MS,
+	PROP_TX_BYTES,
+	PROP_RX_BYTES,
 	LAST_PROP
 };
 
@@ -227,6 +232,16 @@ typedef struct {
 		NMDeviceStateReason post_state_reason;
 	}               dispatcher;
 
+	/* Monotonic timestamps (us) of pending activation phases, for NMStats */
+	struct {
+		gint64 state;       /* entering the current state */
+		gint64 activation;  /* entering PREPARE */
+		gint64 firewall;
+		gint64 ip4_config;
+		gint64 ip6_config;
+		gint64 pre_up;
+	}               timing;
+
 	/* Link stuff */
 	guint           link_connected_id;
 	guint           link_disconnected_id;
@@ -260,6 +275,7 @@ typedef struct {
 	/* DHCPv4 tracking */
 	NMDhcpClient *  dhcp4_client;
 	gulong          dhcp4_state_sigid;
+	guint           dhcp4_sched_id;
 	NMDhcp4Config * dhcp4_config;
 	NMIP4Config *   vpn4_config;  /* routes added by a VPN which uses this device */
 
@@ -272,6 +288,7 @@ typedef struct {
 
 	/* Firewall */
 	NMFirewallPendingCall fw_call;
+	guint                 fw_sched_id;
 
 	/* avahi-autoipd stuff */
 	GPid    aipd_pid;
@@ -302,6 +319,7 @@ typedef struct {
 	NMDhcpClient *  dhcp6_client;
 	NMRDiscDHCPLevel dhcp6_mode;
 	gulong          dhcp6_state_sigid;
+	guint           dhcp6_sched_id;
 	NMDhcp6Config * dhcp6_config;
 	/* IP6 config from DHCP */
 	NMIP6Config *   dhcp6_ip6_config;
@@ -319,8 +337,16 @@ typedef struct {
 	GSList *        slaves;    /* list of SlaveInfo */
 
 	NMConnectionProvider *con_provider;
+
+	struct {
+		guint   refresh_rate_ms;
+		guint64 tx_bytes;
+		guint64 rx_bytes;
+	} stats;
 } NMDevicePrivate;
 
+static void update_stats (NMDevice *self);
+
 static gboolean nm_device_set_ip4_config (NMDevice *self,
                                           NMIP4Config *config,
                                           guint32 default_route_metric,
@@ -466,12 +492,30 @@ reason_to_string (NMDeviceStateReason reason)
 gboolean
 nm_device_ipv6_sysctl_set (NMDevice *self, const char *property, const char *value)
 {
+	int ifindex = nm_device_get_ip_ifindex (self);
+
+	if (ifindex > 0)
+		return nm_platform_link_ip6_conf_set (NM_PLATFORM_GET, ifindex, property, value);
 	return nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip6_property_path (nm_device_get_ip_iface (self), property), value);
 }
 
+static char *
+nm_device_ipv6_sysctl_get (NMDevice *self, const char *property)
+{
+	int ifindex = nm_device_get_ip_ifindex (self);
+
+	if (ifindex > 0)
+		return nm_platform_link_ip6_conf_get (NM_PLATFORM_GET, ifindex, property);
+	return nm_platform_sysctl_get (NM_PLATFORM_GET, nm_utils_ip6_property_path (nm_device_get_ip_iface (self), property));
+}
+
 static guint32
 nm_device_ipv6_sysctl_get_int32 (NMDevice *self, const char *property, gint32 fallback)
 {
+	int ifindex = nm_device_get_ip_ifindex (self);
+
+	if (ifindex > 0)
+		return nm_platform_link_ip6_conf_get_int32 (NM_PLATFORM_GET, ifindex, property, fallback);
 	return nm_platform_sysctl_get_int32 (NM_PLATFORM_GET, nm_utils_ip6_property_path (nm_device_get_ip_iface (self), property), fallback);
 }
 
@@ -600,8 +644,79 @@ nm_device_set_ip_iface (NMDevice *self, const char *iface)
 	if (g_strcmp0 (old_ip_iface, priv->ip_iface))
 		g_object_notify (G_OBJECT (self), NM_DEVICE_IP_IFACE);
 	g_free (old_ip_iface);
+
+	if (priv->stats.refresh_rate_ms) {
+		nm_platform_link_stats_subscribe (NM_PLATFORM_GET, self,
+		                                  MAX (nm_device_get_ip_ifindex (self), 0),
+		                                  priv->stats.refresh_rate_ms);
+		update_stats (self);
+	}
 }
 
+/***********************************************************/
+
+/* The counters are those of the IP interface, so that a modem or PPPoE
+ * device reports the traffic of its PPP link.
+ */
+static void
+update_stats (NMDevice *self)
+{
+	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
+	NMPlatformLinkStats stats;
+	int ifindex;
+
+	ifindex = nm_device_get_ip_ifindex (self);
+	if (   ifindex <= 0
+	    || !nm_platform_link_get_stats (NM_PLATFORM_GET, ifindex, &stats))
+		return;
+
+	if (priv->stats.tx_bytes != stats.tx_bytes) {
+		priv->stats.tx_bytes = stats.tx_bytes;
+		g_object_notify (G_OBJECT (self), NM_DEVICE_STATISTICS_TX_BYTES);
+	}
+	if (priv->stats.rx_bytes != stats.rx_bytes) {
+		priv->stats.rx_bytes = stats.rx_bytes;
+		g_object_notify (G_OBJECT (self), NM_DEVICE_STATISTICS_RX_BYTES);
+	}
+}
+
+static void
+link_stats_changed_cb (NMPlatform *platform, NMDevice *self)
+{
+	update_stats (self);
+}
+
+static void
+set_stats_refresh_rate (NMDevice *self, guint refresh_rate_ms)
+{
+	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
+
+	if (priv->stats.refresh_rate_ms == refresh_rate_ms)
+		return;
+
+	_LOGD (LOGD_DEVICE, "statistics refresh rate set to %u ms", refresh_rate_ms);
+
+	if (!priv->stats.refresh_rate_ms) {
+		g_signal_connect (NM_PLATFORM_GET, NM_PLATFORM_SIGNAL_LINK_STATS_CHANGED,
+		                  G_CALLBACK (link_stats_changed_cb), self);
+	} else if (!refresh_rate_ms) {
+		g_signal_handlers_disconnect_by_func (NM_PLATFORM_GET, G_CALLBACK (link_stats_changed_cb), self);
+	}
+
+	priv->stats.refresh_rate_ms = refresh_rate_ms;
+	if (refresh_rate_ms) {
+		nm_platform_link_stats_subscribe (NM_PLATFORM_GET, self,
+		                                  MAX (nm_device_get_ip_ifindex (self), 0),
+		                                  refresh_rate_ms);
+		update_stats (self);
+	} else
+		nm_platform_link_stats_unsubscribe (NM_PLATFORM_GET, self);
+
+	g_object_notify (G_OBJECT (self), NM_DEVICE_STATISTICS_REFRESH_RATE_MS);
+}
+
+/***********************************************************/
+
 static gboolean
 get_ip_iface_identifier (NMDevice *self, NMUtilsIPv6IfaceId *out_iid)
 {
@@ -2340,6 +2455,22 @@ activation_source_clear (NMDevice *self, gboolean remove_source, int family)
 	}
 }
 
+static void
+timing_record (NMDevice *self, NMStatsStage stage, gint64 *since)
+{
+	const char *type_desc;
+
+	if (!*since)
+		return;
+
+	type_desc = nm_device_get_type_desc (self);
+	nm_stats_record_activation_stage (nm_stats_get (),
+	                                  type_desc ? type_desc : "unknown",
+	                                  stage,
+	                                  nm_utils_get_monotonic_timestamp_us () - *since);
+	*since = 0;
+}
+
 static void
 activation_source_schedule (NMDevice *self, GSourceFunc func, int family)
 {
@@ -2931,11 +3062,28 @@ ensure_con_ipx_config (NMDevice *self)
 /*********************************************/
 /* DHCPv4 stuff */
 
+static void
+dhcp4_sched_release (NMDevice *self)
+{
+	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
+
+	if (priv->dhcp4_sched_id) {
+		nm_activation_scheduler_release (nm_activation_scheduler_get (), priv->dhcp4_sched_id);
+		priv->dhcp4_sched_id = 0;
+	}
+}
+
 static void
 dhcp4_cleanup (NMDevice *self, gboolean stop, gboolean release)
 {
 	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
 
+	if (priv->dhcp4_sched_id && !priv->dhcp4_client) {
+		/* Still waiting for a DHCP slot */
+		nm_device_remove_pending_action (self, PENDING_ACTION_DHCP4, FALSE);
+	}
+	dhcp4_sched_release (self);
+
 	if (priv->dhcp4_client) {
 		/* Stop any ongoing DHCP transaction on this device */
 		if (priv->dhcp4_state_sigid) {
@@ -3154,6 +3302,9 @@ dhcp4_state_changed (NMDhcpClient *client,
 
 	_LOGD (LOGD_DHCP4, "new DHCPv4 client state %d", state);
 
+	/* The DHCP slot is only needed until the first outcome */
+	dhcp4_sched_release (self);
+
 	switch (state) {
 	case NM_DHCP_STATE_BOUND:
 		if (!ip4_config) {
@@ -3189,9 +3340,9 @@ dhcp4_state_changed (NMDhcpClient *client,
 }
 
 static NMActStageReturn
-dhcp4_start (NMDevice *self,
-             NMConnection *connection,
-             NMDeviceStateReason *reason)
+dhcp4_start_client (NMDevice *self,
+                    NMConnection *connection,
+                    NMDeviceStateReason *reason)
 {
 	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
 	NMSettingIPConfig *s_ip4;
@@ -3246,6 +3397,51 @@ dhcp4_start (NMDevice *self,
 	return NM_ACT_STAGE_RETURN_POSTPONE;
 }
 
+static void
+dhcp4_start_granted (gpointer user_data)
+{
+	NMDevice *self = NM_DEVICE (user_data);
+	NMDeviceStateReason reason = NM_DEVICE_STATE_REASON_NONE;
+
+	_LOGD (LOGD_DHCP4, "DHCPv4 slot granted, starting DHCP");
+
+	/* dhcp4_start_client() adds the pending action itself */
+	nm_device_remove_pending_action (self, PENDING_ACTION_DHCP4, TRUE);
+
+	if (dhcp4_start_client (self, nm_device_get_connection (self), &reason) == NM_ACT_STAGE_RETURN_FAILURE) {
+		/* Hand the slot to the next device right away */
+		dhcp4_sched_release (self);
+		dhcp4_fail (self, FALSE);
+	}
+}
+
+static NMActStageReturn
+dhcp4_start (NMDevice *self,
+             NMConnection *connection,
+             NMDeviceStateReason *reason)
+{
+	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
+	NMActStageReturn ret;
+
+	g_warn_if_fail (priv->dhcp4_sched_id == 0);
+
+	if (!nm_activation_scheduler_acquire (nm_activation_scheduler_get (),
+	                                      NM_ACTIVATION_RESOURCE_DHCP,
+	                                      nm_device_get_iface (self),
+	                                      dhcp4_start_granted,
+	                                      self,
+	                                      &priv->dhcp4_sched_id)) {
+		_LOGD (LOGD_DHCP4, "DHCPv4 start queued until a DHCP slot is available");
+		nm_device_add_pending_action (self, PENDING_ACTION_DHCP4, TRUE);
+		return NM_ACT_STAGE_RETURN_POSTPONE;
+	}
+
+	ret = dhcp4_start_client (self, connection, reason);
+	if (ret == NM_ACT_STAGE_RETURN_FAILURE)
+		dhcp4_sched_release (self);
+	return ret;
+}
+
 gboolean
 nm_device_dhcp4_renew (NMDevice *self, gboolean release)
 {
@@ -3513,11 +3709,24 @@ act_stage3_ip4_config_start (NMDevice *self,
 /*********************************************/
 /* DHCPv6 stuff */
 
+static void
+dhcp6_sched_release (NMDevice *self)
+{
+	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
+
+	if (priv->dhcp6_sched_id) {
+		nm_activation_scheduler_release (nm_activation_scheduler_get (), priv->dhcp6_sched_id);
+		priv->dhcp6_sched_id = 0;
+	}
+}
+
 static void
 dhcp6_cleanup (NMDevice *self, gboolean stop, gboolean release)
 {
 	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
 
+	dhcp6_sched_release (self);
+
 	priv->dhcp6_mode = NM_RDISC_DHCP_LEVEL_NONE;
 	g_clear_object (&priv->dhcp6_ip6_config);
 
@@ -3767,6 +3976,9 @@ dhcp6_state_changed (NMDhcpClient *client,
 
 	_LOGD (LOGD_DHCP6, "new DHCPv6 client state %d", state);
 
+	/* The DHCP slot is only needed until the first outcome */
+	dhcp6_sched_release (self);
+
 	switch (state) {
 	case NM_DHCP_STATE_BOUND:
 		g_clear_object (&priv->dhcp6_ip6_config);
@@ -3810,7 +4022,7 @@ dhcp6_state_changed (NMDhcpClient *client,
 }
 
 static gboolean
-dhcp6_start_with_link_ready (NMDevice *self, NMConnection *connection)
+dhcp6_start_client (NMDevice *self, NMConnection *connection)
 {
 	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
 	NMSettingIPConfig *s_ip6;
@@ -3853,6 +4065,44 @@ dhcp6_start_with_link_ready (NMDevice *self, NMConnection *connection)
 	return !!priv->dhcp6_client;
 }
 
+static void
+dhcp6_start_granted (gpointer user_data)
+{
+	NMDevice *self = NM_DEVICE (user_data);
+
+	_LOGD (LOGD_DHCP6, "DHCPv6 slot granted, starting DHCP");
+
+	if (!dhcp6_start_client (self, nm_device_get_connection (self))) {
+		_LOGW (LOGD_DHCP6, "failed to start DHCPv6");
+		dhcp6_sched_release (self);
+		dhcp6_fail (self, FALSE);
+	}
+}
+
+static gboolean
+dhcp6_start_with_link_ready (NMDevice *self, NMConnection *connection)
+{
+	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
+
+	g_warn_if_fail (priv->dhcp6_sched_id == 0);
+
+	if (!nm_activation_scheduler_acquire (nm_activation_scheduler_get (),
+	                                      NM_ACTIVATION_RESOURCE_DHCP,
+	                                      nm_device_get_iface (self),
+	                                      dhcp6_start_granted,
+	                                      self,
+	                                      &priv->dhcp6_sched_id)) {
+		_LOGD (LOGD_DHCP6, "DHCPv6 start queued until a DHCP slot is available");
+		return TRUE;
+	}
+
+	if (!dhcp6_start_client (self, connection)) {
+		dhcp6_sched_release (self);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 static gboolean
 dhcp6_start (NMDevice *self, gboolean wait_for_ll, NMDeviceStateReason *reason)
 {
@@ -4458,14 +4708,13 @@ static void
 save_ip6_properties (NMDevice *self)
 {
 	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
-	const char *ifname = nm_device_get_ip_iface (self);
 	char *value;
 	int i;
 
 	g_hash_table_remove_all (priv->ip6_saved_properties);
 
 	for (i = 0; i < G_N_ELEMENTS (ip6_properties_to_save); i++) {
-		value = nm_platform_sysctl_get (NM_PLATFORM_GET, nm_utils_ip6_property_path (ifname, ip6_properties_to_save[i]));
+		value = nm_device_ipv6_sysctl_get (self, ip6_properties_to_save[i]);
 		if (value) {
 			g_hash_table_insert (priv->ip6_saved_properties,
 			                     (char *) ip6_properties_to_save[i],
@@ -4503,7 +4752,6 @@ set_nm_ipv6ll (NMDevice *self, gboolean enable)
 {
 	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
 	int ifindex = nm_device_get_ip_ifindex (self);
-	const char *iface = nm_device_get_ip_iface (self);
 	char *value;
 
 	if (!nm_platform_check_support_user_ipv6ll (NM_PLATFORM_GET))
@@ -4520,7 +4768,7 @@ set_nm_ipv6ll (NMDevice *self, gboolean enable)
 
 		if (enable) {
 			/* Bounce IPv6 to ensure the kernel stops IPv6LL address generation */
-			value = nm_platform_sysctl_get (NM_PLATFORM_GET, nm_utils_ip6_property_path (iface, "disable_ipv6"));
+			value = nm_device_ipv6_sysctl_get (self, "disable_ipv6");
 			if (g_strcmp0 (value, "0") == 0)
 				nm_device_ipv6_sysctl_set (self, "disable_ipv6", "1");
 			g_free (value);
@@ -4880,6 +5128,7 @@ nm_device_activate_stage3_ip_config_start (gpointer user_data)
 	activation_source_clear (self, FALSE, 0);
 
 	priv->ip4_state = priv->ip6_state = IP_WAIT;
+	priv->timing.ip4_config = priv->timing.ip6_config = nm_utils_get_monotonic_timestamp_us ();
 
 	_LOGD (LOGD_DEVICE, "Activation: Stage 3 of 5 (IP Configure Start) started...");
 	nm_device_state_changed (self, NM_DEVICE_STATE_IP_CONFIG, NM_DEVICE_STATE_REASON_NONE);
@@ -4937,6 +5186,11 @@ fw_change_zone_cb (GError *error, gpointer user_data)
 	priv = NM_DEVICE_GET_PRIVATE (self);
 
 	priv->fw_call = NULL;
+	if (priv->fw_sched_id) {
+		nm_activation_scheduler_release (nm_activation_scheduler_get (), priv->fw_sched_id);
+		priv->fw_sched_id = 0;
+	}
+	timing_record (self, NM_STATS_STAGE_FIREWALL, &priv->timing.firewall);
 
 	if (error) {
 		/* FIXME: fail the device activation? */
@@ -4946,6 +5200,31 @@ fw_change_zone_cb (GError *error, gpointer user_data)
 	_LOGD (LOGD_DEVICE, "Activation: Stage 3 of 5 (IP Configure Start) scheduled.");
 }
 
+static void
+fw_change_zone (NMDevice *self)
+{
+	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
+	NMSettingConnection *s_con;
+	const char *zone;
+
+	s_con = nm_connection_get_setting_connection (nm_device_get_connection (self));
+	zone = nm_setting_connection_get_zone (s_con);
+
+	_LOGD (LOGD_DEVICE, "Activation: setting firewall zone '%s'", zone ? zone : "default");
+	priv->fw_call = nm_firewall_manager_add_or_change_zone (nm_firewall_manager_get (),
+	                                                        nm_device_get_ip_iface (self),
+	                                                        zone,
+	                                                        FALSE,
+	                                                        fw_change_zone_cb,
+	                                                        self);
+}
+
+static void
+fw_change_zone_granted (gpointer user_data)
+{
+	fw_change_zone (NM_DEVICE (user_data));
+}
+
 /*
  * nm_device_activate_schedule_stage3_ip_config_start
  *
@@ -4964,7 +5243,7 @@ nm_device_activate_schedule_stage3_ip_config_start (NMDevice *self)
 	priv = NM_DEVICE_GET_PRIVATE (self);
 	g_return_if_fail (priv->act_request);
 
-	g_return_if_fail (!priv->fw_call);
+	g_return_if_fail (!priv->fw_call && !priv->fw_sched_id);
 
 	/* Add the interface to the specified firewall zone */
 	connection = nm_device_get_connection (self);
@@ -4980,13 +5259,18 @@ nm_device_activate_schedule_stage3_ip_config_start (NMDevice *self)
 		return;
 	}
 
-	_LOGD (LOGD_DEVICE, "Activation: setting firewall zone '%s'", zone ? zone : "default");
-	priv->fw_call = nm_firewall_manager_add_or_change_zone (nm_firewall_manager_get (),
-	                                                        nm_device_get_ip_iface (self),
-	                                                        zone,
-	                                                        FALSE,
-	                                                        fw_change_zone_cb,
-	                                                        self);
+	priv->timing.firewall = nm_utils_get_monotonic_timestamp_us ();
+	if (!nm_activation_scheduler_acquire (nm_activation_scheduler_get (),
+	                                      NM_ACTIVATION_RESOURCE_FIREWALL,
+	                                      nm_device_get_iface (self),
+	                                      fw_change_zone_granted,
+	                                      self,
+	                                      &priv->fw_sched_id)) {
+		_LOGD (LOGD_DEVICE, "Activation: setting firewall zone '%s' queued", zone ? zone : "default");
+		return;
+	}
+
+	fw_change_zone (self);
 }
 
 static NMActStageReturn
@@ -5400,6 +5684,7 @@ nm_device_activate_ip4_config_commit (gpointer user_data)
 
 	/* Enter the IP_CHECK state if this is the first method to complete */
 	priv->ip4_state = IP_DONE;
+	timing_record (self, NM_STATS_STAGE_IP4_CONFIG, &priv->timing.ip4_config);
 
 	nm_device_remove_pending_action (self, PENDING_ACTION_DHCP4, FALSE);
 
@@ -5502,6 +5787,7 @@ nm_device_activate_ip6_config_commit (gpointer user_data)
 
 		/* Enter the IP_CHECK state if this is the first method to complete */
 		priv->ip6_state = IP_DONE;
+		timing_record (self, NM_STATS_STAGE_IP6_CONFIG, &priv->timing.ip6_config);
 
 		nm_device_remove_pending_action (self, PENDING_ACTION_DHCP6, FALSE);
 		nm_device_remove_pending_action (self, PENDING_ACTION_AUTOCONF6, FALSE);
@@ -5597,11 +5883,9 @@ _update_ip4_address (NMDevice *self)
 
 	g_return_if_fail (self  != NULL);
 
-	fd = socket (PF_INET, SOCK_DGRAM, 0);
-	if (fd < 0) {
-		_LOGE (LOGD_IP4, "couldn't open control socket.");
+	fd = nm_platform_ioctl_socket ();
+	if (fd < 0)
 		return;
-	}
 
 	memset (&req, 0, sizeof (struct ifreq));
 	strncpy (req.ifr_name, nm_device_get_ip_iface (self), IFNAMSIZ);
@@ -5610,7 +5894,6 @@ _update_ip4_address (NMDevice *self)
 		if (new_address != priv->ip4_address)
 			priv->ip4_address = new_address;
 	}
-	close (fd);
 }
 
 gboolean
@@ -6311,6 +6594,7 @@ dispatcher_complete_proceed_state (guint call_id, gpointer user_data)
 	g_return_if_fail (call_id == priv->dispatcher.call_id);
 
 	priv->dispatcher.call_id = 0;
+	timing_record (self, NM_STATS_STAGE_DISPATCHER_PRE_UP, &priv->timing.pre_up);
 	nm_device_queue_state (self, priv->dispatcher.post_state,
 	                       priv->dispatcher.post_state_reason);
 	priv->dispatcher.post_state = NM_DEVICE_STATE_UNKNOWN;
@@ -6331,6 +6615,7 @@ ip_check_pre_up (NMDevice *self)
 
 	priv->dispatcher.post_state = NM_DEVICE_STATE_SECONDARIES;
 	priv->dispatcher.post_state_reason = NM_DEVICE_STATE_REASON_NONE;
+	priv->timing.pre_up = nm_utils_get_monotonic_timestamp_us ();
 	if (!nm_dispatcher_call (DISPATCHER_ACTION_PRE_UP,
 	                         nm_device_get_connection (self),
 	                         self,
@@ -7440,6 +7725,10 @@ _cancel_activation (NMDevice *self)
 		nm_firewall_manager_cancel_call (nm_firewall_manager_get (), priv->fw_call);
 		priv->fw_call = NULL;
 	}
+	if (priv->fw_sched_id) {
+		nm_activation_scheduler_release (nm_activation_scheduler_get (), priv->fw_sched_id);
+		priv->fw_sched_id = 0;
+	}
 
 	ip_check_gw_ping_cleanup (self);
 
@@ -7614,21 +7903,30 @@ find_dhcp4_address (NMDevice *self)
 	return NULL;
 }
 
-void
-nm_device_spawn_iface_helper (NMDevice *self)
+/**
+ * nm_device_get_iface_helper_options:
+ * @self: the #NMDevice
+ *
+ * Returns: the nm-iface-helper options to keep managing the device's
+ *   dynamic IP configuration after NetworkManager quit, as one shell-quoted
+ *   string suitable for its --interface option; or %NULL if there is
+ *   nothing for the helper to do.
+ */
+char *
+nm_device_get_iface_helper_options (NMDevice *self)
 {
 	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
 	gboolean configured = FALSE;
 	NMConnection *connection;
-	GError *error = NULL;
 	const char *method;
 	GPtrArray *argv;
 	gs_free char *dhcp4_address = NULL;
+	char *options = NULL;
 
 	if (priv->state != NM_DEVICE_STATE_ACTIVATED)
-		return;
+		return NULL;
 	if (!nm_device_can_assume_connections (self))
-		return;
+		return NULL;
 
 	connection = nm_device_get_connection (self);
 	g_assert (connection);
@@ -7636,7 +7934,6 @@ nm_device_spawn_iface_helper (NMDevice *self)
 	argv = g_ptr_array_sized_new (10);
 	g_ptr_array_set_free_func (argv, g_free);
 
-	g_ptr_array_add (argv, g_strdup (LIBEXECDIR "/nm-iface-helper"));
 	g_ptr_array_add (argv, g_strdup ("--ifname"));
 	g_ptr_array_add (argv, g_strdup (nm_device_get_ip_iface (self)));
 	g_ptr_array_add (argv, g_strdup ("--uuid"));
@@ -7717,28 +8014,22 @@ nm_device_spawn_iface_helper (NMDevice *self)
 	}
 
 	if (configured) {
-		GPid pid;
-
-		g_ptr_array_add (argv, NULL);
+		GString *str = g_string_new (NULL);
+		guint i;
 
-		if (nm_logging_enabled (LOGL_DEBUG, LOGD_DEVICE)) {
-			char *tmp;
+		for (i = 0; i < argv->len; i++) {
+			gs_free char *quoted = g_shell_quote (argv->pdata[i]);
 
-			tmp = g_strjoinv (" ", (char **) argv->pdata);
-			_LOGD (LOGD_DEVICE, "running '%s'", tmp);
-			g_free (tmp);
-		}
-
-		if (g_spawn_async (NULL, (char **) argv->pdata, NULL,
-		                   G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error)) {
-			_LOGI (LOGD_DEVICE, "spawned helper PID %u", (guint) pid);
-		} else {
-			_LOGW (LOGD_DEVICE, "failed to spawn helper: %s", error->message);
-			g_error_free (error);
+			if (i > 0)
+				g_string_append_c (str, ' ');
+			g_string_append (str, quoted);
 		}
+		options = g_string_free (str, FALSE);
+		_LOGD (LOGD_DEVICE, "iface-helper options: %s", options);
 	}
 
 	g_ptr_array_unref (argv);
+	return options;
 }
 
 /***********************************************************/
@@ -7835,6 +8126,59 @@ deactivate_dispatcher_complete (guint call_id, gpointer user_data)
 		nm_device_queue_state (self, NM_DEVICE_STATE_DISCONNECTED, reason);
 }
 
+static void
+timing_state_changed (NMDevice *self, NMDeviceState old_state, NMDeviceState state)
+{
+	NMDevicePrivate *priv = NM_DEVICE_GET_PRIVATE (self);
+	NMStatsStage stage;
+
+	switch (old_state) {
+	case NM_DEVICE_STATE_PREPARE:
+		stage = NM_STATS_STAGE_PREPARE;
+		break;
+	case NM_DEVICE_STATE_CONFIG:
+		stage = NM_STATS_STAGE_CONFIG;
+		break;
+	case NM_DEVICE_STATE_NEED_AUTH:
+		stage = NM_STATS_STAGE_NEED_AUTH;
+		break;
+	case NM_DEVICE_STATE_IP_CONFIG:
+		stage = NM_STATS_STAGE_IP_CONFIG;
+		break;
+	case NM_DEVICE_STATE_IP_CHECK:
+		stage = NM_STATS_STAGE_IP_CHECK;
+		break;
+	case NM_DEVICE_STATE_SECONDARIES:
+		stage = NM_STATS_STAGE_SECONDARIES;
+		break;
+	default:
+		stage = _NM_STATS_STAGE_NUM;
+		break;
+	}
+
+	/* Only phases that completed successfully are recorded; time spent in
+	 * an activation that failed or got interrupted would skew the numbers.
+	 */
+	if (   stage != _NM_STATS_STAGE_NUM
+	    && state >= NM_DEVICE_STATE_PREPARE
+	    && state <= NM_DEVICE_STATE_ACTIVATED)
+		timing_record (self, stage, &priv->timing.state);
+
+	if (state == NM_DEVICE_STATE_ACTIVATED)
+		timing_record (self, NM_STATS_STAGE_TOTAL, &priv->timing.activation);
+
+	if (   state == NM_DEVICE_STATE_PREPARE
+	    || state < NM_DEVICE_STATE_PREPARE
+	    || state > NM_DEVICE_STATE_ACTIVATED)
+		memset (&priv->timing, 0, sizeof (priv->timing));
+
+	if (state >= NM_DEVICE_STATE_PREPARE && state < NM_DEVICE_STATE_ACTIVATED) {
+		priv->timing.state = nm_utils_get_monotonic_timestamp_us ();
+		if (state == NM_DEVICE_STATE_PREPARE)
+			priv->timing.activation = priv->timing.state;
+	}
+}
+
 static void
 _set_state_full (NMDevice *self,
                  NMDeviceState state,
@@ -7875,6 +8219,8 @@ _set_state_full (NMDevice *self,
 	       state,
 	       reason);
 
+	timing_state_changed (self, old_state, state);
+
 	/* Clear any queued transitions */
 	nm_device_queued_state_clear (self);
 
@@ -8401,11 +8747,9 @@ device_get_driver_info (NMDevice *self, const char *iface, char **driver_version
 	struct ifreq req;
 	int fd;
 
-	fd = socket (PF_INET, SOCK_DGRAM, 0);
-	if (fd < 0) {
-		_LOGW (LOGD_HW, "couldn't open control socket.");
+	fd = nm_platform_ioctl_socket ();
+	if (fd < 0)
 		return FALSE;
-	}
 
 	/* Get driver and firmware version info */
 	memset (&drvinfo, 0, sizeof (drvinfo));
@@ -8418,7 +8762,6 @@ device_get_driver_info (NMDevice *self, const char *iface, char **driver_version
 	if (ioctl (fd, SIOCETHTOOL, &req) < 0) {
 		_LOGD (LOGD_HW, "SIOCETHTOOL ioctl() failed: cmd=ETHTOOL_GDRVINFO, iface=%s, errno=%d",
 		       iface, errno);
-		close (fd);
 		return FALSE;
 	}
 	if (driver_version)
@@ -8426,7 +8769,6 @@ device_get_driver_info (NMDevice *self, const char *iface, char **driver_version
 	if (firmware_version)
 		*firmware_version = g_strdup (drvinfo.fw_version);
 
-	close (fd);
 	return TRUE;
 }
 
@@ -8614,6 +8956,8 @@ dispose (GObject *object)
 
 	_clear_queued_act_request (priv);
 
+	set_stats_refresh_rate (self, 0);
+
 	platform = nm_platform_get ();
 	g_signal_handlers_disconnect_by_func (platform, G_CALLBACK (device_ip_changed), self);
 	g_signal_handlers_disconnect_by_func (platform, G_CALLBACK (link_changed_cb), self);
@@ -8710,6 +9054,9 @@ set_property (GObject *object, guint prop_id,
 	case PROP_AUTOCONNECT:
 		nm_device_set_autoconnect (self, g_value_get_boolean (value));
 		break;
+	case PROP_REFRESH_RATE_MS:
+		set_stats_refresh_rate (self, g_value_get_uint (value));
+		break;
 	case PROP_FIRMWARE_MISSING:
 		priv->firmware_missing = g_value_get_boolean (value);
 		break;
@@ -8892,6 +9239,15 @@ get_property (GObject *object, guint prop_id,
 	case PROP_HAS_PENDING_ACTION:
 		g_value_set_boolean (value, nm_device_has_pending_action (self));
 		break;
+	case PROP_REFRESH_RATE_MS:
+		g_value_set_uint (value, priv->stats.refresh_rate_ms);
+		break;
+	case PROP_TX_BYTES:
+		g_value_set_uint64 (value, priv->stats.tx_bytes);
+		break;
+	case PROP_RX_BYTES:
+		g_value_set_uint64 (value, priv->stats.rx_bytes);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -9161,6 +9517,27 @@ nm_device_class_init (NMDeviceClass *klass)
 		                       G_PARAM_READABLE |
 		                       G_PARAM_STATIC_STRINGS));
 
+	g_object_class_install_property
+		(object_class, PROP_REFRESH_RATE_MS,
+		 g_param_spec_uint (NM_DEVICE_STATISTICS_REFRESH_RATE_MS, "", "",
+		                    0, G_MAXUINT32, 0,
+		                    G_PARAM_READWRITE |
+		                    G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property
+		(object_class, PROP_TX_BYTES,
+		 g_param_spec_uint64 (NM_DEVICE_STATISTICS_TX_BYTES, "", "",
+		                      0, G_MAXUINT64, 0,
+		                      G_PARAM_READABLE |
+		                      G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property
+		(object_class, PROP_RX_BYTES,
+		 g_param_spec_uint64 (NM_DEVICE_STATISTICS_RX_BYTES, "", "",
+		                      0, G_MAXUINT64, 0,
+		                      G_PARAM_READABLE |
+		                      G_PARAM_STATIC_STRINGS));
+
 	/* Signals */
 	signals[STATE_CHANGED] =
 		g_signal_new ("state-changed",
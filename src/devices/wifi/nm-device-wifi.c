@@ -142,6 +142,7 @@ struct _NMDeviceWifiPrivate {
 
 	guint32           failed_link_count;
 	guint             periodic_source_id;
+	gulong            station_changed_id;
 	guint             link_timeout_id;
 
 	NMDeviceWifiCapabilities capabilities;
@@ -461,6 +462,56 @@ periodic_update_cb (gpointer user_data)
 	return TRUE;
 }
 
+static void
+station_changed_cb (NMPlatform *platform, int ifindex, gpointer user_data)
+{
+	NMDeviceWifi *self = NM_DEVICE_WIFI (user_data);
+
+	if (ifindex == nm_device_get_ifindex (NM_DEVICE (self)))
+		periodic_update (self);
+}
+
+/* Signal strength and bitrate are updated when the platform reports a
+ * change; drivers that can't report changes are polled instead. */
+static void
+periodic_update_start (NMDeviceWifi *self)
+{
+	NMDeviceWifiPrivate *priv = NM_DEVICE_WIFI_GET_PRIVATE (self);
+	int ifindex = nm_device_get_ifindex (NM_DEVICE (self));
+
+	if (priv->periodic_source_id || priv->station_changed_id)
+		return;
+
+	if (ifindex > 0 && nm_platform_wifi_monitor_station (NM_PLATFORM_GET, ifindex, TRUE)) {
+		priv->station_changed_id = g_signal_connect (NM_PLATFORM_GET,
+		                                             NM_PLATFORM_SIGNAL_WIFI_STATION_CHANGED,
+		                                             G_CALLBACK (station_changed_cb),
+		                                             self);
+	} else
+		priv->periodic_source_id = g_timeout_add_seconds (6, periodic_update_cb, self);
+}
+
+static void
+periodic_update_stop (NMDeviceWifi *self)
+{
+	NMDeviceWifiPrivate *priv = NM_DEVICE_WIFI_GET_PRIVATE (self);
+	int ifindex;
+
+	if (priv->periodic_source_id) {
+		g_source_remove (priv->periodic_source_id);
+		priv->periodic_source_id = 0;
+	}
+
+	if (priv->station_changed_id) {
+		g_signal_handler_disconnect (NM_PLATFORM_GET, priv->station_changed_id);
+		priv->station_changed_id = 0;
+
+		ifindex = nm_device_get_ifindex (NM_DEVICE (self));
+		if (ifindex > 0)
+			nm_platform_wifi_monitor_station (NM_PLATFORM_GET, ifindex, FALSE);
+	}
+}
+
 static gboolean
 bring_up (NMDevice *device, gboolean *no_firmware)
 {
@@ -517,10 +568,7 @@ deactivate (NMDevice *device)
 		g_object_set_data (G_OBJECT (connection), WIRELESS_SECRETS_TRIES, NULL);
 	}
 
-	if (priv->periodic_source_id) {
-		g_source_remove (priv->periodic_source_id);
-		priv->periodic_source_id = 0;
-	}
+	periodic_update_stop (self);
 
 	cleanup_association_attempt (self, TRUE);
 
@@ -1456,7 +1504,8 @@ static void
 try_fill_ssid_for_hidden_ap (NMAccessPoint *ap)
 {
 	const char *bssid;
-	const GSList *connections, *iter;
+	NMConnection *connection;
+	GBytes *ssid;
 
 	g_return_if_fail (nm_ap_get_ssid (ap) == NULL);
 
@@ -1465,22 +1514,12 @@ try_fill_ssid_for_hidden_ap (NMAccessPoint *ap)
 
 	/* Look for this AP's BSSID in the seen-bssids list of a connection,
 	 * and if a match is found, copy over the SSID */
-	connections = nm_connection_provider_get_connections (nm_connection_provider_get ());
-	for (iter = connections; iter; iter = g_slist_next (iter)) {
-		NMConnection *connection = NM_CONNECTION (iter->data);
-		NMSettingWireless *s_wifi;
-
-		s_wifi = nm_connection_get_setting_wireless (connection);
-		if (s_wifi) {
-			if (nm_settings_connection_has_seen_bssid (NM_SETTINGS_CONNECTION (connection), bssid)) {
-				GBytes *ssid = nm_setting_wireless_get_ssid (s_wifi);
-
-				nm_ap_set_ssid (ap,
-				                g_bytes_get_data (ssid, NULL),
-				                g_bytes_get_size (ssid));
-				break;
-			}
-		}
+	connection = nm_connection_provider_get_connection_by_seen_bssid (nm_connection_provider_get (), bssid);
+	if (connection) {
+		ssid = nm_setting_wireless_get_ssid (nm_connection_get_setting_wireless (connection));
+		nm_ap_set_ssid (ap,
+		                g_bytes_get_data (ssid, NULL),
+		                g_bytes_get_size (ssid));
 	}
 }
 
@@ -2357,11 +2396,9 @@ update_permanent_hw_address (NMDevice *device)
 
 	g_return_if_fail (priv->perm_hw_addr == NULL);
 
-	fd = socket (PF_INET, SOCK_DGRAM, 0);
-	if (fd < 0) {
-		_LOGE (LOGD_HW, "could not open control socket.");
+	fd = nm_platform_ioctl_socket ();
+	if (fd < 0)
 		return;
-	}
 
 	/* Get permanent MAC address */
 	memset (&req, 0, sizeof (struct ifreq));
@@ -2385,7 +2422,6 @@ update_permanent_hw_address (NMDevice *device)
 	priv->perm_hw_addr = nm_utils_hwaddr_ntoa (epaddr->data, ETH_ALEN);
 
 	g_free (epaddr);
-	close (fd);
 }
 
 static void
@@ -2620,8 +2656,7 @@ act_stage2_config (NMDevice *device, NMDeviceStateReason *reason)
 	/* Set up a timeout on the association attempt to fail after 25 seconds */
 	priv->sup_timeout_id = g_timeout_add_seconds (25, supplicant_connection_timeout_cb, self);
 
-	if (!priv->periodic_source_id)
-		priv->periodic_source_id = g_timeout_add_seconds (6, periodic_update_cb, self);
+	periodic_update_start (self);
 
 	/* We'll get stage3 started when the supplicant connects */
 	ret = NM_ACT_STAGE_RETURN_POSTPONE;
@@ -2902,10 +2937,7 @@ device_state_changed (NMDevice *device,
 		if (priv->sup_iface)
 			supplicant_interface_release (self);
 
-		if (priv->periodic_source_id) {
-			g_source_remove (priv->periodic_source_id);
-			priv->periodic_source_id = 0;
-		}
+		periodic_update_stop (self);
 
 		cleanup_association_attempt (self, TRUE);
 		remove_all_aps (self);
@@ -3037,10 +3069,7 @@ dispose (GObject *object)
 	NMDeviceWifi *self = NM_DEVICE_WIFI (object);
 	NMDeviceWifiPrivate *priv = NM_DEVICE_WIFI_GET_PRIVATE (self);
 
-	if (priv->periodic_source_id) {
-		g_source_remove (priv->periodic_source_id);
-		priv->periodic_source_id = 0;
-	}
+	periodic_update_stop (self);
 
 	cleanup_association_attempt (self, TRUE);
 	supplicant_interface_release (self);
@@ -79,14 +79,9 @@ typedef struct {
 	guint32 secrets_id;
 
 	guint32 mm_ip_timeout;
-
-	/* PPP stats */
-	guint32 in_bytes;
-	guint32 out_bytes;
 } NMModemPrivate;
 
 enum {
-	PPP_STATS,
 	PPP_FAILED,
 	PREPARE_RESULT,
 	IP4_CONFIG_RESULT,
@@ -453,23 +448,6 @@ ppp_ip6_config (NMPPPManager *ppp_manager,
 	nm_modem_emit_ip6_config_result (self, config, NULL);
 }
 
-static void
-ppp_stats (NMPPPManager *ppp_manager,
-           guint32 in_bytes,
-           guint32 out_bytes,
-           gpointer user_data)
-{
-	NMModem *self = NM_MODEM (user_data);
-	NMModemPrivate *priv = NM_MODEM_GET_PRIVATE (self);
-
-	if (priv->in_bytes != in_bytes || priv->out_bytes != out_bytes) {
-		priv->in_bytes = in_bytes;
-		priv->out_bytes = out_bytes;
-
-		g_signal_emit (self, signals[PPP_STATS], 0, in_bytes, out_bytes);
-	}
-}
-
 static NMActStageReturn
 ppp_stage3_ip_config_start (NMModem *self,
                             NMActRequest *req,
@@ -520,9 +498,6 @@ ppp_stage3_ip_config_start (NMModem *self,
 		g_signal_connect (priv->ppp_manager, "ip6-config",
 		                  G_CALLBACK (ppp_ip6_config),
 		                  self);
-		g_signal_connect (priv->ppp_manager, "stats",
-		                  G_CALLBACK (ppp_stats),
-		                  self);
 
 		ret = NM_ACT_STAGE_RETURN_POSTPONE;
 	} else {
@@ -897,8 +872,6 @@ deactivate_cleanup (NMModem *self, NMDevice *device)
 		priv->act_request = NULL;
 	}
 
-	priv->in_bytes = priv->out_bytes = 0;
-
 	if (priv->ppp_manager) {
 		g_object_unref (priv->ppp_manager);
 		priv->ppp_manager = NULL;
@@ -1516,15 +1489,6 @@ nm_modem_class_init (NMModemClass *klass)
 
 	/* Signals */
 
-	signals[PPP_STATS] =
-		g_signal_new ("ppp-stats",
-		              G_OBJECT_CLASS_TYPE (object_class),
-		              G_SIGNAL_RUN_FIRST,
-		              G_STRUCT_OFFSET (NMModemClass, ppp_stats),
-		              NULL, NULL, NULL,
-		              G_TYPE_NONE, 2,
-		              G_TYPE_UINT, G_TYPE_UINT);
-
 	signals[PPP_FAILED] =
 		g_signal_new ("ppp-failed",
 		              G_OBJECT_CLASS_TYPE (object_class),
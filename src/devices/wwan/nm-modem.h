@@ -50,7 +50,6 @@ G_BEGIN_DECLS
 #define NM_MODEM_IP_TYPES     "ip-types"   /* Supported IP types */
 
 /* Signals */
-#define NM_MODEM_PPP_STATS         "ppp-stats"
 #define NM_MODEM_PPP_FAILED        "ppp-failed"
 #define NM_MODEM_PREPARE_RESULT    "prepare-result"
 #define NM_MODEM_IP4_CONFIG_RESULT "ip4-config-result"
@@ -157,7 +156,6 @@ typedef struct {
 	gboolean (*owns_port)                      (NMModem *self, const char *iface);
 
 	/* Signals */
-	void (*ppp_stats)  (NMModem *self, guint32 in_bytes, guint32 out_bytes);
 	void (*ppp_failed) (NMModem *self, NMDeviceStateReason reason);
 
 	void (*prepare_result)    (NMModem *self, gboolean success, NMDeviceStateReason reason);
@@ -642,21 +642,23 @@ nm_dhcp_client_stop (NMDhcpClient *self, gboolean release)
 /********************************************/
 
 static char *
-garray_to_string (GArray *array, const char *key)
+bytes_to_string (GBytes *bytes, const char *key)
 {
 	GString *str;
-	int i;
+	const guint8 *data;
+	gsize i, len;
 	unsigned char c;
 	char *converted = NULL;
 
-	g_return_val_if_fail (array != NULL, NULL);
+	g_return_val_if_fail (bytes != NULL, NULL);
 
 	/* Since the DHCP options come through environment variables, they should
 	 * already be UTF-8 safe, but just make sure.
 	 */
-	str = g_string_sized_new (array->len);
-	for (i = 0; i < array->len; i++) {
-		c = array->data[i];
+	data = g_bytes_get_data (bytes, &len);
+	str = g_string_sized_new (len);
+	for (i = 0; i < len; i++) {
+		c = data[i];
 
 		/* Convert NULLs to spaces and non-ASCII characters to ? */
 		if (c == '\0')
@@ -679,7 +681,7 @@ garray_to_string (GArray *array, const char *key)
 
 static void
 copy_option (const char * key,
-             GValue *value,
+             GBytes *value,
              gpointer user_data)
 {
 	GHashTable *hash = user_data;
@@ -693,11 +695,6 @@ copy_option (const char * key,
 		NULL
 	};
 
-	if (!G_VALUE_HOLDS (value, DBUS_TYPE_G_UCHAR_ARRAY)) {
-		nm_log_warn (LOGD_DHCP, "key %s value type was not DBUS_TYPE_G_UCHAR_ARRAY", key);
-		return;
-	}
-
 	if (g_str_has_prefix (key, OLD_TAG))
 		return;
 
@@ -712,7 +709,7 @@ copy_option (const char * key,
 	if (!key[0])
 		return;
 
-	str_value = garray_to_string ((GArray *) g_value_get_boxed (value), key);
+	str_value = bytes_to_string (value, key);
 	if (str_value)
 		g_hash_table_insert (hash, g_strdup (key), str_value);
 }
@@ -160,7 +160,7 @@ void nm_dhcp_client_set_state (NMDhcpClient *self,
 gboolean nm_dhcp_client_handle_event (gpointer unused,
                                       const char *iface,
                                       gint pid,
-                                      GHashTable *options,
+                                      GHashTable *options, /* str:GBytes hash */
                                       const char *reason,
                                       NMDhcpClient *self);
 
@@ -0,0 +1,301 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "nm-dhcp-helper-api.h"
+
+/**
+ * nm_dhcp_helper_env_is_ignored:
+ * @name: name of an environment variable of the DHCP client script
+ * @name_len: length of @name
+ *
+ * Returns: %TRUE if the variable is not DHCP related and must not be
+ *   forwarded to NetworkManager.
+ */
+gboolean
+nm_dhcp_helper_env_is_ignored (const char *name, gsize name_len)
+{
+	static const char *ignore[] = {"PATH", "SHLVL", "_", "PWD", "dhc_dbus", NULL};
+	const char **p;
+
+	for (p = ignore; *p; p++) {
+		gsize len = strlen (*p);
+
+		if (len <= name_len && strncmp (name, *p, len) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void
+append_u16 (GByteArray *buf, guint16 v)
+{
+	g_byte_array_append (buf, (const guint8 *) &v, sizeof (v));
+}
+
+static void
+append_u32 (GByteArray *buf, guint32 v)
+{
+	g_byte_array_append (buf, (const guint8 *) &v, sizeof (v));
+}
+
+/**
+ * nm_dhcp_helper_event_build:
+ * @envp: %NULL-terminated "NAME=value" environment of the DHCP client script
+ *
+ * Serializes the DHCP related variables of @envp into a lease event record.
+ *
+ * Returns: the record, or %NULL if it would exceed
+ *   %NM_DHCP_HELPER_EVENT_MAX_SIZE.
+ */
+GByteArray *
+nm_dhcp_helper_event_build (const char *const *envp)
+{
+	GByteArray *buf;
+	const char *const *item;
+	guint32 n_options = 0;
+
+	buf = g_byte_array_sized_new (4096);
+	append_u32 (buf, NM_DHCP_HELPER_EVENT_MAGIC);
+	append_u32 (buf, 0);
+
+	for (item = envp; *item; item++) {
+		const char *name = *item, *val;
+		gsize name_len, val_len;
+
+		val = strchr (name, '=');
+		if (!val || val == name)
+			continue;
+		name_len = val - name;
+		val++;
+		val_len = strlen (val);
+
+		/* Ignore non-DCHP-related environment variables */
+		if (nm_dhcp_helper_env_is_ignored (name, name_len))
+			continue;
+
+		if (name_len > G_MAXUINT16 || val_len > G_MAXUINT16)
+			goto too_large;
+
+		append_u16 (buf, name_len);
+		append_u16 (buf, val_len);
+		g_byte_array_append (buf, (const guint8 *) name, name_len);
+		g_byte_array_append (buf, (const guint8 *) val, val_len);
+		n_options++;
+
+		if (buf->len > NM_DHCP_HELPER_EVENT_MAX_SIZE)
+			goto too_large;
+	}
+
+	memcpy (&buf->data[sizeof (guint32)], &n_options, sizeof (n_options));
+	return buf;
+
+too_large:
+	g_byte_array_free (buf, TRUE);
+	return NULL;
+}
+
+static gboolean
+read_u16 (const guint8 **data, gsize *len, guint16 *out)
+{
+	if (*len < sizeof (*out))
+		return FALSE;
+	memcpy (out, *data, sizeof (*out));
+	*data += sizeof (*out);
+	*len -= sizeof (*out);
+	return TRUE;
+}
+
+static gboolean
+read_u32 (const guint8 **data, gsize *len, guint32 *out)
+{
+	if (*len < sizeof (*out))
+		return FALSE;
+	memcpy (out, *data, sizeof (*out));
+	*data += sizeof (*out);
+	*len -= sizeof (*out);
+	return TRUE;
+}
+
+/**
+ * nm_dhcp_helper_event_parse:
+ * @data: the record as received from the event socket
+ * @len: length of @data
+ *
+ * Returns: a #GHashTable mapping option names to #GBytes values, or
+ *   %NULL if the record is malformed.
+ */
+GHashTable *
+nm_dhcp_helper_event_parse (const guint8 *data, gsize len)
+{
+	GHashTable *options;
+	guint32 magic, n_options, i;
+
+	if (   !read_u32 (&data, &len, &magic)
+	    || magic != NM_DHCP_HELPER_EVENT_MAGIC
+	    || !read_u32 (&data, &len, &n_options))
+		return NULL;
+
+	options = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_bytes_unref);
+	for (i = 0; i < n_options; i++) {
+		guint16 name_len, val_len;
+
+		if (   !read_u16 (&data, &len, &name_len)
+		    || !read_u16 (&data, &len, &val_len)
+		    || name_len == 0
+		    || len < (gsize) name_len + val_len
+		    || memchr (data, '\0', name_len)) {
+			g_hash_table_unref (options);
+			return NULL;
+		}
+
+		g_hash_table_insert (options,
+		                     g_strndup ((const char *) data, name_len),
+		                     g_bytes_new (data + name_len, val_len));
+		data += name_len + val_len;
+		len -= name_len + val_len;
+	}
+
+	if (len != 0) {
+		/* Trailing garbage */
+		g_hash_table_unref (options);
+		return NULL;
+	}
+
+	return options;
+}
+
+static void
+event_socket_addr (struct sockaddr_un *addr, const char *path)
+{
+	memset (addr, 0, sizeof (*addr));
+	addr->sun_family = AF_UNIX;
+	g_strlcpy (addr->sun_path, path, sizeof (addr->sun_path));
+}
+
+/**
+ * nm_dhcp_helper_event_listen:
+ * @path: where to create the socket
+ *
+ * Creates the non-blocking socket NetworkManager accepts event records on,
+ * replacing any stale socket at @path.
+ *
+ * Returns: the listening socket, or a negative errno.
+ */
+int
+nm_dhcp_helper_event_listen (const char *path)
+{
+	struct sockaddr_un addr;
+	int fd, errsv;
+
+	fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd < 0)
+		return -errno;
+
+	event_socket_addr (&addr, path);
+	unlink (addr.sun_path);
+	if (   bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0
+	    || chmod (addr.sun_path, 0600) < 0
+	    || listen (fd, 64) < 0) {
+		errsv = errno;
+		close (fd);
+		return -errsv;
+	}
+	return fd;
+}
+
+/**
+ * nm_dhcp_helper_event_send:
+ * @path: the socket to deliver to
+ * @record: an event record from nm_dhcp_helper_event_build()
+ *
+ * Returns: 0 on success, or a negative errno. -ENOENT and -ECONNREFUSED
+ *   mean that nobody listens on @path.
+ */
+int
+nm_dhcp_helper_event_send (const char *path, const GByteArray *record)
+{
+	struct sockaddr_un addr;
+	ssize_t sent;
+	int fd, errsv = 0;
+
+	fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+
+	event_socket_addr (&addr, path);
+	if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+		errsv = errno;
+		close (fd);
+		return -errsv;
+	}
+
+	do {
+		sent = send (fd, record->data, record->len, MSG_NOSIGNAL);
+	} while (sent < 0 && errno == EINTR);
+	if (sent < 0)
+		errsv = errno;
+	else if (sent != (ssize_t) record->len)
+		errsv = EMSGSIZE;
+
+	close (fd);
+	return -errsv;
+}
+
+/**
+ * nm_dhcp_helper_event_recv:
+ * @fd: an accepted connection of the event socket
+ * @out_options: (out): on success, the options of the record as returned by
+ *   nm_dhcp_helper_event_parse(), or %NULL if the record is malformed or
+ *   too large
+ *
+ * Receives the record the helper sends on a connection, without blocking.
+ *
+ * Returns: the size of the record, 0 if the peer closed the connection
+ *   without sending one, or a negative errno.
+ */
+int
+nm_dhcp_helper_event_recv (int fd, GHashTable **out_options)
+{
+	guint8 *buf;
+	ssize_t len;
+
+	*out_options = NULL;
+
+	buf = g_malloc (NM_DHCP_HELPER_EVENT_MAX_SIZE);
+	len = recv (fd, buf, NM_DHCP_HELPER_EVENT_MAX_SIZE, MSG_DONTWAIT | MSG_TRUNC);
+	if (len < 0) {
+		int errsv = errno;
+
+		g_free (buf);
+		return -errsv;
+	}
+
+	if (len > 0 && len <= NM_DHCP_HELPER_EVENT_MAX_SIZE)
+		*out_options = nm_dhcp_helper_event_parse (buf, len);
+	g_free (buf);
+	return MIN (len, G_MAXINT);
+}
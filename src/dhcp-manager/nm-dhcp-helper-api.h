@@ -0,0 +1,55 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright 2015 Red Hat, Inc.
+ */
+
+#ifndef __NETWORKMANAGER_DHCP_HELPER_API_H__
+#define __NETWORKMANAGER_DHCP_HELPER_API_H__
+
+#include <glib.h>
+
+/* Shared between nm-dhcp-helper and the daemon; must only depend on glib. */
+
+#define NM_DHCP_HELPER_EVENT_SOCKET_PATH  NMRUNDIR "/private-dhcp-event"
+
+/* Each lease event is a single SOCK_SEQPACKET record:
+ *
+ *   guint32 magic
+ *   guint32 n_options
+ *   n_options times:
+ *     guint16 name_len
+ *     guint16 value_len
+ *     name_len bytes of name, value_len bytes of value (no trailing NUL)
+ *
+ * Integers are in host byte order since both peers live on the same host.
+ */
+#define NM_DHCP_HELPER_EVENT_MAGIC        0x4e4d4831 /* "NMH1" */
+#define NM_DHCP_HELPER_EVENT_MAX_SIZE     (64 * 1024)
+
+gboolean nm_dhcp_helper_env_is_ignored (const char *name, gsize name_len);
+
+GByteArray *nm_dhcp_helper_event_build (const char *const *envp);
+
+GHashTable *nm_dhcp_helper_event_parse (const guint8 *data, gsize len);
+
+/* The event socket. These return a negative errno on failure. */
+int nm_dhcp_helper_event_listen (const char *path);
+
+int nm_dhcp_helper_event_send (const char *path, const GByteArray *record);
+
+int nm_dhcp_helper_event_recv (int fd, GHashTable **out_options);
+
+#endif /* __NETWORKMANAGER_DHCP_HELPER_API_H__ */
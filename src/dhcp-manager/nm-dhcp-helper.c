@@ -24,12 +24,43 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
 
 #include <gio/gio.h>
 
+#include "nm-dhcp-helper-api.h"
+
 #define NM_DHCP_CLIENT_DBUS_IFACE   "org.freedesktop.nm_dhcp_client"
 
-static const char * ignore[] = {"PATH", "SHLVL", "_", "PWD", "dhc_dbus", NULL};
+/* Deliver the event as a single record over NetworkManager's event socket.
+ * This avoids the D-Bus connection setup and authentication handshake the
+ * fallback path has to do for every lease event.
+ *
+ * Returns: TRUE if the event was delivered, FALSE if the caller should
+ *   fall back to D-Bus.
+ */
+static gboolean
+send_event_record (void)
+{
+	GByteArray *record;
+	int ret;
+
+	record = nm_dhcp_helper_event_build ((const char *const *) environ);
+	if (!record)
+		return FALSE;
+
+	ret = nm_dhcp_helper_event_send (NM_DHCP_HELPER_EVENT_SOCKET_PATH, record);
+	g_byte_array_free (record, TRUE);
+
+	/* Older daemon or socket not available; not an error */
+	if (ret == -ENOENT || ret == -ECONNREFUSED)
+		return FALSE;
+	if (ret < 0) {
+		g_printerr ("Error: Could not send DHCP event record: %s\n", g_strerror (-ret));
+		return FALSE;
+	}
+	return TRUE;
+}
 
 static GVariant *
 build_signal_parameters (void)
@@ -41,7 +72,7 @@ build_signal_parameters (void)
 
 	/* List environment and format for dbus dict */
 	for (item = environ; *item; item++) {
-		char *name, *val, **p;
+		char *name, *val;
 
 		/* Split on the = */
 		name = g_strdup (*item);
@@ -51,10 +82,8 @@ build_signal_parameters (void)
 		*val++ = '\0';
 
 		/* Ignore non-DCHP-related environment variables */
-		for (p = (char **) ignore; *p; p++) {
-			if (strncmp (name, *p, strlen (*p)) == 0)
-				goto next;
-		}
+		if (nm_dhcp_helper_env_is_ignored (name, strlen (name)))
+			goto next;
 
 		/* Value passed as a byte array rather than a string, because there are
 		 * no character encoding guarantees with DHCP, and D-Bus requires
@@ -160,6 +189,9 @@ main (int argc, char *argv[])
 	GDBusConnection *connection;
 	GError *error = NULL;
 
+	if (send_event_record ())
+		return 0;
+
 	connection = g_dbus_connection_new_for_address_sync ("unix:path=" NMRUNDIR "/private-dhcp",
 	                                                     G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
 	                                                     NULL, NULL, &error);
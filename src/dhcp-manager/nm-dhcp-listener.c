@@ -31,6 +31,7 @@
 #include <unistd.h>
 
 #include "nm-dhcp-listener.h"
+#include "nm-dhcp-helper-api.h"
 #include "nm-core-internal.h"
 #include "nm-logging.h"
 #include "nm-dbus-manager.h"
@@ -48,6 +49,10 @@ typedef struct {
 	guint               dis_conn_id;
 	GHashTable *        proxies;
 	DBusGProxy *        proxy;
+
+	int                 event_fd;
+	guint               event_id;
+	GHashTable *        event_clients;
 } NMDhcpListenerPrivate;
 
 #define NM_DHCP_LISTENER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NM_TYPE_DHCP_LISTENER, NMDhcpListenerPrivate))
@@ -63,21 +68,23 @@ static guint signals[LAST_SIGNAL] = { 0 };
 /***************************************************/
 
 static char *
-garray_to_string (GArray *array, const char *key)
+bytes_to_string (GBytes *bytes, const char *key)
 {
 	GString *str;
-	int i;
+	const guint8 *data;
+	gsize i, len;
 	unsigned char c;
 	char *converted = NULL;
 
-	g_return_val_if_fail (array != NULL, NULL);
+	g_return_val_if_fail (bytes != NULL, NULL);
 
 	/* Since the DHCP options come through environment variables, they should
 	 * already be UTF-8 safe, but just make sure.
 	 */
-	str = g_string_sized_new (array->len);
-	for (i = 0; i < array->len; i++) {
-		c = array->data[i];
+	data = g_bytes_get_data (bytes, &len);
+	str = g_string_sized_new (len);
+	for (i = 0; i < len; i++) {
+		c = data[i];
 
 		/* Convert NULLs to spaces and non-ASCII characters to ? */
 		if (c == '\0')
@@ -98,28 +105,20 @@ garray_to_string (GArray *array, const char *key)
 static char *
 get_option (GHashTable *hash, const char *key)
 {
-	GValue *value;
+	GBytes *bytes;
 
-	value = g_hash_table_lookup (hash, key);
-	if (value == NULL)
+	bytes = g_hash_table_lookup (hash, key);
+	if (bytes == NULL)
 		return NULL;
 
-	if (G_VALUE_TYPE (value) != DBUS_TYPE_G_UCHAR_ARRAY) {
-		nm_log_warn (LOGD_DHCP, "unexpected key %s value type was not "
-		             "DBUS_TYPE_G_UCHAR_ARRAY",
-		             (char *) key);
-		return NULL;
-	}
-
-	return garray_to_string ((GArray *) g_value_get_boxed (value), key);
+	return bytes_to_string (bytes, key);
 }
 
+/* @options maps option names to #GBytes values, which is what the event
+ * records carry. */
 static void
-handle_event (DBusGProxy *proxy,
-              GHashTable *options,
-              gpointer user_data)
+emit_event (NMDhcpListener *self, GHashTable *options)
 {
-	NMDhcpListener *self = NM_DHCP_LISTENER (user_data);
 	char *iface = NULL;
 	char *pid_str = NULL;
 	char *reason = NULL;
@@ -160,6 +159,36 @@ out:
 	g_free (reason);
 }
 
+static void
+handle_event (DBusGProxy *proxy,
+              GHashTable *options,
+              gpointer user_data)
+{
+	NMDhcpListener *self = NM_DHCP_LISTENER (user_data);
+	GHashTable *bytes_options;
+	GHashTableIter iter;
+	const char *name;
+	GValue *value;
+
+	bytes_options = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) g_bytes_unref);
+	g_hash_table_iter_init (&iter, options);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &value)) {
+		GArray *array;
+
+		if (!G_VALUE_HOLDS (value, DBUS_TYPE_G_UCHAR_ARRAY)) {
+			nm_log_warn (LOGD_DHCP, "unexpected key %s value type was not "
+			             "DBUS_TYPE_G_UCHAR_ARRAY",
+			             name);
+			continue;
+		}
+		array = g_value_get_boxed (value);
+		g_hash_table_insert (bytes_options, (gpointer) name, g_bytes_new (array->data, array->len));
+	}
+
+	emit_event (self, bytes_options);
+	g_hash_table_unref (bytes_options);
+}
+
 #if HAVE_DBUS_GLIB_100
 static void
 new_connection_cb (NMDBusManager *mgr,
@@ -194,6 +223,96 @@ dis_connection_cb (NMDBusManager *mgr,
 
 /***************************************************/
 
+static gboolean
+event_client_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	NMDhcpListener *self = NM_DHCP_LISTENER (user_data);
+	NMDhcpListenerPrivate *priv = NM_DHCP_LISTENER_GET_PRIVATE (self);
+	int fd = g_io_channel_unix_get_fd (channel);
+	GHashTable *options;
+	int len;
+
+	if (condition & G_IO_IN) {
+		len = nm_dhcp_helper_event_recv (fd, &options);
+		if (len == -EAGAIN || len == -EINTR)
+			return TRUE;
+
+		/* The record's options are handed on as they are */
+		if (options) {
+			emit_event (self, options);
+			g_hash_table_unref (options);
+		} else if (len > NM_DHCP_HELPER_EVENT_MAX_SIZE)
+			nm_log_warn (LOGD_DHCP, "DHCP event: event record too large (%d bytes)", len);
+		else if (len > 0)
+			nm_log_warn (LOGD_DHCP, "DHCP event: malformed event record (%d bytes)", len);
+	}
+
+	/* The helper sends exactly one record per connection */
+	g_hash_table_remove (priv->event_clients, GINT_TO_POINTER (fd));
+	return FALSE;
+}
+
+static gboolean
+event_accept_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	NMDhcpListener *self = NM_DHCP_LISTENER (user_data);
+	NMDhcpListenerPrivate *priv = NM_DHCP_LISTENER_GET_PRIVATE (self);
+	struct ucred cred;
+	socklen_t cred_len = sizeof (cred);
+	GIOChannel *client;
+	guint id;
+	int fd;
+
+	fd = accept4 (priv->event_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (fd < 0)
+		return TRUE;
+
+	/* Only root may deliver leases, like on the private D-Bus socket */
+	if (   getsockopt (fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) < 0
+	    || cred.uid != 0) {
+		nm_log_warn (LOGD_DHCP, "DHCP event: rejecting event connection from non-root peer");
+		close (fd);
+		return TRUE;
+	}
+
+	client = g_io_channel_unix_new (fd);
+	g_io_channel_set_close_on_unref (client, TRUE);
+	id = g_io_add_watch (client, G_IO_IN | G_IO_ERR | G_IO_HUP, event_client_cb, self);
+	g_io_channel_unref (client);
+
+	g_hash_table_insert (priv->event_clients, GINT_TO_POINTER (fd), GUINT_TO_POINTER (id));
+	return TRUE;
+}
+
+static void
+event_socket_init (NMDhcpListener *self)
+{
+	NMDhcpListenerPrivate *priv = NM_DHCP_LISTENER_GET_PRIVATE (self);
+	GIOChannel *channel;
+	int fd;
+
+	fd = nm_dhcp_helper_event_listen (NM_DHCP_HELPER_EVENT_SOCKET_PATH);
+	if (fd < 0) {
+		nm_log_warn (LOGD_DHCP, "failed to set up DHCP event socket %s: %s",
+		             NM_DHCP_HELPER_EVENT_SOCKET_PATH, strerror (-fd));
+		return;
+	}
+	priv->event_fd = fd;
+
+	channel = g_io_channel_unix_new (priv->event_fd);
+	priv->event_id = g_io_add_watch (channel, G_IO_IN, event_accept_cb, self);
+	g_io_channel_unref (channel);
+}
+
+static void
+event_client_remove (gpointer data)
+{
+	/* Removing the watch drops the last channel reference, closing the fd */
+	g_source_remove (GPOINTER_TO_UINT (data));
+}
+
+/***************************************************/
+
 NM_DEFINE_SINGLETON_GETTER (NMDhcpListener, nm_dhcp_listener_get, NM_TYPE_DHCP_LISTENER);
 
 static void
@@ -209,6 +328,11 @@ nm_dhcp_listener_init (NMDhcpListener *self)
 
 	priv->dbus_mgr = nm_dbus_manager_get ();
 
+	/* Maps client fd :: watch id for nm-dhcp-helper event connections */
+	priv->event_clients = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, event_client_remove);
+	priv->event_fd = -1;
+	event_socket_init (self);
+
 #if HAVE_DBUS_GLIB_100
 	/* Register the socket our DHCP clients will return lease info on */
 	nm_dbus_manager_private_server_register (priv->dbus_mgr, PRIV_SOCK_PATH, PRIV_SOCK_TAG);
@@ -253,6 +377,20 @@ dispose (GObject *object)
 	}
 	g_clear_object (&priv->proxy);
 
+	if (priv->event_clients) {
+		g_hash_table_destroy (priv->event_clients);
+		priv->event_clients = NULL;
+	}
+	if (priv->event_id) {
+		g_source_remove (priv->event_id);
+		priv->event_id = 0;
+	}
+	if (priv->event_fd >= 0) {
+		close (priv->event_fd);
+		unlink (NM_DHCP_HELPER_EVENT_SOCKET_PATH);
+		priv->event_fd = -1;
+	}
+
 	G_OBJECT_CLASS (nm_dhcp_listener_parent_class)->dispose (object);
 }
 
@@ -277,6 +415,6 @@ nm_dhcp_listener_class_init (NMDhcpListenerClass *listener_class)
 		              4,
 		              G_TYPE_STRING,      /* iface */
 		              G_TYPE_INT,         /* pid */
-		              G_TYPE_HASH_TABLE,  /* options */
+		              G_TYPE_HASH_TABLE,  /* options: name :: GBytes */
 		              G_TYPE_STRING);     /* reason */
 }
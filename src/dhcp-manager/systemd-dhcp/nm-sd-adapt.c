@@ -33,10 +33,26 @@ struct sd_event_source {
 	GIOChannel *channel;
 	sd_event_io_handler_t io_cb;
 
+	clockid_t clock;
 	uint64_t usec;
 	sd_event_time_handler_t time_cb;
+	gint64 deadline;
+	GSequenceIter *timer_iter;
 };
 
+/* All time sources of all DHCP clients are kept in one queue ordered by
+ * deadline, driven by a single GSource armed for the earliest one. With
+ * many interfaces this avoids one GSource per retransmission/T1/T2/lease
+ * timer and coalesces timers that expire together into one wakeup.
+ */
+static struct {
+	GSequence *timers;
+	guint id;
+	gint64 armed_deadline;
+} timer_queue;
+
+static void timer_queue_rearm (void);
+
 int
 sd_event_source_set_priority (sd_event_source *s, int64_t priority)
 {
@@ -54,6 +70,11 @@ sd_event_source_unref (sd_event_source *s)
 
 	s->refcount--;
 	if (s->refcount == 0) {
+		if (s->timer_iter) {
+			g_sequence_remove (s->timer_iter);
+			s->timer_iter = NULL;
+			timer_queue_rearm ();
+		}
 		if (s->id)
 			g_source_remove (s->id);
 		if (s->channel) {
@@ -73,7 +94,9 @@ sd_event_source_set_description(sd_event_source *s, const char *description)
 	if (!s)
 		return -EINVAL;
 
-	g_source_set_name_by_id (s->id, description);
+	/* Time sources have no GSource of their own */
+	if (s->id)
+		g_source_set_name_by_id (s->id, description);
 	return 0;
 }
 
@@ -138,18 +161,74 @@ sd_event_add_io (sd_event *e, sd_event_source **s, int fd, uint32_t events, sd_e
 	return 0;
 }
 
+static gint
+timer_compare (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const struct sd_event_source *sa = a, *sb = b;
+
+	if (sa->deadline != sb->deadline)
+		return sa->deadline < sb->deadline ? -1 : 1;
+	/* Equal deadlines fire in insertion order */
+	return 0;
+}
+
 static gboolean
-time_ready (struct sd_event_source *source)
+timer_queue_dispatch (gpointer user_data)
 {
-	int r;
+	gint64 now_us = g_get_monotonic_time ();
+	GSequenceIter *iter;
+
+	timer_queue.id = 0;
+
+	while (   (iter = g_sequence_get_begin_iter (timer_queue.timers))
+	       && !g_sequence_iter_is_end (iter)) {
+		struct sd_event_source *source = g_sequence_get (iter);
+
+		if (source->deadline > now_us)
+			break;
+
+		/* Time sources are oneshot, as with sd-event. The callback
+		 * commonly drops the last external reference to the source.
+		 */
+		g_sequence_remove (iter);
+		source->timer_iter = NULL;
+		source->refcount++;
+		source->time_cb (source, source->usec, source->user_data);
+		sd_event_source_unref (source);
+	}
 
-	r = source->time_cb (source, source->usec, source->user_data);
-	if (r < 0) {
-		source->id = 0;
-		return G_SOURCE_REMOVE;
+	timer_queue_rearm ();
+	return G_SOURCE_REMOVE;
+}
+
+static void
+timer_queue_rearm (void)
+{
+	GSequenceIter *iter;
+	struct sd_event_source *first;
+	gint64 delay;
+
+	iter = g_sequence_get_begin_iter (timer_queue.timers);
+	if (g_sequence_iter_is_end (iter)) {
+		if (timer_queue.id) {
+			g_source_remove (timer_queue.id);
+			timer_queue.id = 0;
+		}
+		return;
 	}
 
-	return G_SOURCE_CONTINUE;
+	first = g_sequence_get (iter);
+	if (timer_queue.id) {
+		if (timer_queue.armed_deadline == first->deadline)
+			return;
+		g_source_remove (timer_queue.id);
+	}
+
+	delay = first->deadline - g_get_monotonic_time ();
+	if (delay < 0)
+		delay = 0;
+	timer_queue.armed_deadline = first->deadline;
+	timer_queue.id = g_timeout_add ((delay + 999) / 1000, timer_queue_dispatch, NULL);
 }
 
 int
@@ -162,16 +241,41 @@ sd_event_add_time(sd_event *e, sd_event_source **s, clockid_t clock, uint64_t us
 	source->refcount = 1;
 	source->time_cb = callback;
 	source->user_data = userdata;
+	source->clock = clock;
 	source->usec = usec;
 
-	if (usec > 1000)
-		usec = n < usec - 1000 ? usec - n : 1000;
-	source->id = g_timeout_add (usec / 1000, (GSourceFunc) time_ready, source);
+	/* @usec is absolute in @clock; translate into a monotonic deadline */
+	source->deadline = g_get_monotonic_time () + (usec > n ? usec - n : 0);
+
+	if (!timer_queue.timers)
+		timer_queue.timers = g_sequence_new (NULL);
+	source->timer_iter = g_sequence_insert_sorted (timer_queue.timers, source, timer_compare, NULL);
+	timer_queue_rearm ();
 
 	*s = source;
 	return 0;
 }
 
+int
+sd_event_source_set_time (sd_event_source *s, uint64_t usec)
+{
+	uint64_t n;
+
+	if (!s || !s->time_cb)
+		return -EINVAL;
+
+	n = now (s->clock);
+	s->usec = usec;
+	s->deadline = g_get_monotonic_time () + (usec > n ? usec - n : 0);
+
+	/* Also re-arms a source that already fired */
+	if (s->timer_iter)
+		g_sequence_remove (s->timer_iter);
+	s->timer_iter = g_sequence_insert_sorted (timer_queue.timers, s, timer_compare, NULL);
+	timer_queue_rearm ();
+	return 0;
+}
+
 /* sd_event is basically a GMainContext; but since we only
  * ever use the default context, nothing to do here.
  */
@@ -0,0 +1,280 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright 2015 Red Hat, Inc.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "nm-dhcp-helper-api.h"
+#include "nm-dhcp-utils.h"
+#include "nm-logging.h"
+#include "nm-platform.h"
+
+#include "gsystem-local-alloc.h"
+#include "nm-test-utils.h"
+
+/* Recorded dhclient script environments, one NAME=value per line */
+static char **
+read_event (const char *name)
+{
+	gs_free char *path = g_build_filename (TESTDIR, "events", name, NULL);
+	gs_free char *contents = NULL;
+	GError *error = NULL;
+	char **lines;
+
+	if (!g_file_get_contents (path, &contents, NULL, &error))
+		g_error ("failed to read %s: %s", path, error->message);
+	g_strchomp (contents);
+	lines = g_strsplit (contents, "\n", -1);
+	return lines;
+}
+
+static GHashTable *
+replay_event (const char *name)
+{
+	char **envp;
+	GByteArray *record;
+	GHashTable *options;
+
+	envp = read_event (name);
+	record = nm_dhcp_helper_event_build ((const char *const *) envp);
+	g_assert (record);
+	g_assert_cmpint (record->len, <=, NM_DHCP_HELPER_EVENT_MAX_SIZE);
+
+	options = nm_dhcp_helper_event_parse (record->data, record->len);
+	g_assert (options);
+
+	g_byte_array_free (record, TRUE);
+	g_strfreev (envp);
+	return options;
+}
+
+static void
+assert_option (GHashTable *options, const char *key, const char *expected)
+{
+	GBytes *bytes;
+	gconstpointer data;
+	gsize len;
+
+	bytes = g_hash_table_lookup (options, key);
+	if (!expected) {
+		g_assert (bytes == NULL);
+		return;
+	}
+	g_assert (bytes);
+	data = g_bytes_get_data (bytes, &len);
+	g_assert_cmpint (len, ==, strlen (expected));
+	g_assert (memcmp (data, expected, len) == 0);
+}
+
+/* Mirrors the option filtering NMDhcpClient applies to BOUND events */
+static GHashTable *
+to_str_options (GHashTable *options)
+{
+	GHashTable *str_options;
+	GHashTableIter iter;
+	const char *key;
+	GBytes *bytes;
+
+	str_options = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	g_hash_table_iter_init (&iter, options);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &bytes)) {
+		gconstpointer data;
+		gsize len;
+
+		if (!g_str_has_prefix (key, "new_"))
+			continue;
+		data = g_bytes_get_data (bytes, &len);
+		g_hash_table_insert (str_options, g_strdup (key + 4), g_strndup (data, len));
+	}
+	return str_options;
+}
+
+static void
+test_replay_bound (void)
+{
+	GHashTable *options, *str_options;
+	NMIP4Config *ip4_config;
+	const NMPlatformIP4Address *address;
+	guint32 tmp;
+
+	options = replay_event ("bound.env");
+
+	assert_option (options, "reason", "BOUND");
+	assert_option (options, "interface", "eth0");
+	assert_option (options, "pid", "1234");
+	assert_option (options, "new_domain_name_servers", "216.254.95.2 216.231.41.2");
+
+	/* Ignored environment is not forwarded */
+	assert_option (options, "PATH", NULL);
+	assert_option (options, "SHLVL", NULL);
+
+	str_options = to_str_options (options);
+	ip4_config = nm_dhcp_utils_ip4_config_from_options (1, "eth0", str_options, 0);
+	g_assert (ip4_config);
+
+	g_assert_cmpint (nm_ip4_config_get_num_addresses (ip4_config), ==, 1);
+	address = nm_ip4_config_get_address (ip4_config, 0);
+	g_assert (inet_pton (AF_INET, "192.168.1.106", &tmp) > 0);
+	g_assert (address->address == tmp);
+	g_assert_cmpint (address->plen, ==, 24);
+	g_assert (inet_pton (AF_INET, "192.168.1.1", &tmp) > 0);
+	g_assert (nm_ip4_config_get_gateway (ip4_config) == tmp);
+	g_assert_cmpint (nm_ip4_config_get_num_nameservers (ip4_config), ==, 2);
+	g_assert_cmpint (nm_ip4_config_get_mtu (ip4_config), ==, 987);
+
+	g_object_unref (ip4_config);
+	g_hash_table_unref (str_options);
+	g_hash_table_unref (options);
+}
+
+static void
+test_replay_renew (void)
+{
+	GHashTable *options;
+
+	options = replay_event ("renew.env");
+	assert_option (options, "reason", "RENEW");
+	assert_option (options, "old_ip_address", "192.168.1.106");
+	assert_option (options, "new_ip_address", "192.168.1.107");
+	assert_option (options, "PWD", NULL);
+	g_hash_table_unref (options);
+}
+
+static void
+test_replay_expire (void)
+{
+	GHashTable *options;
+
+	options = replay_event ("expire.env");
+	assert_option (options, "reason", "EXPIRE");
+	assert_option (options, "new_empty", "");
+	g_hash_table_unref (options);
+}
+
+static void
+test_malformed (void)
+{
+	const char *envp[] = { "reason=BOUND", "interface=eth0", NULL };
+	GByteArray *record;
+	guint i;
+
+	record = nm_dhcp_helper_event_build (envp);
+	g_assert (record);
+
+	/* Every truncation must be rejected */
+	for (i = 0; i < record->len; i++)
+		g_assert (nm_dhcp_helper_event_parse (record->data, i) == NULL);
+
+	/* Trailing garbage too */
+	g_byte_array_append (record, (const guint8 *) "x", 1);
+	g_assert (nm_dhcp_helper_event_parse (record->data, record->len) == NULL);
+
+	/* And a wrong magic */
+	record->data[0] ^= 0xFF;
+	g_assert (nm_dhcp_helper_event_parse (record->data, record->len - 1) == NULL);
+
+	g_byte_array_free (record, TRUE);
+}
+
+static void
+test_socket (void)
+{
+	const char *envp[] = { "reason=BOUND", "interface=eth0", "pid=1234",
+	                       "new_ip_address=192.168.1.106", "PATH=/usr/bin", NULL };
+	gs_free char *dir = NULL;
+	gs_free char *path = NULL;
+	GByteArray *record, *oversized;
+	GHashTable *options;
+	int listen_fd, fd, len;
+
+	dir = g_dir_make_tmp ("test-dhcp-helper-XXXXXX", NULL);
+	g_assert (dir);
+	path = g_build_filename (dir, "event", NULL);
+
+	/* Nobody listens yet; the helper falls back to D-Bus */
+	record = nm_dhcp_helper_event_build (envp);
+	g_assert (record);
+	g_assert_cmpint (nm_dhcp_helper_event_send (path, record), ==, -ENOENT);
+
+	listen_fd = nm_dhcp_helper_event_listen (path);
+	g_assert_cmpint (listen_fd, >=, 0);
+
+	/* One record per connection, readable once accepted */
+	g_assert_cmpint (nm_dhcp_helper_event_send (path, record), ==, 0);
+	fd = accept4 (listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	g_assert_cmpint (fd, >=, 0);
+
+	len = nm_dhcp_helper_event_recv (fd, &options);
+	g_assert_cmpint (len, ==, record->len);
+	g_assert (options);
+	assert_option (options, "reason", "BOUND");
+	assert_option (options, "interface", "eth0");
+	assert_option (options, "pid", "1234");
+	assert_option (options, "new_ip_address", "192.168.1.106");
+	assert_option (options, "PATH", NULL);
+	g_hash_table_unref (options);
+
+	/* The helper closed its end */
+	g_assert_cmpint (nm_dhcp_helper_event_recv (fd, &options), ==, 0);
+	g_assert (options == NULL);
+	close (fd);
+
+	/* Records beyond the limit are received whole, but not parsed */
+	oversized = g_byte_array_sized_new (NM_DHCP_HELPER_EVENT_MAX_SIZE + 1);
+	g_byte_array_append (oversized, record->data, record->len);
+	g_byte_array_set_size (oversized, NM_DHCP_HELPER_EVENT_MAX_SIZE + 1);
+	g_assert_cmpint (nm_dhcp_helper_event_send (path, oversized), ==, 0);
+	fd = accept4 (listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	g_assert_cmpint (fd, >=, 0);
+	g_assert_cmpint (nm_dhcp_helper_event_recv (fd, &options), ==, NM_DHCP_HELPER_EVENT_MAX_SIZE + 1);
+	g_assert (options == NULL);
+	close (fd);
+
+	/* Nothing pending on the listening socket */
+	g_assert_cmpint (accept4 (listen_fd, NULL, NULL, SOCK_CLOEXEC), <, 0);
+	g_assert_cmpint (errno, ==, EAGAIN);
+
+	close (listen_fd);
+	unlink (path);
+	rmdir (dir);
+	g_byte_array_free (oversized, TRUE);
+	g_byte_array_free (record, TRUE);
+}
+
+NMTST_DEFINE ();
+
+int main (int argc, char **argv)
+{
+	nmtst_init_assert_logging (&argc, &argv, "WARN", "DEFAULT");
+
+	g_test_add_func ("/dhcp/helper-api/replay-bound", test_replay_bound);
+	g_test_add_func ("/dhcp/helper-api/replay-renew", test_replay_renew);
+	g_test_add_func ("/dhcp/helper-api/replay-expire", test_replay_expire);
+	g_test_add_func ("/dhcp/helper-api/malformed", test_malformed);
+	g_test_add_func ("/dhcp/helper-api/socket", test_socket);
+
+	return g_test_run ();
+}
@@ -0,0 +1,183 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright 2015 Red Hat, Inc.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include "nm-logging.h"
+#include "nm-test-utils.h"
+
+#include "nm-sd-adapt.h"
+
+#include "sd-event.h"
+#include "time-util.h"
+
+/* Tests for the shared timer queue behind the sd-event time sources of
+ * the internal DHCP client. */
+
+static GString *fired;
+
+static struct {
+	sd_event_source *victim;
+} cancel_from_cb;
+
+static int
+time_cb (sd_event_source *s, uint64_t usec, void *userdata)
+{
+	g_string_append (fired, userdata);
+
+	if (cancel_from_cb.victim) {
+		sd_event_source_unref (cancel_from_cb.victim);
+		cancel_from_cb.victim = NULL;
+	}
+	return 0;
+}
+
+static sd_event_source *
+add_timer (guint delay_ms, const char *label)
+{
+	sd_event_source *s = NULL;
+	uint64_t n;
+
+	n = now (CLOCK_MONOTONIC);
+	g_assert_cmpint (sd_event_add_time (NULL, &s, CLOCK_MONOTONIC, n + delay_ms * USEC_PER_MSEC, 0,
+	                                    time_cb, (void *) label), ==, 0);
+	g_assert (s);
+	return s;
+}
+
+static void
+reschedule (sd_event_source *s, guint delay_ms)
+{
+	g_assert_cmpint (sd_event_source_set_time (s, now (CLOCK_MONOTONIC) + delay_ms * USEC_PER_MSEC), ==, 0);
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+	g_main_loop_quit (user_data);
+	return G_SOURCE_REMOVE;
+}
+
+/* Runs the main loop for @ms and returns the labels of the fired timers */
+static const char *
+run_for (guint ms)
+{
+	GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+
+	g_string_truncate (fired, 0);
+	g_timeout_add (ms, quit_cb, loop);
+	g_main_loop_run (loop);
+	g_main_loop_unref (loop);
+	return fired->str;
+}
+
+/*****************************************************************************/
+
+static void
+test_ordering (void)
+{
+	sd_event_source *s[5];
+
+	s[0] = add_timer (60, "d");
+	s[1] = add_timer (20, "a");
+	s[2] = add_timer (40, "c");
+	s[3] = add_timer (20, "b");
+	s[4] = add_timer (0, "0");
+
+	/* Equal deadlines fire in the order they were added */
+	g_assert_cmpstr (run_for (150), ==, "0abcd");
+
+	/* Time sources are oneshot */
+	g_assert_cmpstr (run_for (50), ==, "");
+
+	sd_event_source_unref (s[0]);
+	sd_event_source_unref (s[1]);
+	sd_event_source_unref (s[2]);
+	sd_event_source_unref (s[3]);
+	sd_event_source_unref (s[4]);
+}
+
+static void
+test_reschedule (void)
+{
+	sd_event_source *a, *b;
+
+	a = add_timer (20, "a");
+	b = add_timer (40, "b");
+
+	/* Moving the earliest timer back re-arms the queue for the next one */
+	reschedule (a, 80);
+	g_assert_cmpstr (run_for (150), ==, "ba");
+
+	/* And forward past others */
+	reschedule (a, 60);
+	reschedule (b, 80);
+	reschedule (a, 20);
+	g_assert_cmpstr (run_for (150), ==, "ab");
+
+	sd_event_source_unref (a);
+	sd_event_source_unref (b);
+}
+
+static void
+test_cancel (void)
+{
+	sd_event_source *a, *b, *c;
+
+	a = add_timer (20, "a");
+	b = add_timer (40, "b");
+	c = add_timer (60, "c");
+
+	/* Dropping the earliest timer must not fire it, nor stall the others */
+	sd_event_source_unref (a);
+	sd_event_source_unref (c);
+	g_assert_cmpstr (run_for (150), ==, "b");
+	sd_event_source_unref (b);
+
+	/* A callback may drop a timer that is due in the same dispatch */
+	a = add_timer (20, "a");
+	b = add_timer (20, "b");
+	cancel_from_cb.victim = b;
+	g_assert_cmpstr (run_for (100), ==, "a");
+	g_assert (!cancel_from_cb.victim);
+	sd_event_source_unref (a);
+
+	/* Nothing is left armed */
+	g_assert_cmpstr (run_for (50), ==, "");
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int main (int argc, char **argv)
+{
+	nmtst_init_assert_logging (&argc, &argv, "WARN", "DEFAULT");
+
+	fired = g_string_new (NULL);
+
+	g_test_add_func ("/dhcp/sd-event/ordering", test_ordering);
+	g_test_add_func ("/dhcp/sd-event/reschedule", test_reschedule);
+	g_test_add_func ("/dhcp/sd-event/cancel", test_cancel);
+
+	return g_test_run ();
+}
@@ -29,6 +29,7 @@
 
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <gio/gio.h>
 
 #include "nm-dns-dnsmasq.h"
 #include "nm-utils.h"
@@ -37,6 +38,7 @@
 #include "nm-ip6-config.h"
 #include "nm-dns-utils.h"
 #include "NetworkManagerUtils.h"
+#include "gsystem-local-alloc.h"
 
 G_DEFINE_TYPE (NMDnsDnsmasq, nm_dns_dnsmasq, NM_TYPE_DNS_PLUGIN)
 
@@ -47,13 +49,38 @@ G_DEFINE_TYPE (NMDnsDnsmasq, nm_dns_dnsmasq, NM_TYPE_DNS_PLUGIN)
 #define CONFDIR NMCONFDIR "/dnsmasq.d"
 
 typedef struct {
-	guint32 foo;
+	GDBusConnection *dbus_connection;
+	guint name_watch_id;
+
+	/* dnsmasq is started once with its D-Bus interface enabled and
+	 * upstream servers are pushed with SetServersEx.  If that doesn't
+	 * work, fall back to writing a config file and restarting dnsmasq
+	 * on every change.
+	 */
+	NMDnsDnsmasqFallback fallback;
+	gboolean running;            /* dnsmasq owns its bus name */
+	char *cmdline;               /* of the dnsmasq we spawned in D-Bus mode */
+	GVariant *servers;           /* aas, pushed whenever dnsmasq appears */
+	GCancellable *set_servers_cancellable;
 } NMDnsDnsmasqPrivate;
 
 /*******************************************/
 
+static void
+add_server (GVariantBuilder *servers, const char *addr, GPtrArray *domains)
+{
+	GVariantBuilder entry;
+	guint i;
+
+	g_variant_builder_init (&entry, G_VARIANT_TYPE ("as"));
+	g_variant_builder_add (&entry, "s", addr);
+	for (i = 0; domains && i < domains->len; i++)
+		g_variant_builder_add (&entry, "s", domains->pdata[i]);
+	g_variant_builder_add_value (servers, g_variant_builder_end (&entry));
+}
+
 static gboolean
-add_ip4_config (GString *str, NMIP4Config *ip4, gboolean split)
+add_ip4_config (GVariantBuilder *servers, NMIP4Config *ip4, gboolean split)
 {
 	char buf[INET_ADDRSTRLEN];
 	in_addr_t addr;
@@ -69,39 +96,37 @@ add_ip4_config (GString *str, NMIP4Config *ip4, gboolean split)
 			return FALSE;
 
 		for (i_nameserver = 0; i_nameserver < nnameservers; i_nameserver++) {
+			GPtrArray *server_domains = g_ptr_array_new ();
+
 			addr = nm_ip4_config_get_nameserver (ip4, i_nameserver);
 			nm_utils_inet4_ntop (addr, buf);
 
 			/* searches are preferred over domains */
 			n = nm_ip4_config_get_num_searches (ip4);
-			for (i = 0; i < n; i++) {
-				g_string_append_printf (str, "server=/%s/%s\n",
-				                        nm_ip4_config_get_search (ip4, i),
-				                        buf);
-				added = TRUE;
-			}
+			for (i = 0; i < n; i++)
+				g_ptr_array_add (server_domains, (gpointer) nm_ip4_config_get_search (ip4, i));
 
 			if (n == 0) {
 				/* If not searches, use any domains */
 				n = nm_ip4_config_get_num_domains (ip4);
-				for (i = 0; i < n; i++) {
-					g_string_append_printf (str, "server=/%s/%s\n",
-					                        nm_ip4_config_get_domain (ip4, i),
-					                        buf);
-					added = TRUE;
-				}
+				for (i = 0; i < n; i++)
+					g_ptr_array_add (server_domains, (gpointer) nm_ip4_config_get_domain (ip4, i));
 			}
 
 			/* Ensure reverse-DNS works by directing queries for in-addr.arpa
 			 * domains to the split domain's nameserver.
 			 */
 			domains = nm_dns_utils_get_ip4_rdns_domains (ip4);
-			if (domains) {
-				for (iter = domains; iter && *iter; iter++)
-					g_string_append_printf (str, "server=/%s/%s\n", *iter, buf);
-				g_strfreev (domains);
+			for (iter = domains; iter && *iter; iter++)
+				g_ptr_array_add (server_domains, *iter);
+
+			if (server_domains->len) {
+				add_server (servers, buf, server_domains);
 				added = TRUE;
 			}
+
+			g_ptr_array_unref (server_domains);
+			g_strfreev (domains);
 		}
 	}
 
@@ -109,7 +134,7 @@ add_ip4_config (GString *str, NMIP4Config *ip4, gboolean split)
 	if (!added) {
 		for (i = 0; i < nnameservers; i++) {
 			addr = nm_ip4_config_get_nameserver (ip4, i);
-			g_string_append_printf (str, "server=%s\n", nm_utils_inet4_ntop (addr, NULL));
+			add_server (servers, nm_utils_inet4_ntop (addr, NULL), NULL);
 		}
 	}
 
@@ -139,7 +164,7 @@ ip6_addr_to_string (const struct in6_addr *addr, const char *iface)
 }
 
 static gboolean
-add_ip6_config (GString *str, NMIP6Config *ip6, gboolean split)
+add_ip6_config (GVariantBuilder *servers, NMIP6Config *ip6, gboolean split)
 {
 	const struct in6_addr *addr;
 	char *buf = NULL;
@@ -157,29 +182,29 @@ add_ip6_config (GString *str, NMIP6Config *ip6, gboolean split)
 			return FALSE;
 
 		for (i_nameserver = 0; i_nameserver < nnameservers; i_nameserver++) {
+			GPtrArray *server_domains = g_ptr_array_new ();
+
 			addr = nm_ip6_config_get_nameserver (ip6, i_nameserver);
 			buf = ip6_addr_to_string (addr, iface);
 
 			/* searches are preferred over domains */
 			n = nm_ip6_config_get_num_searches (ip6);
-			for (i = 0; i < n; i++) {
-				g_string_append_printf (str, "server=/%s/%s\n",
-				                        nm_ip6_config_get_search (ip6, i),
-				                        buf);
-				added = TRUE;
-			}
+			for (i = 0; i < n; i++)
+				g_ptr_array_add (server_domains, (gpointer) nm_ip6_config_get_search (ip6, i));
 
 			if (n == 0) {
 				/* If not searches, use any domains */
 				n = nm_ip6_config_get_num_domains (ip6);
-				for (i = 0; i < n; i++) {
-					g_string_append_printf (str, "server=/%s/%s\n",
-					                        nm_ip6_config_get_domain (ip6, i),
-					                        buf);
-					added = TRUE;
-				}
+				for (i = 0; i < n; i++)
+					g_ptr_array_add (server_domains, (gpointer) nm_ip6_config_get_domain (ip6, i));
+			}
+
+			if (server_domains->len) {
+				add_server (servers, buf, server_domains);
+				added = TRUE;
 			}
 
+			g_ptr_array_unref (server_domains);
 			g_free (buf);
 		}
 	}
@@ -190,7 +215,7 @@ add_ip6_config (GString *str, NMIP6Config *ip6, gboolean split)
 			addr = nm_ip6_config_get_nameserver (ip6, i);
 			buf = ip6_addr_to_string (addr, iface);
 			if (buf) {
-				g_string_append_printf (str, "server=%s\n", buf);
+				add_server (servers, buf, NULL);
 				g_free (buf);
 			}
 		}
@@ -199,76 +224,268 @@ add_ip6_config (GString *str, NMIP6Config *ip6, gboolean split)
 	return TRUE;
 }
 
-static gboolean
-update (NMDnsPlugin *plugin,
-        const GSList *vpn_configs,
-        const GSList *dev_configs,
-        const GSList *other_configs,
-        const char *hostname)
+static void
+add_configs (GVariantBuilder *servers, const GSList *configs, gboolean split)
 {
-	NMDnsDnsmasq *self = NM_DNS_DNSMASQ (plugin);
-	const char *dm_binary;
-	GString *conf;
-	GSList *iter;
-	const char *argv[15];
-	GError *error = NULL;
-	int ignored;
-	GPid pid = 0;
-	guint idx = 0;
-
-	/* Kill the old dnsmasq; there doesn't appear to be a way to get dnsmasq
-	 * to reread the config file using SIGHUP or similar.  This is a small race
-	 * here when restarting dnsmasq when DNS requests could go to the upstream
-	 * servers instead of to dnsmasq.
-	 */
-	nm_dns_plugin_child_kill (plugin);
+	const GSList *iter;
 
-	dm_binary = nm_utils_find_helper ("dnsmasq", DNSMASQ_PATH, NULL);
-	if (!dm_binary) {
-		nm_log_warn (LOGD_DNS, "Could not find dnsmasq binary");
-		return FALSE;
+	for (iter = configs; iter; iter = g_slist_next (iter)) {
+		if (NM_IS_IP4_CONFIG (iter->data))
+			add_ip4_config (servers, NM_IP4_CONFIG (iter->data), split);
+		else if (NM_IS_IP6_CONFIG (iter->data))
+			add_ip6_config (servers, NM_IP6_CONFIG (iter->data), split);
 	}
+}
 
-	/* Build up the new dnsmasq config file */
-	conf = g_string_sized_new (150);
+/**
+ * nm_dns_dnsmasq_build_servers:
+ * @vpn_configs: configs from VPN connections, which get split DNS
+ * @dev_configs: configs from active devices
+ * @other_configs: any other configs in use
+ *
+ * Returns: (transfer none): a floating #GVariant of type "aas" in the format
+ *   of the dnsmasq SetServersEx D-Bus method: one string array per upstream
+ *   server, whose first element is the server address and the remaining
+ *   ones the domains that should be resolved by it.  Servers without
+ *   domains are used for everything else.
+ */
+GVariant *
+nm_dns_dnsmasq_build_servers (const GSList *vpn_configs,
+                              const GSList *dev_configs,
+                              const GSList *other_configs)
+{
+	GVariantBuilder servers;
+
+	g_variant_builder_init (&servers, G_VARIANT_TYPE ("aas"));
 
 	/* Use split DNS for VPN configs */
-	for (iter = (GSList *) vpn_configs; iter; iter = g_slist_next (iter)) {
-		if (NM_IS_IP4_CONFIG (iter->data))
-			add_ip4_config (conf, NM_IP4_CONFIG (iter->data), TRUE);
-		else if (NM_IS_IP6_CONFIG (iter->data))
-			add_ip6_config (conf, NM_IP6_CONFIG (iter->data), TRUE);
-	}
+	add_configs (&servers, vpn_configs, TRUE);
 
 	/* Now add interface configs without split DNS */
-	for (iter = (GSList *) dev_configs; iter; iter = g_slist_next (iter)) {
-		if (NM_IS_IP4_CONFIG (iter->data))
-			add_ip4_config (conf, NM_IP4_CONFIG (iter->data), FALSE);
-		else if (NM_IS_IP6_CONFIG (iter->data))
-			add_ip6_config (conf, NM_IP6_CONFIG (iter->data), FALSE);
-	}
+	add_configs (&servers, dev_configs, FALSE);
 
 	/* And any other random configs */
-	for (iter = (GSList *) other_configs; iter; iter = g_slist_next (iter)) {
-		if (NM_IS_IP4_CONFIG (iter->data))
-			add_ip4_config (conf, NM_IP4_CONFIG (iter->data), FALSE);
-		else if (NM_IS_IP6_CONFIG (iter->data))
-			add_ip6_config (conf, NM_IP6_CONFIG (iter->data), FALSE);
+	add_configs (&servers, other_configs, FALSE);
+
+	return g_variant_builder_end (&servers);
+}
+
+static char *
+servers_to_conf (GVariant *servers)
+{
+	GString *conf;
+	GVariantIter iter;
+	const char **entry;
+	guint i;
+
+	conf = g_string_sized_new (150);
+
+	g_variant_iter_init (&iter, servers);
+	while (g_variant_iter_next (&iter, "^a&s", &entry)) {
+		if (!entry[0])
+			;
+		else if (!entry[1])
+			g_string_append_printf (conf, "server=%s\n", entry[0]);
+		else {
+			for (i = 1; entry[i]; i++)
+				g_string_append_printf (conf, "server=/%s/%s\n", entry[i], entry[0]);
+		}
+		g_free (entry);
 	}
 
-	/* Write out the config file */
-	if (!g_file_set_contents (CONFFILE, conf->str, -1, &error)) {
-		nm_log_warn (LOGD_DNS, "Failed to write dnsmasq config file %s: (%d) %s",
-		             CONFFILE,
-		             error ? error->code : -1,
-		             error && error->message ? error->message : "(unknown)");
-		g_clear_error (&error);
-		goto out;
+	return g_string_free (conf, FALSE);
+}
+
+/**
+ * nm_dns_dnsmasq_set_servers:
+ * @connection: the bus dnsmasq is connected to
+ * @servers: the upstream servers, as returned by nm_dns_dnsmasq_build_servers()
+ * @cancellable: a #GCancellable
+ * @callback: called with the result
+ * @user_data: data for @callback
+ *
+ * Replaces the upstream servers of a running dnsmasq through its
+ * SetServersEx D-Bus method.  The dnsmasq cache is kept.
+ */
+void
+nm_dns_dnsmasq_set_servers (GDBusConnection *connection,
+                            GVariant *servers,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+	g_return_if_fail (G_IS_DBUS_CONNECTION (connection));
+	g_return_if_fail (g_variant_is_of_type (servers, G_VARIANT_TYPE ("aas")));
+
+	g_dbus_connection_call (connection,
+	                        NM_DNS_DNSMASQ_DBUS_SERVICE,
+	                        NM_DNS_DNSMASQ_DBUS_PATH,
+	                        NM_DNS_DNSMASQ_DBUS_INTERFACE,
+	                        "SetServersEx",
+	                        g_variant_new_tuple (&servers, 1),
+	                        NULL,
+	                        G_DBUS_CALL_FLAGS_NO_AUTO_START,
+	                        -1,
+	                        cancellable,
+	                        callback,
+	                        user_data);
+}
+
+gboolean
+nm_dns_dnsmasq_set_servers_finish (GDBusConnection *connection,
+                                   GAsyncResult *result,
+                                   GError **error)
+{
+	GVariant *ret;
+
+	ret = g_dbus_connection_call_finish (connection, result, error);
+	if (!ret)
+		return FALSE;
+
+	g_variant_unref (ret);
+	return TRUE;
+}
+
+/*******************************************/
+
+gboolean
+nm_dns_dnsmasq_fallback_use_dbus (const NMDnsDnsmasqFallback *fallback)
+{
+	return !fallback->no_dbus && !fallback->set_servers_failed;
+}
+
+void
+nm_dns_dnsmasq_fallback_spawned (NMDnsDnsmasqFallback *fallback, gboolean use_dbus)
+{
+	fallback->spawned_dbus = use_dbus;
+	fallback->appeared = FALSE;
+
+	/* A failed SetServersEx sends only the next update through a config
+	 * file; the new dnsmasq gets a fresh chance afterwards.
+	 */
+	fallback->set_servers_failed = FALSE;
+}
+
+void
+nm_dns_dnsmasq_fallback_appeared (NMDnsDnsmasqFallback *fallback)
+{
+	fallback->appeared = TRUE;
+}
+
+void
+nm_dns_dnsmasq_fallback_set_servers_done (NMDnsDnsmasqFallback *fallback, gboolean success)
+{
+	fallback->set_servers_failed = !success;
+}
+
+/**
+ * nm_dns_dnsmasq_fallback_child_quit:
+ * @fallback: the fallback state
+ * @status: the wait status of dnsmasq
+ *
+ * Returns: %TRUE if the exit shows that dnsmasq has no D-Bus support, in
+ *   which case it is always restarted with a config file from now on.
+ */
+gboolean
+nm_dns_dnsmasq_fallback_child_quit (NMDnsDnsmasqFallback *fallback, int status)
+{
+	gboolean lacks_dbus;
+
+	/* dnsmasq built without D-Bus support rejects --enable-dbus as a
+	 * configuration problem right at startup.  A crash or any other error
+	 * says nothing about D-Bus support, and neither does an exit after
+	 * the name was claimed once, even if the name has been lost since.
+	 */
+	lacks_dbus =    fallback->spawned_dbus
+	             && !fallback->appeared
+	             && WIFEXITED (status)
+	             && WEXITSTATUS (status) == 1;
+
+	fallback->spawned_dbus = FALSE;
+	fallback->appeared = FALSE;
+	fallback->set_servers_failed = FALSE;
+	if (lacks_dbus)
+		fallback->no_dbus = TRUE;
+	return lacks_dbus;
+}
+
+/*******************************************/
+
+static void
+set_servers_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	NMDnsDnsmasq *self = NM_DNS_DNSMASQ (user_data);
+	gs_free_error GError *error = NULL;
+
+	if (nm_dns_dnsmasq_set_servers_finish (G_DBUS_CONNECTION (source), result, &error)) {
+		nm_log_dbg (LOGD_DNS, "dnsmasq: upstream servers updated over D-Bus");
+		nm_dns_dnsmasq_fallback_set_servers_done (&NM_DNS_DNSMASQ_GET_PRIVATE (self)->fallback, TRUE);
+	} else if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_dbus_error_strip_remote_error (error);
+		nm_log_warn (LOGD_DNS, "dnsmasq: failed to update upstream servers over D-Bus: %s; "
+		             "will restart dnsmasq with a config file instead",
+		             error->message);
+
+		nm_dns_dnsmasq_fallback_set_servers_done (&NM_DNS_DNSMASQ_GET_PRIVATE (self)->fallback, FALSE);
+		g_signal_emit_by_name (self, NM_DNS_PLUGIN_FAILED);
 	}
-	ignored = chmod (CONFFILE, 0644);
 
-	nm_log_dbg (LOGD_DNS, "dnsmasq local caching DNS configuration:");
-	nm_log_dbg (LOGD_DNS, "%s", conf->str);
+	g_object_unref (self);
+}
+
+static void
+push_servers (NMDnsDnsmasq *self)
+{
+	NMDnsDnsmasqPrivate *priv = NM_DNS_DNSMASQ_GET_PRIVATE (self);
+
+	if (!priv->running || !priv->servers)
+		return;
+
+	/* Only the latest set of servers matters */
+	if (priv->set_servers_cancellable) {
+		g_cancellable_cancel (priv->set_servers_cancellable);
+		g_object_unref (priv->set_servers_cancellable);
+	}
+	priv->set_servers_cancellable = g_cancellable_new ();
+
+	nm_dns_dnsmasq_set_servers (priv->dbus_connection,
+	                            priv->servers,
+	                            priv->set_servers_cancellable,
+	                            set_servers_cb,
+	                            g_object_ref (self));
+}
+
+static void
+name_appeared (GDBusConnection *connection,
+               const char *name,
+               const char *name_owner,
+               gpointer user_data)
+{
+	NMDnsDnsmasq *self = NM_DNS_DNSMASQ (user_data);
+	NMDnsDnsmasqPrivate *priv = NM_DNS_DNSMASQ_GET_PRIVATE (self);
+
+	nm_log_dbg (LOGD_DNS, "dnsmasq: appeared on D-Bus as %s", name_owner);
+	priv->running = TRUE;
+	nm_dns_dnsmasq_fallback_appeared (&priv->fallback);
+	push_servers (self);
+}
+
+static void
+name_vanished (GDBusConnection *connection,
+               const char *name,
+               gpointer user_data)
+{
+	NMDnsDnsmasq *self = NM_DNS_DNSMASQ (user_data);
+
+	NM_DNS_DNSMASQ_GET_PRIVATE (self)->running = FALSE;
+}
+
+/*******************************************/
+
+static void
+build_argv (const char **argv, guint argv_len, const char *dm_binary, gboolean use_dbus)
+{
+	guint idx = 0;
 
 	argv[idx++] = dm_binary;
 	argv[idx++] = "--no-resolv";  /* Use only commandline */
@@ -277,7 +494,12 @@ update (NMDnsPlugin *plugin,
 	argv[idx++] = "--bind-interfaces";
 	argv[idx++] = "--pid-file=" PIDFILE;
 	argv[idx++] = "--listen-address=127.0.0.1"; /* Should work for both 4 and 6 */
-	argv[idx++] = "--conf-file=" CONFFILE;
+	if (use_dbus) {
+		argv[idx++] = "--enable-dbus=" NM_DNS_DNSMASQ_DBUS_SERVICE;
+		/* Don't let dnsmasq pick up its default /etc/dnsmasq.conf */
+		argv[idx++] = "--conf-file=/dev/null";
+	} else
+		argv[idx++] = "--conf-file=" CONFFILE;
 	argv[idx++] = "--cache-size=400";
 	argv[idx++] = "--proxy-dnssec"; /* Allow DNSSEC to pass through */
 
@@ -286,14 +508,123 @@ update (NMDnsPlugin *plugin,
 		argv[idx++] = "--conf-dir=" CONFDIR;
 
 	argv[idx++] = NULL;
-	g_warn_if_fail (idx <= G_N_ELEMENTS (argv));
+	g_warn_if_fail (idx <= argv_len);
+}
+
+static gboolean
+update_dbus (NMDnsDnsmasq *self, const char *dm_binary, GVariant *servers)
+{
+	NMDnsDnsmasqPrivate *priv = NM_DNS_DNSMASQ_GET_PRIVATE (self);
+	const char *argv[15];
+	gs_free char *cmdline = NULL;
+	gs_free char *servers_str = NULL;
+
+	g_variant_ref (servers);
+	g_clear_pointer (&priv->servers, g_variant_unref);
+	priv->servers = servers;
+
+	servers_str = g_variant_print (servers, FALSE);
+	nm_log_dbg (LOGD_DNS, "dnsmasq upstream servers: %s", servers_str);
+
+	build_argv (argv, G_N_ELEMENTS (argv), dm_binary, TRUE);
+	cmdline = g_strjoinv (" ", (char **) argv);
+
+	/* Only the command line requires a restart; the servers are changed
+	 * at runtime without dropping the cache.  If dnsmasq didn't claim its
+	 * name yet, the servers are pushed once it does.
+	 */
+	if (   nm_dns_plugin_child_pid (NM_DNS_PLUGIN (self))
+	    && !g_strcmp0 (cmdline, priv->cmdline)) {
+		push_servers (self);
+		return TRUE;
+	}
+
+	nm_dns_plugin_child_kill (NM_DNS_PLUGIN (self));
+	priv->running = FALSE;
+	g_clear_pointer (&priv->cmdline, g_free);
+
+	nm_dns_dnsmasq_fallback_spawned (&priv->fallback, TRUE);
+	if (!nm_dns_plugin_child_spawn (NM_DNS_PLUGIN (self), argv, PIDFILE, "bin/dnsmasq"))
+		return FALSE;
+
+	priv->cmdline = cmdline;
+	cmdline = NULL;
+	return TRUE;
+}
+
+static gboolean
+update_conf_file (NMDnsDnsmasq *self, const char *dm_binary, GVariant *servers)
+{
+	NMDnsDnsmasqPrivate *priv = NM_DNS_DNSMASQ_GET_PRIVATE (self);
+	const char *argv[15];
+	gs_free char *conf = NULL;
+	GError *error = NULL;
+	int ignored;
+
+	/* Kill the old dnsmasq; without D-Bus there doesn't appear to be a way
+	 * to get dnsmasq to reread the config file using SIGHUP or similar.
+	 * This is a small race here when restarting dnsmasq when DNS requests
+	 * could go to the upstream servers instead of to dnsmasq.
+	 */
+	nm_dns_plugin_child_kill (NM_DNS_PLUGIN (self));
+
+	/* Write out the config file */
+	conf = servers_to_conf (servers);
+	if (!g_file_set_contents (CONFFILE, conf, -1, &error)) {
+		nm_log_warn (LOGD_DNS, "Failed to write dnsmasq config file %s: (%d) %s",
+		             CONFFILE,
+		             error ? error->code : -1,
+		             error && error->message ? error->message : "(unknown)");
+		g_clear_error (&error);
+		return FALSE;
+	}
+	ignored = chmod (CONFFILE, 0644);
+
+	nm_log_dbg (LOGD_DNS, "dnsmasq local caching DNS configuration:");
+	nm_log_dbg (LOGD_DNS, "%s", conf);
+
+	build_argv (argv, G_N_ELEMENTS (argv), dm_binary, FALSE);
 
 	/* And finally spawn dnsmasq */
-	pid = nm_dns_plugin_child_spawn (NM_DNS_PLUGIN (self), argv, PIDFILE, "bin/dnsmasq");
+	nm_dns_dnsmasq_fallback_spawned (&priv->fallback, FALSE);
+	return nm_dns_plugin_child_spawn (NM_DNS_PLUGIN (self), argv, PIDFILE, "bin/dnsmasq") != 0;
+}
 
-out:
-	g_string_free (conf, TRUE);
-	return pid ? TRUE : FALSE;
+static gboolean
+update (NMDnsPlugin *plugin,
+        const GSList *vpn_configs,
+        const GSList *dev_configs,
+        const GSList *other_configs,
+        const char *hostname)
+{
+	NMDnsDnsmasq *self = NM_DNS_DNSMASQ (plugin);
+	NMDnsDnsmasqPrivate *priv = NM_DNS_DNSMASQ_GET_PRIVATE (self);
+	const char *dm_binary;
+	GVariant *servers;
+	gboolean success;
+
+	dm_binary = nm_utils_find_helper ("dnsmasq", DNSMASQ_PATH, NULL);
+	if (!dm_binary) {
+		nm_log_warn (LOGD_DNS, "Could not find dnsmasq binary");
+		nm_dns_plugin_child_kill (plugin);
+		return FALSE;
+	}
+
+	servers = g_variant_ref_sink (nm_dns_dnsmasq_build_servers (vpn_configs, dev_configs, other_configs));
+
+	if (nm_dns_dnsmasq_fallback_use_dbus (&priv->fallback))
+		success = update_dbus (self, dm_binary, servers);
+	else {
+		if (priv->cmdline) {
+			/* Switching modes; the running dnsmasq has no config file */
+			nm_dns_plugin_child_kill (plugin);
+			g_clear_pointer (&priv->cmdline, g_free);
+		}
+		success = update_conf_file (self, dm_binary, servers);
+	}
+
+	g_variant_unref (servers);
+	return success;
 }
 
 /****************************************************************/
@@ -320,6 +651,7 @@ static void
 child_quit (NMDnsPlugin *plugin, gint status)
 {
 	NMDnsDnsmasq *self = NM_DNS_DNSMASQ (plugin);
+	NMDnsDnsmasqPrivate *priv = NM_DNS_DNSMASQ_GET_PRIVATE (self);
 	gboolean failed = TRUE;
 	int err;
 
@@ -340,6 +672,13 @@ child_quit (NMDnsPlugin *plugin, gint status)
 	}
 	unlink (CONFFILE);
 
+	if (nm_dns_dnsmasq_fallback_child_quit (&priv->fallback, status)) {
+		nm_log_warn (LOGD_DNS, "dnsmasq rejected --enable-dbus before connecting to D-Bus; "
+		             "will restart dnsmasq on DNS changes instead");
+	}
+	g_clear_pointer (&priv->cmdline, g_free);
+	priv->running = FALSE;
+
 	if (failed)
 		g_signal_emit_by_name (self, NM_DNS_PLUGIN_FAILED);
 }
@@ -369,11 +708,43 @@ nm_dns_dnsmasq_new (void)
 static void
 nm_dns_dnsmasq_init (NMDnsDnsmasq *self)
 {
+	NMDnsDnsmasqPrivate *priv = NM_DNS_DNSMASQ_GET_PRIVATE (self);
+	gs_free_error GError *error = NULL;
+
+	priv->dbus_connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (!priv->dbus_connection) {
+		nm_log_dbg (LOGD_DNS, "dnsmasq: no D-Bus connection, will restart dnsmasq on DNS changes: %s",
+		            error->message);
+		priv->fallback.no_dbus = TRUE;
+		return;
+	}
+
+	priv->name_watch_id = g_bus_watch_name_on_connection (priv->dbus_connection,
+	                                                      NM_DNS_DNSMASQ_DBUS_SERVICE,
+	                                                      G_BUS_NAME_WATCHER_FLAGS_NONE,
+	                                                      name_appeared,
+	                                                      name_vanished,
+	                                                      self,
+	                                                      NULL);
 }
 
 static void
 dispose (GObject *object)
 {
+	NMDnsDnsmasqPrivate *priv = NM_DNS_DNSMASQ_GET_PRIVATE (object);
+
+	if (priv->name_watch_id) {
+		g_bus_unwatch_name (priv->name_watch_id);
+		priv->name_watch_id = 0;
+	}
+	if (priv->set_servers_cancellable) {
+		g_cancellable_cancel (priv->set_servers_cancellable);
+		g_clear_object (&priv->set_servers_cancellable);
+	}
+	g_clear_object (&priv->dbus_connection);
+	g_clear_pointer (&priv->servers, g_variant_unref);
+	g_clear_pointer (&priv->cmdline, g_free);
+
 	unlink (CONFFILE);
 
 	G_OBJECT_CLASS (nm_dns_dnsmasq_parent_class)->dispose (object);
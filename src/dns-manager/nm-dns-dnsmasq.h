@@ -21,6 +21,7 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "nm-dns-plugin.h"
 
@@ -31,6 +32,13 @@
 #define NM_IS_DNS_DNSMASQ_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NM_TYPE_DNS_DNSMASQ))
 #define NM_DNS_DNSMASQ_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NM_TYPE_DNS_DNSMASQ, NMDnsDnsmasqClass))
 
+/* dnsmasq keeps its object path and interface name when started with
+ * --enable-dbus=<service>; only the bus name changes.
+ */
+#define NM_DNS_DNSMASQ_DBUS_SERVICE   "org.freedesktop.NetworkManager.dnsmasq"
+#define NM_DNS_DNSMASQ_DBUS_PATH      "/uk/org/thekelleys/dnsmasq"
+#define NM_DNS_DNSMASQ_DBUS_INTERFACE "uk.org.thekelleys.dnsmasq"
+
 typedef struct {
 	NMDnsPlugin parent;
 } NMDnsDnsmasq;
@@ -43,5 +51,37 @@ GType nm_dns_dnsmasq_get_type (void);
 
 NMDnsPlugin *nm_dns_dnsmasq_new (void);
 
+/* For testing */
+
+GVariant *nm_dns_dnsmasq_build_servers (const GSList *vpn_configs,
+                                        const GSList *dev_configs,
+                                        const GSList *other_configs);
+
+void nm_dns_dnsmasq_set_servers (GDBusConnection *connection,
+                                 GVariant *servers,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data);
+
+gboolean nm_dns_dnsmasq_set_servers_finish (GDBusConnection *connection,
+                                            GAsyncResult *result,
+                                            GError **error);
+
+/* Decides between pushing servers over D-Bus and restarting dnsmasq with
+ * a config file.
+ */
+typedef struct {
+	gboolean no_dbus;            /* no bus, or dnsmasq lacks D-Bus support */
+	gboolean set_servers_failed; /* until dnsmasq is respawned or a call succeeds */
+	gboolean spawned_dbus;       /* the running dnsmasq was started with --enable-dbus */
+	gboolean appeared;           /* ...and claimed its bus name since */
+} NMDnsDnsmasqFallback;
+
+gboolean nm_dns_dnsmasq_fallback_use_dbus (const NMDnsDnsmasqFallback *fallback);
+void nm_dns_dnsmasq_fallback_spawned (NMDnsDnsmasqFallback *fallback, gboolean use_dbus);
+void nm_dns_dnsmasq_fallback_appeared (NMDnsDnsmasqFallback *fallback);
+void nm_dns_dnsmasq_fallback_set_servers_done (NMDnsDnsmasqFallback *fallback, gboolean success);
+gboolean nm_dns_dnsmasq_fallback_child_quit (NMDnsDnsmasqFallback *fallback, int status);
+
 #endif /* __NETWORKMANAGER_DNS_DNSMASQ_H__ */
 
@@ -45,6 +45,7 @@
 #include "nm-logging.h"
 #include "NetworkManagerUtils.h"
 #include "nm-config.h"
+#include "nm-stats.h"
 
 #include "nm-dns-plugin.h"
 #include "nm-dns-dnsmasq.h"
@@ -655,6 +656,7 @@ update_dns (NMDnsManager *self,
 	char **nis_servers = NULL;
 	int num, i, len;
 	gboolean success = FALSE, caching = FALSE;
+	gint64 start;
 
 	g_return_val_if_fail (!error || !*error, FALSE);
 
@@ -664,6 +666,7 @@ update_dns (NMDnsManager *self,
 		return TRUE;
 
 	priv->dns_touched = TRUE;
+	start = nm_utils_get_monotonic_timestamp_us ();
 
 	nm_log_dbg (LOGD_DNS, "updating resolv.conf");
 
@@ -827,6 +830,7 @@ update_dns (NMDnsManager *self,
 	if (nis_servers)
 		g_strfreev (nis_servers);
 
+	nm_stats_probe_time (NM_STATS_PROBE_DNS_UPDATE, start);
 	return success;
 }
 
@@ -1047,6 +1051,25 @@ nm_dns_manager_set_hostname (NMDnsManager *mgr,
 	}
 }
 
+/**
+ * nm_dns_manager_get_config_hash:
+ * @mgr: the #NMDnsManager
+ *
+ * Returns: a hex string identifying the current DNS configuration; it
+ * changes whenever the configuration does, also when resolv.conf is not
+ * managed and nothing gets applied. Free with g_free().
+ */
+char *
+nm_dns_manager_get_config_hash (NMDnsManager *mgr)
+{
+	guint8 hash[HASH_LEN];
+
+	g_return_val_if_fail (NM_IS_DNS_MANAGER (mgr), NULL);
+
+	compute_hash (mgr, hash);
+	return nm_utils_bin2hexstr (hash, HASH_LEN, -1);
+}
+
 NMDnsManagerResolvConfMode
 nm_dns_manager_get_resolv_conf_mode (NMDnsManager *mgr)
 {
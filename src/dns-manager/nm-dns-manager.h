@@ -81,6 +81,8 @@ void nm_dns_manager_set_initial_hostname (NMDnsManager *mgr,
 void nm_dns_manager_set_hostname         (NMDnsManager *mgr,
                                           const char *hostname);
 
+char *nm_dns_manager_get_config_hash (NMDnsManager *mgr);
+
 /**
  * NMDnsManagerResolvConfMode:
  * @NM_DNS_MANAGER_RESOLV_CONF_UNMANAGED: NM is not managing resolv.conf
@@ -209,6 +209,14 @@ nm_dns_plugin_child_kill (NMDnsPlugin *self)
 	return TRUE;
 }
 
+GPid
+nm_dns_plugin_child_pid (NMDnsPlugin *self)
+{
+	g_return_val_if_fail (NM_IS_DNS_PLUGIN (self), 0);
+
+	return NM_DNS_PLUGIN_GET_PRIVATE (self)->pid;
+}
+
 /********************************************/
 
 static void
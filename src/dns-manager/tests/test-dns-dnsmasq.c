@@ -0,0 +1,382 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+#include "nm-dns-dnsmasq.h"
+#include "nm-ip4-config.h"
+#include "nm-ip6-config.h"
+#include "nm-platform.h"
+
+#include "gsystem-local-alloc.h"
+#include "nm-test-utils.h"
+
+static guint32
+addr4 (const char *str)
+{
+	guint32 addr;
+
+	g_assert (inet_pton (AF_INET, str, &addr) == 1);
+	return addr;
+}
+
+static NMIP4Config *
+ip4_config (const char *nameserver, const char *search)
+{
+	NMIP4Config *config = nm_ip4_config_new (1);
+
+	nm_ip4_config_add_nameserver (config, addr4 (nameserver));
+	if (search)
+		nm_ip4_config_add_search (config, search);
+	return config;
+}
+
+static NMIP6Config *
+ip6_config (const char *nameserver, const char *iface)
+{
+	NMIP6Config *config = nm_ip6_config_new (2);
+	struct in6_addr addr;
+
+	g_assert (inet_pton (AF_INET6, nameserver, &addr) == 1);
+	nm_ip6_config_add_nameserver (config, &addr);
+	g_object_set_data_full (G_OBJECT (config), IP_CONFIG_IFACE_TAG, g_strdup (iface), g_free);
+	return config;
+}
+
+static void
+assert_servers (GVariant *servers, const char *expected)
+{
+	gs_free char *str = g_variant_print (servers, FALSE);
+
+	g_assert_cmpstr (str, ==, expected);
+}
+
+/*******************************************/
+
+static void
+test_build_servers (void)
+{
+	NMIP4Config *vpn1, *vpn2, *dev4;
+	NMIP6Config *dev6;
+	NMPlatformIP4Address address;
+	GSList *vpn_configs = NULL, *dev_configs = NULL;
+	GVariant *servers;
+
+	/* Split DNS for the searches of a VPN */
+	vpn1 = ip4_config ("10.8.0.1", "corp.example.com");
+
+	/* A VPN without searches still gets its reverse domain */
+	vpn2 = ip4_config ("10.9.0.1", NULL);
+	memset (&address, 0, sizeof (address));
+	address.address = addr4 ("10.9.0.5");
+	address.plen = 24;
+	nm_ip4_config_add_address (vpn2, &address);
+
+	/* Devices don't use split DNS, even with searches */
+	dev4 = ip4_config ("192.168.1.1", "home");
+	nm_ip4_config_add_nameserver (dev4, addr4 ("192.168.1.2"));
+	dev6 = ip6_config ("fe80::1", "eth0");
+
+	vpn_configs = g_slist_append (vpn_configs, vpn1);
+	vpn_configs = g_slist_append (vpn_configs, vpn2);
+	dev_configs = g_slist_append (dev_configs, dev4);
+	dev_configs = g_slist_append (dev_configs, dev6);
+
+	servers = g_variant_ref_sink (nm_dns_dnsmasq_build_servers (vpn_configs, dev_configs, NULL));
+	assert_servers (servers,
+	                "[['10.8.0.1', 'corp.example.com'], "
+	                "['10.9.0.1', '10.in-addr.arpa'], "
+	                "['192.168.1.1'], "
+	                "['192.168.1.2'], "
+	                "['fe80::1@eth0']]");
+	g_variant_unref (servers);
+
+	/* Without any nameservers dnsmasq gets an empty list */
+	servers = g_variant_ref_sink (nm_dns_dnsmasq_build_servers (NULL, NULL, NULL));
+	g_assert_cmpint (g_variant_n_children (servers), ==, 0);
+	g_variant_unref (servers);
+
+	g_slist_free (vpn_configs);
+	g_slist_free (dev_configs);
+	g_object_unref (vpn1);
+	g_object_unref (vpn2);
+	g_object_unref (dev4);
+	g_object_unref (dev6);
+}
+
+/*******************************************/
+
+/* A stand-in for dnsmasq's D-Bus interface that records what it gets */
+
+static const char stub_introspection[] =
+	"<node>"
+	"  <interface name='" NM_DNS_DNSMASQ_DBUS_INTERFACE "'>"
+	"    <method name='SetServersEx'>"
+	"      <arg name='servers' type='aas' direction='in'/>"
+	"    </method>"
+	"  </interface>"
+	"</node>";
+
+typedef struct {
+	GDBusConnection *connection;
+	GMainLoop *loop;
+	guint own_id;
+	guint registration_id;
+	gboolean name_acquired;
+
+	guint calls;
+	GVariant *servers;
+
+	gboolean done;
+	GError *error;
+} StubDnsmasq;
+
+static void
+stub_method_call (GDBusConnection *connection,
+                  const char *sender,
+                  const char *object_path,
+                  const char *interface_name,
+                  const char *method_name,
+                  GVariant *parameters,
+                  GDBusMethodInvocation *invocation,
+                  gpointer user_data)
+{
+	StubDnsmasq *stub = user_data;
+
+	g_assert_cmpstr (method_name, ==, "SetServersEx");
+
+	stub->calls++;
+	g_clear_pointer (&stub->servers, g_variant_unref);
+	g_variant_get (parameters, "(@aas)", &stub->servers);
+
+	g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static const GDBusInterfaceVTable stub_vtable = {
+	stub_method_call,
+};
+
+static void
+stub_name_acquired (GDBusConnection *connection, const char *name, gpointer user_data)
+{
+	StubDnsmasq *stub = user_data;
+
+	stub->name_acquired = TRUE;
+	g_main_loop_quit (stub->loop);
+}
+
+static void
+stub_start (StubDnsmasq *stub)
+{
+	GDBusNodeInfo *info;
+	GError *error = NULL;
+
+	memset (stub, 0, sizeof (*stub));
+	stub->loop = g_main_loop_new (NULL, FALSE);
+	stub->connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+	g_assert_no_error (error);
+
+	info = g_dbus_node_info_new_for_xml (stub_introspection, &error);
+	g_assert_no_error (error);
+
+	stub->registration_id = g_dbus_connection_register_object (stub->connection,
+	                                                           NM_DNS_DNSMASQ_DBUS_PATH,
+	                                                           info->interfaces[0],
+	                                                           &stub_vtable,
+	                                                           stub, NULL, &error);
+	g_assert_no_error (error);
+	g_dbus_node_info_unref (info);
+
+	stub->own_id = g_bus_own_name_on_connection (stub->connection,
+	                                             NM_DNS_DNSMASQ_DBUS_SERVICE,
+	                                             G_BUS_NAME_OWNER_FLAGS_NONE,
+	                                             stub_name_acquired,
+	                                             NULL, stub, NULL);
+	g_main_loop_run (stub->loop);
+	g_assert (stub->name_acquired);
+}
+
+static void
+stub_stop (StubDnsmasq *stub)
+{
+	if (stub->own_id)
+		g_bus_unown_name (stub->own_id);
+	g_dbus_connection_unregister_object (stub->connection, stub->registration_id);
+	g_clear_pointer (&stub->servers, g_variant_unref);
+	g_clear_error (&stub->error);
+	g_object_unref (stub->connection);
+	g_main_loop_unref (stub->loop);
+}
+
+static void
+set_servers_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	StubDnsmasq *stub = user_data;
+
+	g_clear_error (&stub->error);
+	nm_dns_dnsmasq_set_servers_finish (G_DBUS_CONNECTION (source), result, &stub->error);
+	stub->done = TRUE;
+	g_main_loop_quit (stub->loop);
+}
+
+static void
+set_servers (StubDnsmasq *stub, const char *servers_text)
+{
+	GVariant *servers;
+	GError *error = NULL;
+
+	servers = g_variant_parse (G_VARIANT_TYPE ("aas"), servers_text, NULL, NULL, &error);
+	g_assert_no_error (error);
+
+	stub->done = FALSE;
+	nm_dns_dnsmasq_set_servers (stub->connection, servers, NULL, set_servers_cb, stub);
+	g_variant_unref (servers);
+
+	g_main_loop_run (stub->loop);
+	g_assert (stub->done);
+}
+
+static void
+test_set_servers (void)
+{
+	StubDnsmasq stub;
+
+	stub_start (&stub);
+
+	set_servers (&stub, "[['10.8.0.1', 'corp.example.com'], ['192.168.1.1']]");
+	g_assert_no_error (stub.error);
+	g_assert_cmpint (stub.calls, ==, 1);
+	assert_servers (stub.servers, "[['10.8.0.1', 'corp.example.com'], ['192.168.1.1']]");
+
+	/* The VPN goes away; the same dnsmasq just gets the new list */
+	set_servers (&stub, "[['192.168.1.1']]");
+	g_assert_no_error (stub.error);
+	g_assert_cmpint (stub.calls, ==, 2);
+	assert_servers (stub.servers, "[['192.168.1.1']]");
+
+	set_servers (&stub, "@aas []");
+	g_assert_no_error (stub.error);
+	g_assert_cmpint (stub.calls, ==, 3);
+	g_assert_cmpint (g_variant_n_children (stub.servers), ==, 0);
+
+	stub_stop (&stub);
+}
+
+static void
+test_set_servers_no_dnsmasq (void)
+{
+	StubDnsmasq stub;
+
+	stub_start (&stub);
+
+	/* Once dnsmasq left the bus the call must fail instead of hanging, so
+	 * that the plugin can fall back to restarting it.
+	 */
+	g_bus_unown_name (stub.own_id);
+	stub.own_id = 0;
+
+	set_servers (&stub, "[['192.168.1.1']]");
+	g_assert (stub.error);
+	g_assert_cmpint (stub.calls, ==, 0);
+
+	stub_stop (&stub);
+}
+
+/*******************************************/
+
+static void
+test_fallback (void)
+{
+	NMDnsDnsmasqFallback fallback = { 0 };
+
+	g_assert (nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+
+	/* A dnsmasq that claimed its name once may crash or exit with an
+	 * error later, even after the name watcher saw the name vanish.
+	 */
+	nm_dns_dnsmasq_fallback_spawned (&fallback, TRUE);
+	nm_dns_dnsmasq_fallback_appeared (&fallback);
+	g_assert (!nm_dns_dnsmasq_fallback_child_quit (&fallback, W_EXITCODE (0, SIGSEGV)));
+	g_assert (nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+
+	nm_dns_dnsmasq_fallback_spawned (&fallback, TRUE);
+	nm_dns_dnsmasq_fallback_appeared (&fallback);
+	g_assert (!nm_dns_dnsmasq_fallback_child_quit (&fallback, W_EXITCODE (1, 0)));
+	g_assert (nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+
+	/* Before the name appeared, only a configuration error counts */
+	nm_dns_dnsmasq_fallback_spawned (&fallback, TRUE);
+	g_assert (!nm_dns_dnsmasq_fallback_child_quit (&fallback, W_EXITCODE (0, SIGSEGV)));
+	g_assert (nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+
+	nm_dns_dnsmasq_fallback_spawned (&fallback, TRUE);
+	g_assert (!nm_dns_dnsmasq_fallback_child_quit (&fallback, W_EXITCODE (2, 0)));
+	g_assert (nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+
+	/* A failed SetServersEx falls back until a later call succeeds... */
+	nm_dns_dnsmasq_fallback_spawned (&fallback, TRUE);
+	nm_dns_dnsmasq_fallback_appeared (&fallback);
+	nm_dns_dnsmasq_fallback_set_servers_done (&fallback, FALSE);
+	g_assert (!nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+	nm_dns_dnsmasq_fallback_set_servers_done (&fallback, TRUE);
+	g_assert (nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+
+	/* ...or for the one restart with a config file */
+	nm_dns_dnsmasq_fallback_set_servers_done (&fallback, FALSE);
+	g_assert (!nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+	nm_dns_dnsmasq_fallback_spawned (&fallback, FALSE);
+	g_assert (nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+
+	/* The exit code of a dnsmasq without --enable-dbus says nothing */
+	g_assert (!nm_dns_dnsmasq_fallback_child_quit (&fallback, W_EXITCODE (1, 0)));
+	g_assert (nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+
+	/* Rejecting --enable-dbus at startup is permanent */
+	nm_dns_dnsmasq_fallback_spawned (&fallback, TRUE);
+	g_assert (nm_dns_dnsmasq_fallback_child_quit (&fallback, W_EXITCODE (1, 0)));
+	g_assert (!nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+	nm_dns_dnsmasq_fallback_spawned (&fallback, FALSE);
+	nm_dns_dnsmasq_fallback_set_servers_done (&fallback, TRUE);
+	g_assert (!nm_dns_dnsmasq_fallback_use_dbus (&fallback));
+}
+
+/*******************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	nmtst_init_assert_logging (&argc, &argv, "WARN", "DEFAULT");
+
+	g_test_add_func ("/dns/dnsmasq/build-servers", test_build_servers);
+	g_test_add_func ("/dns/dnsmasq/set-servers", test_set_servers);
+	g_test_add_func ("/dns/dnsmasq/set-servers-no-dnsmasq", test_set_servers_no_dnsmasq);
+	g_test_add_func ("/dns/dnsmasq/fallback", test_fallback);
+
+	return g_test_run ();
+}
@@ -33,13 +33,27 @@
 #include "nm-logging.h"
 #include "nm-glib-compat.h"
 #include "nm-utils.h"
+#include "nm-config.h"
 #include "NetworkManagerUtils.h"
+#include "gsystem-local-alloc.h"
+
+/* What dnsmasq serves on one shared interface */
+typedef struct {
+	char *iface;
+	char listen[INET_ADDRSTRLEN];
+	char first[INET_ADDRSTRLEN];
+	char last[INET_ADDRSTRLEN];
+} DhcpScope;
 
 typedef struct {
 	char *iface;
 	char *pidfile;
 	GPid pid;
 	guint32 dm_watch_id;
+
+	/* Served by the single shared instance instead of an own process */
+	gboolean single;
+	DhcpScope *scope;
 } NMDnsMasqManagerPrivate;
 
 #define NM_DNSMASQ_MANAGER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NM_TYPE_DNSMASQ_MANAGER, NMDnsMasqManagerPrivate))
@@ -59,12 +73,15 @@ nm_dnsmasq_manager_init (NMDnsMasqManager *manager)
 {
 }
 
+static void scope_free (DhcpScope *scope);
+
 static void
 finalize (GObject *object)
 {
 	NMDnsMasqManagerPrivate *priv = NM_DNSMASQ_MANAGER_GET_PRIVATE (object);
 
 	nm_dnsmasq_manager_stop (NM_DNSMASQ_MANAGER (object));
+	g_clear_pointer (&priv->scope, scope_free);
 
 	g_free (priv->iface);
 	g_free (priv->pidfile);
@@ -93,8 +110,24 @@ nm_dnsmasq_manager_class_init (NMDnsMasqManagerClass *manager_class)
 				    G_TYPE_UINT);
 }
 
-NMDnsMasqManager *
-nm_dnsmasq_manager_new (const char *iface)
+static gboolean
+use_single_instance (void)
+{
+	gs_free char *value = NULL;
+
+	value = nm_config_data_get_value (nm_config_get_data (nm_config_get ()),
+	                                  "sharing", "dnsmasq", NULL);
+	if (!value || !strcmp (value, "per-interface"))
+		return FALSE;
+	if (!strcmp (value, "single"))
+		return TRUE;
+
+	nm_log_warn (LOGD_SHARING, "unknown value '%s' for 'dnsmasq' in section [sharing]", value);
+	return FALSE;
+}
+
+static NMDnsMasqManager *
+dnsmasq_manager_new (const char *iface, gboolean single)
 {
 	NMDnsMasqManager *manager;
 	NMDnsMasqManagerPrivate *priv;
@@ -104,10 +137,17 @@ nm_dnsmasq_manager_new (const char *iface)
 	priv = NM_DNSMASQ_MANAGER_GET_PRIVATE (manager);
 	priv->iface = g_strdup (iface);
 	priv->pidfile = g_strdup_printf (LOCALSTATEDIR "/run/nm-dnsmasq-%s.pid", iface);
+	priv->single = single;
 
 	return manager;
 }
 
+NMDnsMasqManager *
+nm_dnsmasq_manager_new (const char *iface)
+{
+	return dnsmasq_manager_new (iface, use_single_instance ());
+}
+
 typedef struct {
 	GPtrArray *array;
 	GStringChunk *chunk;
@@ -184,10 +224,8 @@ dm_exit_code (guint dm_exit_status)
 }
 
 static void
-dm_watch_cb (GPid pid, gint status, gpointer user_data)
+dm_log_exit_status (gint status)
 {
-	NMDnsMasqManager *manager = NM_DNSMASQ_MANAGER (user_data);
-	NMDnsMasqManagerPrivate *priv = NM_DNSMASQ_MANAGER_GET_PRIVATE (manager);
 	guint err;
 
 	if (WIFEXITED (status)) {
@@ -201,30 +239,77 @@ dm_watch_cb (GPid pid, gint status, gpointer user_data)
 	} else {
 		nm_log_warn (LOGD_SHARING, "dnsmasq died from an unknown cause");
 	}
-  
+}
+
+static void
+dm_watch_cb (GPid pid, gint status, gpointer user_data)
+{
+	NMDnsMasqManager *manager = NM_DNSMASQ_MANAGER (user_data);
+	NMDnsMasqManagerPrivate *priv = NM_DNSMASQ_MANAGER_GET_PRIVATE (manager);
+
+	dm_log_exit_status (status);
 	priv->pid = 0;
 
 	g_signal_emit (manager, signals[STATE_CHANGED], 0, NM_DNSMASQ_STATUS_DEAD);
 }
 
-static NMCmdLine *
-create_dm_cmd_line (const char *iface,
-                    NMIP4Config *ip4_config,
-                    const char *pidfile,
-                    GError **error)
+static void
+scope_free (DhcpScope *scope)
 {
-	NMCmdLine *cmd;
-	GString *s;
+	g_free (scope->iface);
+	g_slice_free (DhcpScope, scope);
+}
+
+static DhcpScope *
+scope_dup (const DhcpScope *scope)
+{
+	DhcpScope *copy = g_slice_dup (DhcpScope, scope);
+
+	copy->iface = g_strdup (scope->iface);
+	return copy;
+}
+
+static gboolean
+scope_equal (const DhcpScope *a, const DhcpScope *b)
+{
+	return    !strcmp (a->iface, b->iface)
+	       && !strcmp (a->listen, b->listen)
+	       && !strcmp (a->first, b->first)
+	       && !strcmp (a->last, b->last);
+}
+
+static DhcpScope *
+scope_new (const char *iface, NMIP4Config *ip4_config, GError **error)
+{
+	DhcpScope *scope;
 	const NMPlatformIP4Address *tmp;
-	char first[INET_ADDRSTRLEN];
-	char last[INET_ADDRSTRLEN];
-	char localaddr[INET_ADDRSTRLEN];
 	char *error_desc = NULL;
-	const char *dm_binary;
 
-	dm_binary = nm_utils_find_helper ("dnsmasq", DNSMASQ_PATH, error);
-	if (!dm_binary)
+	scope = g_slice_new0 (DhcpScope);
+	scope->iface = g_strdup (iface);
+
+	/* Find the IP4 address to use */
+	tmp = nm_ip4_config_get_address (ip4_config, 0);
+	nm_utils_inet4_ntop (tmp->address, scope->listen);
+
+	if (!nm_dnsmasq_utils_get_range (tmp, scope->first, scope->last, &error_desc)) {
+		g_set_error_literal (error,
+		                     NM_MANAGER_ERROR,
+		                     NM_MANAGER_ERROR_FAILED,
+		                     error_desc);
+		nm_log_warn (LOGD_SHARING, "Failed to find DHCP address ranges: %s", error_desc);
+		g_free (error_desc);
+		scope_free (scope);
 		return NULL;
+	}
+
+	return scope;
+}
+
+static NMCmdLine *
+create_dm_cmd_line_common (const char *dm_binary, gboolean single)
+{
+	NMCmdLine *cmd;
 
 	/* Create dnsmasq command line */
 	cmd = nm_cmd_line_new ();
@@ -245,7 +330,11 @@ create_dm_cmd_line (const char *iface,
 
 	nm_cmd_line_add_string (cmd, "--no-hosts");
 	nm_cmd_line_add_string (cmd, "--keep-in-foreground");
-	nm_cmd_line_add_string (cmd, "--bind-interfaces");
+
+	/* The single instance outlives the interfaces it serves, which may go
+	 * away and come back with the same address; let dnsmasq follow them.
+	 */
+	nm_cmd_line_add_string (cmd, single ? "--bind-dynamic" : "--bind-interfaces");
 	nm_cmd_line_add_string (cmd, "--except-interface=lo");
 	nm_cmd_line_add_string (cmd, "--clear-on-reload");
 
@@ -255,42 +344,44 @@ create_dm_cmd_line (const char *iface,
 	 */
 	nm_cmd_line_add_string (cmd, "--strict-order");
 
-	/* Find the IP4 address to use */
-	tmp = nm_ip4_config_get_address (ip4_config, 0);
+	return cmd;
+}
 
-	s = g_string_new ("--listen-address=");
-	nm_utils_inet4_ntop (tmp->address, localaddr);
-	g_string_append (s, localaddr);
-	nm_cmd_line_add_string (cmd, s->str);
-	g_string_free (s, TRUE);
+static void
+nm_cmd_line_add_printf (NMCmdLine *cmd, const char *format, ...) G_GNUC_PRINTF (2, 3);
 
-	if (!nm_dnsmasq_utils_get_range (tmp, first, last, &error_desc)) {
-		g_set_error_literal (error,
-		                     NM_MANAGER_ERROR,
-		                     NM_MANAGER_ERROR_FAILED,
-		                     error_desc);
-		nm_log_warn (LOGD_SHARING, "Failed to find DHCP address ranges: %s", error_desc);
-		g_free (error_desc);
-		nm_cmd_line_destroy (cmd);
-		return NULL;
-	}
+static void
+nm_cmd_line_add_printf (NMCmdLine *cmd, const char *format, ...)
+{
+	gs_free char *str = NULL;
+	va_list args;
 
-	s = g_string_new ("--dhcp-range=");
-	g_string_append_printf (s, "%s,%s,60m", first, last);
-	nm_cmd_line_add_string (cmd, s->str);
-	g_string_free (s, TRUE);
+	va_start (args, format);
+	str = g_strdup_vprintf (format, args);
+	va_end (args);
 
-	s = g_string_new ("--dhcp-option=option:router,");
-	g_string_append (s, localaddr);
-	nm_cmd_line_add_string (cmd, s->str);
-	g_string_free (s, TRUE);
+	nm_cmd_line_add_string (cmd, str);
+}
 
-	nm_cmd_line_add_string (cmd, "--dhcp-lease-max=50");
+static NMCmdLine *
+create_dm_cmd_line (const DhcpScope *scope,
+                    const char *pidfile,
+                    GError **error)
+{
+	NMCmdLine *cmd;
+	const char *dm_binary;
+
+	dm_binary = nm_utils_find_helper ("dnsmasq", DNSMASQ_PATH, error);
+	if (!dm_binary)
+		return NULL;
 
-	s = g_string_new ("--pid-file=");
-	g_string_append (s, pidfile);
-	nm_cmd_line_add_string (cmd, s->str);
-	g_string_free (s, TRUE);
+	cmd = create_dm_cmd_line_common (dm_binary, FALSE);
+
+	nm_cmd_line_add_printf (cmd, "--listen-address=%s", scope->listen);
+	nm_cmd_line_add_printf (cmd, "--dhcp-range=%s,%s,60m", scope->first, scope->last);
+	nm_cmd_line_add_printf (cmd, "--dhcp-option=option:router,%s", scope->listen);
+	nm_cmd_line_add_string (cmd, "--dhcp-lease-max=50");
+	nm_cmd_line_add_printf (cmd, "--pid-file=%s", pidfile);
 
 	return cmd;
 }
@@ -328,6 +419,314 @@ out:
 	g_free (contents);
 }
 
+/*******************************************/
+/* Single instance shared by all interfaces
+ *
+ * With "dnsmasq=single" in the [sharing] section, one dnsmasq process
+ * serves DHCP and DNS on all shared interfaces. Each interface gets its
+ * own tagged DHCP range and router option.
+ *
+ * dnsmasq can't add DHCP ranges at runtime, so adding an interface that
+ * the running process doesn't already serve restarts it; interfaces that
+ * come up together are batched into one restart. Removing an interface
+ * restarts it as well, so that it stops serving the interface. Leases
+ * are kept in a lease file of their own, which survives the restarts.
+ */
+
+#define SINGLE_PIDFILE    LOCALSTATEDIR "/run/nm-dnsmasq-shared.pid"
+#define SINGLE_LEASEFILE  NMSTATEDIR "/dnsmasq-shared.leases"
+#define SINGLE_RESTART_DELAY_MS 250
+
+static struct {
+	GPid pid;
+	guint watch_id;
+	guint restart_id;
+	gboolean stopping;    /* waiting for the old process to exit */
+	GSList *members;      /* NMDnsMasqManager */
+	GPtrArray *running;   /* DhcpScope the process was started with */
+} single;
+
+/* Replaces g_spawn_async() in tests */
+static NMDnsMasqSpawnFunc single_spawn_func;
+
+static void
+single_emit_dead (void)
+{
+	GSList *members, *iter;
+
+	/* Handlers usually stop and drop their manager */
+	members = g_slist_copy (single.members);
+	g_slist_foreach (members, (GFunc) g_object_ref, NULL);
+	for (iter = members; iter; iter = iter->next)
+		g_signal_emit (iter->data, signals[STATE_CHANGED], 0, NM_DNSMASQ_STATUS_DEAD);
+	g_slist_free_full (members, g_object_unref);
+}
+
+static void
+single_watch_cb (GPid pid, gint status, gpointer user_data)
+{
+	single.watch_id = 0;
+	single.pid = 0;
+	g_clear_pointer (&single.running, g_ptr_array_unref);
+
+	dm_log_exit_status (status);
+	single_emit_dead ();
+}
+
+static NMCmdLine *
+single_create_cmd_line (const char *dm_binary, const GPtrArray *scopes)
+{
+	NMCmdLine *cmd;
+	guint i;
+
+	cmd = create_dm_cmd_line_common (dm_binary, TRUE);
+
+	for (i = 0; i < scopes->len; i++) {
+		const DhcpScope *scope = scopes->pdata[i];
+
+		nm_cmd_line_add_printf (cmd, "--listen-address=%s", scope->listen);
+		nm_cmd_line_add_printf (cmd, "--dhcp-range=set:%s,%s,%s,60m",
+		                        scope->iface, scope->first, scope->last);
+		nm_cmd_line_add_printf (cmd, "--dhcp-option=tag:%s,option:router,%s",
+		                        scope->iface, scope->listen);
+	}
+
+	nm_cmd_line_add_printf (cmd, "--dhcp-lease-max=%u", 50 * scopes->len);
+	nm_cmd_line_add_printf (cmd, "--dhcp-leasefile=%s", SINGLE_LEASEFILE);
+	nm_cmd_line_add_printf (cmd, "--pid-file=%s", SINGLE_PIDFILE);
+
+	return cmd;
+}
+
+static void
+single_spawn (void)
+{
+	NMCmdLine *dm_cmd;
+	const char *dm_binary;
+	GError *error = NULL;
+	GSList *iter;
+	char *cmd_str;
+	gboolean success;
+
+	g_return_if_fail (!single.pid);
+
+	kill_existing_for_iface (NULL, SINGLE_PIDFILE);
+
+	if (single_spawn_func)
+		dm_binary = "dnsmasq";
+	else
+		dm_binary = nm_utils_find_helper ("dnsmasq", DNSMASQ_PATH, &error);
+	if (!dm_binary)
+		goto fail;
+
+	/* Remember what the process serves, the managers' scopes may change */
+	single.running = g_ptr_array_new_with_free_func ((GDestroyNotify) scope_free);
+	for (iter = single.members; iter; iter = iter->next) {
+		const DhcpScope *scope = NM_DNSMASQ_MANAGER_GET_PRIVATE (iter->data)->scope;
+
+		g_ptr_array_add (single.running, scope_dup (scope));
+	}
+
+	dm_cmd = single_create_cmd_line (dm_binary, single.running);
+
+	nm_log_info (LOGD_SHARING, "Starting dnsmasq for %u shared interfaces...",
+	             g_slist_length (single.members));
+
+	cmd_str = nm_cmd_line_to_str (dm_cmd);
+	nm_log_dbg (LOGD_SHARING, "Command line: %s", cmd_str);
+	g_free (cmd_str);
+
+	g_ptr_array_add (dm_cmd->array, NULL);
+	if (single_spawn_func)
+		success = single_spawn_func ((char **) dm_cmd->array->pdata, &single.pid, &error);
+	else {
+		success = g_spawn_async (NULL, (char **) dm_cmd->array->pdata, NULL,
+		                         G_SPAWN_DO_NOT_REAP_CHILD,
+		                         nm_utils_setpgid, NULL,
+		                         &single.pid, &error);
+	}
+	if (!success) {
+		single.pid = 0;
+		nm_cmd_line_destroy (dm_cmd);
+		goto fail;
+	}
+	nm_cmd_line_destroy (dm_cmd);
+
+	nm_log_dbg (LOGD_SHARING, "dnsmasq started with pid %d", single.pid);
+	single.watch_id = g_child_watch_add (single.pid, (GChildWatchFunc) single_watch_cb, NULL);
+	return;
+
+fail:
+	g_clear_pointer (&single.running, g_ptr_array_unref);
+	nm_log_warn (LOGD_SHARING, "Failed to start dnsmasq: %s", error->message);
+	g_error_free (error);
+	single_emit_dead ();
+}
+
+static void
+single_stopped_cb (pid_t pid, gboolean success, int child_status, void *user_data)
+{
+	single.stopping = FALSE;
+	if (single.members && !single.restart_id)
+		single_spawn ();
+}
+
+static void
+single_stop_process (void)
+{
+	if (single.watch_id) {
+		g_source_remove (single.watch_id);
+		single.watch_id = 0;
+	}
+	g_clear_pointer (&single.running, g_ptr_array_unref);
+
+	if (single.pid) {
+		single.stopping = TRUE;
+		nm_utils_kill_child_async (single.pid, SIGTERM, LOGD_SHARING, "dnsmasq", 2000,
+		                           single_stopped_cb, NULL);
+		single.pid = 0;
+	}
+	unlink (SINGLE_PIDFILE);
+}
+
+static gboolean
+single_restart_cb (gpointer user_data)
+{
+	single.restart_id = 0;
+
+	if (!single.members)
+		return G_SOURCE_REMOVE;
+
+	/* The new process can only bind once the old one has gone; it is
+	 * spawned from single_stopped_cb() then.
+	 */
+	if (single.pid)
+		single_stop_process ();
+	if (!single.stopping)
+		single_spawn ();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+single_schedule_restart (void)
+{
+	if (!single.restart_id)
+		single.restart_id = g_timeout_add (SINGLE_RESTART_DELAY_MS, single_restart_cb, NULL);
+}
+
+static gboolean
+single_is_served (const DhcpScope *scope)
+{
+	guint i;
+
+	if (!single.pid || !single.running)
+		return FALSE;
+
+	for (i = 0; i < single.running->len; i++) {
+		if (scope_equal (single.running->pdata[i], scope))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static gboolean
+single_serves_iface (const char *iface)
+{
+	guint i;
+
+	if (!single.pid || !single.running)
+		return FALSE;
+
+	for (i = 0; i < single.running->len; i++) {
+		if (!strcmp (((DhcpScope *) single.running->pdata[i])->iface, iface))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void
+single_add (NMDnsMasqManager *manager)
+{
+	NMDnsMasqManagerPrivate *priv = NM_DNSMASQ_MANAGER_GET_PRIVATE (manager);
+
+	if (!g_slist_find (single.members, manager))
+		single.members = g_slist_append (single.members, manager);
+
+	if (single_is_served (priv->scope)) {
+		nm_log_dbg (LOGD_SHARING, "(%s): already served by dnsmasq with pid %d",
+		            priv->iface, single.pid);
+		return;
+	}
+
+	nm_log_dbg (LOGD_SHARING, "(%s): dnsmasq restart scheduled", priv->iface);
+	single_schedule_restart ();
+}
+
+static void
+single_remove (NMDnsMasqManager *manager)
+{
+	NMDnsMasqManagerPrivate *priv = NM_DNSMASQ_MANAGER_GET_PRIVATE (manager);
+
+	if (!g_slist_find (single.members, manager))
+		return;
+
+	single.members = g_slist_remove (single.members, manager);
+	if (single.members) {
+		/* Otherwise dnsmasq keeps handing out leases on the interface */
+		if (single_serves_iface (priv->iface)) {
+			nm_log_dbg (LOGD_SHARING, "(%s): dnsmasq restart scheduled", priv->iface);
+			single_schedule_restart ();
+		}
+		return;
+	}
+
+	if (single.restart_id) {
+		g_source_remove (single.restart_id);
+		single.restart_id = 0;
+	}
+	single_stop_process ();
+}
+
+/*******************************************/
+
+char **
+_nm_dnsmasq_manager_single_cmd_line (const char *const *ifaces, NMIP4Config *const *configs)
+{
+	gs_unref_ptrarray GPtrArray *scopes = NULL;
+	NMCmdLine *cmd;
+	char **argv;
+	guint i;
+
+	scopes = g_ptr_array_new_with_free_func ((GDestroyNotify) scope_free);
+	for (i = 0; ifaces[i]; i++) {
+		DhcpScope *scope = scope_new (ifaces[i], configs[i], NULL);
+
+		g_return_val_if_fail (scope, NULL);
+		g_ptr_array_add (scopes, scope);
+	}
+
+	cmd = single_create_cmd_line ("dnsmasq", scopes);
+	g_ptr_array_add (cmd->array, NULL);
+	argv = g_strdupv ((char **) cmd->array->pdata);
+	nm_cmd_line_destroy (cmd);
+	return argv;
+}
+
+NMDnsMasqManager *
+_nm_dnsmasq_manager_new_single (const char *iface)
+{
+	return dnsmasq_manager_new (iface, TRUE);
+}
+
+void
+_nm_dnsmasq_manager_set_spawn_func (NMDnsMasqSpawnFunc func)
+{
+	single_spawn_func = func;
+}
+
+/*******************************************/
+
 gboolean
 nm_dnsmasq_manager_start (NMDnsMasqManager *manager,
                           NMIP4Config *ip4_config,
@@ -343,9 +742,19 @@ nm_dnsmasq_manager_start (NMDnsMasqManager *manager,
 
 	priv = NM_DNSMASQ_MANAGER_GET_PRIVATE (manager);
 
+	g_clear_pointer (&priv->scope, scope_free);
+	priv->scope = scope_new (priv->iface, ip4_config, error);
+	if (!priv->scope)
+		return FALSE;
+
+	if (priv->single) {
+		single_add (manager);
+		return TRUE;
+	}
+
 	kill_existing_for_iface (priv->iface, priv->pidfile);
 
-	dm_cmd = create_dm_cmd_line (priv->iface, ip4_config, priv->pidfile, error);
+	dm_cmd = create_dm_cmd_line (priv->scope, priv->pidfile, error);
 	if (!dm_cmd)
 		return FALSE;
 
@@ -385,6 +794,11 @@ nm_dnsmasq_manager_stop (NMDnsMasqManager *manager)
 
 	priv = NM_DNSMASQ_MANAGER_GET_PRIVATE (manager);
 
+	if (priv->single) {
+		single_remove (manager);
+		return;
+	}
+
 	if (priv->dm_watch_id) {
 		g_source_remove (priv->dm_watch_id);
 		priv->dm_watch_id = 0;
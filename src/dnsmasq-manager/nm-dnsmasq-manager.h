@@ -61,4 +61,18 @@ gboolean nm_dnsmasq_manager_start (NMDnsMasqManager *manager,
 
 void     nm_dnsmasq_manager_stop  (NMDnsMasqManager *manager);
 
+/* Testing-only functions */
+
+char **_nm_dnsmasq_manager_single_cmd_line (const char *const *ifaces,
+                                            NMIP4Config *const *configs);
+
+NMDnsMasqManager *_nm_dnsmasq_manager_new_single (const char *iface);
+
+/* Spawns the shared instance in place of dnsmasq; @argv is the would-be
+ * dnsmasq command line and @out_pid a child the caller doesn't reap.
+ */
+typedef gboolean (*NMDnsMasqSpawnFunc) (char **argv, GPid *out_pid, GError **error);
+
+void _nm_dnsmasq_manager_set_spawn_func (NMDnsMasqSpawnFunc func);
+
 #endif /* __NETWORKMANAGER_DNSMASQ_MANAGER_H__ */
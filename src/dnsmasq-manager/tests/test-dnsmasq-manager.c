@@ -0,0 +1,262 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ *
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <arpa/inet.h>
+
+#include "nm-dnsmasq-manager.h"
+#include "nm-platform.h"
+
+#include "nm-test-utils.h"
+
+static NMIP4Config *
+config_new (const char *address, guint plen)
+{
+	NMIP4Config *config = nm_ip4_config_new (1);
+	NMPlatformIP4Address addr;
+
+	memset (&addr, 0, sizeof (addr));
+	g_assert (inet_pton (AF_INET, address, (void *) &addr.address) == 1);
+	addr.plen = plen;
+	nm_ip4_config_add_address (config, &addr);
+	return config;
+}
+
+static gboolean
+has_arg (char **argv, const char *arg)
+{
+	for (; *argv; argv++) {
+		if (!strcmp (*argv, arg))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static const char *
+find_option (char **argv, const char *option)
+{
+	for (; *argv; argv++) {
+		if (g_str_has_prefix (*argv, option) && (*argv)[strlen (option)] == '=')
+			return *argv + strlen (option) + 1;
+	}
+	return NULL;
+}
+
+static void
+test_single_cmd_line (void)
+{
+	const char *ifaces[] = { "eth1", "wlan0", NULL };
+	NMIP4Config *configs[2];
+	char **argv;
+
+	configs[0] = config_new ("10.42.0.1", 24);
+	configs[1] = config_new ("10.42.1.1", 24);
+
+	argv = _nm_dnsmasq_manager_single_cmd_line (ifaces, configs);
+	g_assert (argv);
+	g_assert_cmpstr (argv[0], ==, "dnsmasq");
+
+	/* Follows interfaces that come and go instead of binding once */
+	g_assert (has_arg (argv, "--bind-dynamic"));
+	g_assert (!has_arg (argv, "--bind-interfaces"));
+
+	/* One tagged range and router per interface */
+	g_assert (has_arg (argv, "--listen-address=10.42.0.1"));
+	g_assert (has_arg (argv, "--dhcp-range=set:eth1,10.42.0.10,10.42.0.254,60m"));
+	g_assert (has_arg (argv, "--dhcp-option=tag:eth1,option:router,10.42.0.1"));
+	g_assert (has_arg (argv, "--listen-address=10.42.1.1"));
+	g_assert (has_arg (argv, "--dhcp-range=set:wlan0,10.42.1.10,10.42.1.254,60m"));
+	g_assert (has_arg (argv, "--dhcp-option=tag:wlan0,option:router,10.42.1.1"));
+
+	g_assert (has_arg (argv, "--dhcp-lease-max=100"));
+	g_assert (g_str_has_suffix (find_option (argv, "--dhcp-leasefile"), "/dnsmasq-shared.leases"));
+	g_assert (g_str_has_suffix (find_option (argv, "--pid-file"), "/run/nm-dnsmasq-shared.pid"));
+	g_strfreev (argv);
+
+	/* A removed interface's range is gone from the next command line */
+	ifaces[1] = NULL;
+	argv = _nm_dnsmasq_manager_single_cmd_line (ifaces, configs);
+	g_assert (has_arg (argv, "--dhcp-range=set:eth1,10.42.0.10,10.42.0.254,60m"));
+	g_assert (!has_arg (argv, "--listen-address=10.42.1.1"));
+	g_assert (!has_arg (argv, "--dhcp-range=set:wlan0,10.42.1.10,10.42.1.254,60m"));
+	g_assert (has_arg (argv, "--dhcp-lease-max=50"));
+	g_strfreev (argv);
+
+	g_object_unref (configs[0]);
+	g_object_unref (configs[1]);
+}
+
+/*******************************************/
+
+static guint n_spawns;
+static char **spawned_argv;
+static GPid spawned_pid;
+
+/* Stands in for dnsmasq with a child that lives until it is killed */
+static gboolean
+fake_spawn (char **argv, GPid *out_pid, GError **error)
+{
+	char *sleep_argv[] = { "sleep", "60", NULL };
+
+	if (!g_spawn_async (NULL, sleep_argv, NULL,
+	                    G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH,
+	                    NULL, NULL, out_pid, error))
+		return FALSE;
+
+	n_spawns++;
+	g_strfreev (spawned_argv);
+	spawned_argv = g_strdupv (argv);
+	spawned_pid = *out_pid;
+	return TRUE;
+}
+
+static gboolean
+quit_cb (gpointer user_data)
+{
+	g_main_loop_quit (user_data);
+	return G_SOURCE_REMOVE;
+}
+
+/* Long enough for the batched restart and for the old process to exit */
+static void
+run_for (guint ms)
+{
+	GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+
+	g_timeout_add (ms, quit_cb, loop);
+	g_main_loop_run (loop);
+	g_main_loop_unref (loop);
+}
+
+static void
+start (NMDnsMasqManager *manager, NMIP4Config *config)
+{
+	GError *error = NULL;
+
+	g_assert (nm_dnsmasq_manager_start (manager, config, &error));
+	g_assert_no_error (error);
+}
+
+static void
+test_single_restarts (void)
+{
+	NMDnsMasqManager *eth1, *wlan0, *eth2;
+	NMIP4Config *configs[4];
+	GPid pid;
+
+	_nm_dnsmasq_manager_set_spawn_func (fake_spawn);
+
+	configs[0] = config_new ("10.42.0.1", 24);
+	configs[1] = config_new ("10.42.1.1", 24);
+	configs[2] = config_new ("10.42.2.1", 24);
+	configs[3] = config_new ("10.42.3.1", 24);
+	eth1 = _nm_dnsmasq_manager_new_single ("eth1");
+	wlan0 = _nm_dnsmasq_manager_new_single ("wlan0");
+	eth2 = _nm_dnsmasq_manager_new_single ("eth2");
+
+	/* Interfaces that come up together are served by one start */
+	start (eth1, configs[0]);
+	start (wlan0, configs[1]);
+	g_assert_cmpint (n_spawns, ==, 0);
+	run_for (500);
+	g_assert_cmpint (n_spawns, ==, 1);
+	g_assert (has_arg (spawned_argv, "--dhcp-range=set:eth1,10.42.0.10,10.42.0.254,60m"));
+	g_assert (has_arg (spawned_argv, "--dhcp-range=set:wlan0,10.42.1.10,10.42.1.254,60m"));
+
+	/* Restarting sharing with unchanged addressing keeps the process */
+	start (eth1, configs[0]);
+	run_for (500);
+	g_assert_cmpint (n_spawns, ==, 1);
+
+	/* A new interface replaces the process with one serving all three */
+	pid = spawned_pid;
+	start (eth2, configs[2]);
+	run_for (500);
+	g_assert_cmpint (n_spawns, ==, 2);
+	g_assert_cmpint (kill (pid, 0), !=, 0);
+	g_assert (has_arg (spawned_argv, "--dhcp-range=set:eth1,10.42.0.10,10.42.0.254,60m"));
+	g_assert (has_arg (spawned_argv, "--dhcp-range=set:wlan0,10.42.1.10,10.42.1.254,60m"));
+	g_assert (has_arg (spawned_argv, "--dhcp-range=set:eth2,10.42.2.10,10.42.2.254,60m"));
+
+	/* So does a changed address */
+	start (eth2, configs[3]);
+	run_for (500);
+	g_assert_cmpint (n_spawns, ==, 3);
+	g_assert (has_arg (spawned_argv, "--dhcp-range=set:eth2,10.42.3.10,10.42.3.254,60m"));
+	g_assert (!has_arg (spawned_argv, "--dhcp-range=set:eth2,10.42.2.10,10.42.2.254,60m"));
+
+	/* A removed interface must no longer be served */
+	nm_dnsmasq_manager_stop (wlan0);
+	run_for (500);
+	g_assert_cmpint (n_spawns, ==, 4);
+	g_assert (has_arg (spawned_argv, "--dhcp-range=set:eth1,10.42.0.10,10.42.0.254,60m"));
+	g_assert (!has_arg (spawned_argv, "--dhcp-range=set:wlan0,10.42.1.10,10.42.1.254,60m"));
+
+	/* Removing and adding an interface within the delay is one restart */
+	nm_dnsmasq_manager_stop (eth2);
+	start (wlan0, configs[1]);
+	run_for (500);
+	g_assert_cmpint (n_spawns, ==, 5);
+	g_assert (has_arg (spawned_argv, "--dhcp-range=set:wlan0,10.42.1.10,10.42.1.254,60m"));
+	g_assert (!has_arg (spawned_argv, "--dhcp-range=set:eth2,10.42.3.10,10.42.3.254,60m"));
+
+	/* The last interface going away stops the process for good, even
+	 * with a restart pending.
+	 */
+	pid = spawned_pid;
+	nm_dnsmasq_manager_stop (eth1);
+	nm_dnsmasq_manager_stop (wlan0);
+	run_for (500);
+	g_assert_cmpint (n_spawns, ==, 5);
+	g_assert_cmpint (kill (pid, 0), !=, 0);
+
+	g_object_unref (eth1);
+	g_object_unref (wlan0);
+	g_object_unref (eth2);
+	g_object_unref (configs[0]);
+	g_object_unref (configs[1]);
+	g_object_unref (configs[2]);
+	g_object_unref (configs[3]);
+	g_clear_pointer (&spawned_argv, g_strfreev);
+	_nm_dnsmasq_manager_set_spawn_func (NULL);
+}
+
+/*******************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	nmtst_init_assert_logging (&argc, &argv, "WARN", "DEFAULT");
+
+	/* Would add logging options to the command line */
+	unsetenv ("NM_DNSMASQ_DEBUG");
+
+	g_test_add_func ("/dnsmasq-manager/single-cmd-line", test_single_cmd_line);
+	g_test_add_func ("/dnsmasq-manager/single-restarts", test_single_restarts);
+
+	return g_test_run ();
+}
@@ -38,6 +38,7 @@
 #include "main-utils.h"
 #include "NetworkManagerUtils.h"
 #include "nm-logging.h"
+#include "nm-stats.h"
 
 static gboolean
 sighup_handler (gpointer user_data)
@@ -46,6 +47,20 @@ sighup_handler (gpointer user_data)
 	return G_SOURCE_CONTINUE;
 }
 
+static gboolean
+sigusr1_handler (gpointer user_data)
+{
+	nm_stats_log_dump (FALSE);
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+sigusr2_handler (gpointer user_data)
+{
+	nm_stats_log_dump (TRUE);
+	return G_SOURCE_CONTINUE;
+}
+
 static gboolean
 sigint_handler (gpointer user_data)
 {
@@ -82,6 +97,8 @@ nm_main_utils_setup_signals (GMainLoop *main_loop)
 	signal (SIGPIPE, SIG_IGN);
 
 	g_unix_signal_add (SIGHUP, sighup_handler, NULL);
+	g_unix_signal_add (SIGUSR1, sigusr1_handler, NULL);
+	g_unix_signal_add (SIGUSR2, sigusr2_handler, NULL);
 	g_unix_signal_add (SIGINT, sigint_handler, main_loop);
 	g_unix_signal_add (SIGTERM, sigterm_handler, main_loop);
 }
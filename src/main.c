@@ -55,6 +55,8 @@
 #include "nm-dispatcher.h"
 #include "nm-settings.h"
 #include "nm-auth-manager.h"
+#include "nm-stats.h"
+#include "nm-activation-scheduler.h"
 #include "nm-core-internal.h"
 
 #if !defined(NM_DIST_VERSION)
@@ -204,6 +206,20 @@ _init_nm_debug (const char *debug)
 		_set_g_fatal_warnings ();
 }
 
+static guint
+get_watchdog_threshold (NMConfig *config)
+{
+	gs_free char *value = NULL;
+
+	/* The watchdog replaces the poll function of the main loop; only do
+	 * that when asked to. */
+	value = nm_config_data_get_value (nm_config_get_data (config), "stats", "watchdog-threshold", NULL);
+	if (!value)
+		return 0;
+
+	return _nm_utils_ascii_str_to_int64 (value, 10, 0, G_MAXUINT, 0);
+}
+
 void
 nm_main_config_reload ()
 {
@@ -443,6 +459,11 @@ main (int argc, char *argv[])
 
 	nm_dispatcher_init ();
 
+	/* Export the statistics object before any device activates */
+	nm_stats_get ();
+	nm_stats_set_scheduler_func (nm_activation_scheduler_export_stats);
+	nm_stats_watchdog_start (get_watchdog_threshold (config));
+
 	settings = nm_settings_new (&error);
 	if (!settings) {
 		nm_log_err (LOGD_CORE, "failed to initialize settings storage: %s",
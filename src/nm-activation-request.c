@@ -36,6 +36,7 @@
 #include "nm-active-connection.h"
 #include "nm-settings-connection.h"
 #include "nm-auth-subject.h"
+#include "NetworkManagerUtils.h"
 
 G_DEFINE_TYPE (NMActRequest, nm_act_request, NM_TYPE_ACTIVE_CONNECTION)
 
@@ -43,11 +44,6 @@ G_DEFINE_TYPE (NMActRequest, nm_act_request, NM_TYPE_ACTIVE_CONNECTION)
                                        NM_TYPE_ACT_REQUEST, \
                                        NMActRequestPrivate))
 
-typedef struct {
-	char *table;
-	char *rule;
-} ShareRule;
-
 typedef struct {
 	GSList *secrets_calls;
 	gboolean shared;
@@ -184,44 +180,34 @@ clear_share_rules (NMActRequest *req)
 	GSList *iter;
 
 	for (iter = priv->share_rules; iter; iter = g_slist_next (iter)) {
-		ShareRule *rule = (ShareRule *) iter->data;
+		NMUtilsIPTablesRule *rule = iter->data;
 
 		g_free (rule->table);
 		g_free (rule->rule);
-		g_free (rule);
+		g_slice_free (NMUtilsIPTablesRule, rule);
 	}
 
 	g_slist_free (priv->share_rules);
 	priv->share_rules = NULL;
 }
 
-void
-nm_act_request_set_shared (NMActRequest *req, gboolean shared)
+static void
+share_rules_apply_one_by_one (GSList *rules, gboolean shared)
 {
-	NMActRequestPrivate *priv = NM_ACT_REQUEST_GET_PRIVATE (req);
 	GSList *list, *iter;
 
-	g_return_if_fail (NM_IS_ACT_REQUEST (req));
-
-	NM_ACT_REQUEST_GET_PRIVATE (req)->shared = shared;
-
 	/* Tear the rules down in reverse order when sharing is stopped */
-	list = g_slist_copy (priv->share_rules);
+	list = g_slist_copy (rules);
 	if (!shared)
 		list = g_slist_reverse (list);
 
 	/* Send the rules to iptables */
 	for (iter = list; iter; iter = g_slist_next (iter)) {
-		ShareRule *rule = (ShareRule *) iter->data;
 		char *envp[1] = { NULL };
 		gs_strfreev char **argv = NULL;
 		gs_free char *cmd = NULL;
 
-		cmd = g_strdup_printf ("%s --table %s %s %s",
-		                       IPTABLES_PATH,
-		                       rule->table,
-		                       shared ? "--insert" : "--delete",
-		                       rule->rule);
+		cmd = nm_utils_iptables_rule_to_cmd (iter->data, shared);
 		if (!cmd)
 			continue;
 
@@ -245,6 +231,71 @@ nm_act_request_set_shared (NMActRequest *req, gboolean shared)
 	}
 
 	g_slist_free (list);
+}
+
+static void
+share_rules_apply_table (GSList *rules, const char *table, gboolean shared)
+{
+	gs_free char *script = NULL;
+	GError *error = NULL;
+
+	script = nm_utils_iptables_rules_to_restore_script (rules, shared);
+	nm_log_info (LOGD_SHARING, "Executing: %s --noflush (%s %u rules in table %s)",
+	             IPTABLES_RESTORE_PATH,
+	             shared ? "inserting" : "deleting",
+	             g_slist_length (rules), table);
+	nm_log_dbg (LOGD_SHARING, "iptables-restore input:\n%s", script);
+	if (!nm_utils_iptables_restore (script, &error)) {
+		nm_log_warn (LOGD_SHARING, "Error executing iptables-restore: %s; applying rules of table %s one by one",
+		             error->message, table);
+		g_clear_error (&error);
+		share_rules_apply_one_by_one (rules, shared);
+	}
+}
+
+void
+nm_act_request_set_shared (NMActRequest *req, gboolean shared)
+{
+	NMActRequestPrivate *priv = NM_ACT_REQUEST_GET_PRIVATE (req);
+	GSList *list, *iter, *table_rules;
+	const char *table;
+
+	g_return_if_fail (NM_IS_ACT_REQUEST (req));
+
+	NM_ACT_REQUEST_GET_PRIVATE (req)->shared = shared;
+
+	/* Apply the rules of each table with one iptables-restore. Should that
+	 * fail, e.g. because some of the rules were removed behind our back and
+	 * the table is rejected as a whole, fall back to one iptables call per
+	 * rule of that table so that the remaining ones are still handled.
+	 * iptables-restore commits each table on its own; running it once per
+	 * table tells which ones were applied, so that the rules of a table
+	 * that was committed are not applied a second time.
+	 */
+	list = g_slist_copy (priv->share_rules);
+	if (!shared)
+		list = g_slist_reverse (list);
+
+	while (list) {
+		table = ((NMUtilsIPTablesRule *) list->data)->table;
+
+		table_rules = NULL;
+		for (iter = list; iter; ) {
+			GSList *next = iter->next;
+
+			if (!strcmp (((NMUtilsIPTablesRule *) iter->data)->table, table)) {
+				list = g_slist_remove_link (list, iter);
+				table_rules = g_slist_concat (table_rules, iter);
+			}
+			iter = next;
+		}
+
+		/* Back to the order of priv->share_rules */
+		if (!shared)
+			table_rules = g_slist_reverse (table_rules);
+		share_rules_apply_table (table_rules, table, shared);
+		g_slist_free (table_rules);
+	}
 
 	/* Clear the share rule list when sharing is stopped */
 	if (!shared)
@@ -265,13 +316,13 @@ nm_act_request_add_share_rule (NMActRequest *req,
                                const char *table_rule)
 {
 	NMActRequestPrivate *priv = NM_ACT_REQUEST_GET_PRIVATE (req);
-	ShareRule *rule;
+	NMUtilsIPTablesRule *rule;
 
 	g_return_if_fail (NM_IS_ACT_REQUEST (req));
 	g_return_if_fail (table != NULL);
 	g_return_if_fail (table_rule != NULL);
 
-	rule = g_malloc0 (sizeof (ShareRule));
+	rule = g_slice_new0 (NMUtilsIPTablesRule);
 	rule->table = g_strdup (table);
 	rule->rule = g_strdup (table_rule);
 	priv->share_rules = g_slist_append (priv->share_rules, rule);
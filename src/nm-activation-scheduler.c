@@ -0,0 +1,385 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "nm-activation-scheduler.h"
+#include "nm-config.h"
+#include "nm-logging.h"
+#include "nm-core-internal.h"
+#include "NetworkManagerUtils.h"
+#include "gsystem-local-alloc.h"
+
+typedef struct {
+	guint handle;
+	NMActivationResource resource;
+	char *owner;
+	NMActivationSchedulerFunc func;
+	gpointer user_data;
+	gint64 queued_at;
+	gint64 granted_at;     /* 0 while still waiting */
+} Request;
+
+typedef struct {
+	guint limit;
+	guint in_flight;
+	GQueue waiting;
+	NMActivationSchedulerStats stats;
+} ResourceQueue;
+
+typedef struct {
+	ResourceQueue queues[_NM_ACTIVATION_RESOURCE_NUM];
+	GHashTable *requests;  /* handle :: Request */
+	guint last_handle;
+	guint dispatch_id;
+} NMActivationSchedulerPrivate;
+
+#define NM_ACTIVATION_SCHEDULER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NM_TYPE_ACTIVATION_SCHEDULER, NMActivationSchedulerPrivate))
+
+G_DEFINE_TYPE (NMActivationScheduler, nm_activation_scheduler, G_TYPE_OBJECT)
+
+NM_DEFINE_SINGLETON_DESTRUCTOR (NMActivationScheduler);
+NM_DEFINE_SINGLETON_WEAK_REF (NMActivationScheduler);
+
+/*****************************************************************************/
+
+static const char *resource_names[_NM_ACTIVATION_RESOURCE_NUM] = {
+	[NM_ACTIVATION_RESOURCE_DHCP]     = "dhcp",
+	[NM_ACTIVATION_RESOURCE_FIREWALL] = "firewall",
+};
+
+const char *
+nm_activation_resource_to_string (NMActivationResource resource)
+{
+	g_return_val_if_fail (resource < _NM_ACTIVATION_RESOURCE_NUM, NULL);
+
+	return resource_names[resource];
+}
+
+static void
+request_free (Request *req)
+{
+	g_free (req->owner);
+	g_slice_free (Request, req);
+}
+
+static void
+grant (NMActivationScheduler *self, Request *req)
+{
+	NMActivationSchedulerPrivate *priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (self);
+	ResourceQueue *q = &priv->queues[req->resource];
+	gint64 wait;
+
+	req->granted_at = nm_utils_get_monotonic_timestamp_us ();
+	q->in_flight++;
+
+	wait = req->granted_at - req->queued_at;
+	q->stats.granted++;
+	q->stats.wait_total_us += wait;
+	q->stats.wait_max_us = MAX (q->stats.wait_max_us, wait);
+}
+
+static gboolean
+dispatch_waiting (gpointer user_data)
+{
+	NMActivationScheduler *self = NM_ACTIVATION_SCHEDULER (user_data);
+	NMActivationSchedulerPrivate *priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (self);
+	guint i;
+
+	priv->dispatch_id = 0;
+
+	for (i = 0; i < _NM_ACTIVATION_RESOURCE_NUM; i++) {
+		ResourceQueue *q = &priv->queues[i];
+
+		/* Requests are granted in arrival order; a device only ever has one
+		 * request per resource outstanding, so FIFO is fair across devices.
+		 */
+		while (   !g_queue_is_empty (&q->waiting)
+		       && (!q->limit || q->in_flight < q->limit)) {
+			Request *req = g_queue_pop_head (&q->waiting);
+
+			grant (self, req);
+			nm_log_dbg (LOGD_CORE, "activation-scheduler: %s slot granted to %s after %" G_GINT64_FORMAT " ms (%u in flight, %u queued)",
+			            resource_names[i], req->owner,
+			            (req->granted_at - req->queued_at) / 1000,
+			            q->in_flight, g_queue_get_length (&q->waiting));
+			req->func (req->user_data);
+		}
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_dispatch (NMActivationScheduler *self)
+{
+	NMActivationSchedulerPrivate *priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (self);
+
+	if (!priv->dispatch_id)
+		priv->dispatch_id = g_idle_add (dispatch_waiting, self);
+}
+
+/**
+ * nm_activation_scheduler_acquire:
+ * @self: the #NMActivationScheduler
+ * @resource: the resource class the caller is about to use
+ * @owner: a name for logging, usually the interface name
+ * @func: called once the slot is granted, if it could not be granted
+ *   immediately
+ * @user_data: data for @func
+ * @out_handle: (out): the handle to pass to nm_activation_scheduler_release()
+ *
+ * Requests a slot for @resource. The caller must release the handle once
+ * the operation has finished, or to cancel a request that is still queued.
+ *
+ * Returns: %TRUE if the slot was granted immediately and the caller may
+ *   proceed; %FALSE if the request was queued and @func will be invoked
+ *   later.
+ */
+gboolean
+nm_activation_scheduler_acquire (NMActivationScheduler *self,
+                                 NMActivationResource resource,
+                                 const char *owner,
+                                 NMActivationSchedulerFunc func,
+                                 gpointer user_data,
+                                 guint *out_handle)
+{
+	NMActivationSchedulerPrivate *priv;
+	ResourceQueue *q;
+	Request *req;
+
+	g_return_val_if_fail (NM_IS_ACTIVATION_SCHEDULER (self), TRUE);
+	g_return_val_if_fail (resource < _NM_ACTIVATION_RESOURCE_NUM, TRUE);
+	g_return_val_if_fail (func, TRUE);
+	g_return_val_if_fail (out_handle, TRUE);
+
+	priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (self);
+	q = &priv->queues[resource];
+
+	req = g_slice_new0 (Request);
+	do {
+		req->handle = ++priv->last_handle;
+	} while (!req->handle || g_hash_table_contains (priv->requests, GUINT_TO_POINTER (req->handle)));
+	req->resource = resource;
+	req->owner = g_strdup (owner);
+	req->func = func;
+	req->user_data = user_data;
+	req->queued_at = nm_utils_get_monotonic_timestamp_us ();
+	g_hash_table_insert (priv->requests, GUINT_TO_POINTER (req->handle), req);
+
+	*out_handle = req->handle;
+
+	if (   g_queue_is_empty (&q->waiting)
+	    && (!q->limit || q->in_flight < q->limit)) {
+		grant (self, req);
+		return TRUE;
+	}
+
+	g_queue_push_tail (&q->waiting, req);
+	q->stats.queue_depth_max = MAX (q->stats.queue_depth_max, g_queue_get_length (&q->waiting));
+	nm_log_dbg (LOGD_CORE, "activation-scheduler: %s request from %s queued (%u in flight, %u queued)",
+	            resource_names[resource], req->owner, q->in_flight, g_queue_get_length (&q->waiting));
+	return FALSE;
+}
+
+/**
+ * nm_activation_scheduler_release:
+ * @self: the #NMActivationScheduler
+ * @handle: a handle returned by nm_activation_scheduler_acquire()
+ *
+ * Releases a granted slot, or cancels a request that is still queued. The
+ * callback of a cancelled request is never invoked.
+ */
+void
+nm_activation_scheduler_release (NMActivationScheduler *self, guint handle)
+{
+	NMActivationSchedulerPrivate *priv;
+	ResourceQueue *q;
+	Request *req;
+
+	g_return_if_fail (NM_IS_ACTIVATION_SCHEDULER (self));
+
+	priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (self);
+	req = g_hash_table_lookup (priv->requests, GUINT_TO_POINTER (handle));
+	g_return_if_fail (req);
+
+	q = &priv->queues[req->resource];
+	if (req->granted_at) {
+		gint64 hold = nm_utils_get_monotonic_timestamp_us () - req->granted_at;
+
+		g_return_if_fail (q->in_flight > 0);
+		q->in_flight--;
+		q->stats.hold_total_us += hold;
+		q->stats.hold_max_us = MAX (q->stats.hold_max_us, hold);
+		if (!g_queue_is_empty (&q->waiting))
+			schedule_dispatch (self);
+	} else
+		g_queue_remove (&q->waiting, req);
+
+	g_hash_table_remove (priv->requests, GUINT_TO_POINTER (handle));
+}
+
+void
+nm_activation_scheduler_get_stats (NMActivationScheduler *self,
+                                   NMActivationResource resource,
+                                   NMActivationSchedulerStats *out_stats)
+{
+	NMActivationSchedulerPrivate *priv;
+	ResourceQueue *q;
+
+	g_return_if_fail (NM_IS_ACTIVATION_SCHEDULER (self));
+	g_return_if_fail (resource < _NM_ACTIVATION_RESOURCE_NUM);
+	g_return_if_fail (out_stats);
+
+	priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (self);
+	q = &priv->queues[resource];
+
+	*out_stats = q->stats;
+	out_stats->limit = q->limit;
+	out_stats->in_flight = q->in_flight;
+	out_stats->queue_depth = g_queue_get_length (&q->waiting);
+}
+
+/**
+ * nm_activation_scheduler_export_stats:
+ * @resource: index of the resource to report
+ * @out_name: (out): the name of @resource
+ * @out_stats: (out): the statistics of @resource
+ *
+ * Returns: %FALSE if @resource is not a valid #NMActivationResource.
+ */
+gboolean
+nm_activation_scheduler_export_stats (guint resource,
+                                      const char **out_name,
+                                      NMActivationSchedulerStats *out_stats)
+{
+	if (resource >= _NM_ACTIVATION_RESOURCE_NUM)
+		return FALSE;
+
+	*out_name = nm_activation_resource_to_string (resource);
+	nm_activation_scheduler_get_stats (nm_activation_scheduler_get (), resource, out_stats);
+	return TRUE;
+}
+
+/*****************************************************************************/
+
+static void
+set_limits (NMActivationScheduler *self, const guint *limits)
+{
+	NMActivationSchedulerPrivate *priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (self);
+	guint i;
+
+	for (i = 0; i < _NM_ACTIVATION_RESOURCE_NUM; i++) {
+		priv->queues[i].limit = limits[i];
+		if (limits[i]) {
+			nm_log_dbg (LOGD_CORE, "activation-scheduler: at most %u concurrent %s operations",
+			            limits[i], resource_names[i]);
+		}
+	}
+}
+
+static guint
+read_limit (NMConfigData *config_data, NMActivationResource resource)
+{
+	gs_free char *key = g_strdup_printf ("%s-limit", resource_names[resource]);
+	gs_free char *value = NULL;
+
+	value = nm_config_data_get_value (config_data, "activation", key, NULL);
+	if (!value)
+		return 0;
+
+	return _nm_utils_ascii_str_to_int64 (value, 10, 0, G_MAXUINT, 0);
+}
+
+NMActivationScheduler *
+nm_activation_scheduler_get (void)
+{
+	if (G_UNLIKELY (!singleton_instance)) {
+		NMConfigData *config_data = nm_config_get_data (nm_config_get ());
+		guint limits[_NM_ACTIVATION_RESOURCE_NUM];
+		guint i;
+
+		for (i = 0; i < _NM_ACTIVATION_RESOURCE_NUM; i++)
+			limits[i] = read_limit (config_data, i);
+
+		singleton_instance = g_object_new (NM_TYPE_ACTIVATION_SCHEDULER, NULL);
+		set_limits (singleton_instance, limits);
+		nm_singleton_instance_weak_ref_register ();
+		nm_log_dbg (LOGD_CORE, "create NMActivationScheduler singleton (%p)", singleton_instance);
+	}
+	return singleton_instance;
+}
+
+/*****************************************************************************/
+/* Testing-only functions */
+
+NMActivationScheduler *
+_nm_activation_scheduler_new_for_testing (const guint *limits)
+{
+	NMActivationScheduler *self;
+
+	self = g_object_new (NM_TYPE_ACTIVATION_SCHEDULER, NULL);
+	set_limits (self, limits);
+	return self;
+}
+
+/*****************************************************************************/
+
+static void
+nm_activation_scheduler_init (NMActivationScheduler *self)
+{
+	NMActivationSchedulerPrivate *priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (self);
+	guint i;
+
+	priv->requests = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) request_free);
+
+	for (i = 0; i < _NM_ACTIVATION_RESOURCE_NUM; i++)
+		g_queue_init (&priv->queues[i].waiting);
+}
+
+static void
+dispose (GObject *object)
+{
+	NMActivationSchedulerPrivate *priv = NM_ACTIVATION_SCHEDULER_GET_PRIVATE (object);
+	guint i;
+
+	if (priv->dispatch_id) {
+		g_source_remove (priv->dispatch_id);
+		priv->dispatch_id = 0;
+	}
+
+	for (i = 0; i < _NM_ACTIVATION_RESOURCE_NUM; i++)
+		g_queue_clear (&priv->queues[i].waiting);
+	g_clear_pointer (&priv->requests, g_hash_table_unref);
+
+	G_OBJECT_CLASS (nm_activation_scheduler_parent_class)->dispose (object);
+}
+
+static void
+nm_activation_scheduler_class_init (NMActivationSchedulerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (NMActivationSchedulerPrivate));
+
+	object_class->dispose = dispose;
+}
@@ -0,0 +1,96 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#ifndef __NETWORKMANAGER_ACTIVATION_SCHEDULER_H__
+#define __NETWORKMANAGER_ACTIVATION_SCHEDULER_H__
+
+#include <glib-object.h>
+
+#include "nm-types.h"
+
+#define NM_TYPE_ACTIVATION_SCHEDULER            (nm_activation_scheduler_get_type ())
+#define NM_ACTIVATION_SCHEDULER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NM_TYPE_ACTIVATION_SCHEDULER, NMActivationScheduler))
+#define NM_ACTIVATION_SCHEDULER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NM_TYPE_ACTIVATION_SCHEDULER, NMActivationSchedulerClass))
+#define NM_IS_ACTIVATION_SCHEDULER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NM_TYPE_ACTIVATION_SCHEDULER))
+#define NM_IS_ACTIVATION_SCHEDULER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NM_TYPE_ACTIVATION_SCHEDULER))
+#define NM_ACTIVATION_SCHEDULER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NM_TYPE_ACTIVATION_SCHEDULER, NMActivationSchedulerClass))
+
+struct _NMActivationScheduler {
+	GObject parent;
+};
+
+typedef struct {
+	GObjectClass parent;
+} NMActivationSchedulerClass;
+
+/* Resources that activations compete for. Each class has its own limit of
+ * concurrently running operations, configured in the [activation] section
+ * of NetworkManager.conf.
+ */
+typedef enum {
+	NM_ACTIVATION_RESOURCE_DHCP,
+	NM_ACTIVATION_RESOURCE_FIREWALL,
+
+	_NM_ACTIVATION_RESOURCE_NUM,
+} NMActivationResource;
+
+typedef struct {
+	guint limit;           /* 0 means unlimited */
+	guint in_flight;
+	guint queue_depth;
+	guint queue_depth_max;
+	guint64 granted;
+	gint64 wait_total_us;  /* time spent queued, summed over all grants */
+	gint64 wait_max_us;
+	gint64 hold_total_us;  /* time from grant to release */
+	gint64 hold_max_us;
+} NMActivationSchedulerStats;
+
+typedef void (*NMActivationSchedulerFunc) (gpointer user_data);
+
+GType nm_activation_scheduler_get_type (void);
+
+NMActivationScheduler *nm_activation_scheduler_get (void);
+
+const char *nm_activation_resource_to_string (NMActivationResource resource);
+
+gboolean nm_activation_scheduler_acquire (NMActivationScheduler *self,
+                                          NMActivationResource resource,
+                                          const char *owner,
+                                          NMActivationSchedulerFunc func,
+                                          gpointer user_data,
+                                          guint *out_handle);
+
+void nm_activation_scheduler_release (NMActivationScheduler *self, guint handle);
+
+void nm_activation_scheduler_get_stats (NMActivationScheduler *self,
+                                        NMActivationResource resource,
+                                        NMActivationSchedulerStats *out_stats);
+
+gboolean nm_activation_scheduler_export_stats (guint resource,
+                                               const char **out_name,
+                                               NMActivationSchedulerStats *out_stats);
+
+/*****************************************************************************/
+/* Testing-only functions */
+
+NMActivationScheduler *_nm_activation_scheduler_new_for_testing (const guint *limits);
+
+#endif /* __NETWORKMANAGER_ACTIVATION_SCHEDULER_H__ */
@@ -88,6 +88,25 @@ nm_connection_provider_get_connection_by_uuid (NMConnectionProvider *self,
 	return NM_CONNECTION_PROVIDER_GET_INTERFACE (self)->get_connection_by_uuid (self, uuid);
 }
 
+/**
+ * nm_connection_provider_get_connection_by_seen_bssid:
+ * @self: the #NMConnectionProvider
+ * @bssid: the BSSID to search for
+ *
+ * Returns: a Wi-Fi connection that has @bssid in its seen-bssids list,
+ *   or %NULL
+ */
+NMConnection *
+nm_connection_provider_get_connection_by_seen_bssid (NMConnectionProvider *self,
+                                                     const char *bssid)
+{
+	g_return_val_if_fail (NM_IS_CONNECTION_PROVIDER (self), NULL);
+	g_return_val_if_fail (bssid != NULL, NULL);
+
+	g_assert (NM_CONNECTION_PROVIDER_GET_INTERFACE (self)->get_connection_by_seen_bssid);
+	return NM_CONNECTION_PROVIDER_GET_INTERFACE (self)->get_connection_by_seen_bssid (self, bssid);
+}
+
 /*****************************************************************************/
 
 static void
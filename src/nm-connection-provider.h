@@ -65,6 +65,9 @@ struct _NMConnectionProvider {
 	NMConnection * (*get_connection_by_uuid) (NMConnectionProvider *self,
 	                                          const char *uuid);
 
+	NMConnection * (*get_connection_by_seen_bssid) (NMConnectionProvider *self,
+	                                                const char *bssid);
+
 	/* Signals */
 	void (*connection_added)   (NMConnectionProvider *self, NMConnection *connection);
 
@@ -133,4 +136,7 @@ NMConnection *nm_connection_provider_add_connection (NMConnectionProvider *self,
 NMConnection *nm_connection_provider_get_connection_by_uuid (NMConnectionProvider *self,
                                                              const char *uuid);
 
+NMConnection *nm_connection_provider_get_connection_by_seen_bssid (NMConnectionProvider *self,
+                                                                   const char *bssid);
+
 #endif /* __NETWORKMANAGER_CONNECTION_PROVIDER_H__ */
@@ -36,6 +36,7 @@
 #include <dbus/dbus-glib-lowlevel.h>
 #include <string.h>
 #include "nm-logging.h"
+#include "nm-stats.h"
 
 #define PRIV_SOCK_PATH NMRUNDIR "/private"
 #define PRIV_SOCK_TAG  "private"
@@ -109,6 +110,21 @@ nm_dbus_manager_setup (NMDBusManager *instance)
 
 /**************************************************************/
 
+static DBusHandlerResult
+stats_message_filter (DBusConnection *conn,
+                      DBusMessage *message,
+                      void *data)
+{
+	if (dbus_message_get_type (message) == DBUS_MESSAGE_TYPE_METHOD_CALL) {
+		nm_stats_dbus_method_call (dbus_message_get_interface (message),
+		                           dbus_message_get_member (message));
+	}
+
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/**************************************************************/
+
 struct _PrivateServer {
 	const char *tag;
 	GQuark detail;
@@ -126,6 +142,8 @@ private_server_message_filter (DBusConnection *conn,
 	PrivateServer *s = data;
 	int fd;
 
+	stats_message_filter (conn, message, NULL);
+
 	/* Clean up after the connection */
 	if (dbus_message_is_signal (message, DBUS_INTERFACE_LOCAL, "Disconnected")) {
 		nm_log_dbg (LOGD_CORE, "(%s) closed connection %p on private socket (fd %d).",
@@ -617,6 +635,7 @@ nm_dbus_manager_cleanup (NMDBusManager *self, gboolean dispose)
 	}
 
 	if (priv->g_connection) {
+		dbus_connection_remove_filter (priv->connection, stats_message_filter, NULL);
 		dbus_g_connection_unref (priv->g_connection);
 		priv->g_connection = NULL;
 		priv->connection = NULL;
@@ -766,6 +785,7 @@ nm_dbus_manager_init_bus (NMDBusManager *self)
 
 	priv->connection = dbus_g_connection_get_connection (priv->g_connection);
 	dbus_connection_set_exit_on_disconnect (priv->connection, FALSE);
+	dbus_connection_add_filter (priv->connection, stats_message_filter, NULL, NULL);
 
 	priv->proxy = dbus_g_proxy_new_for_name (priv->g_connection,
 	                                         "org.freedesktop.DBus",
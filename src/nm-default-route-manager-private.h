@@ -0,0 +1,88 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ */
+
+#ifndef __NETWORKMANAGER_DEFAULT_ROUTE_MANAGER_PRIVATE_H__
+#define __NETWORKMANAGER_DEFAULT_ROUTE_MANAGER_PRIVATE_H__
+
+#include "nm-default-route-manager.h"
+#include "nm-platform.h"
+
+/* Internals of NMDefaultRouteManager, exposed for the testsuite */
+
+typedef struct {
+	union {
+		void *pointer;
+		GObject *object;
+		NMDevice *device;
+		NMVpnConnection *vpn;
+	} source;
+	NMPlatformIPXRoute route;
+
+	/* Whether the route is synced to platform and has a default route.
+	 *
+	 * ( synced && !never_default): the interface gets a default route that
+	 *     is enforced and managed by NMDefaultRouteManager.
+	 *
+	 * (!synced && !never_default): the interface has this route, but it is assumed.
+	 *     Assumed interfaces are those that have no tracked entry or that only have
+	 *     (!synced && !never_default) entries. NMDefaultRouteManager will not touch
+	 *     default routes on these interfaces.
+	 *     This combination makes only sense for device sources.
+	 *     They are tracked so that assumed devices can also be the best device.
+	 *
+	 * ( synced &&  never_default): entries of this kind are a placeholder
+	 *     to indicate that the ifindex is managed but has no default-route.
+	 *     Missing entries also indicate that a certain ifindex has no default-route.
+	 *     The difference is that missing entries are considered assumed while on
+	 *     (synced && never_default) entries the absence of the default route
+	 *     is enforced. NMDefaultRouteManager will actively remove any default
+	 *     route on such ifindexes.
+	 *     Also, for VPN sources in addition we track them so that a never-default
+	 *     VPN connection can be choosen by get_best_config() to receive the DNS configuration.
+	 *
+	 * (!synced &&  never_default): this combination makes no sense.
+	 */
+	gboolean synced;
+	gboolean never_default;
+
+	guint32 effective_metric;
+
+	/* The highest metric in use after this entry, while assigning the
+	 * effective metrics in order. An entry change only needs to revisit the
+	 * following entries until this value is the same as before. */
+	gint64 last_metric;
+} NMDefaultRouteEntry;
+
+gboolean _nm_default_route_entries_update (gboolean is_ip4,
+                                           GPtrArray *entries,
+                                           const GArray *routes,
+                                           guint *entry_idx,
+                                           const NMDefaultRouteEntry *old_entry,
+                                           gboolean incremental,
+                                           GArray *changed_metrics);
+gboolean _nm_default_route_entries_remove (gboolean is_ip4,
+                                           GPtrArray *entries,
+                                           const GArray *routes,
+                                           guint entry_idx,
+                                           const NMDefaultRouteEntry *removed_entry,
+                                           gboolean incremental,
+                                           GArray *changed_metrics);
+
+#endif  /* __NETWORKMANAGER_DEFAULT_ROUTE_MANAGER_PRIVATE_H__ */
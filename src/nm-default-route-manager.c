@@ -21,7 +21,7 @@
 
 #include "config.h"
 
-#include "nm-default-route-manager.h"
+#include "nm-default-route-manager-private.h"
 
 #include "string.h"
 
@@ -92,7 +92,9 @@ NM_DEFINE_SINGLETON_GETTER (NMDefaultRouteManager, nm_default_route_manager_get,
 		(entry_idx), \
 		NM_IS_DEVICE ((entry)->source.pointer) ? "dev" : "vpn", \
 		(entry)->source.pointer, \
-		NM_IS_DEVICE ((entry)->source.pointer) ? nm_device_get_iface ((entry)->source.device) : nm_vpn_connection_get_connection_id ((entry)->source.vpn), \
+		NM_IS_DEVICE ((entry)->source.pointer) \
+		    ? nm_device_get_iface ((entry)->source.device) \
+		    : (NM_IS_VPN_CONNECTION ((entry)->source.pointer) ? nm_vpn_connection_get_connection_id ((entry)->source.vpn) : NULL), \
 		((entry)->never_default ? '0' : '1'), \
 		((entry)->synced ? '+' : '-')
 
@@ -102,44 +104,7 @@ static void _resync_idle_cancel (NMDefaultRouteManager *self);
 
 /***********************************************************************************/
 
-typedef struct {
-	union {
-		void *pointer;
-		GObject *object;
-		NMDevice *device;
-		NMVpnConnection *vpn;
-	} source;
-	NMPlatformIPXRoute route;
-
-	/* Whether the route is synced to platform and has a default route.
-	 *
-	 * ( synced && !never_default): the interface gets a default route that
-	 *     is enforced and managed by NMDefaultRouteManager.
-	 *
-	 * (!synced && !never_default): the interface has this route, but it is assumed.
-	 *     Assumed interfaces are those that have no tracked entry or that only have
-	 *     (!synced && !never_default) entries. NMDefaultRouteManager will not touch
-	 *     default routes on these interfaces.
-	 *     This combination makes only sense for device sources.
-	 *     They are tracked so that assumed devices can also be the best device.
-	 *
-	 * ( synced &&  never_default): entries of this kind are a placeholder
-	 *     to indicate that the ifindex is managed but has no default-route.
-	 *     Missing entries also indicate that a certain ifindex has no default-route.
-	 *     The difference is that missing entries are considered assumed while on
-	 *     (synced && never_default) entries the absence of the default route
-	 *     is enforced. NMDefaultRouteManager will actively remove any default
-	 *     route on such ifindexes.
-	 *     Also, for VPN sources in addition we track them so that a never-default
-	 *     VPN connection can be choosen by get_best_config() to receive the DNS configuration.
-	 *
-	 * (!synced &&  never_default): this combination makes no sense.
-	 */
-	gboolean synced;
-	gboolean never_default;
-
-	guint32 effective_metric;
-} Entry;
+typedef NMDefaultRouteEntry Entry;
 
 typedef struct {
 	const NMPlatformVTableRoute *vt;
@@ -149,7 +114,7 @@ typedef struct {
 static const VTableIP vtable_ip4, vtable_ip6;
 
 static NMPlatformIPRoute *
-_vt_route_index (const VTableIP *vtable, GArray *routes, guint index)
+_vt_route_index (const VTableIP *vtable, const GArray *routes, guint index)
 {
 	if (vtable->vt->is_ip4)
 		return (NMPlatformIPRoute *) &g_array_index (routes, NMPlatformIP4Route, index);
@@ -158,7 +123,7 @@ _vt_route_index (const VTableIP *vtable, GArray *routes, guint index)
 }
 
 static gboolean
-_vt_routes_has_entry (const VTableIP *vtable, GArray *routes, const Entry *entry)
+_vt_routes_has_entry (const VTableIP *vtable, const GArray *routes, const Entry *entry)
 {
 	guint i;
 	NMPlatformIPXRoute route = entry->route;
@@ -374,44 +339,100 @@ _sort_entries_cmp (gconstpointer a, gconstpointer b, gpointer user_data)
 	return 0;
 }
 
-static GHashTable *
-_get_assumed_interface_metrics (const VTableIP *vtable, NMDefaultRouteManager *self, GArray *routes)
+typedef struct {
+	/* ifindex -> number of synced entries on that interface */
+	GHashTable *synced_ifindexes;
+
+	/* whether any interface has more than one synced entry */
+	gboolean has_shared_ifindex;
+
+	/* the metrics that are in use by assumed interfaces, which we want to preserve */
+	GHashTable *assumed_metrics;
+} ResyncContext;
+
+static void
+_resync_context_init (const VTableIP *vtable, ResyncContext *ctx, const GPtrArray *entries, const GArray *routes)
 {
-	NMDefaultRouteManagerPrivate *priv = NM_DEFAULT_ROUTE_MANAGER_GET_PRIVATE (self);
-	GPtrArray *entries;
-	guint i, j;
-	GHashTable *result;
+	guint i;
+
+	ctx->synced_ifindexes = g_hash_table_new (NULL, NULL);
+	ctx->has_shared_ifindex = FALSE;
+	for (i = 0; i < entries->len; i++) {
+		const Entry *e = g_ptr_array_index (entries, i);
+		gpointer key = GINT_TO_POINTER (e->route.rx.ifindex);
+		guint count;
+
+		if (!e->synced)
+			continue;
+
+		count = GPOINTER_TO_UINT (g_hash_table_lookup (ctx->synced_ifindexes, key)) + 1;
+		if (count > 1)
+			ctx->has_shared_ifindex = TRUE;
+		g_hash_table_insert (ctx->synced_ifindexes, key, GUINT_TO_POINTER (count));
+	}
 
 	/* create a list of all metrics that are currently assigned on an interface
 	 * that is *not* already covered by one of our synced entries.
 	 * IOW, returns the metrics that are in use by assumed interfaces
 	 * that we want to preserve. */
+	ctx->assumed_metrics = g_hash_table_new (NULL, NULL);
+	for (i = 0; i < routes->len; i++) {
+		const NMPlatformIPRoute *route = _vt_route_index (vtable, routes, i);
 
-	entries = vtable->get_entries (priv);
+		if (!g_hash_table_contains (ctx->synced_ifindexes, GINT_TO_POINTER (route->ifindex)))
+			g_hash_table_add (ctx->assumed_metrics, GUINT_TO_POINTER (vtable->vt->metric_normalize (route->metric)));
+	}
+}
 
-	result = g_hash_table_new (NULL, NULL);
+static void
+_resync_context_clear (ResyncContext *ctx)
+{
+	g_hash_table_unref (ctx->synced_ifindexes);
+	g_hash_table_unref (ctx->assumed_metrics);
+}
 
-	for (i = 0; i < routes->len; i++) {
-		gboolean ifindex_has_synced_entry = FALSE;
-		const NMPlatformIPRoute *route;
+/* Whether the change of an entry on @ifindex only affects the effective
+ * metrics from the entry's position on. That is not the case if the interface
+ * turns from assumed to managed (or vice versa) while it has default routes
+ * or assumed entries, because that changes the metrics we preserve, or if
+ * synced entries share an interface and their routes influence each other's
+ * metric. */
+static gboolean
+_resync_context_is_local_change (const VTableIP *vtable,
+                                 const ResyncContext *ctx,
+                                 const GPtrArray *entries,
+                                 const GArray *routes,
+                                 int ifindex,
+                                 gboolean was_synced,
+                                 gboolean is_synced)
+{
+	guint others, i;
 
-		route = _vt_route_index (vtable, routes, i);
+	if (ctx->has_shared_ifindex)
+		return FALSE;
 
-		for (j = 0; j < entries->len; j++) {
-			Entry *e = g_ptr_array_index (entries, j);
+	if (!was_synced == !is_synced)
+		return TRUE;
 
-			if (   e->synced
-			    && e->route.rx.ifindex == route->ifindex) {
-				ifindex_has_synced_entry = TRUE;
-				break;
-			}
-		}
+	others = GPOINTER_TO_UINT (g_hash_table_lookup (ctx->synced_ifindexes, GINT_TO_POINTER (ifindex)));
+	if (is_synced)
+		others--;
+	if (others > 0)
+		return FALSE;
 
-		if (!ifindex_has_synced_entry)
-			g_hash_table_add (result, GUINT_TO_POINTER (vtable->vt->metric_normalize (route->metric)));
-	}
+	for (i = 0; i < entries->len; i++) {
+		const Entry *e = g_ptr_array_index (entries, i);
 
-	return result;
+		if (   e->route.rx.ifindex == ifindex
+		    && !e->synced
+		    && !e->never_default)
+			return FALSE;
+	}
+	for (i = 0; i < routes->len; i++) {
+		if (_vt_route_index (vtable, routes, i)->ifindex == ifindex)
+			return FALSE;
+	}
+	return TRUE;
 }
 
 static int
@@ -425,163 +446,305 @@ _sort_metrics_ascending_fcn (gconstpointer a, gconstpointer b)
 	return m_a == m_b ? 0 : 1;
 }
 
+/* Moves the entry at @entry_idx to its place in @entries, which are sorted
+ * otherwise. Like the stable sort of the whole array, the entry ends up after
+ * the equal entries that preceded it and before the ones that followed. */
+static guint
+_entries_move_sorted (GPtrArray *entries, guint entry_idx)
+{
+	Entry *entry = g_ptr_array_index (entries, entry_idx);
+	guint len = entries->len - 1;
+	guint lower, upper, mid, idx;
+
+	memmove (&entries->pdata[entry_idx], &entries->pdata[entry_idx + 1], (len - entry_idx) * sizeof (gpointer));
+
+	lower = 0;
+	upper = len;
+	while (lower < upper) {
+		mid = lower + (upper - lower) / 2;
+		if (_sort_entries_cmp (&entries->pdata[mid], &entry, NULL) < 0)
+			lower = mid + 1;
+		else
+			upper = mid;
+	}
+
+	upper = len;
+	for (idx = lower; idx < upper; ) {
+		mid = idx + (upper - idx) / 2;
+		if (_sort_entries_cmp (&entries->pdata[mid], &entry, NULL) <= 0)
+			idx = mid + 1;
+		else
+			upper = mid;
+	}
+
+	idx = CLAMP (entry_idx, lower, upper);
+	memmove (&entries->pdata[idx + 1], &entries->pdata[idx], (len - idx) * sizeof (gpointer));
+	entries->pdata[idx] = entry;
+	return idx;
+}
+
+/* Assigns the effective metrics of the entries from @start on. Once past
+ * @end, the scan stops as soon as the highest metric in use is the same as
+ * in the previous run, because the following entries then get the same
+ * metrics as before.
+ *
+ * The metrics whose default routes must be added or removed are appended
+ * to @changed_metrics. Returns %TRUE if an effective metric changed. */
 static gboolean
-_resync_all (const VTableIP *vtable, NMDefaultRouteManager *self, const Entry *changed_entry, const Entry *old_entry, gboolean external_change)
+_entries_assign_metrics (const VTableIP *vtable,
+                         NMDefaultRouteManager *self,
+                         GPtrArray *entries,
+                         const GArray *routes,
+                         const ResyncContext *ctx,
+                         guint start,
+                         guint end,
+                         const Entry *changed_entry,
+                         const Entry *old_entry,
+                         GArray *changed_metrics)
 {
-	NMDefaultRouteManagerPrivate *priv = NM_DEFAULT_ROUTE_MANAGER_GET_PRIVATE (self);
 	Entry *entry;
 	guint i, j;
 	gint64 last_metric = -1;
+	gint64 previous_last_metric;
 	guint32 expected_metric;
-	GPtrArray *entries;
-	GArray *changed_metrics = g_array_new (FALSE, FALSE, sizeof (guint32));
-	GHashTable *assumed_metrics;
-	GArray *routes;
 	gboolean changed = FALSE;
-	int ifindex_to_flush = 0;
-
-	g_assert (priv->resync.guard == 0);
-	priv->resync.guard++;
 
-	if (!external_change) {
-		if (vtable->vt->is_ip4)
-			priv->resync.has_v4_changes = FALSE;
-		else
-			priv->resync.has_v6_changes = FALSE;
-		if (!priv->resync.has_v4_changes && !priv->resync.has_v6_changes)
-			_resync_idle_cancel (self);
-	}
+	if (start > 0)
+		last_metric = ((Entry *) g_ptr_array_index (entries, start - 1))->last_metric;
 
-	entries = vtable->get_entries (priv);
-
-	routes = vtable->vt->route_get_all (NM_PLATFORM_GET, 0, NM_PLATFORM_GET_ROUTE_MODE_ONLY_DEFAULT);
-
-	assumed_metrics = _get_assumed_interface_metrics (vtable, self, routes);
-
-	if (old_entry && old_entry->synced && !old_entry->never_default) {
-		/* The old version obviously changed. */
-		g_array_append_val (changed_metrics, old_entry->effective_metric);
-	}
-
-	/* first iterate over all entries and adjust the effective metrics. */
-	for (i = 0; i < entries->len; i++) {
+	for (i = start; i < entries->len; i++) {
 		entry = g_ptr_array_index (entries, i);
+		previous_last_metric = entry->last_metric;
 
-		g_assert (entry != old_entry);
-
-		if (entry->never_default)
-			continue;
-
-		if (!entry->synced) {
-			gboolean has_synced_entry = FALSE;
-
+		if (entry->never_default) {
+			/* no default route */
+		} else if (!entry->synced) {
 			/* A non synced entry is completely ignored, if we have
 			 * a synced entry for the same if index.
 			 * Otherwise the metric of the entry is still remembered as
 			 * last_metric to avoid reusing it. */
-			for (j = 0; j < entries->len; j++) {
-				const Entry *e = g_ptr_array_index (entries, j);
-
-				if (   e->synced
-					&& e->route.rx.ifindex == entry->route.rx.ifindex) {
-					has_synced_entry = TRUE;
-					break;
-				}
-			}
-			if (!has_synced_entry)
+			if (!g_hash_table_contains (ctx->synced_ifindexes, GINT_TO_POINTER (entry->route.rx.ifindex)))
 				last_metric = MAX (last_metric, (gint64) entry->effective_metric);
-			continue;
-		}
-
-		expected_metric = entry->route.rx.metric;
-		if ((gint64) expected_metric <= last_metric)
-			expected_metric = last_metric == G_MAXUINT32 ? G_MAXUINT32 : last_metric + 1;
+		} else {
+			expected_metric = entry->route.rx.metric;
+			if ((gint64) expected_metric <= last_metric)
+				expected_metric = last_metric == G_MAXUINT32 ? G_MAXUINT32 : last_metric + 1;
 
-		while (   expected_metric < G_MAXUINT32
-		       && g_hash_table_contains (assumed_metrics, GUINT_TO_POINTER (expected_metric))) {
-			gboolean has_metric_for_ifindex = FALSE;
+			while (   expected_metric < G_MAXUINT32
+			       && g_hash_table_contains (ctx->assumed_metrics, GUINT_TO_POINTER (expected_metric))) {
+				gboolean has_metric_for_ifindex = FALSE;
 
-			/* Check if there are assumed devices that have default routes with this metric.
-			 * If there are any, we have to pick another effective_metric. */
+				/* Check if there are assumed devices that have default routes with this metric.
+				 * If there are any, we have to pick another effective_metric. */
 
-			/* However, if there is a matching route (ifindex+metric) for our current entry, we are done. */
-			for (j = 0; j < routes->len; j++) {
-				const NMPlatformIPRoute *r = _vt_route_index (vtable, routes, i);
+				/* However, if there is a matching route (ifindex+metric) for our current entry, we are done. */
+				for (j = 0; j < routes->len; j++) {
+					const NMPlatformIPRoute *r = _vt_route_index (vtable, routes, j);
 
-				if (   r->metric == expected_metric
-				    && r->ifindex == entry->route.rx.ifindex) {
-					has_metric_for_ifindex = TRUE;
-					break;
+					if (   r->metric == expected_metric
+					    && r->ifindex == entry->route.rx.ifindex) {
+						has_metric_for_ifindex = TRUE;
+						break;
+					}
 				}
+				if (has_metric_for_ifindex)
+					break;
+				expected_metric++;
 			}
-			if (has_metric_for_ifindex)
-				break;
-			expected_metric++;
-		}
 
-		if (changed_entry == entry) {
-			/* for the changed entry, the previous metric was either old_entry->effective_metric,
-			 * or none. Hence, we only have to remember what is going to change. */
-			g_array_append_val (changed_metrics, expected_metric);
-			if (old_entry) {
-				_LOGD (vtable->vt->addr_family, LOG_ENTRY_FMT": update %s (%u -> %u)", LOG_ENTRY_ARGS (i, entry),
-				       vtable->vt->route_to_string (&entry->route), (guint) old_entry->effective_metric,
+			if (changed_entry == entry) {
+				/* for the changed entry, the previous metric was either old_entry->effective_metric,
+				 * or none. Hence, we only have to remember what is going to change. */
+				g_array_append_val (changed_metrics, expected_metric);
+				if (old_entry) {
+					_LOGD (vtable->vt->addr_family, LOG_ENTRY_FMT": update %s (%u -> %u)", LOG_ENTRY_ARGS (i, entry),
+					       vtable->vt->route_to_string (&entry->route), (guint) old_entry->effective_metric,
+					       (guint) expected_metric);
+				} else {
+					_LOGD (vtable->vt->addr_family, LOG_ENTRY_FMT": add %s (%u)", LOG_ENTRY_ARGS (i, entry),
+					       vtable->vt->route_to_string (&entry->route), (guint) expected_metric);
+				}
+			} else if (entry->effective_metric != expected_metric) {
+				g_array_append_val (changed_metrics, entry->effective_metric);
+				g_array_append_val (changed_metrics, expected_metric);
+				_LOGD (vtable->vt->addr_family, LOG_ENTRY_FMT": resync metric %s (%u -> %u)", LOG_ENTRY_ARGS (i, entry),
+				       vtable->vt->route_to_string (&entry->route), (guint) entry->effective_metric,
 				       (guint) expected_metric);
 			} else {
-				_LOGD (vtable->vt->addr_family, LOG_ENTRY_FMT": add %s (%u)", LOG_ENTRY_ARGS (i, entry),
-				       vtable->vt->route_to_string (&entry->route), (guint) expected_metric);
+				if (!_vt_routes_has_entry (vtable, routes, entry)) {
+					g_array_append_val (changed_metrics, entry->effective_metric);
+					_LOGD (vtable->vt->addr_family, LOG_ENTRY_FMT": re-add route %s (%u -> %u)", LOG_ENTRY_ARGS (i, entry),
+					       vtable->vt->route_to_string (&entry->route), (guint) entry->effective_metric,
+					       (guint) entry->effective_metric);
+				}
 			}
-		} else if (entry->effective_metric != expected_metric) {
-			g_array_append_val (changed_metrics, entry->effective_metric);
-			g_array_append_val (changed_metrics, expected_metric);
-			_LOGD (vtable->vt->addr_family, LOG_ENTRY_FMT": resync metric %s (%u -> %u)", LOG_ENTRY_ARGS (i, entry),
-			       vtable->vt->route_to_string (&entry->route), (guint) entry->effective_metric,
-			       (guint) expected_metric);
-		} else {
-			if (!_vt_routes_has_entry (vtable, routes, entry)) {
-				g_array_append_val (changed_metrics, entry->effective_metric);
-				_LOGD (vtable->vt->addr_family, LOG_ENTRY_FMT": re-add route %s (%u -> %u)", LOG_ENTRY_ARGS (i, entry),
-				       vtable->vt->route_to_string (&entry->route), (guint) entry->effective_metric,
-				       (guint) entry->effective_metric);
+
+			if (entry->effective_metric != expected_metric) {
+				entry->effective_metric = expected_metric;
+				changed = TRUE;
 			}
+			last_metric = expected_metric;
 		}
 
-		if (entry->effective_metric != expected_metric) {
-			entry->effective_metric = expected_metric;
-			changed = TRUE;
+		entry->last_metric = last_metric;
+		if (   i >= end
+		    && last_metric == previous_last_metric)
+			break;
+	}
+
+	return changed;
+}
+
+static gboolean
+_entries_update (const VTableIP *vtable,
+                 NMDefaultRouteManager *self,
+                 GPtrArray *entries,
+                 const GArray *routes,
+                 guint *entry_idx,
+                 const Entry *old_entry,
+                 gboolean incremental,
+                 GArray *changed_metrics)
+{
+	Entry *entry = g_ptr_array_index (entries, *entry_idx);
+	ResyncContext ctx;
+	guint old_idx = *entry_idx;
+	guint start = 0, end = G_MAXUINT;
+	gboolean changed;
+
+	if (old_entry && old_entry->synced && !old_entry->never_default) {
+		/* The old version obviously changed. */
+		g_array_append_val (changed_metrics, old_entry->effective_metric);
+	}
+
+	if (incremental)
+		*entry_idx = _entries_move_sorted (entries, old_idx);
+	else {
+		g_ptr_array_sort_with_data (entries, _sort_entries_cmp, NULL);
+		for (*entry_idx = 0; g_ptr_array_index (entries, *entry_idx) != entry; (*entry_idx)++)
+			;
+	}
+
+	_resync_context_init (vtable, &ctx, entries, routes);
+
+	if (   incremental
+	    && _resync_context_is_local_change (vtable, &ctx, entries, routes, entry->route.rx.ifindex,
+	                                        old_entry && old_entry->synced, entry->synced)) {
+		/* Only the entries between the old and the new position of the
+		 * changed entry see a different sequence of entries before them.
+		 * A new entry has no old position. */
+		if (old_entry) {
+			start = MIN (old_idx, *entry_idx);
+			end = MAX (old_idx, *entry_idx) + 1;
+		} else {
+			start = *entry_idx;
+			end = *entry_idx + 1;
 		}
-		last_metric = expected_metric;
 	}
 
-	g_array_free (routes, TRUE);
+	changed = _entries_assign_metrics (vtable, self, entries, routes, &ctx, start, end, entry, old_entry, changed_metrics);
+
+	_resync_context_clear (&ctx);
+	return changed;
+}
+
+static gboolean
+_entries_remove (const VTableIP *vtable,
+                 NMDefaultRouteManager *self,
+                 GPtrArray *entries,
+                 const GArray *routes,
+                 guint entry_idx,
+                 const Entry *removed_entry,
+                 gboolean incremental,
+                 GArray *changed_metrics)
+{
+	ResyncContext ctx;
+	guint start = 0, end = G_MAXUINT;
+	gboolean changed;
+
+	if (removed_entry->synced && !removed_entry->never_default)
+		g_array_append_val (changed_metrics, removed_entry->effective_metric);
+
+	_resync_context_init (vtable, &ctx, entries, routes);
+
+	if (   incremental
+	    && _resync_context_is_local_change (vtable, &ctx, entries, routes, removed_entry->route.rx.ifindex,
+	                                        removed_entry->synced, FALSE))
+		start = end = entry_idx;
+
+	changed = _entries_assign_metrics (vtable, self, entries, routes, &ctx, start, end, NULL, removed_entry, changed_metrics);
+
+	_resync_context_clear (&ctx);
+	return changed;
+}
+
+static gboolean
+_resync_apply (const VTableIP *vtable, NMDefaultRouteManager *self, GArray *changed_metrics, int ifindex_to_flush)
+{
+	gint64 last_metric = -1;
+	guint32 metric;
+	gboolean changed = FALSE;
+	guint i;
 
 	g_array_sort (changed_metrics, _sort_metrics_ascending_fcn);
-	last_metric = -1;
-	for (j = 0; j < changed_metrics->len; j++) {
-		expected_metric = g_array_index (changed_metrics, guint32, j);
+	for (i = 0; i < changed_metrics->len; i++) {
+		metric = g_array_index (changed_metrics, guint32, i);
 
-		if (last_metric == (gint64) expected_metric) {
+		if (last_metric == (gint64) metric) {
 			/* skip duplicates. */
 			continue;
 		}
-		changed |= _platform_route_sync_add (vtable, self, expected_metric);
-		last_metric = expected_metric;
+		changed |= _platform_route_sync_add (vtable, self, metric);
+		last_metric = metric;
 	}
 
-	if (   old_entry
-	    && !changed_entry
-	    && old_entry->synced
-	    && !old_entry->never_default) {
-		/* If we entriely remove an entry that was synced before, we must make
-		 * sure to flush routes for this ifindex too. Otherwise they linger
-		 * around as "assumed" routes */
-		ifindex_to_flush = old_entry->route.rx.ifindex;
+	changed |= _platform_route_sync_flush (vtable, self, ifindex_to_flush);
+	return changed;
+}
+
+/* Returns %TRUE if there were external changes pending for the address
+ * family of @vtable, which are now going to be handled. */
+static gboolean
+_resync_take_pending (const VTableIP *vtable, NMDefaultRouteManager *self)
+{
+	NMDefaultRouteManagerPrivate *priv = NM_DEFAULT_ROUTE_MANAGER_GET_PRIVATE (self);
+	gboolean pending;
+
+	if (vtable->vt->is_ip4) {
+		pending = priv->resync.has_v4_changes;
+		priv->resync.has_v4_changes = FALSE;
+	} else {
+		pending = priv->resync.has_v6_changes;
+		priv->resync.has_v6_changes = FALSE;
 	}
+	if (!priv->resync.has_v4_changes && !priv->resync.has_v6_changes)
+		_resync_idle_cancel (self);
+	return pending;
+}
 
-	changed |= _platform_route_sync_flush (vtable, self, ifindex_to_flush);
+static gboolean
+_resync_all (const VTableIP *vtable, NMDefaultRouteManager *self)
+{
+	NMDefaultRouteManagerPrivate *priv = NM_DEFAULT_ROUTE_MANAGER_GET_PRIVATE (self);
+	GArray *changed_metrics = g_array_new (FALSE, FALSE, sizeof (guint32));
+	ResyncContext ctx;
+	GPtrArray *entries;
+	GArray *routes;
+	gboolean changed;
+
+	g_assert (priv->resync.guard == 0);
+	priv->resync.guard++;
+
+	entries = vtable->get_entries (priv);
+	routes = vtable->vt->route_get_all (NM_PLATFORM_GET, 0, NM_PLATFORM_GET_ROUTE_MODE_ONLY_DEFAULT);
+
+	_resync_context_init (vtable, &ctx, entries, routes);
+	changed = _entries_assign_metrics (vtable, self, entries, routes, &ctx, 0, G_MAXUINT, NULL, NULL, changed_metrics);
+	_resync_context_clear (&ctx);
+	g_array_free (routes, TRUE);
+
+	changed |= _resync_apply (vtable, self, changed_metrics, 0);
 
 	g_array_free (changed_metrics, TRUE);
-	g_hash_table_unref (assumed_metrics);
 
 	priv->resync.guard--;
 	return changed;
@@ -593,6 +756,9 @@ _entry_at_idx_update (const VTableIP *vtable, NMDefaultRouteManager *self, guint
 	NMDefaultRouteManagerPrivate *priv = NM_DEFAULT_ROUTE_MANAGER_GET_PRIVATE (self);
 	Entry *entry;
 	GPtrArray *entries;
+	GArray *routes;
+	GArray *changed_metrics;
+	gboolean incremental;
 
 	entries = vtable->get_entries (priv);
 	g_assert (entry_idx < entries->len);
@@ -610,9 +776,23 @@ _entry_at_idx_update (const VTableIP *vtable, NMDefaultRouteManager *self, guint
 	       old_entry ? "update" : "add",
 	       vtable->vt->route_to_string (&entry->route));
 
-	g_ptr_array_sort_with_data (entries, _sort_entries_cmp, NULL);
+	g_assert (priv->resync.guard == 0);
+	priv->resync.guard++;
+
+	/* Pending external changes could affect every entry; handle them with
+	 * a full resync. */
+	incremental = !_resync_take_pending (vtable, self);
 
-	_resync_all (vtable, self, entry, old_entry, FALSE);
+	routes = vtable->vt->route_get_all (NM_PLATFORM_GET, 0, NM_PLATFORM_GET_ROUTE_MODE_ONLY_DEFAULT);
+	changed_metrics = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	_entries_update (vtable, self, entries, routes, &entry_idx, old_entry, incremental, changed_metrics);
+	g_array_free (routes, TRUE);
+
+	_resync_apply (vtable, self, changed_metrics, 0);
+	g_array_free (changed_metrics, TRUE);
+
+	priv->resync.guard--;
 }
 
 static void
@@ -621,6 +801,10 @@ _entry_at_idx_remove (const VTableIP *vtable, NMDefaultRouteManager *self, guint
 	NMDefaultRouteManagerPrivate *priv = NM_DEFAULT_ROUTE_MANAGER_GET_PRIVATE (self);
 	Entry *entry;
 	GPtrArray *entries;
+	GArray *routes;
+	GArray *changed_metrics;
+	gboolean incremental;
+	int ifindex_to_flush = 0;
 
 	entries = vtable->get_entries (priv);
 
@@ -635,13 +819,65 @@ _entry_at_idx_remove (const VTableIP *vtable, NMDefaultRouteManager *self, guint
 	g_ptr_array_index (entries, entry_idx) = NULL;
 	g_ptr_array_remove_index (entries, entry_idx);
 
-	_resync_all (vtable, self, NULL, entry, FALSE);
+	g_assert (priv->resync.guard == 0);
+	priv->resync.guard++;
+
+	incremental = !_resync_take_pending (vtable, self);
+
+	routes = vtable->vt->route_get_all (NM_PLATFORM_GET, 0, NM_PLATFORM_GET_ROUTE_MODE_ONLY_DEFAULT);
+	changed_metrics = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	_entries_remove (vtable, self, entries, routes, entry_idx, entry, incremental, changed_metrics);
+	g_array_free (routes, TRUE);
+
+	if (entry->synced && !entry->never_default) {
+		/* If we entriely remove an entry that was synced before, we must make
+		 * sure to flush routes for this ifindex too. Otherwise they linger
+		 * around as "assumed" routes */
+		ifindex_to_flush = entry->route.rx.ifindex;
+	}
+
+	_resync_apply (vtable, self, changed_metrics, ifindex_to_flush);
+	g_array_free (changed_metrics, TRUE);
+
+	priv->resync.guard--;
 
 	_entry_free (entry);
 }
 
 /***********************************************************************************/
 
+/* For testcases only! Run the metric assignment on @entries against the default
+ * routes @routes, either incrementally or with a full resort and resync. */
+gboolean
+_nm_default_route_entries_update (gboolean is_ip4,
+                                  GPtrArray *entries,
+                                  const GArray *routes,
+                                  guint *entry_idx,
+                                  const NMDefaultRouteEntry *old_entry,
+                                  gboolean incremental,
+                                  GArray *changed_metrics)
+{
+	return _entries_update (is_ip4 ? &vtable_ip4 : &vtable_ip6, NULL,
+	                        entries, routes, entry_idx, old_entry, incremental, changed_metrics);
+}
+
+/* For testcases only! @removed_entry was at @entry_idx and is no longer part of @entries. */
+gboolean
+_nm_default_route_entries_remove (gboolean is_ip4,
+                                  GPtrArray *entries,
+                                  const GArray *routes,
+                                  guint entry_idx,
+                                  const NMDefaultRouteEntry *removed_entry,
+                                  gboolean incremental,
+                                  GArray *changed_metrics)
+{
+	return _entries_remove (is_ip4 ? &vtable_ip4 : &vtable_ip6, NULL,
+	                        entries, routes, entry_idx, removed_entry, incremental, changed_metrics);
+}
+
+/***********************************************************************************/
+
 static void
 _ipx_update_default_route (const VTableIP *vtable, NMDefaultRouteManager *self, gpointer source)
 {
@@ -1196,10 +1432,10 @@ _resync_idle_now (NMDefaultRouteManager *self)
 	    : priv->resync.backoff_wait_time_ms * 2;
 
 	if (has_v4_changes)
-		changed |= _resync_all (&vtable_ip4, self, NULL, NULL, TRUE);
+		changed |= _resync_all (&vtable_ip4, self);
 
 	if (has_v6_changes)
-		changed |= _resync_all (&vtable_ip6, self, NULL, NULL, TRUE);
+		changed |= _resync_all (&vtable_ip6, self);
 
 	if (!changed) {
 		/* Nothing changed: reset the backoff wait time */
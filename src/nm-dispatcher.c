@@ -549,7 +549,8 @@ _dispatcher_call (DispatcherAction action,
 	if (connection) {
 		const char *filename;
 
-		connection_dict = nm_connection_to_dbus (connection, NM_CONNECTION_SERIALIZE_NO_SECRETS);
+		connection_dict = nm_settings_connection_to_dbus (NM_SETTINGS_CONNECTION (connection),
+		                                                  NM_CONNECTION_SERIALIZE_NO_SECRETS);
 
 		g_variant_builder_init (&connection_props, G_VARIANT_TYPE_VARDICT);
 		g_variant_builder_add (&connection_props, "{sv}",
@@ -567,7 +568,7 @@ _dispatcher_call (DispatcherAction action,
 			                       g_variant_new_boolean (TRUE));
 		}
 	} else {
-		connection_dict = g_variant_new_array (G_VARIANT_TYPE ("{sa{sv}}"), NULL, 0);
+		connection_dict = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE ("{sa{sv}}"), NULL, 0));
 		g_variant_builder_init (&connection_props, G_VARIANT_TYPE_VARDICT);
 	}
 
@@ -652,6 +653,7 @@ _dispatcher_call (DispatcherAction action,
 		                   NULL, dispatcher_done_cb, info);
 		success = TRUE;
 	}
+	g_variant_unref (connection_dict);
 
 done:
 	if (success && info) {
@@ -0,0 +1,425 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "nm-hostname-resolver.h"
+#include "nm-logging.h"
+#include "NetworkManagerUtils.h"
+
+/* Reverse lookups of an address are cached per DNS configuration: a
+ * successful result stays valid until the DNS configuration changes, a
+ * failure for negative_ttl_ms. Callers asking for an address that is
+ * already being looked up share the pending resolver operation.
+ */
+
+typedef struct {
+	char *hostname;
+	GError *error;
+	gint64 expires_at;     /* 0 if valid until the DNS configuration changes */
+} CacheEntry;
+
+typedef struct {
+	GSimpleAsyncResult *simple;
+	GCancellable *cancellable;
+	gulong cancelled_id;
+} Waiter;
+
+typedef struct {
+	NMHostnameResolver *self;
+	char *key;
+	GCancellable *cancellable;
+	guint timeout_id;
+	gboolean timed_out;
+	GSList *waiters;
+} Lookup;
+
+typedef struct {
+	GResolver *resolver;
+	guint timeout_ms;
+	guint negative_ttl_ms;
+
+	char *dns_hash;        /* DNS configuration the cache is valid for */
+	GHashTable *cache;     /* key :: CacheEntry */
+	GHashTable *lookups;   /* key :: Lookup */
+	guint abandoned_id;
+} NMHostnameResolverPrivate;
+
+#define NM_HOSTNAME_RESOLVER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NM_TYPE_HOSTNAME_RESOLVER, NMHostnameResolverPrivate))
+
+G_DEFINE_TYPE (NMHostnameResolver, nm_hostname_resolver, G_TYPE_OBJECT)
+
+/*****************************************************************************/
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+	g_free (entry->hostname);
+	g_clear_error (&entry->error);
+	g_slice_free (CacheEntry, entry);
+}
+
+static void
+lookup_free (Lookup *lookup)
+{
+	g_assert (!lookup->waiters);
+
+	if (lookup->timeout_id)
+		g_source_remove (lookup->timeout_id);
+	g_object_unref (lookup->cancellable);
+	g_object_unref (lookup->self);
+	g_free (lookup->key);
+	g_slice_free (Lookup, lookup);
+}
+
+static void
+complete (GSimpleAsyncResult *simple, const char *hostname, const GError *error, gboolean in_idle)
+{
+	if (hostname)
+		g_simple_async_result_set_op_res_gpointer (simple, g_strdup (hostname), g_free);
+	else
+		g_simple_async_result_set_from_error (simple, error);
+
+	if (in_idle)
+		g_simple_async_result_complete_in_idle (simple);
+	else
+		g_simple_async_result_complete (simple);
+}
+
+static void
+waiter_complete (Waiter *waiter, const char *hostname, const GError *error)
+{
+	if (waiter->cancelled_id)
+		g_cancellable_disconnect (waiter->cancellable, waiter->cancelled_id);
+	complete (waiter->simple, hostname, error, FALSE);
+	g_object_unref (waiter->simple);
+	g_clear_object (&waiter->cancellable);
+	g_slice_free (Waiter, waiter);
+}
+
+/* Completes the waiters that were cancelled and cancels lookups nobody
+ * waits for anymore, rather than keeping them in flight until the
+ * resolver gives up. */
+static gboolean
+cancel_abandoned_lookups (gpointer user_data)
+{
+	NMHostnameResolver *self = user_data;
+	NMHostnameResolverPrivate *priv = NM_HOSTNAME_RESOLVER_GET_PRIVATE (self);
+	GHashTableIter iter;
+	Lookup *lookup;
+	GSList *waiters, *l;
+	GError *error = NULL;
+
+	priv->abandoned_id = 0;
+
+	g_set_error_literal (&error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Operation was cancelled");
+
+	g_hash_table_iter_init (&iter, priv->lookups);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &lookup)) {
+		waiters = lookup->waiters;
+		lookup->waiters = NULL;
+		for (l = waiters; l; l = l->next) {
+			Waiter *waiter = l->data;
+
+			if (waiter->cancellable && g_cancellable_is_cancelled (waiter->cancellable))
+				waiter_complete (waiter, NULL, error);
+			else
+				lookup->waiters = g_slist_append (lookup->waiters, waiter);
+		}
+		g_slist_free (waiters);
+
+		if (!lookup->waiters) {
+			/* New requests must not join a cancelled lookup */
+			g_hash_table_iter_steal (&iter);
+			g_cancellable_cancel (lookup->cancellable);
+		}
+	}
+
+	g_error_free (error);
+	return G_SOURCE_REMOVE;
+}
+
+/* Callers commonly cancel a lookup and ask for the same address again
+ * right away; only cancel the lookup itself if nobody asked again until
+ * the next main loop iteration. */
+static void
+waiter_cancelled_cb (GCancellable *cancellable, gpointer user_data)
+{
+	NMHostnameResolver *self = user_data;
+	NMHostnameResolverPrivate *priv = NM_HOSTNAME_RESOLVER_GET_PRIVATE (self);
+
+	if (!priv->abandoned_id && priv->lookups)
+		priv->abandoned_id = g_idle_add (cancel_abandoned_lookups, self);
+}
+
+static void
+lookup_done (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+	Lookup *lookup = user_data;
+	NMHostnameResolverPrivate *priv = NM_HOSTNAME_RESOLVER_GET_PRIVATE (lookup->self);
+	GError *error = NULL;
+	char *hostname;
+	GSList *waiters, *iter;
+
+	hostname = g_resolver_lookup_by_address_finish (G_RESOLVER (source), result, &error);
+	if (lookup->timed_out) {
+		g_clear_error (&error);
+		g_set_error (&error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+		             "Reverse lookup of %s timed out", lookup->key);
+	}
+
+	if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		CacheEntry *entry;
+
+		if (hostname || priv->negative_ttl_ms) {
+			entry = g_slice_new0 (CacheEntry);
+			if (hostname)
+				entry->hostname = g_strdup (hostname);
+			else {
+				entry->error = g_error_copy (error);
+				entry->expires_at = nm_utils_get_monotonic_timestamp_ms () + priv->negative_ttl_ms;
+			}
+			g_hash_table_insert (priv->cache, g_strdup (lookup->key), entry);
+		}
+
+		nm_log_dbg (LOGD_DNS, "hostname-resolver: %s resolved to %s%s",
+		            lookup->key,
+		            hostname ? hostname : "error: ",
+		            hostname ? "" : error->message);
+	}
+
+	/* New requests for the key start from the cache */
+	if (g_hash_table_lookup (priv->lookups, lookup->key) == lookup)
+		g_hash_table_steal (priv->lookups, lookup->key);
+
+	waiters = lookup->waiters;
+	lookup->waiters = NULL;
+	for (iter = waiters; iter; iter = iter->next)
+		waiter_complete (iter->data, hostname, error);
+	g_slist_free (waiters);
+
+	lookup_free (lookup);
+	g_free (hostname);
+	g_clear_error (&error);
+}
+
+static gboolean
+lookup_timeout_cb (gpointer user_data)
+{
+	Lookup *lookup = user_data;
+
+	lookup->timeout_id = 0;
+	lookup->timed_out = TRUE;
+	g_cancellable_cancel (lookup->cancellable);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * nm_hostname_resolver_lookup_async:
+ * @self: the #NMHostnameResolver
+ * @address: the address to look up
+ * @dns_hash: identifies the DNS configuration the lookup is done with,
+ *   see nm_dns_manager_get_config_hash()
+ * @cancellable: (allow-none): a #GCancellable
+ * @callback: called with the result
+ * @user_data: data for @callback
+ *
+ * Starts a reverse lookup of @address, unless the result is cached for
+ * @dns_hash or a lookup for it is already in progress. When @dns_hash
+ * differs from the previous call, all cached results are dropped.
+ */
+void
+nm_hostname_resolver_lookup_async (NMHostnameResolver *self,
+                                   GInetAddress *address,
+                                   const char *dns_hash,
+                                   GCancellable *cancellable,
+                                   GAsyncReadyCallback callback,
+                                   gpointer user_data)
+{
+	NMHostnameResolverPrivate *priv;
+	GSimpleAsyncResult *simple;
+	CacheEntry *entry;
+	Lookup *lookup;
+	Waiter *waiter;
+	char *addr_str, *key;
+
+	g_return_if_fail (NM_IS_HOSTNAME_RESOLVER (self));
+	g_return_if_fail (G_IS_INET_ADDRESS (address));
+
+	priv = NM_HOSTNAME_RESOLVER_GET_PRIVATE (self);
+
+	simple = g_simple_async_result_new (G_OBJECT (self), callback, user_data,
+	                                    nm_hostname_resolver_lookup_async);
+	if (cancellable)
+		g_simple_async_result_set_check_cancellable (simple, cancellable);
+
+	if (g_strcmp0 (priv->dns_hash, dns_hash) != 0) {
+		if (g_hash_table_size (priv->cache))
+			nm_log_dbg (LOGD_DNS, "hostname-resolver: DNS configuration changed, dropping cache");
+		g_free (priv->dns_hash);
+		priv->dns_hash = g_strdup (dns_hash);
+		g_hash_table_remove_all (priv->cache);
+	}
+
+	addr_str = g_inet_address_to_string (address);
+	key = g_strdup_printf ("%s/%s", addr_str, dns_hash ? dns_hash : "");
+	g_free (addr_str);
+
+	entry = g_hash_table_lookup (priv->cache, key);
+	if (entry && entry->expires_at && entry->expires_at <= nm_utils_get_monotonic_timestamp_ms ()) {
+		g_hash_table_remove (priv->cache, key);
+		entry = NULL;
+	}
+	if (entry) {
+		complete (simple, entry->hostname, entry->error, TRUE);
+		g_object_unref (simple);
+		g_free (key);
+		return;
+	}
+
+	lookup = g_hash_table_lookup (priv->lookups, key);
+	if (!lookup) {
+		lookup = g_slice_new0 (Lookup);
+		lookup->self = g_object_ref (self);
+		lookup->key = g_strdup (key);
+		lookup->cancellable = g_cancellable_new ();
+		if (priv->timeout_ms)
+			lookup->timeout_id = g_timeout_add (priv->timeout_ms, lookup_timeout_cb, lookup);
+		g_hash_table_insert (priv->lookups, lookup->key, lookup);
+
+		nm_log_dbg (LOGD_DNS, "hostname-resolver: starting reverse lookup of %s", key);
+		g_resolver_lookup_by_address_async (priv->resolver, address, lookup->cancellable,
+		                                    lookup_done, lookup);
+	}
+
+	waiter = g_slice_new0 (Waiter);
+	waiter->simple = simple;
+	lookup->waiters = g_slist_append (lookup->waiters, waiter);
+	if (cancellable) {
+		waiter->cancellable = g_object_ref (cancellable);
+		waiter->cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (waiter_cancelled_cb),
+		                                              self, NULL);
+	}
+
+	g_free (key);
+}
+
+/**
+ * nm_hostname_resolver_lookup_finish:
+ * @self: the #NMHostnameResolver
+ * @result: the #GAsyncResult passed to the callback
+ * @error: return location for a #GError
+ *
+ * Returns: the hostname, or %NULL on failure. A lookup that did not
+ * finish in time fails with %G_IO_ERROR_TIMED_OUT.
+ */
+char *
+nm_hostname_resolver_lookup_finish (NMHostnameResolver *self,
+                                    GAsyncResult *result,
+                                    GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (g_simple_async_result_is_valid (result, G_OBJECT (self),
+	                                                      nm_hostname_resolver_lookup_async),
+	                      NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (result);
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	return g_strdup (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/*****************************************************************************/
+
+/**
+ * nm_hostname_resolver_new:
+ * @resolver: the #GResolver doing the lookups
+ * @timeout_ms: cancel lookups after this time, 0 for no timeout
+ * @negative_ttl_ms: how long failed lookups are cached, 0 to not cache them
+ *
+ * Returns: a new #NMHostnameResolver
+ */
+NMHostnameResolver *
+nm_hostname_resolver_new (GResolver *resolver, guint timeout_ms, guint negative_ttl_ms)
+{
+	NMHostnameResolver *self;
+	NMHostnameResolverPrivate *priv;
+
+	g_return_val_if_fail (G_IS_RESOLVER (resolver), NULL);
+
+	self = g_object_new (NM_TYPE_HOSTNAME_RESOLVER, NULL);
+	priv = NM_HOSTNAME_RESOLVER_GET_PRIVATE (self);
+	priv->resolver = g_object_ref (resolver);
+	priv->timeout_ms = timeout_ms;
+	priv->negative_ttl_ms = negative_ttl_ms;
+	return self;
+}
+
+static void
+nm_hostname_resolver_init (NMHostnameResolver *self)
+{
+	NMHostnameResolverPrivate *priv = NM_HOSTNAME_RESOLVER_GET_PRIVATE (self);
+
+	priv->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) cache_entry_free);
+	priv->lookups = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+static void
+dispose (GObject *object)
+{
+	NMHostnameResolverPrivate *priv = NM_HOSTNAME_RESOLVER_GET_PRIVATE (object);
+
+	if (priv->abandoned_id) {
+		g_source_remove (priv->abandoned_id);
+		priv->abandoned_id = 0;
+	}
+
+	/* Lookups keep the resolver alive, so none can be pending here */
+	g_clear_pointer (&priv->lookups, g_hash_table_unref);
+	g_clear_pointer (&priv->cache, g_hash_table_unref);
+	g_clear_object (&priv->resolver);
+
+	G_OBJECT_CLASS (nm_hostname_resolver_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+	NMHostnameResolverPrivate *priv = NM_HOSTNAME_RESOLVER_GET_PRIVATE (object);
+
+	g_free (priv->dns_hash);
+
+	G_OBJECT_CLASS (nm_hostname_resolver_parent_class)->finalize (object);
+}
+
+static void
+nm_hostname_resolver_class_init (NMHostnameResolverClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (NMHostnameResolverPrivate));
+
+	object_class->dispose = dispose;
+	object_class->finalize = finalize;
+}
@@ -0,0 +1,60 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#ifndef __NETWORKMANAGER_HOSTNAME_RESOLVER_H__
+#define __NETWORKMANAGER_HOSTNAME_RESOLVER_H__
+
+#include <gio/gio.h>
+
+#include "nm-types.h"
+
+#define NM_TYPE_HOSTNAME_RESOLVER            (nm_hostname_resolver_get_type ())
+#define NM_HOSTNAME_RESOLVER(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NM_TYPE_HOSTNAME_RESOLVER, NMHostnameResolver))
+#define NM_HOSTNAME_RESOLVER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NM_TYPE_HOSTNAME_RESOLVER, NMHostnameResolverClass))
+#define NM_IS_HOSTNAME_RESOLVER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NM_TYPE_HOSTNAME_RESOLVER))
+#define NM_IS_HOSTNAME_RESOLVER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NM_TYPE_HOSTNAME_RESOLVER))
+#define NM_HOSTNAME_RESOLVER_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NM_TYPE_HOSTNAME_RESOLVER, NMHostnameResolverClass))
+
+struct _NMHostnameResolver {
+	GObject parent;
+};
+
+typedef struct {
+	GObjectClass parent;
+} NMHostnameResolverClass;
+
+GType nm_hostname_resolver_get_type (void);
+
+NMHostnameResolver *nm_hostname_resolver_new (GResolver *resolver,
+                                              guint timeout_ms,
+                                              guint negative_ttl_ms);
+
+void nm_hostname_resolver_lookup_async (NMHostnameResolver *self,
+                                        GInetAddress *address,
+                                        const char *dns_hash,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data);
+
+char *nm_hostname_resolver_lookup_finish (NMHostnameResolver *self,
+                                          GAsyncResult *result,
+                                          GError **error);
+
+#endif /* __NETWORKMANAGER_HOSTNAME_RESOLVER_H__ */
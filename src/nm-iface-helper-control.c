@@ -0,0 +1,144 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <glib/gi18n.h>
+
+#include "nm-iface-helper-control.h"
+#include "gsystem-local-alloc.h"
+
+static const char *command_names[] = {
+	[NMIH_CONTROL_COMMAND_ADD]    = "add",
+	[NMIH_CONTROL_COMMAND_REMOVE] = "remove",
+};
+
+/**
+ * nm_iface_helper_control_parse:
+ * @msg: the received message, without trailing whitespace
+ * @out_command: on return, the command
+ * @out_arg: on return, the argument of the command, pointing into @msg
+ * @error: location to store the error on failure
+ *
+ * Returns: %TRUE if @msg is a known command with a non-empty argument
+ */
+gboolean
+nm_iface_helper_control_parse (const char *msg,
+                               NMIfaceHelperCommand *out_command,
+                               const char **out_arg,
+                               GError **error)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (command_names); i++) {
+		gsize len = strlen (command_names[i]);
+
+		if (   strncmp (msg, command_names[i], len) == 0
+		    && msg[len] == ' '
+		    && msg[len + 1]) {
+			*out_command = i;
+			*out_arg = msg + len + 1;
+			return TRUE;
+		}
+	}
+
+	g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+	                     _("Unknown command"));
+	return FALSE;
+}
+
+/**
+ * nm_iface_helper_control_reply:
+ * @error: the error the command failed with, or %NULL
+ *
+ * Returns: the reply to send back for a command
+ */
+char *
+nm_iface_helper_control_reply (const GError *error)
+{
+	if (!error)
+		return g_strdup ("ok");
+	return g_strdup_printf ("error %s", error->message);
+}
+
+/**
+ * nm_iface_helper_control_send:
+ * @fd: a connected control socket. Set a receive timeout on it, so that a
+ *   hanging helper is not waited for forever.
+ * @command: the command to send
+ * @arg: the argument of @command
+ * @out_message: (allow-none): on return, the error message of the helper
+ *   if it rejected the command, or a description of why there was no answer
+ *
+ * Returns: %NMIH_CONTROL_RESULT_OK if the helper accepted the command,
+ *   %NMIH_CONTROL_RESULT_REJECTED if it answered with an error, and
+ *   %NMIH_CONTROL_RESULT_FAILED if it could not be reached or did not
+ *   answer in time.
+ */
+NMIfaceHelperControlResult
+nm_iface_helper_control_send (int fd,
+                              NMIfaceHelperCommand command,
+                              const char *arg,
+                              char **out_message)
+{
+	gs_free char *msg = NULL;
+	char reply[NMIH_CONTROL_MSG_MAX + 1];
+	ssize_t len;
+
+	g_return_val_if_fail (command < G_N_ELEMENTS (command_names), NMIH_CONTROL_RESULT_FAILED);
+	g_return_val_if_fail (arg && *arg, NMIH_CONTROL_RESULT_FAILED);
+
+	msg = g_strdup_printf ("%s %s", command_names[command], arg);
+	if (strlen (msg) > NMIH_CONTROL_MSG_MAX) {
+		if (out_message)
+			*out_message = g_strdup ("message too long");
+		return NMIH_CONTROL_RESULT_FAILED;
+	}
+
+	if (send (fd, msg, strlen (msg), MSG_NOSIGNAL) < 0) {
+		if (out_message)
+			*out_message = g_strdup_printf ("send failed: %s", g_strerror (errno));
+		return NMIH_CONTROL_RESULT_FAILED;
+	}
+
+	do
+		len = recv (fd, reply, NMIH_CONTROL_MSG_MAX, 0);
+	while (len < 0 && errno == EINTR);
+
+	if (len <= 0) {
+		if (out_message) {
+			*out_message = len == 0
+			               ? g_strdup ("connection closed")
+			               : g_strdup_printf ("no reply: %s", g_strerror (errno));
+		}
+		return NMIH_CONTROL_RESULT_FAILED;
+	}
+	reply[len] = '\0';
+
+	if (strcmp (reply, "ok") == 0)
+		return NMIH_CONTROL_RESULT_OK;
+
+	if (out_message)
+		*out_message = g_strdup (g_str_has_prefix (reply, "error ") ? reply + 6 : reply);
+	return NMIH_CONTROL_RESULT_REJECTED;
+}
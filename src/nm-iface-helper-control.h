@@ -0,0 +1,65 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#ifndef __NETWORKMANAGER_IFACE_HELPER_CONTROL_H__
+#define __NETWORKMANAGER_IFACE_HELPER_CONTROL_H__
+
+#include <glib.h>
+
+/* In multi-interface mode, nm-iface-helper accepts interfaces on a
+ * SOCK_SEQPACKET unix socket. Every message is one command:
+ *
+ *   add <interface options>
+ *   remove <interface name>
+ *
+ * and is answered with "ok" or "error <message>".
+ */
+
+#define NMIH_CONTROL_SOCKET NMRUNDIR "/nm-iface-helper.sock"
+#define NMIH_MULTI_PID_FILE NMRUNDIR "/nm-iface-helper.pid"
+
+#define NMIH_CONTROL_MSG_MAX 4096
+
+typedef enum {
+	NMIH_CONTROL_COMMAND_ADD,
+	NMIH_CONTROL_COMMAND_REMOVE,
+} NMIfaceHelperCommand;
+
+typedef enum {
+	NMIH_CONTROL_RESULT_OK,
+	NMIH_CONTROL_RESULT_REJECTED,  /* the helper answered with an error */
+	NMIH_CONTROL_RESULT_FAILED,    /* the helper did not answer */
+} NMIfaceHelperControlResult;
+
+/* nm-iface-helper side */
+gboolean nm_iface_helper_control_parse (const char *msg,
+                                        NMIfaceHelperCommand *out_command,
+                                        const char **out_arg,
+                                        GError **error);
+
+char *nm_iface_helper_control_reply (const GError *error);
+
+/* NetworkManager side */
+NMIfaceHelperControlResult nm_iface_helper_control_send (int fd,
+                                                         NMIfaceHelperCommand command,
+                                                         const char *arg,
+                                                         char **out_message);
+
+#endif /* __NETWORKMANAGER_IFACE_HELPER_CONTROL_H__ */
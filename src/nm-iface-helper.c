@@ -32,6 +32,8 @@
 #include <string.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <signal.h>
 
 /* Cannot include <net/if.h> due to conflict with <linux/if.h>.
@@ -44,6 +46,7 @@ extern unsigned int if_nametoindex (const char *__ifname);
 #include "nm-dhcp-manager.h"
 #include "nm-logging.h"
 #include "main-utils.h"
+#include "nm-iface-helper-control.h"
 #include "nm-rdisc.h"
 #include "nm-lndp-rdisc.h"
 #include "nm-utils.h"
@@ -55,14 +58,13 @@ extern unsigned int if_nametoindex (const char *__ifname);
 #define NMIH_PID_FILE_FMT NMRUNDIR "/nm-iface-helper-%d.pid"
 
 static GMainLoop *main_loop = NULL;
-static int ifindex = -1;
 
-static struct {
+/* Options of one managed interface, given on the command line in
+ * single-interface mode, or with --interface and the "add" command of the
+ * control socket in multi-interface mode.
+ */
+typedef struct {
 	gboolean slaac;
-	gboolean show_version;
-	gboolean become_daemon;
-	gboolean debug;
-	gboolean g_fatal_warnings;
 	gboolean slaac_required;
 	gboolean dhcp4_required;
 	int tempaddr;
@@ -72,15 +74,70 @@ static struct {
 	char *dhcp4_clientid;
 	char *dhcp4_hostname;
 	char *iid_str;
-	char *opt_log_level;
-	char *opt_log_domains;
+	gint64 priority64_v4;
+	gint64 priority64_v6;
+} InterfaceOpt;
+
+#define INTERFACE_OPT_INIT { \
+		.tempaddr = NM_SETTING_IP6_CONFIG_PRIVACY_UNKNOWN, \
+		.priority64_v4 = -1, \
+		.priority64_v6 = -1, \
+	}
+
+#define INTERFACE_OPTION_ENTRIES(opt) \
+	{ "ifname", 'i', 0, G_OPTION_ARG_STRING, &(opt)->ifname, N_("The interface to manage"), N_("eth0") }, \
+	{ "uuid", 'u', 0, G_OPTION_ARG_STRING, &(opt)->uuid, N_("Connection UUID"), N_("661e8cd0-b618-46b8-9dc9-31a52baaa16b") }, \
+	{ "slaac", 's', 0, G_OPTION_ARG_NONE, &(opt)->slaac, N_("Whether to manage IPv6 SLAAC"), NULL }, \
+	{ "slaac-required", '6', 0, G_OPTION_ARG_NONE, &(opt)->slaac_required, N_("Whether SLAAC must be successful"), NULL }, \
+	{ "slaac-tempaddr", 't', 0, G_OPTION_ARG_INT, &(opt)->tempaddr, N_("Use an IPv6 temporary privacy address"), NULL }, \
+	{ "dhcp4", 'd', 0, G_OPTION_ARG_STRING, &(opt)->dhcp4_address, N_("Current DHCPv4 address"), NULL }, \
+	{ "dhcp4-required", '4', 0, G_OPTION_ARG_NONE, &(opt)->dhcp4_required, N_("Whether DHCPv4 must be successful"), NULL }, \
+	{ "dhcp4-clientid", 'c', 0, G_OPTION_ARG_STRING, &(opt)->dhcp4_clientid, N_("Hex-encoded DHCPv4 client ID"), NULL }, \
+	{ "dhcp4-hostname", 'h', 0, G_OPTION_ARG_STRING, &(opt)->dhcp4_hostname, N_("Hostname to send to DHCP server"), N_("barbar") }, \
+	{ "priority4", '\0', 0, G_OPTION_ARG_INT64, &(opt)->priority64_v4, N_("Route priority for IPv4"), N_("0") }, \
+	{ "priority6", '\0', 0, G_OPTION_ARG_INT64, &(opt)->priority64_v6, N_("Route priority for IPv6"), N_("1024") }, \
+	{ "iid", 'e', 0, G_OPTION_ARG_STRING, &(opt)->iid_str, N_("Hex-encoded Interface Identifier"), N_("") }
+
+typedef struct {
+	InterfaceOpt opt;
+	int ifindex;
 	guint32 priority_v4;
 	guint32 priority_v6;
-} global_opt = {
-	.tempaddr = NM_SETTING_IP6_CONFIG_PRIVACY_UNKNOWN,
-	.priority_v4 = NM_PLATFORM_ROUTE_METRIC_DEFAULT_IP4,
-	.priority_v6 = NM_PLATFORM_ROUTE_METRIC_DEFAULT_IP6,
-};
+	NMDhcpClient *dhcp4_client;
+	NMRDisc *rdisc;
+	NMIP4Config *last_ip4_config;
+	NMIP6Config *last_ip6_config;
+	guint remove_id;
+} Interface;
+
+static struct {
+	gboolean show_version;
+	gboolean become_daemon;
+	gboolean debug;
+	gboolean g_fatal_warnings;
+	gboolean multi;
+	char **interfaces;
+	char *opt_log_level;
+	char *opt_log_domains;
+} global_opt;
+
+static InterfaceOpt cmdline_opt = INTERFACE_OPT_INIT;
+
+/* All managed interfaces, by interface name */
+static GHashTable *interfaces = NULL;
+
+static void interface_remove_later (Interface *iface);
+
+static void
+interface_opt_clear (InterfaceOpt *opt)
+{
+	g_free (opt->ifname);
+	g_free (opt->uuid);
+	g_free (opt->dhcp4_address);
+	g_free (opt->dhcp4_clientid);
+	g_free (opt->dhcp4_hostname);
+	g_free (opt->iid_str);
+}
 
 static void
 dhcp4_state_changed (NMDhcpClient *client,
@@ -89,38 +146,39 @@ dhcp4_state_changed (NMDhcpClient *client,
                      GHashTable *options,
                      gpointer user_data)
 {
-	static NMIP4Config *last_config = NULL;
+	Interface *iface = user_data;
 	NMIP4Config *existing;
 
 	g_return_if_fail (!ip4_config || NM_IS_IP4_CONFIG (ip4_config));
 
-	nm_log_dbg (LOGD_DHCP4, "(%s): new DHCPv4 client state %d", global_opt.ifname, state);
+	nm_log_dbg (LOGD_DHCP4, "(%s): new DHCPv4 client state %d", iface->opt.ifname, state);
 
 	switch (state) {
 	case NM_DHCP_STATE_BOUND:
 		g_assert (ip4_config);
-		existing = nm_ip4_config_capture (ifindex, FALSE);
-		if (last_config)
-			nm_ip4_config_subtract (existing, last_config);
+		existing = nm_ip4_config_capture (iface->ifindex, FALSE);
+		if (iface->last_ip4_config)
+			nm_ip4_config_subtract (existing, iface->last_ip4_config);
 
 		nm_ip4_config_merge (existing, ip4_config);
-		if (!nm_ip4_config_commit (existing, ifindex, global_opt.priority_v4))
-			nm_log_warn (LOGD_DHCP4, "(%s): failed to apply DHCPv4 config", global_opt.ifname);
-
-		if (last_config) {
-			g_object_unref (last_config);
-			last_config = nm_ip4_config_new (nm_dhcp_client_get_ifindex (client));
-			nm_ip4_config_replace (last_config, ip4_config, NULL);
+		if (!nm_ip4_config_commit (existing, iface->ifindex, iface->priority_v4))
+			nm_log_warn (LOGD_DHCP4, "(%s): failed to apply DHCPv4 config", iface->opt.ifname);
+		g_object_unref (existing);
+
+		if (iface->last_ip4_config) {
+			g_object_unref (iface->last_ip4_config);
+			iface->last_ip4_config = nm_ip4_config_new (nm_dhcp_client_get_ifindex (client));
+			nm_ip4_config_replace (iface->last_ip4_config, ip4_config, NULL);
 		}
 		break;
 	case NM_DHCP_STATE_TIMEOUT:
 	case NM_DHCP_STATE_DONE:
 	case NM_DHCP_STATE_FAIL:
-		if (global_opt.dhcp4_required) {
-			nm_log_warn (LOGD_DHCP4, "(%s): DHCPv4 timed out or failed, quitting...", global_opt.ifname);
-			g_main_loop_quit (main_loop);
+		if (iface->opt.dhcp4_required) {
+			nm_log_warn (LOGD_DHCP4, "(%s): DHCPv4 timed out or failed, no longer managing the interface", iface->opt.ifname);
+			interface_remove_later (iface);
 		} else
-			nm_log_warn (LOGD_DHCP4, "(%s): DHCPv4 timed out or failed", global_opt.ifname);
+			nm_log_warn (LOGD_DHCP4, "(%s): DHCPv4 timed out or failed", iface->opt.ifname);
 		break;
 	default:
 		break;
@@ -130,7 +188,7 @@ dhcp4_state_changed (NMDhcpClient *client,
 static void
 rdisc_config_changed (NMRDisc *rdisc, NMRDiscConfigMap changed, gpointer user_data)
 {
-	static NMIP6Config *last_config = NULL;
+	Interface *iface = user_data;
 	NMIP6Config *existing;
 	NMIP6Config *ip6_config;
 	static int system_support = -1;
@@ -151,14 +209,14 @@ rdisc_config_changed (NMRDisc *rdisc, NMRDiscConfigMap changed, gpointer user_da
 
 	if (system_support)
 		ifa_flags = IFA_F_NOPREFIXROUTE;
-	if (global_opt.tempaddr == NM_SETTING_IP6_CONFIG_PRIVACY_PREFER_TEMP_ADDR
-	    || global_opt.tempaddr == NM_SETTING_IP6_CONFIG_PRIVACY_PREFER_PUBLIC_ADDR)
+	if (iface->opt.tempaddr == NM_SETTING_IP6_CONFIG_PRIVACY_PREFER_TEMP_ADDR
+	    || iface->opt.tempaddr == NM_SETTING_IP6_CONFIG_PRIVACY_PREFER_PUBLIC_ADDR)
 	{
 		/* without system_support, this flag will be ignored. Still set it, doesn't seem to do any harm. */
 		ifa_flags |= IFA_F_MANAGETEMPADDR;
 	}
 
-	ip6_config = nm_ip6_config_new (ifindex);
+	ip6_config = nm_ip6_config_new (iface->ifindex);
 
 	if (changed & NM_RDISC_CONFIG_GATEWAYS) {
 		/* Use the first gateway as ordered in router discovery cache. */
@@ -216,7 +274,7 @@ rdisc_config_changed (NMRDisc *rdisc, NMRDiscConfigMap changed, gpointer user_da
 				route.plen = discovered_route->plen;
 				route.gateway = discovered_route->gateway;
 				route.source = NM_IP_CONFIG_SOURCE_RDISC;
-				route.metric = global_opt.priority_v6;
+				route.metric = iface->priority_v6;
 
 				nm_ip6_config_add_route (ip6_config, &route);
 			}
@@ -233,41 +291,403 @@ rdisc_config_changed (NMRDisc *rdisc, NMRDiscConfigMap changed, gpointer user_da
 		char val[16];
 
 		g_snprintf (val, sizeof (val), "%d", rdisc->hop_limit);
-		nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip6_property_path (global_opt.ifname, "hop_limit"), val);
+		nm_platform_link_ip6_conf_set (NM_PLATFORM_GET, iface->ifindex, "hop_limit", val);
 	}
 
 	if (changed & NM_RDISC_CONFIG_MTU) {
 		char val[16];
 
 		g_snprintf (val, sizeof (val), "%d", rdisc->mtu);
-		nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip6_property_path (global_opt.ifname, "mtu"), val);
+		nm_platform_link_ip6_conf_set (NM_PLATFORM_GET, iface->ifindex, "mtu", val);
 	}
 
-	existing = nm_ip6_config_capture (ifindex, FALSE, global_opt.tempaddr);
-	if (last_config)
-		nm_ip6_config_subtract (existing, last_config);
+	existing = nm_ip6_config_capture (iface->ifindex, FALSE, iface->opt.tempaddr);
+	if (iface->last_ip6_config)
+		nm_ip6_config_subtract (existing, iface->last_ip6_config);
 
 	nm_ip6_config_merge (existing, ip6_config);
-	if (!nm_ip6_config_commit (existing, ifindex))
-		nm_log_warn (LOGD_IP6, "(%s): failed to apply IPv6 config", global_opt.ifname);
-
-	if (last_config) {
-		g_object_unref (last_config);
-		last_config = nm_ip6_config_new (ifindex);
-		nm_ip6_config_replace (last_config, ip6_config, NULL);
+	if (!nm_ip6_config_commit (existing, iface->ifindex))
+		nm_log_warn (LOGD_IP6, "(%s): failed to apply IPv6 config", iface->opt.ifname);
+	g_object_unref (existing);
+
+	if (iface->last_ip6_config) {
+		g_object_unref (iface->last_ip6_config);
+		iface->last_ip6_config = nm_ip6_config_new (iface->ifindex);
+		nm_ip6_config_replace (iface->last_ip6_config, ip6_config, NULL);
 	}
+	g_object_unref (ip6_config);
 }
 
 static void
 rdisc_ra_timeout (NMRDisc *rdisc, gpointer user_data)
 {
-	if (global_opt.slaac_required) {
-		nm_log_warn (LOGD_IP6, "(%s): IPv6 timed out or failed, quitting...", global_opt.ifname);
-		g_main_loop_quit (main_loop);
+	Interface *iface = user_data;
+
+	if (iface->opt.slaac_required) {
+		nm_log_warn (LOGD_IP6, "(%s): IPv6 timed out or failed, no longer managing the interface", iface->opt.ifname);
+		interface_remove_later (iface);
 	} else
-		nm_log_warn (LOGD_IP6, "(%s): IPv6 timed out or failed", global_opt.ifname);
+		nm_log_warn (LOGD_IP6, "(%s): IPv6 timed out or failed", iface->opt.ifname);
+}
+
+/*******************************************************/
+
+static void
+interface_free (Interface *iface)
+{
+	nm_log_dbg (LOGD_CORE, "(%s): stop managing interface", iface->opt.ifname);
+
+	if (iface->remove_id)
+		g_source_remove (iface->remove_id);
+
+	/* Stop the client but keep the lease, the addresses stay configured */
+	if (iface->dhcp4_client) {
+		g_signal_handlers_disconnect_by_data (iface->dhcp4_client, iface);
+		nm_dhcp_client_stop (iface->dhcp4_client, FALSE);
+		g_object_unref (iface->dhcp4_client);
+	}
+	if (iface->rdisc) {
+		g_signal_handlers_disconnect_by_data (iface->rdisc, iface);
+		g_object_unref (iface->rdisc);
+	}
+	g_clear_object (&iface->last_ip4_config);
+	g_clear_object (&iface->last_ip6_config);
+	interface_opt_clear (&iface->opt);
+	g_slice_free (Interface, iface);
+}
+
+static void
+interface_remove (const char *ifname)
+{
+	g_hash_table_remove (interfaces, ifname);
+
+	/* Nothing left to do */
+	if (g_hash_table_size (interfaces) == 0) {
+		nm_log_info (LOGD_CORE, "no interfaces left to manage, quitting...");
+		g_main_loop_quit (main_loop);
+	}
 }
 
+static gboolean
+interface_remove_cb (gpointer user_data)
+{
+	Interface *iface = user_data;
+
+	iface->remove_id = 0;
+	interface_remove (iface->opt.ifname);
+	return G_SOURCE_REMOVE;
+}
+
+/* Removing the interface would destroy the object that is emitting the
+ * signal we are handling; do it from an idle handler instead. */
+static void
+interface_remove_later (Interface *iface)
+{
+	if (!iface->remove_id)
+		iface->remove_id = g_idle_add (interface_remove_cb, iface);
+}
+
+/* Starts managing the interface described by @opt, taking ownership of
+ * the strings of @opt.
+ */
+static gboolean
+interface_add (InterfaceOpt *opt, GError **error)
+{
+	Interface *iface;
+	GByteArray *hwaddr = NULL;
+	size_t hwaddr_len = 0;
+	gconstpointer tmp;
+	gs_free NMUtilsIPv6IfaceId *iid = NULL;
+	int ifindex;
+
+	if (!opt->ifname || !opt->uuid) {
+		g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+		                     _("An interface name and UUID are required"));
+		goto fail;
+	}
+
+	ifindex = if_nametoindex (opt->ifname);
+	if (ifindex <= 0) {
+		g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+		             _("Failed to find interface index for %s (%s)"), opt->ifname, strerror (errno));
+		goto fail;
+	}
+
+	if (opt->iid_str) {
+		GBytes *bytes;
+		gsize ignored = 0;
+
+		bytes = nm_utils_hexstr2bin (opt->iid_str);
+		if (!bytes || g_bytes_get_size (bytes) != sizeof (*iid)) {
+			if (bytes)
+				g_bytes_unref (bytes);
+			g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+			             _("(%s): Invalid IID %s"), opt->ifname, opt->iid_str);
+			goto fail;
+		}
+		iid = g_bytes_unref_to_data (bytes, &ignored);
+	}
+
+	/* The new options replace the ones the interface is managed with */
+	if (g_hash_table_lookup (interfaces, opt->ifname))
+		g_hash_table_remove (interfaces, opt->ifname);
+
+	iface = g_slice_new0 (Interface);
+	iface->opt = *opt;
+	iface->ifindex = ifindex;
+	iface->priority_v4 = NM_PLATFORM_ROUTE_METRIC_DEFAULT_IP4;
+	iface->priority_v6 = NM_PLATFORM_ROUTE_METRIC_DEFAULT_IP6;
+	if (opt->priority64_v4 >= 0 && opt->priority64_v4 <= G_MAXUINT32)
+		iface->priority_v4 = (guint32) opt->priority64_v4;
+	if (opt->priority64_v6 >= 0 && opt->priority64_v6 <= G_MAXUINT32)
+		iface->priority_v6 = (guint32) opt->priority64_v6;
+	g_hash_table_insert (interfaces, iface->opt.ifname, iface);
+
+	nm_log_info (LOGD_CORE, "(%s): managing interface (ifindex %d)", iface->opt.ifname, ifindex);
+
+	tmp = nm_platform_link_get_address (NM_PLATFORM_GET, ifindex, &hwaddr_len);
+	if (tmp) {
+		hwaddr = g_byte_array_sized_new (hwaddr_len);
+		g_byte_array_append (hwaddr, tmp, hwaddr_len);
+	}
+
+	if (iface->opt.dhcp4_address) {
+		nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip4_property_path (iface->opt.ifname, "promote_secondaries"), "1");
+
+		iface->dhcp4_client = nm_dhcp_manager_start_ip4 (nm_dhcp_manager_get (),
+		                                                 iface->opt.ifname,
+		                                                 ifindex,
+		                                                 hwaddr,
+		                                                 iface->opt.uuid,
+		                                                 iface->priority_v4,
+		                                                 !!iface->opt.dhcp4_hostname,
+		                                                 iface->opt.dhcp4_hostname,
+		                                                 iface->opt.dhcp4_clientid,
+		                                                 45,
+		                                                 NULL,
+		                                                 iface->opt.dhcp4_address);
+		g_assert (iface->dhcp4_client);
+		g_signal_connect (iface->dhcp4_client,
+		                  NM_DHCP_CLIENT_SIGNAL_STATE_CHANGED,
+		                  G_CALLBACK (dhcp4_state_changed),
+		                  iface);
+	}
+
+	if (iface->opt.slaac) {
+		nm_platform_link_set_user_ipv6ll_enabled (NM_PLATFORM_GET, ifindex, TRUE);
+
+		iface->rdisc = nm_lndp_rdisc_new (ifindex, iface->opt.ifname);
+		g_assert (iface->rdisc);
+
+		if (iid)
+			nm_rdisc_set_iid (iface->rdisc, *iid);
+
+		nm_platform_link_ip6_conf_set (NM_PLATFORM_GET, ifindex, "accept_ra", "1");
+		nm_platform_link_ip6_conf_set (NM_PLATFORM_GET, ifindex, "accept_ra_defrtr", "0");
+		nm_platform_link_ip6_conf_set (NM_PLATFORM_GET, ifindex, "accept_ra_pinfo", "0");
+		nm_platform_link_ip6_conf_set (NM_PLATFORM_GET, ifindex, "accept_ra_rtr_pref", "0");
+
+		g_signal_connect (iface->rdisc,
+		                  NM_RDISC_CONFIG_CHANGED,
+		                  G_CALLBACK (rdisc_config_changed),
+		                  iface);
+		g_signal_connect (iface->rdisc,
+		                  NM_RDISC_RA_TIMEOUT,
+		                  G_CALLBACK (rdisc_ra_timeout),
+		                  iface);
+		nm_rdisc_start (iface->rdisc);
+	}
+
+	g_clear_pointer (&hwaddr, g_byte_array_unref);
+	return TRUE;
+
+fail:
+	interface_opt_clear (opt);
+	return FALSE;
+}
+
+/* Parses the options of one interface, as passed with --interface and
+ * the "add" command, e.g. "--ifname eth0 --uuid ... --dhcp4 192.0.2.5".
+ */
+static gboolean
+interface_add_from_string (const char *str, GError **error)
+{
+	InterfaceOpt opt = INTERFACE_OPT_INIT;
+	GOptionEntry entries[] = {
+		INTERFACE_OPTION_ENTRIES (&opt),
+		{ NULL }
+	};
+	GOptionContext *context;
+	char **argv = NULL, **argv_full;
+	int argc, i;
+	gboolean success;
+
+	if (!g_shell_parse_argv (str, &argc, &argv, error))
+		return FALSE;
+
+	/* g_option_context_parse() wants the program name first */
+	argv_full = g_new0 (char *, argc + 2);
+	argv_full[0] = g_strdup ("nm-iface-helper");
+	for (i = 0; i < argc; i++)
+		argv_full[i + 1] = argv[i];
+	g_free (argv);
+	argc++;
+	argv = argv_full;
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_help_enabled (context, FALSE);
+	g_option_context_add_main_entries (context, entries, NULL);
+	success = g_option_context_parse (context, &argc, &argv, error);
+	g_option_context_free (context);
+
+	if (success && argc > 1) {
+		g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+		             _("Unexpected argument '%s'"), argv[1]);
+		success = FALSE;
+	}
+	g_strfreev (argv);
+
+	if (!success) {
+		interface_opt_clear (&opt);
+		return FALSE;
+	}
+	return interface_add (&opt, error);
+}
+
+/*******************************************************/
+
+/* In multi-interface mode, interfaces can be added and removed through
+ * the control socket; see nm-iface-helper-control.h for the protocol.
+ */
+
+static int control_fd = -1;
+static guint control_id = 0;
+
+static char *
+control_handle (const char *msg)
+{
+	NMIfaceHelperCommand command;
+	const char *arg;
+	GError *error = NULL;
+	char *reply;
+
+	if (nm_iface_helper_control_parse (msg, &command, &arg, &error)) {
+		switch (command) {
+		case NMIH_CONTROL_COMMAND_ADD:
+			interface_add_from_string (arg, &error);
+			break;
+		case NMIH_CONTROL_COMMAND_REMOVE:
+			if (g_hash_table_lookup (interfaces, arg))
+				interface_remove (arg);
+			else {
+				g_set_error (&error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+				             _("Interface %s is not managed"), arg);
+			}
+			break;
+		}
+	}
+
+	if (error)
+		nm_log_warn (LOGD_CORE, "control command failed: %s", error->message);
+	reply = nm_iface_helper_control_reply (error);
+	g_clear_error (&error);
+	return reply;
+}
+
+static gboolean
+control_client_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	int fd = g_io_channel_unix_get_fd (channel);
+	char buf[NMIH_CONTROL_MSG_MAX + 1];
+	gs_free char *reply = NULL;
+	ssize_t len;
+
+	len = recv (fd, buf, NMIH_CONTROL_MSG_MAX, MSG_DONTWAIT);
+	if (len < 0 && (errno == EAGAIN || errno == EINTR))
+		return G_SOURCE_CONTINUE;
+	if (len <= 0)
+		return G_SOURCE_REMOVE;
+
+	buf[len] = '\0';
+	g_strchomp (buf);
+	nm_log_dbg (LOGD_CORE, "control command: %s", buf);
+
+	reply = control_handle (buf);
+	if (send (fd, reply, strlen (reply), MSG_NOSIGNAL) < 0)
+		return G_SOURCE_REMOVE;
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+control_accept_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	GIOChannel *client;
+	int fd;
+
+	fd = accept (control_fd, NULL, NULL);
+	if (fd < 0)
+		return G_SOURCE_CONTINUE;
+
+	client = g_io_channel_unix_new (fd);
+	g_io_channel_set_close_on_unref (client, TRUE);
+	g_io_add_watch (client, G_IO_IN | G_IO_HUP | G_IO_ERR, control_client_cb, NULL);
+	g_io_channel_unref (client);
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+control_setup (GError **error)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	GIOChannel *channel;
+	int errsv;
+
+	g_strlcpy (addr.sun_path, NMIH_CONTROL_SOCKET, sizeof (addr.sun_path));
+
+	control_fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (control_fd < 0)
+		goto fail;
+
+	unlink (NMIH_CONTROL_SOCKET);
+	if (bind (control_fd, (struct sockaddr *) &addr, sizeof (addr)) < 0)
+		goto fail;
+	if (chmod (NMIH_CONTROL_SOCKET, S_IRUSR | S_IWUSR) < 0)
+		goto fail;
+	if (listen (control_fd, 16) < 0)
+		goto fail;
+
+	channel = g_io_channel_unix_new (control_fd);
+	control_id = g_io_add_watch (channel, G_IO_IN, control_accept_cb, NULL);
+	g_io_channel_unref (channel);
+	return TRUE;
+
+fail:
+	errsv = errno;
+	g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+	             _("Cannot create control socket %s: %s"), NMIH_CONTROL_SOCKET, g_strerror (errsv));
+	if (control_fd >= 0) {
+		close (control_fd);
+		control_fd = -1;
+	}
+	return FALSE;
+}
+
+static void
+control_teardown (void)
+{
+	if (control_id) {
+		g_source_remove (control_id);
+		control_id = 0;
+	}
+	if (control_fd >= 0) {
+		close (control_fd);
+		control_fd = -1;
+		unlink (NMIH_CONTROL_SOCKET);
+	}
+}
+
+/*******************************************************/
+
 static gboolean
 quit_handler (gpointer user_data)
 {
@@ -286,22 +706,11 @@ setup_signals (void)
 static void
 do_early_setup (int *argc, char **argv[])
 {
-	gint64 priority64_v4 = -1;
-	gint64 priority64_v6 = -1;
 	GOptionEntry options[] = {
 		/* Interface/IP config */
-		{ "ifname", 'i', 0, G_OPTION_ARG_STRING, &global_opt.ifname, N_("The interface to manage"), N_("eth0") },
-		{ "uuid", 'u', 0, G_OPTION_ARG_STRING, &global_opt.uuid, N_("Connection UUID"), N_("661e8cd0-b618-46b8-9dc9-31a52baaa16b") },
-		{ "slaac", 's', 0, G_OPTION_ARG_NONE, &global_opt.slaac, N_("Whether to manage IPv6 SLAAC"), NULL },
-		{ "slaac-required", '6', 0, G_OPTION_ARG_NONE, &global_opt.slaac_required, N_("Whether SLAAC must be successful"), NULL },
-		{ "slaac-tempaddr", 't', 0, G_OPTION_ARG_INT, &global_opt.tempaddr, N_("Use an IPv6 temporary privacy address"), NULL },
-		{ "dhcp4", 'd', 0, G_OPTION_ARG_STRING, &global_opt.dhcp4_address, N_("Current DHCPv4 address"), NULL },
-		{ "dhcp4-required", '4', 0, G_OPTION_ARG_NONE, &global_opt.dhcp4_required, N_("Whether DHCPv4 must be successful"), NULL },
-		{ "dhcp4-clientid", 'c', 0, G_OPTION_ARG_STRING, &global_opt.dhcp4_clientid, N_("Hex-encoded DHCPv4 client ID"), NULL },
-		{ "dhcp4-hostname", 'h', 0, G_OPTION_ARG_STRING, &global_opt.dhcp4_hostname, N_("Hostname to send to DHCP server"), N_("barbar") },
-		{ "priority4", '\0', 0, G_OPTION_ARG_INT64, &priority64_v4, N_("Route priority for IPv4"), N_("0") },
-		{ "priority6", '\0', 0, G_OPTION_ARG_INT64, &priority64_v6, N_("Route priority for IPv6"), N_("1024") },
-		{ "iid", 'e', 0, G_OPTION_ARG_STRING, &global_opt.iid_str, N_("Hex-encoded Interface Identifier"), N_("") },
+		INTERFACE_OPTION_ENTRIES (&cmdline_opt),
+		{ "multi", 'm', 0, G_OPTION_ARG_NONE, &global_opt.multi, N_("Manage several interfaces, and accept more on the control socket"), NULL },
+		{ "interface", 'I', 0, G_OPTION_ARG_STRING_ARRAY, &global_opt.interfaces, N_("Options of an interface to manage in multi-interface mode"), N_("\"--ifname eth0 --uuid ...\"") },
 
 		/* Logging/debugging */
 		{ "version", 'V', 0, G_OPTION_ARG_NONE, &global_opt.show_version, N_("Print NetworkManager version and exit"), NULL },
@@ -325,13 +734,8 @@ do_early_setup (int *argc, char **argv[])
 	                                options,
 	                                NULL,
 	                                NULL,
-	                                _("nm-iface-helper is a small, standalone process that manages a single network interface.")))
+	                                _("nm-iface-helper is a small, standalone process that manages network interfaces.")))
 		exit (1);
-
-	if (priority64_v4 >= 0 && priority64_v4 <= G_MAXUINT32)
-		global_opt.priority_v4 = (guint32) priority64_v4;
-	if (priority64_v6 >= 0 && priority64_v6 <= G_MAXUINT32)
-		global_opt.priority_v6 = (guint32) priority64_v6;
 }
 
 int
@@ -341,12 +745,8 @@ main (int argc, char *argv[])
 	GError *error = NULL;
 	gboolean wrote_pidfile = FALSE;
 	gs_free char *pidfile = NULL;
-	gs_unref_object NMDhcpClient *dhcp4_client = NULL;
-	gs_unref_object NMRDisc *rdisc = NULL;
-	GByteArray *hwaddr = NULL;
-	size_t hwaddr_len = 0;
-	gconstpointer tmp;
-	gs_free NMUtilsIPv6IfaceId *iid = NULL;
+	int ifindex;
+	guint i;
 
 #if !GLIB_CHECK_VERSION (2, 35, 0)
 	g_type_init ();
@@ -371,17 +771,29 @@ main (int argc, char *argv[])
 
 	nm_main_utils_ensure_root ();
 
-	if (!global_opt.ifname || !global_opt.uuid) {
-		fprintf (stderr, _("An interface name and UUID are required\n"));
-		exit (1);
-	}
+	if (global_opt.multi) {
+		if (cmdline_opt.ifname || cmdline_opt.uuid) {
+			fprintf (stderr, _("Interfaces must be given with --interface in multi-interface mode\n"));
+			exit (1);
+		}
+		pidfile = g_strdup (NMIH_MULTI_PID_FILE);
+	} else {
+		if (global_opt.interfaces) {
+			fprintf (stderr, _("--interface requires --multi\n"));
+			exit (1);
+		}
+		if (!cmdline_opt.ifname || !cmdline_opt.uuid) {
+			fprintf (stderr, _("An interface name and UUID are required\n"));
+			exit (1);
+		}
 
-	ifindex = if_nametoindex (global_opt.ifname);
-	if (ifindex <= 0) {
-		fprintf (stderr, _("Failed to find interface index for %s (%s)\n"), global_opt.ifname, strerror (errno));
-		exit (1);
+		ifindex = if_nametoindex (cmdline_opt.ifname);
+		if (ifindex <= 0) {
+			fprintf (stderr, _("Failed to find interface index for %s (%s)\n"), cmdline_opt.ifname, strerror (errno));
+			exit (1);
+		}
+		pidfile = g_strdup_printf (NMIH_PID_FILE_FMT, ifindex);
 	}
-	pidfile = g_strdup_printf (NMIH_PID_FILE_FMT, ifindex);
 	nm_main_utils_ensure_not_running_pidfile (pidfile);
 
 	nm_main_utils_ensure_rundir ();
@@ -401,6 +813,13 @@ main (int argc, char *argv[])
 		g_clear_pointer (&bad_domains, g_free);
 	}
 
+	/* Create the control socket before daemonizing, so that it can be
+	 * used as soon as the parent returns. */
+	if (global_opt.multi && !control_setup (&error)) {
+		fprintf (stderr, "%s\n", error->message);
+		exit (1);
+	}
+
 	if (global_opt.become_daemon && !global_opt.debug) {
 		if (daemon (0, 0) < 0) {
 			int saved_errno;
@@ -423,77 +842,33 @@ main (int argc, char *argv[])
 
 	nm_log_info (LOGD_CORE, "nm-iface-helper (version " NM_DIST_VERSION ") is starting...");
 
-	/* Set up platform interaction layer */
+	/* Set up platform interaction layer. All interfaces share the platform
+	 * cache and its netlink sockets. */
 	nm_linux_platform_setup ();
 
-	tmp = nm_platform_link_get_address (NM_PLATFORM_GET, ifindex, &hwaddr_len);
-	if (tmp) {
-		hwaddr = g_byte_array_sized_new (hwaddr_len);
-		g_byte_array_append (hwaddr, tmp, hwaddr_len);
-	}
-
-	if (global_opt.iid_str) {
-		GBytes *bytes;
-		gsize ignored = 0;
+	interfaces = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) interface_free);
 
-		bytes = nm_utils_hexstr2bin (global_opt.iid_str);
-		if (!bytes || g_bytes_get_size (bytes) != sizeof (*iid)) {
-			fprintf (stderr, _("(%s): Invalid IID %s\n"), global_opt.ifname, global_opt.iid_str);
+	if (global_opt.multi) {
+		for (i = 0; global_opt.interfaces && global_opt.interfaces[i]; i++) {
+			if (!interface_add_from_string (global_opt.interfaces[i], &error)) {
+				nm_log_warn (LOGD_CORE, "failed to manage interface: %s", error->message);
+				g_clear_error (&error);
+			}
+		}
+	} else {
+		if (!interface_add (&cmdline_opt, &error)) {
+			fprintf (stderr, "%s\n", error->message);
 			exit (1);
 		}
-		iid = g_bytes_unref_to_data (bytes, &ignored);
-	}
-
-	if (global_opt.dhcp4_address) {
-		nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip4_property_path (global_opt.ifname, "promote_secondaries"), "1");
-
-		dhcp4_client = nm_dhcp_manager_start_ip4 (nm_dhcp_manager_get (),
-		                                          global_opt.ifname,
-		                                          ifindex,
-		                                          hwaddr,
-		                                          global_opt.uuid,
-		                                          global_opt.priority_v4,
-		                                          !!global_opt.dhcp4_hostname,
-		                                          global_opt.dhcp4_hostname,
-		                                          global_opt.dhcp4_clientid,
-		                                          45,
-		                                          NULL,
-		                                          global_opt.dhcp4_address);
-		g_assert (dhcp4_client);
-		g_signal_connect (dhcp4_client,
-		                  NM_DHCP_CLIENT_SIGNAL_STATE_CHANGED,
-		                  G_CALLBACK (dhcp4_state_changed),
-		                  NULL);
 	}
 
-	if (global_opt.slaac) {
-		nm_platform_link_set_user_ipv6ll_enabled (NM_PLATFORM_GET, ifindex, TRUE);
+	if (g_hash_table_size (interfaces) > 0)
+		g_main_loop_run (main_loop);
+	else
+		nm_log_info (LOGD_CORE, "no interfaces to manage");
 
-		rdisc = nm_lndp_rdisc_new (ifindex, global_opt.ifname);
-		g_assert (rdisc);
-
-		if (iid)
-			nm_rdisc_set_iid (rdisc, *iid);
-
-		nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip6_property_path (global_opt.ifname, "accept_ra"), "1");
-		nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip6_property_path (global_opt.ifname, "accept_ra_defrtr"), "0");
-		nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip6_property_path (global_opt.ifname, "accept_ra_pinfo"), "0");
-		nm_platform_sysctl_set (NM_PLATFORM_GET, nm_utils_ip6_property_path (global_opt.ifname, "accept_ra_rtr_pref"), "0");
-
-		g_signal_connect (rdisc,
-		                  NM_RDISC_CONFIG_CHANGED,
-		                  G_CALLBACK (rdisc_config_changed),
-		                  NULL);
-		g_signal_connect (rdisc,
-		                  NM_RDISC_RA_TIMEOUT,
-		                  G_CALLBACK (rdisc_ra_timeout),
-		                  NULL);
-		nm_rdisc_start (rdisc);
-	}
-
-	g_main_loop_run (main_loop);
-
-	g_clear_pointer (&hwaddr, g_byte_array_unref);
+	control_teardown ();
+	g_hash_table_unref (interfaces);
 
 	nm_logging_syslog_closelog ();
 
@@ -26,8 +26,11 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <dbus/dbus-glib-lowlevel.h>
 #include <dbus/dbus-glib.h>
 #include <gio/gio.h>
@@ -60,6 +63,7 @@
 #include "nm-activation-request.h"
 #include "nm-core-internal.h"
 #include "nm-config.h"
+#include "nm-iface-helper-control.h"
 
 #define NM_AUTOIP_DBUS_SERVICE "org.freedesktop.nm_avahi_autoipd"
 #define NM_AUTOIP_DBUS_IFACE   "org.freedesktop.nm_avahi_autoipd"
@@ -201,6 +205,9 @@ typedef struct {
 
 	guint timestamp_update_id;
 
+	/* nm-iface-helper options of the devices left configured on quit */
+	GPtrArray *iface_helper_options;
+
 	gboolean startup;
 } NMManagerPrivate;
 
@@ -775,7 +782,13 @@ remove_device (NMManager *manager,
 			else
 				nm_device_set_unmanaged (device, NM_UNMANAGED_INTERNAL, TRUE, NM_DEVICE_STATE_REASON_REMOVED);
 		} else if (quitting && nm_config_get_configure_and_quit (nm_config_get ())) {
-			nm_device_spawn_iface_helper (device);
+			char *options = nm_device_get_iface_helper_options (device);
+
+			if (options) {
+				if (!priv->iface_helper_options)
+					priv->iface_helper_options = g_ptr_array_new_with_free_func (g_free);
+				g_ptr_array_add (priv->iface_helper_options, options);
+			}
 		}
 	}
 
@@ -4271,6 +4284,195 @@ nm_manager_start (NMManager *self)
 	check_if_startup_complete (self);
 }
 
+/* Connects to the control socket of a multi-interface nm-iface-helper
+ * that is still running from a previous quit.
+ */
+static int
+iface_helper_connect (void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct timeval timeout = { .tv_sec = 1 };
+	int fd;
+
+	g_strlcpy (addr.sun_path, NMIH_CONTROL_SOCKET, sizeof (addr.sun_path));
+	fd = socket (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	if (   connect (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0
+	    || setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout)) < 0) {
+		close (fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Stops a multi-interface nm-iface-helper that does not answer on the
+ * control socket. As long as it holds the pid file, a newly spawned
+ * multi-interface helper would exit right away.
+ */
+static void
+iface_helper_stop_stale (void)
+{
+	gs_free char *contents = NULL;
+	gs_free char *proc_cmdline = NULL;
+	gs_free char *cmdline = NULL;
+	const char *process_name;
+	guint64 start_time;
+	glong pid;
+
+	if (!g_file_get_contents (NMIH_MULTI_PID_FILE, &contents, NULL, NULL))
+		return;
+
+	errno = 0;
+	pid = strtol (contents, NULL, 10);
+	if (pid <= 0 || pid > 65536 || errno)
+		return;
+
+	proc_cmdline = g_strdup_printf ("/proc/%ld/cmdline", pid);
+	if (!g_file_get_contents (proc_cmdline, &cmdline, NULL, NULL))
+		return;
+
+	process_name = strrchr (cmdline, '/');
+	process_name = process_name ? process_name + 1 : cmdline;
+	if (strcmp (process_name, "nm-iface-helper") != 0)
+		return;
+
+	start_time = nm_utils_get_start_time_for_pid (pid);
+	if (!start_time)
+		return;
+
+	nm_log_warn (LOGD_CORE, "nm-iface-helper PID %ld does not answer, replacing it", pid);
+	nm_utils_kill_process_sync (pid, start_time, SIGTERM, LOGD_CORE, "nm-iface-helper", 2000, 0);
+}
+
+static void
+iface_helper_spawn (char **argv, guint n_interfaces)
+{
+	GError *error = NULL;
+	GPid pid;
+
+	if (g_spawn_async (NULL, argv, NULL,
+	                   G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error)) {
+		nm_log_info (LOGD_CORE, "spawned nm-iface-helper PID %u for %u interfaces",
+		             (guint) pid, n_interfaces);
+	} else {
+		nm_log_warn (LOGD_CORE, "failed to spawn nm-iface-helper: %s", error->message);
+		g_error_free (error);
+	}
+}
+
+static void
+iface_helper_spawn_multi (GPtrArray *options)
+{
+	GPtrArray *argv;
+	guint i;
+
+	argv = g_ptr_array_new ();
+	g_ptr_array_add (argv, LIBEXECDIR "/nm-iface-helper");
+	g_ptr_array_add (argv, "--multi");
+	for (i = 0; i < options->len; i++) {
+		g_ptr_array_add (argv, "--interface");
+		g_ptr_array_add (argv, options->pdata[i]);
+	}
+	g_ptr_array_add (argv, NULL);
+
+	iface_helper_spawn ((char **) argv->pdata, options->len);
+	g_ptr_array_unref (argv);
+}
+
+/* A helper in single-interface mode has a pid file of its own, so it can
+ * run next to the multi-interface one.
+ */
+static void
+iface_helper_spawn_single (const char *options)
+{
+	GError *error = NULL;
+	char **args = NULL;
+	GPtrArray *argv;
+	guint i;
+
+	if (!g_shell_parse_argv (options, NULL, &args, &error)) {
+		nm_log_warn (LOGD_CORE, "invalid nm-iface-helper options '%s': %s", options, error->message);
+		g_error_free (error);
+		return;
+	}
+
+	argv = g_ptr_array_new ();
+	g_ptr_array_add (argv, LIBEXECDIR "/nm-iface-helper");
+	for (i = 0; args[i]; i++)
+		g_ptr_array_add (argv, args[i]);
+	g_ptr_array_add (argv, NULL);
+
+	iface_helper_spawn ((char **) argv->pdata, 1);
+	g_ptr_array_unref (argv);
+	g_strfreev (args);
+}
+
+/* One nm-iface-helper takes care of all devices left configured. Pass the
+ * interfaces to a helper that is still running from a previous quit, or
+ * spawn a new one. Interfaces the running helper rejects get a helper of
+ * their own.
+ */
+static void
+spawn_iface_helper (NMManager *self)
+{
+	NMManagerPrivate *priv = NM_MANAGER_GET_PRIVATE (self);
+	GPtrArray *options = priv->iface_helper_options;
+	GPtrArray *rejected;
+	gboolean failed = FALSE;
+	guint i, n_passed = 0;
+	int fd;
+
+	if (!options)
+		return;
+	priv->iface_helper_options = NULL;
+
+	fd = iface_helper_connect ();
+	if (fd < 0) {
+		/* A helper may still hold the pid file without listening */
+		iface_helper_stop_stale ();
+		iface_helper_spawn_multi (options);
+		g_ptr_array_unref (options);
+		return;
+	}
+
+	rejected = g_ptr_array_new ();
+	for (i = 0; i < options->len && !failed; i++) {
+		gs_free char *message = NULL;
+
+		switch (nm_iface_helper_control_send (fd, NMIH_CONTROL_COMMAND_ADD, options->pdata[i], &message)) {
+		case NMIH_CONTROL_RESULT_OK:
+			n_passed++;
+			break;
+		case NMIH_CONTROL_RESULT_REJECTED:
+			nm_log_warn (LOGD_CORE, "nm-iface-helper did not take over interface: %s", message);
+			g_ptr_array_add (rejected, options->pdata[i]);
+			break;
+		case NMIH_CONTROL_RESULT_FAILED:
+			nm_log_warn (LOGD_CORE, "nm-iface-helper did not answer: %s", message);
+			failed = TRUE;
+			break;
+		}
+	}
+	close (fd);
+
+	if (failed) {
+		/* The interfaces passed so far go with the stale helper, so the
+		 * new one gets all of them.
+		 */
+		iface_helper_stop_stale ();
+		iface_helper_spawn_multi (options);
+	} else {
+		nm_log_info (LOGD_CORE, "passed %u interfaces to running nm-iface-helper", n_passed);
+		for (i = 0; i < rejected->len; i++)
+			iface_helper_spawn_single (rejected->pdata[i]);
+	}
+
+	g_ptr_array_unref (rejected);
+	g_ptr_array_unref (options);
+}
+
 void
 nm_manager_stop (NMManager *self)
 {
@@ -4279,6 +4481,8 @@ nm_manager_stop (NMManager *self)
 	/* Remove all devices */
 	while (priv->devices)
 		remove_device (self, NM_DEVICE (priv->devices->data), TRUE, TRUE);
+
+	spawn_iface_helper (self);
 }
 
 static gboolean
@@ -4433,14 +4637,14 @@ prop_set_auth_done_cb (NMAuthChain *chain,
 	DBusMessage *reply = NULL, *message;
 	const char *permission, *prop;
 	GObject *obj;
-	gboolean set_enabled = TRUE;
+	guint set_value;
 
 	priv->auth_chains = g_slist_remove (priv->auth_chains, chain);
 
 	message = nm_auth_chain_get_data (chain, "message");
 	permission = nm_auth_chain_get_data (chain, "permission");
 	prop = nm_auth_chain_get_data (chain, "prop");
-	set_enabled = GPOINTER_TO_UINT (nm_auth_chain_get_data (chain, "enabled"));
+	set_value = GPOINTER_TO_UINT (nm_auth_chain_get_data (chain, "value"));
 	obj = nm_auth_chain_get_data (chain, "object");
 
 	result = nm_auth_chain_get_result (chain, permission);
@@ -4449,7 +4653,8 @@ prop_set_auth_done_cb (NMAuthChain *chain,
 		                                NM_IS_DEVICE (obj) ? DEV_PERM_DENIED_ERROR : NM_PERM_DENIED_ERROR,
 		                                "Not authorized to perform this operation");
 	} else {
-		g_object_set (obj, prop, set_enabled, NULL);
+		/* Booleans and unsigned ints are passed the same way */
+		g_object_set (obj, prop, set_value, NULL);
 		reply = dbus_message_new_method_return (message);
 	}
 
@@ -4475,7 +4680,9 @@ prop_filter (DBusConnection *connection,
 	const char *propname = NULL;
 	const char *glib_propname = NULL, *permission = NULL;
 	DBusMessage *reply = NULL;
-	gboolean set_enabled = FALSE;
+	int value_type = DBUS_TYPE_BOOLEAN;
+	dbus_bool_t set_enabled = FALSE;
+	dbus_uint32_t set_value = 0;
 	NMAuthSubject *subject = NULL;
 	NMAuthChain *chain;
 	GObject *obj;
@@ -4494,7 +4701,10 @@ prop_filter (DBusConnection *connection,
 	if (dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_STRING)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 	dbus_message_iter_get_basic (&iter, &propiface);
-	if (!propiface || (strcmp (propiface, NM_DBUS_INTERFACE) && strcmp (propiface, NM_DBUS_INTERFACE_DEVICE)))
+	if (   !propiface
+	    || (   strcmp (propiface, NM_DBUS_INTERFACE)
+	        && strcmp (propiface, NM_DBUS_INTERFACE_DEVICE)
+	        && strcmp (propiface, NM_DBUS_INTERFACE_DEVICE_STATISTICS)))
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 	dbus_message_iter_next (&iter);
 
@@ -4516,6 +4726,10 @@ prop_filter (DBusConnection *connection,
 	} else if (!strcmp (propname, "Autoconnect")) {
 		glib_propname = NM_DEVICE_AUTOCONNECT;
 		permission = NM_AUTH_PERMISSION_NETWORK_CONTROL;
+	} else if (!strcmp (propname, "RefreshRateMs")) {
+		glib_propname = NM_DEVICE_STATISTICS_REFRESH_RATE_MS;
+		permission = NM_AUTH_PERMISSION_NETWORK_CONTROL;
+		value_type = DBUS_TYPE_UINT32;
 	} else
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
@@ -4523,9 +4737,13 @@ prop_filter (DBusConnection *connection,
 	if (dbus_message_iter_get_arg_type (&iter) != DBUS_TYPE_VARIANT)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 	dbus_message_iter_recurse (&iter, &sub);
-	if (dbus_message_iter_get_arg_type (&sub) != DBUS_TYPE_BOOLEAN)
+	if (dbus_message_iter_get_arg_type (&sub) != value_type)
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-	dbus_message_iter_get_basic (&sub, &set_enabled);
+	if (value_type == DBUS_TYPE_BOOLEAN) {
+		dbus_message_iter_get_basic (&sub, &set_enabled);
+		set_value = !!set_enabled;
+	} else
+		dbus_message_iter_get_basic (&sub, &set_value);
 
 	/* Make sure the object exists */
 	obj = dbus_g_connection_lookup_g_object (dbus_connection_get_g_connection (connection),
@@ -4554,7 +4772,7 @@ prop_filter (DBusConnection *connection,
 	priv->auth_chains = g_slist_append (priv->auth_chains, chain);
 	nm_auth_chain_set_data (chain, "prop", g_strdup (glib_propname), g_free);
 	nm_auth_chain_set_data (chain, "permission", g_strdup (permission), g_free);
-	nm_auth_chain_set_data (chain, "enabled", GUINT_TO_POINTER (set_enabled), NULL);
+	nm_auth_chain_set_data (chain, "value", GUINT_TO_POINTER (set_value), NULL);
 	nm_auth_chain_set_data (chain, "message", dbus_message_ref (message), (GDestroyNotify) dbus_message_unref);
 	nm_auth_chain_set_data (chain, "connection", dbus_connection_ref (connection), (GDestroyNotify) dbus_connection_unref);
 	nm_auth_chain_set_data (chain, "object", g_object_ref (obj), (GDestroyNotify) g_object_unref);
@@ -5106,6 +5324,7 @@ dispose (GObject *object)
 	                                      manager);
 
 	g_assert (priv->devices == NULL);
+	g_clear_pointer (&priv->iface_helper_options, g_ptr_array_unref);
 
 	if (priv->ac_cleanup_id) {
 		g_source_remove (priv->ac_cleanup_id);
@@ -29,6 +29,7 @@
 #include <gio/gio.h>
 
 #include "nm-policy.h"
+#include "gsystem-local-alloc.h"
 #include "NetworkManagerUtils.h"
 #include "nm-activation-request.h"
 #include "nm-logging.h"
@@ -49,13 +50,16 @@
 #include "nm-manager.h"
 #include "nm-settings.h"
 #include "nm-settings-connection.h"
+#include "nm-retry-queue.h"
 #include "nm-dhcp4-config.h"
 #include "nm-dhcp6-config.h"
+#include "nm-hostname-resolver.h"
 
 typedef struct {
 	NMManager *manager;
 	guint update_state_id;
 	GSList *pending_activation_checks;
+	guint activate_all_id;  /* coalesces activation checks for added connections */
 	GSList *manager_ids;
 	GSList *settings_ids;
 	GSList *dev_ids;
@@ -69,13 +73,13 @@ typedef struct {
 	NMDevice *default_device4, *activating_device4;
 	NMDevice *default_device6, *activating_device6;
 
-	GResolver *resolver;
+	NMHostnameResolver *hostname_resolver;
 	GInetAddress *lookup_addr;
 	GCancellable *lookup_cancellable;
 	NMDnsManager *dns_manager;
 	gulong config_changed_id;
 
-	gint reset_retries_id;  /* idle handler for resetting the retries count */
+	NMRetryQueue *autoconnect_retry_queue;  /* connections that ran out of retries */
 
 	char *orig_hostname; /* hostname at NM start time */
 	char *cur_hostname;  /* hostname we want to assign */
@@ -206,20 +210,22 @@ lookup_callback (GObject *source,
                  gpointer user_data)
 {
 	NMPolicy *policy = (NMPolicy *) user_data;
-	NMPolicyPrivate *priv = NM_POLICY_GET_PRIVATE (policy);
-	const char *hostname;
+	NMPolicyPrivate *priv;
+	char *hostname;
 	GError *error = NULL;
 
-	hostname = g_resolver_lookup_by_address_finish (G_RESOLVER (source), result, &error);
+	hostname = nm_hostname_resolver_lookup_finish (NM_HOSTNAME_RESOLVER (source), result, &error);
 	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
 		/* Don't touch policy; it may have been freed already */
 		g_error_free (error);
 		return;
 	}
 
-	if (hostname)
+	priv = NM_POLICY_GET_PRIVATE (policy);
+	if (hostname) {
 		_set_hostname (policy, hostname, "from address lookup");
-	else {
+		g_free (hostname);
+	} else {
 		_set_hostname (policy, NULL, error->message);
 		g_error_free (error);
 	}
@@ -227,6 +233,29 @@ lookup_callback (GObject *source,
 	g_clear_object (&priv->lookup_cancellable);
 }
 
+/* Lookups are cached per DNS configuration and a lookup of the same
+ * address that is still in progress is reused, so restarting is cheap. */
+static void
+start_hostname_lookup (NMPolicy *policy)
+{
+	NMPolicyPrivate *priv = NM_POLICY_GET_PRIVATE (policy);
+	gs_free char *dns_hash = NULL;
+
+	if (priv->lookup_cancellable) {
+		g_cancellable_cancel (priv->lookup_cancellable);
+		g_clear_object (&priv->lookup_cancellable);
+	}
+
+	dns_hash = nm_dns_manager_get_config_hash (priv->dns_manager);
+
+	priv->lookup_cancellable = g_cancellable_new ();
+	nm_hostname_resolver_lookup_async (priv->hostname_resolver,
+	                                   priv->lookup_addr,
+	                                   dns_hash,
+	                                   priv->lookup_cancellable,
+	                                   lookup_callback, policy);
+}
+
 static void
 update_system_hostname (NMPolicy *policy, NMDevice *best4, NMDevice *best6)
 {
@@ -349,11 +378,7 @@ update_system_hostname (NMPolicy *policy, NMDevice *best4, NMDevice *best6)
 		return;
 	}
 
-	priv->lookup_cancellable = g_cancellable_new ();
-	g_resolver_lookup_by_address_async (priv->resolver,
-	                                    priv->lookup_addr,
-	                                    priv->lookup_cancellable,
-	                                    lookup_callback, policy);
+	start_hostname_lookup (policy);
 }
 
 static void
@@ -829,6 +854,7 @@ reset_autoconnect_all (NMPolicy *policy, NMDevice *device)
 	for (iter = connections; iter; iter = g_slist_next (iter)) {
 		if (!device || nm_device_check_connection_compatible (device, iter->data)) {
 			nm_settings_connection_reset_autoconnect_retries (iter->data);
+			nm_retry_queue_forget (priv->autoconnect_retry_queue, iter->data);
 			nm_settings_connection_set_autoconnect_blocked_reason (iter->data, NM_DEVICE_STATE_REASON_NONE);
 		}
 	}
@@ -849,6 +875,7 @@ reset_autoconnect_for_failed_secrets (NMPolicy *policy)
 
 		if (nm_settings_connection_get_autoconnect_blocked_reason (connection) == NM_DEVICE_STATE_REASON_NO_SECRETS) {
 			nm_settings_connection_reset_autoconnect_retries (connection);
+			nm_retry_queue_forget (priv->autoconnect_retry_queue, connection);
 			nm_settings_connection_set_autoconnect_blocked_reason (connection, NM_DEVICE_STATE_REASON_NONE);
 		}
 	}
@@ -939,44 +966,40 @@ clear_pending_activate_check (NMPolicy *policy, NMDevice *device)
 		activate_data_free (data);
 }
 
-static gboolean
-reset_connections_retries (gpointer user_data)
+static void
+schedule_activate_for_connection (NMPolicy *policy, NMConnection *connection)
 {
-	NMPolicy *policy = (NMPolicy *) user_data;
 	NMPolicyPrivate *priv = NM_POLICY_GET_PRIVATE (policy);
-	GSList *connections, *iter;
-	gint32 con_stamp, min_stamp, now;
-	gboolean changed = FALSE;
+	const GSList *iter;
 
-	priv->reset_retries_id = 0;
+	for (iter = nm_manager_get_devices (priv->manager); iter; iter = g_slist_next (iter)) {
+		NMDevice *device = NM_DEVICE (iter->data);
 
-	min_stamp = 0;
-	now = nm_utils_get_monotonic_timestamp_s ();
-	connections = nm_settings_get_connections (priv->settings);
-	for (iter = connections; iter; iter = g_slist_next (iter)) {
-		NMSettingsConnection *connection = NM_SETTINGS_CONNECTION (iter->data);
+		if (nm_device_check_connection_compatible (device, connection))
+			schedule_activate_check (policy, device);
+	}
+}
 
-		con_stamp = nm_settings_connection_get_autoconnect_retry_time (connection);
-		if (con_stamp == 0)
-			continue;
+static void
+autoconnect_retry_expired (gpointer item, gpointer user_data)
+{
+	NMPolicy *policy = user_data;
+	NMSettingsConnection *connection = item;
 
-		if (con_stamp <= now) {
-			nm_settings_connection_reset_autoconnect_retries (connection);
-			changed = TRUE;
-		} else if (min_stamp == 0 || min_stamp > con_stamp)
-			min_stamp = con_stamp;
-	}
-	g_slist_free (connections);
+	/* The retries might have been reset meanwhile, e.g. on wake-up. */
+	if (nm_settings_connection_get_autoconnect_retries (connection) != 0)
+		return;
 
-	/* Schedule the handler again if there are some stamps left */
-	if (min_stamp != 0)
-		priv->reset_retries_id = g_timeout_add_seconds (min_stamp - now, reset_connections_retries, policy);
+	nm_log_dbg (LOGD_DEVICE, "Re-enabling autoconnect for connection '%s'",
+	            nm_connection_get_id (NM_CONNECTION (connection)));
 
-	/* If anything changed, try to activate the newly re-enabled connections */
-	if (changed)
-		schedule_activate_all (policy);
+	/* Unlike the other resets, this one keeps the connection in the queue,
+	 * so that it is blocked for longer if it runs out of retries again.
+	 */
+	nm_settings_connection_reset_autoconnect_retries (connection);
 
-	return FALSE;
+	/* Only devices that can take the connection need to look again */
+	schedule_activate_for_connection (policy, NM_CONNECTION (connection));
 }
 
 static void schedule_activate_all (NMPolicy *policy);
@@ -1011,8 +1034,10 @@ activate_slave_connections (NMPolicy *policy, NMDevice *device)
 		if (!slave_master)
 			continue;
 
-		if (!g_strcmp0 (slave_master, master_device) || !g_strcmp0 (slave_master, master_uuid))
+		if (!g_strcmp0 (slave_master, master_device) || !g_strcmp0 (slave_master, master_uuid)) {
 			nm_settings_connection_reset_autoconnect_retries (NM_SETTINGS_CONNECTION (slave));
+			nm_retry_queue_forget (priv->autoconnect_retry_queue, slave);
+		}
 	}
 
 	g_slist_free (connections);
@@ -1126,16 +1151,16 @@ device_state_changed (NMDevice *device,
 				nm_settings_connection_set_autoconnect_retries (connection, tries - 1);
 			}
 
-			if (nm_settings_connection_get_autoconnect_retries (connection) == 0) {
-				nm_log_info (LOGD_DEVICE, "Disabling autoconnect for connection '%s'.",
-				             nm_connection_get_id (NM_CONNECTION (connection)));
-				/* Schedule a handler to reset retries count */
-				if (!priv->reset_retries_id) {
-					gint32 retry_time = nm_settings_connection_get_autoconnect_retry_time (connection);
+			if (   nm_settings_connection_get_autoconnect_retries (connection) == 0
+			    && !nm_retry_queue_is_blocked (priv->autoconnect_retry_queue, connection)) {
+				gint64 deadline;
 
-					g_warn_if_fail (retry_time != 0);
-					priv->reset_retries_id = g_timeout_add_seconds (MAX (0, retry_time - nm_utils_get_monotonic_timestamp_s ()), reset_connections_retries, policy);
-				}
+				/* Schedule resetting the retries count; the delay grows each
+				 * time the connection runs out of retries again. */
+				deadline = nm_retry_queue_block (priv->autoconnect_retry_queue, connection);
+				nm_log_info (LOGD_DEVICE, "Disabling autoconnect for connection '%s' for %" G_GINT64_FORMAT " seconds.",
+				             nm_connection_get_id (NM_CONNECTION (connection)),
+				             MAX (deadline - nm_utils_get_monotonic_timestamp_ms (), 0) / 1000);
 			}
 			nm_connection_clear_secrets (NM_CONNECTION (connection));
 		}
@@ -1144,6 +1169,7 @@ device_state_changed (NMDevice *device,
 		if (connection) {
 			/* Reset auto retries back to default since connection was successful */
 			nm_settings_connection_reset_autoconnect_retries (connection);
+			nm_retry_queue_forget (priv->autoconnect_retry_queue, connection);
 
 			/* And clear secrets so they will always be requested from the
 			 * settings service when the next connection is made.
@@ -1542,14 +1568,29 @@ schedule_activate_all (NMPolicy *policy)
 		schedule_activate_check (policy, NM_DEVICE (iter->data));
 }
 
+static gboolean
+activate_all_idle (gpointer user_data)
+{
+	NMPolicy *policy = NM_POLICY (user_data);
+	NMPolicyPrivate *priv = NM_POLICY_GET_PRIVATE (policy);
+
+	priv->activate_all_id = 0;
+	schedule_activate_all (policy);
+	return G_SOURCE_REMOVE;
+}
+
 static void
 connection_added (NMSettings *settings,
                   NMSettingsConnection *connection,
                   gpointer user_data)
 {
 	NMPolicy *policy = NM_POLICY (user_data);
+	NMPolicyPrivate *priv = NM_POLICY_GET_PRIVATE (policy);
 
-	schedule_activate_all (policy);
+	/* Connections are often added in bulk; check the devices only once
+	 * for all of them. */
+	if (!priv->activate_all_id)
+		priv->activate_all_id = g_idle_add (activate_all_idle, policy);
 }
 
 static void
@@ -1625,30 +1666,24 @@ dns_config_changed (NMDnsManager *dns_manager, gpointer user_data)
 	NMPolicy *policy = (NMPolicy *) user_data;
 	NMPolicyPrivate *priv = NM_POLICY_GET_PRIVATE (policy);
 
-	/* Restart a thread for reverse-DNS lookup after we are signalled that
-	 * DNS changed. Because the result from a previous run may not be right
-	 * (race in updating DNS and doing the reverse lookup).
+	/* Restart the reverse-DNS lookup after we are signalled that DNS
+	 * changed, because the result from a previous run may not be right
+	 * (race in updating DNS and doing the reverse lookup). The changed
+	 * DNS configuration makes the lookup bypass cached results.
 	 */
 
-	/* Stop a lookup thread if any. */
-	if (priv->lookup_cancellable) {
-		g_cancellable_cancel (priv->lookup_cancellable);
-		g_clear_object (&priv->lookup_cancellable);
-	}
-
-	/* Re-start the hostname lookup thread if we don't have hostname yet. */
+	/* Re-start the hostname lookup if we don't have hostname yet. */
 	if (priv->lookup_addr) {
 		char *str = NULL;
 
-		nm_log_dbg (LOGD_DNS, "restarting reverse-lookup thread for address %s",
+		nm_log_dbg (LOGD_DNS, "restarting reverse-lookup for address %s",
 		            (str = g_inet_address_to_string (priv->lookup_addr)));
 		g_free (str);
 
-		priv->lookup_cancellable = g_cancellable_new ();
-		g_resolver_lookup_by_address_async (priv->resolver,
-		                                    priv->lookup_addr,
-		                                    priv->lookup_cancellable,
-		                                    lookup_callback, policy);
+		start_hostname_lookup (policy);
+	} else if (priv->lookup_cancellable) {
+		g_cancellable_cancel (priv->lookup_cancellable);
+		g_clear_object (&priv->lookup_cancellable);
 	}
 }
 
@@ -1669,8 +1704,11 @@ connection_updated_by_user (NMSettings *settings,
                             NMSettingsConnection *connection,
                             gpointer user_data)
 {
+	NMPolicyPrivate *priv = NM_POLICY_GET_PRIVATE (user_data);
+
 	/* Reset auto retries back to default since connection was updated */
 	nm_settings_connection_reset_autoconnect_retries (connection);
+	nm_retry_queue_forget (priv->autoconnect_retry_queue, connection);
 }
 
 static void
@@ -1708,6 +1746,7 @@ connection_removed (NMSettings *settings,
 	NMPolicy *policy = user_data;
 	NMPolicyPrivate *priv = NM_POLICY_GET_PRIVATE (policy);
 
+	nm_retry_queue_forget (priv->autoconnect_retry_queue, connection);
 	_deactivate_if_active (priv->manager, connection);
 }
 
@@ -1760,11 +1799,29 @@ _connect_settings_signal (NMPolicy *policy, const char *name, gpointer callback)
 	priv->settings_ids = g_slist_prepend (priv->settings_ids, GUINT_TO_POINTER (id));
 }
 
+#define AUTOCONNECT_RETRY_DELAY_DEFAULT 300
+
+/* In seconds */
+#define HOSTNAME_LOOKUP_TIMEOUT_DEFAULT      30
+#define HOSTNAME_LOOKUP_NEGATIVE_TTL_DEFAULT 300
+
+static guint
+read_config_uint (NMConfigData *config_data, const char *group, const char *key, guint default_value)
+{
+	gs_free char *value = NULL;
+
+	value = nm_config_data_get_value (config_data, group, key, NULL);
+	return _nm_utils_ascii_str_to_int64 (value, 10, 0, G_MAXUINT, default_value);
+}
+
 NMPolicy *
 nm_policy_new (NMManager *manager, NMSettings *settings)
 {
 	NMPolicy *policy;
 	NMPolicyPrivate *priv;
+	NMConfigData *config_data;
+	GResolver *resolver;
+	guint lookup_timeout, lookup_negative_ttl;
 	static gboolean initialized = FALSE;
 	char hostname[HOST_NAME_MAX + 2];
 
@@ -1777,6 +1834,13 @@ nm_policy_new (NMManager *manager, NMSettings *settings)
 	priv->settings = g_object_ref (settings);
 	priv->update_state_id = 0;
 
+	config_data = nm_config_get_data (nm_config_get ());
+	priv->autoconnect_retry_queue = nm_retry_queue_new (read_config_uint (config_data, "autoconnect", "retry-delay", AUTOCONNECT_RETRY_DELAY_DEFAULT),
+	                                                    read_config_uint (config_data, "autoconnect", "retry-delay-max", 0),
+	                                                    read_config_uint (config_data, "autoconnect", "retry-jitter", 0),
+	                                                    autoconnect_retry_expired,
+	                                                    policy);
+
 	/* Grab hostname on startup and use that if nothing provides one */
 	memset (hostname, 0, sizeof (hostname));
 	if (gethostname (&hostname[0], HOST_NAME_MAX) == 0) {
@@ -1793,7 +1857,13 @@ nm_policy_new (NMManager *manager, NMSettings *settings)
 	priv->config_changed_id = g_signal_connect (priv->dns_manager, "config-changed",
 	                                            G_CALLBACK (dns_config_changed), policy);
 
-	priv->resolver = g_resolver_get_default ();
+	lookup_timeout = read_config_uint (config_data, "hostname-lookup", "timeout", HOSTNAME_LOOKUP_TIMEOUT_DEFAULT);
+	lookup_negative_ttl = read_config_uint (config_data, "hostname-lookup", "negative-ttl", HOSTNAME_LOOKUP_NEGATIVE_TTL_DEFAULT);
+	resolver = g_resolver_get_default ();
+	priv->hostname_resolver = nm_hostname_resolver_new (resolver,
+	                                                    MIN (lookup_timeout, G_MAXUINT / 1000) * 1000,
+	                                                    MIN (lookup_negative_ttl, G_MAXUINT / 1000) * 1000);
+	g_object_unref (resolver);
 
 	_connect_manager_signal (policy, "state-changed", global_state_changed);
 	_connect_manager_signal (policy, "notify::" NM_MANAGER_HOSTNAME, hostname_changed);
@@ -1884,11 +1954,16 @@ dispose (GObject *object)
 		g_clear_object (&priv->lookup_cancellable);
 	}
 	g_clear_object (&priv->lookup_addr);
-	g_clear_object (&priv->resolver);
+	g_clear_object (&priv->hostname_resolver);
 
 	while (priv->pending_activation_checks)
 		activate_data_free (priv->pending_activation_checks->data);
 
+	if (priv->activate_all_id) {
+		g_source_remove (priv->activate_all_id);
+		priv->activate_all_id = 0;
+	}
+
 	g_slist_free_full (priv->pending_secondaries, (GDestroyNotify) pending_secondary_data_free);
 	priv->pending_secondaries = NULL;
 
@@ -1925,10 +2000,7 @@ dispose (GObject *object)
 	connections = nm_manager_get_active_connections (priv->manager);
 	g_assert (connections == NULL);
 
-	if (priv->reset_retries_id) {
-		g_source_remove (priv->reset_retries_id);
-		priv->reset_retries_id = 0;
-	}
+	g_clear_pointer (&priv->autoconnect_retry_queue, nm_retry_queue_free);
 
 	g_clear_pointer (&priv->orig_hostname, g_free);
 	g_clear_pointer (&priv->cur_hostname, g_free);
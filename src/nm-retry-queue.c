@@ -0,0 +1,406 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include "nm-retry-queue.h"
+#include "NetworkManagerUtils.h"
+
+typedef struct {
+	gpointer item;
+	guint blocked_count;  /* how often the item was blocked since it was forgotten */
+	guint heap_idx;       /* G_MAXUINT while not blocked */
+	gint64 deadline;      /* in milliseconds */
+} Entry;
+
+struct _NMRetryQueue {
+	gint64 delay_ms;
+	gint64 max_delay_ms;
+	guint jitter_percent;
+
+	NMRetryQueueExpiredFunc func;
+	gpointer user_data;
+
+	NMRetryQueueClockFunc clock;
+	gpointer clock_data;
+
+	GPtrArray *heap;     /* blocked entries, ordered by deadline */
+	GHashTable *entries; /* item :: Entry */
+
+	guint timeout_id;
+	gint64 timeout_deadline;
+};
+
+/*****************************************************************************/
+
+static gint64
+_now (NMRetryQueue *self)
+{
+	if (self->clock)
+		return self->clock (self->clock_data);
+	return nm_utils_get_monotonic_timestamp_ms ();
+}
+
+static void
+_heap_set (NMRetryQueue *self, guint idx, Entry *entry)
+{
+	self->heap->pdata[idx] = entry;
+	entry->heap_idx = idx;
+}
+
+static void
+_heap_sift_up (NMRetryQueue *self, guint idx)
+{
+	Entry *entry = self->heap->pdata[idx];
+
+	while (idx > 0) {
+		guint parent = (idx - 1) / 2;
+		Entry *p = self->heap->pdata[parent];
+
+		if (p->deadline <= entry->deadline)
+			break;
+		_heap_set (self, idx, p);
+		idx = parent;
+	}
+	_heap_set (self, idx, entry);
+}
+
+static void
+_heap_sift_down (NMRetryQueue *self, guint idx)
+{
+	Entry *entry = self->heap->pdata[idx];
+	guint len = self->heap->len;
+
+	for (;;) {
+		guint child = 2 * idx + 1;
+		Entry *c;
+
+		if (child >= len)
+			break;
+		if (   child + 1 < len
+		    && ((Entry *) self->heap->pdata[child + 1])->deadline < ((Entry *) self->heap->pdata[child])->deadline)
+			child++;
+		c = self->heap->pdata[child];
+		if (entry->deadline <= c->deadline)
+			break;
+		_heap_set (self, idx, c);
+		idx = child;
+	}
+	_heap_set (self, idx, entry);
+}
+
+static void
+_heap_push (NMRetryQueue *self, Entry *entry)
+{
+	g_ptr_array_add (self->heap, entry);
+	_heap_sift_up (self, self->heap->len - 1);
+}
+
+static void
+_heap_remove (NMRetryQueue *self, Entry *entry)
+{
+	guint idx = entry->heap_idx;
+
+	g_assert (idx < self->heap->len && self->heap->pdata[idx] == entry);
+
+	/* moves the last entry into the hole */
+	g_ptr_array_remove_index_fast (self->heap, idx);
+	entry->heap_idx = G_MAXUINT;
+
+	if (idx < self->heap->len) {
+		Entry *moved = self->heap->pdata[idx];
+
+		_heap_set (self, idx, moved);
+		_heap_sift_up (self, idx);
+		_heap_sift_down (self, moved->heap_idx);
+	}
+}
+
+/*****************************************************************************/
+
+static gboolean _timeout_cb (gpointer user_data);
+
+static void
+_timeout_rearm (NMRetryQueue *self)
+{
+	gint64 deadline, now;
+
+	/* with a fake clock, the caller dispatches */
+	if (self->clock)
+		return;
+
+	deadline = nm_retry_queue_get_next_deadline (self);
+	if (self->timeout_id) {
+		if (deadline && self->timeout_deadline == deadline)
+			return;
+		g_source_remove (self->timeout_id);
+		self->timeout_id = 0;
+	}
+	if (!deadline)
+		return;
+
+	now = _now (self);
+	self->timeout_deadline = deadline;
+	self->timeout_id = g_timeout_add (CLAMP (deadline - now, 0, G_MAXUINT), _timeout_cb, self);
+}
+
+static gboolean
+_timeout_cb (gpointer user_data)
+{
+	NMRetryQueue *self = user_data;
+
+	self->timeout_id = 0;
+	nm_retry_queue_dispatch (self);
+	return G_SOURCE_REMOVE;
+}
+
+static gint64
+_get_delay (NMRetryQueue *self, guint blocked_count)
+{
+	gint64 delay = self->delay_ms;
+	guint i;
+
+	for (i = 1; i < blocked_count && delay < self->max_delay_ms; i++)
+		delay *= 2;
+	delay = MIN (delay, self->max_delay_ms);
+
+	if (self->jitter_percent) {
+		gint64 spread = delay * self->jitter_percent / 100;
+
+		/* spread retries of items that failed at the same time */
+		delay += (gint64) g_random_double_range (-spread, spread);
+	}
+	return MAX (delay, 1);
+}
+
+/*****************************************************************************/
+
+/**
+ * nm_retry_queue_block:
+ * @self: the #NMRetryQueue
+ * @item: the item to block
+ *
+ * Sets the deadline after which @item expires. The delay starts at the
+ * queue's base delay and doubles every time @item is blocked again before
+ * it is forgotten, up to the maximum delay. If @item is already blocked,
+ * its deadline is replaced.
+ *
+ * Returns: the deadline in nm_utils_get_monotonic_timestamp_ms() scale.
+ */
+gint64
+nm_retry_queue_block (NMRetryQueue *self, gpointer item)
+{
+	Entry *entry;
+
+	g_return_val_if_fail (self, 0);
+
+	entry = g_hash_table_lookup (self->entries, item);
+	if (!entry) {
+		entry = g_slice_new0 (Entry);
+		entry->item = item;
+		entry->heap_idx = G_MAXUINT;
+		g_hash_table_insert (self->entries, item, entry);
+	}
+
+	if (entry->blocked_count < G_MAXUINT)
+		entry->blocked_count++;
+	entry->deadline = _now (self) + _get_delay (self, entry->blocked_count);
+
+	if (entry->heap_idx == G_MAXUINT)
+		_heap_push (self, entry);
+	else {
+		_heap_sift_up (self, entry->heap_idx);
+		_heap_sift_down (self, entry->heap_idx);
+	}
+
+	_timeout_rearm (self);
+	return entry->deadline;
+}
+
+/**
+ * nm_retry_queue_forget:
+ * @self: the #NMRetryQueue
+ * @item: the item
+ *
+ * Unblocks @item without calling the expired callback and resets its
+ * delay to the base delay.
+ */
+void
+nm_retry_queue_forget (NMRetryQueue *self, gpointer item)
+{
+	Entry *entry;
+
+	g_return_if_fail (self);
+
+	entry = g_hash_table_lookup (self->entries, item);
+	if (!entry)
+		return;
+
+	if (entry->heap_idx != G_MAXUINT) {
+		_heap_remove (self, entry);
+		_timeout_rearm (self);
+	}
+	g_hash_table_remove (self->entries, item);
+}
+
+gboolean
+nm_retry_queue_is_blocked (NMRetryQueue *self, gpointer item)
+{
+	Entry *entry;
+
+	g_return_val_if_fail (self, FALSE);
+
+	entry = g_hash_table_lookup (self->entries, item);
+	return entry && entry->heap_idx != G_MAXUINT;
+}
+
+guint
+nm_retry_queue_get_length (NMRetryQueue *self)
+{
+	g_return_val_if_fail (self, 0);
+
+	return self->heap->len;
+}
+
+/**
+ * nm_retry_queue_get_next_deadline:
+ * @self: the #NMRetryQueue
+ *
+ * Returns: the earliest deadline of the blocked items, or 0 if no item
+ *   is blocked.
+ */
+gint64
+nm_retry_queue_get_next_deadline (NMRetryQueue *self)
+{
+	g_return_val_if_fail (self, 0);
+
+	if (!self->heap->len)
+		return 0;
+	return ((Entry *) self->heap->pdata[0])->deadline;
+}
+
+/**
+ * nm_retry_queue_dispatch:
+ * @self: the #NMRetryQueue
+ *
+ * Unblocks all items whose deadline passed and invokes the expired callback
+ * for each of them, earliest deadline first. The callback may block or
+ * forget items, including the expired one. This is done automatically
+ * when the earliest deadline is reached.
+ *
+ * Returns: the number of expired items.
+ */
+guint
+nm_retry_queue_dispatch (NMRetryQueue *self)
+{
+	gint64 now;
+	guint n = 0;
+
+	g_return_val_if_fail (self, 0);
+
+	now = _now (self);
+	while (self->heap->len) {
+		Entry *entry = self->heap->pdata[0];
+
+		if (entry->deadline > now)
+			break;
+
+		_heap_remove (self, entry);
+		n++;
+		self->func (entry->item, self->user_data);
+	}
+
+	_timeout_rearm (self);
+	return n;
+}
+
+/*****************************************************************************/
+
+static void
+_entry_free (Entry *entry)
+{
+	g_slice_free (Entry, entry);
+}
+
+/**
+ * nm_retry_queue_new:
+ * @delay_s: the delay of the first block of an item
+ * @max_delay_s: the delay never grows beyond this
+ * @jitter_percent: randomly shift each deadline by up to this many percent
+ *   of the delay
+ * @func: called when the deadline of an item passed
+ * @user_data: data for @func
+ *
+ * Returns: a new #NMRetryQueue
+ */
+NMRetryQueue *
+nm_retry_queue_new (guint delay_s,
+                    guint max_delay_s,
+                    guint jitter_percent,
+                    NMRetryQueueExpiredFunc func,
+                    gpointer user_data)
+{
+	NMRetryQueue *self;
+
+	g_return_val_if_fail (func, NULL);
+
+	self = g_slice_new0 (NMRetryQueue);
+	self->delay_ms = MAX (delay_s, 1) * (gint64) 1000;
+	self->max_delay_ms = MAX (self->delay_ms, max_delay_s * (gint64) 1000);
+	self->jitter_percent = MIN (jitter_percent, 100);
+	self->func = func;
+	self->user_data = user_data;
+	self->heap = g_ptr_array_new ();
+	self->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) _entry_free);
+	return self;
+}
+
+void
+nm_retry_queue_free (NMRetryQueue *self)
+{
+	if (!self)
+		return;
+
+	if (self->timeout_id)
+		g_source_remove (self->timeout_id);
+	g_ptr_array_free (self->heap, TRUE);
+	g_hash_table_destroy (self->entries);
+	g_slice_free (NMRetryQueue, self);
+}
+
+/*****************************************************************************/
+
+/* For testcases only! Use @clock instead of the monotonic clock. Expired
+ * items are then only unblocked by nm_retry_queue_dispatch(). */
+void
+_nm_retry_queue_set_clock (NMRetryQueue *self,
+                           NMRetryQueueClockFunc clock,
+                           gpointer clock_data)
+{
+	g_return_if_fail (self);
+
+	if (self->timeout_id) {
+		g_source_remove (self->timeout_id);
+		self->timeout_id = 0;
+	}
+	self->clock = clock;
+	self->clock_data = clock_data;
+	_timeout_rearm (self);
+}
@@ -0,0 +1,60 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#ifndef __NETWORKMANAGER_RETRY_QUEUE_H__
+#define __NETWORKMANAGER_RETRY_QUEUE_H__
+
+#include <glib.h>
+
+/* Keeps the deadlines of blocked items (e.g. connections that ran out of
+ * autoconnect retries) in a min-heap and calls back when they expire. Each
+ * time an item gets blocked again before it was forgotten, its delay doubles
+ * up to a maximum. Items are opaque pointers that are not referenced.
+ */
+typedef struct _NMRetryQueue NMRetryQueue;
+
+typedef void (*NMRetryQueueExpiredFunc) (gpointer item, gpointer user_data);
+
+NMRetryQueue *nm_retry_queue_new (guint delay_s,
+                                  guint max_delay_s,
+                                  guint jitter_percent,
+                                  NMRetryQueueExpiredFunc func,
+                                  gpointer user_data);
+void nm_retry_queue_free (NMRetryQueue *self);
+
+gint64 nm_retry_queue_block (NMRetryQueue *self, gpointer item);
+void nm_retry_queue_forget (NMRetryQueue *self, gpointer item);
+
+gboolean nm_retry_queue_is_blocked (NMRetryQueue *self, gpointer item);
+guint nm_retry_queue_get_length (NMRetryQueue *self);
+gint64 nm_retry_queue_get_next_deadline (NMRetryQueue *self);
+
+guint nm_retry_queue_dispatch (NMRetryQueue *self);
+
+/******************************************************/
+/* Testing-only functions */
+
+typedef gint64 (*NMRetryQueueClockFunc) (gpointer user_data);
+
+void _nm_retry_queue_set_clock (NMRetryQueue *self,
+                                NMRetryQueueClockFunc clock,
+                                gpointer clock_data);
+
+#endif /* __NETWORKMANAGER_RETRY_QUEUE_H__ */
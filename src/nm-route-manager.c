@@ -27,6 +27,7 @@
 #include "nm-logging.h"
 #include "gsystem-local-alloc.h"
 #include "NetworkManagerUtils.h"
+#include "nm-stats.h"
 
 typedef struct {
 	guint len;
@@ -34,8 +35,23 @@ typedef struct {
 } RouteIndex;
 
 typedef struct {
-	GArray *entries;
-	RouteIndex *index;
+	NMPlatformIPXRoute route;
+	guint64 seqno;
+	GSequenceIter *iter;          /* position in RouteEntries.all */
+	GSequenceIter *ifindex_iter;  /* position in the view of route.rx.ifindex */
+} RouteEntry;
+
+typedef struct {
+	/* All managed routes, ordered by route id. Routes with the same id on
+	 * different interfaces are ordered by the time they were added; the first
+	 * one is configured in the kernel and shadows the others. */
+	GSequence *all;
+
+	/* ifindex -> GSequence of the RouteEntry of that interface, ordered by
+	 * route id. A sync only needs to walk the view of its own interface. */
+	GHashTable *by_ifindex;
+
+	guint64 seqno;
 } RouteEntries;
 
 typedef struct {
@@ -171,8 +187,52 @@ ASSERT_route_index_valid (const VTableIP *vtable, const GArray *entries, const R
 		}
 	}
 }
+
+inline static void
+ASSERT_route_entries_valid (const VTableIP *vtable, const RouteEntries *ipx_routes)
+{
+	GSequenceIter *iter;
+	GHashTableIter hiter;
+	GSequence *view;
+	const RouteEntry *prev = NULL;
+	guint n_view_entries = 0;
+
+	for (iter = g_sequence_get_begin_iter (ipx_routes->all); !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter)) {
+		const RouteEntry *entry = g_sequence_get (iter);
+
+		g_assert (entry->iter == iter);
+		g_assert (g_sequence_get (entry->ifindex_iter) == entry);
+		if (prev) {
+			int c = vtable->route_id_cmp (&prev->route, &entry->route);
+
+			g_assert (c <= 0);
+			if (c == 0)
+				g_assert (prev->seqno < entry->seqno);
+		}
+		prev = entry;
+	}
+
+	g_hash_table_iter_init (&hiter, ipx_routes->by_ifindex);
+	while (g_hash_table_iter_next (&hiter, NULL, (gpointer *) &view)) {
+		prev = NULL;
+		g_assert (g_sequence_get_length (view) > 0);
+		for (iter = g_sequence_get_begin_iter (view); !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter)) {
+			const RouteEntry *entry = g_sequence_get (iter);
+
+			g_assert (entry->ifindex_iter == iter);
+			if (prev) {
+				g_assert_cmpint (prev->route.rx.ifindex, ==, entry->route.rx.ifindex);
+				g_assert (vtable->route_id_cmp (&prev->route, &entry->route) < 0);
+			}
+			prev = entry;
+		}
+		n_view_entries += g_sequence_get_length (view);
+	}
+	g_assert_cmpint (n_view_entries, ==, g_sequence_get_length (ipx_routes->all));
+}
 #else
 #define ASSERT_route_index_valid(vtable, entries, index, unique_ifindexes) G_STMT_START { (void) 0; } G_STMT_END
+#define ASSERT_route_entries_valid(vtable, ipx_routes) G_STMT_START { (void) 0; } G_STMT_END
 #endif
 
 /*********************************************************************************************/
@@ -232,24 +292,97 @@ _route_index_create (const VTableIP *vtable, const GArray *routes)
 	return index;
 }
 
-static guint
-_route_index_reverse_idx (const VTableIP *vtable, const RouteIndex *index, guint idx_idx, const GArray *routes)
+/*********************************************************************************************/
+
+static int
+_route_entry_cmp (const RouteEntry *e1, const RouteEntry *e2, const VTableIP *vtable)
+{
+	int c;
+
+	c = vtable->route_id_cmp (&e1->route, &e2->route);
+	if (c != 0)
+		return c;
+	CMP_AND_RETURN_INT (e1->seqno, e2->seqno);
+	return 0;
+}
+
+static int
+_route_entry_id_cmp (const RouteEntry *e1, const RouteEntry *e2, const VTableIP *vtable)
 {
-	const NMPlatformIPXRoute *r, *r0;
-	gssize offset;
+	return vtable->route_id_cmp (&e1->route, &e2->route);
+}
 
-	/* reverse the @idx_idx that points into @index, to the corresponding index into the unsorted @routes array. */
+static void
+_route_entry_free (RouteEntry *entry)
+{
+	g_slice_free (RouteEntry, entry);
+}
 
-	r = index->entries[idx_idx];
-	r0 = VTABLE_ROUTE_INDEX (vtable, routes, 0);
+static RouteEntry *
+_route_entry_at (GSequenceIter *iter)
+{
+	if (!iter || g_sequence_iter_is_end (iter))
+		return NULL;
+	return g_sequence_get (iter);
+}
 
-	if (vtable->vt->is_ip4)
-		offset = &r->r4 - &r0->r4;
-	else
-		offset = &r->r6 - &r0->r6;
-	g_assert (offset >= 0 && offset < index->len);
-	g_assert (VTABLE_ROUTE_INDEX (vtable, routes, offset) == r);
-	return offset;
+static GSequenceIter *
+_route_entries_view_begin (RouteEntries *ipx_routes, int ifindex)
+{
+	GSequence *view = g_hash_table_lookup (ipx_routes->by_ifindex, GINT_TO_POINTER (ifindex));
+
+	return view ? g_sequence_get_begin_iter (view) : NULL;
+}
+
+static RouteEntry *
+_route_entries_add (const VTableIP *vtable, RouteEntries *ipx_routes, int ifindex, const NMPlatformIPXRoute *route)
+{
+	RouteEntry *entry;
+	GSequence *view;
+
+	entry = g_slice_new0 (RouteEntry);
+	memcpy (&entry->route, route, vtable->vt->sizeof_route);
+	entry->route.rx.ifindex = ifindex;
+	entry->route.rx.metric = vtable->vt->metric_normalize (entry->route.rx.metric);
+	entry->seqno = ++ipx_routes->seqno;
+
+	view = g_hash_table_lookup (ipx_routes->by_ifindex, GINT_TO_POINTER (ifindex));
+	if (!view) {
+		view = g_sequence_new (NULL);
+		g_hash_table_insert (ipx_routes->by_ifindex, GINT_TO_POINTER (ifindex), view);
+	}
+
+	entry->iter = g_sequence_insert_sorted (ipx_routes->all, entry, (GCompareDataFunc) _route_entry_cmp, (gpointer) vtable);
+	entry->ifindex_iter = g_sequence_insert_sorted (view, entry, (GCompareDataFunc) _route_entry_id_cmp, (gpointer) vtable);
+	return entry;
+}
+
+static void
+_route_entries_remove (RouteEntries *ipx_routes, RouteEntry *entry)
+{
+	GSequence *view = g_sequence_iter_get_sequence (entry->ifindex_iter);
+
+	g_sequence_remove (entry->ifindex_iter);
+	if (g_sequence_get_length (view) == 0)
+		g_hash_table_remove (ipx_routes->by_ifindex, GINT_TO_POINTER (entry->route.rx.ifindex));
+
+	/* frees @entry */
+	g_sequence_remove (entry->iter);
+}
+
+static void
+_route_entries_init (RouteEntries *ipx_routes)
+{
+	ipx_routes->all = g_sequence_new ((GDestroyNotify) _route_entry_free);
+	ipx_routes->by_ifindex = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_sequence_free);
+	ipx_routes->seqno = 0;
+}
+
+static void
+_route_entries_clear (RouteEntries *ipx_routes)
+{
+	g_clear_pointer (&ipx_routes->by_ifindex, g_hash_table_unref);
+	g_clear_pointer (&ipx_routes->all, g_sequence_free);
 }
 
 /*********************************************************************************************/
@@ -267,26 +400,6 @@ _route_equals_ignoring_ifindex (const VTableIP *vtable, const NMPlatformIPXRoute
 	return vtable->vt->route_cmp (r1, r2) == 0;
 }
 
-static NMPlatformIPXRoute *
-_get_next_ipx_route (const RouteIndex *index, gboolean start_at_zero, guint *cur_idx, int ifindex)
-{
-	guint i;
-
-	if (start_at_zero)
-		i = 0;
-	else
-		i = *cur_idx + 1;
-	/* Find the next route with matching @ifindex. */
-	for (; i < index->len; i++) {
-		if (index->entries[i]->rx.ifindex == ifindex) {
-			*cur_idx = i;
-			return index->entries[i];
-		}
-	}
-	*cur_idx = index->len;
-	return NULL;
-}
-
 static const NMPlatformIPXRoute *
 _get_next_known_route (const VTableIP *vtable, const RouteIndex *index, gboolean start_at_zero, guint *cur_idx)
 {
@@ -333,14 +446,60 @@ _get_next_plat_route (const RouteIndex *index, gboolean start_at_zero, guint *cu
 	return NULL;
 }
 
-static int
-_sort_indexes_cmp (guint *a, guint *b)
+/*********************************************************************************************/
+
+typedef struct {
+	const VTableIP *vtable;
+	NMRouteManager *self;
+	RouteEntries *ipx_routes;
+	int ifindex;
+	gboolean success;
+} RouteSyncData;
+
+static void
+_route_add_failed (RouteSyncData *data, const NMPlatformIPXRoute *route)
 {
-	CMP_AND_RETURN_INT (*a, *b);
-	g_return_val_if_reached (0);
+	const VTableIP *vtable = data->vtable;
+	NMRouteManager *self = data->self;
+
+	if (route->rx.source < NM_IP_CONFIG_SOURCE_USER) {
+		_LOGD (vtable->vt->addr_family, "ignore error adding IPv%c route to kernel: %s",
+		       vtable->vt->is_ip4 ? '4' : '6',
+		       vtable->vt->route_to_string (route));
+		/* Remember that there was a failure, but for now continue trying to sync the
+		 * remaining routes. */
+		data->success = FALSE;
+	}
 }
 
-/*********************************************************************************************/
+static void
+_route_sync_transaction_failed (NMPlatform *platform,
+                                NMPlatformTransactionObject object_type,
+                                gboolean add,
+                                gconstpointer object,
+                                gpointer user_data)
+{
+	RouteSyncData *data = user_data;
+	const NMPlatformIPXRoute *route = object;
+	GSequence *view;
+	GSequenceIter *iter;
+	RouteEntry needle;
+
+	if (!add || route->rx.ifindex != data->ifindex)
+		return;
+	if (object_type != (data->vtable->vt->is_ip4 ? NM_PLATFORM_TRANSACTION_IP4_ROUTE : NM_PLATFORM_TRANSACTION_IP6_ROUTE))
+		return;
+
+	/* Platform only reports what it sent. Find our entry, which has the
+	 * original source of the route. */
+	view = g_hash_table_lookup (data->ipx_routes->by_ifindex, GINT_TO_POINTER (data->ifindex));
+	if (!view)
+		return;
+	memcpy (&needle.route, route, data->vtable->vt->sizeof_route);
+	iter = g_sequence_lookup (view, &needle, (GCompareDataFunc) _route_entry_id_cmp, (gpointer) data->vtable);
+	if (iter)
+		_route_add_failed (data, &((RouteEntry *) g_sequence_get (iter))->route);
+}
 
 static gboolean
 _vx_route_sync (const VTableIP *vtable, NMRouteManager *self, int ifindex, const GArray *known_routes)
@@ -349,13 +508,15 @@ _vx_route_sync (const VTableIP *vtable, NMRouteManager *self, int ifindex, const
 	GArray *plat_routes;
 	RouteEntries *ipx_routes;
 	RouteIndex *plat_routes_idx, *known_routes_idx;
-	gboolean success = TRUE;
+	RouteSyncData sync_data;
 	guint i, i_type;
-	GArray *to_delete_indexes = NULL, *to_restore_routes = NULL;
-	GPtrArray *to_add_routes = NULL;
-	guint i_known_routes, i_plat_routes, i_ipx_routes;
+	GArray *to_restore_routes = NULL;
+	GPtrArray *to_add_routes = NULL, *to_delete_entries = NULL;
+	guint i_known_routes, i_plat_routes;
 	const NMPlatformIPXRoute *cur_known_route, *cur_plat_route;
-	NMPlatformIPXRoute *cur_ipx_route;
+	GSequenceIter *ipx_iter;
+	RouteEntry *cur_ipx_entry;
+	gint64 start = nm_utils_get_monotonic_timestamp_us ();
 
 	ipx_routes = vtable->vt->is_ip4 ? &priv->ip4_routes : &priv->ip6_routes;
 	plat_routes = vtable->vt->route_get_all (NM_PLATFORM_GET, ifindex, NM_PLATFORM_GET_ROUTE_MODE_NO_DEFAULT);
@@ -371,8 +532,10 @@ _vx_route_sync (const VTableIP *vtable, NMRouteManager *self, int ifindex, const
 			_LOGT (vtable->vt->addr_family, "%3d: sync new addr #%u: %s",
 			       ifindex, i, vtable->vt->route_to_string (VTABLE_ROUTE_INDEX (vtable, known_routes, i)));
 		}
-		for (i = 0; i < ipx_routes->index->len; i++)
-			_LOGT (vtable->vt->addr_family, "%3d: STATE: has    #%u - %s", ifindex, i, vtable->vt->route_to_string (ipx_routes->index->entries[i]));
+		for (ipx_iter = _route_entries_view_begin (ipx_routes, ifindex); (cur_ipx_entry = _route_entry_at (ipx_iter)); ipx_iter = g_sequence_iter_next (ipx_iter)) {
+			_LOGT (vtable->vt->addr_family, "%3d: STATE: has    #%d - %s", ifindex,
+			       g_sequence_iter_get_position (cur_ipx_entry->iter), vtable->vt->route_to_string (&cur_ipx_entry->route));
+		}
 	}
 
 	/***************************************************************************
@@ -382,95 +545,102 @@ _vx_route_sync (const VTableIP *vtable, NMRouteManager *self, int ifindex, const
 	 * be added/deleted.
 	 **************************************************************************/
 
-	/* iterate over @ipx_routes and @known_routes */
-	cur_ipx_route = _get_next_ipx_route (ipx_routes->index, TRUE, &i_ipx_routes, ifindex);
+	/* iterate over the routes of @ifindex in @ipx_routes and over @known_routes */
+	ipx_iter = _route_entries_view_begin (ipx_routes, ifindex);
+	cur_ipx_entry = _route_entry_at (ipx_iter);
 	cur_known_route = _get_next_known_route (vtable, known_routes_idx, TRUE, &i_known_routes);
-	while (cur_ipx_route || cur_known_route) {
+	while (cur_ipx_entry || cur_known_route) {
 		int route_id_cmp_result = -1;
 
-		while (   cur_ipx_route
+		while (   cur_ipx_entry
 		       && (   !cur_known_route
-		           || ((route_id_cmp_result = vtable->route_id_cmp (cur_ipx_route, cur_known_route)) < 0))) {
-			/* we have @cur_ipx_route, which is less then @cur_known_route. Hence,
+		           || ((route_id_cmp_result = vtable->route_id_cmp (&cur_ipx_entry->route, cur_known_route)) < 0))) {
+			GSequenceIter *next_iter;
+
+			/* we have @cur_ipx_entry, which is less then @cur_known_route. Hence,
 			 * the route does no longer exist in @known_routes */
-			if (!to_delete_indexes)
-				to_delete_indexes = g_array_new (FALSE, FALSE, sizeof (guint));
-			g_array_append_val (to_delete_indexes, i_ipx_routes);
+			if (!to_delete_entries)
+				to_delete_entries = g_ptr_array_new ();
+			g_ptr_array_add (to_delete_entries, cur_ipx_entry);
 
-			/* later we will delete @cur_ipx_route. See if @cur_ipx_route was shadowing another route, that
+			/* later we will delete @cur_ipx_entry. See if @cur_ipx_entry was shadowing another route, that
 			 * we must restore. */
-			if (i_ipx_routes + 1 < ipx_routes->index->len) {
-				const NMPlatformIPXRoute *next_route = ipx_routes->index->entries[i_ipx_routes + 1];
+			next_iter = g_sequence_iter_next (cur_ipx_entry->iter);
+			if (!g_sequence_iter_is_end (next_iter)) {
+				const RouteEntry *next_entry = g_sequence_get (next_iter);
 
-				if (vtable->route_id_cmp (cur_ipx_route, next_route) == 0) {
+				if (vtable->route_id_cmp (&cur_ipx_entry->route, &next_entry->route) == 0) {
 					if (!to_restore_routes)
 						to_restore_routes = g_array_new (FALSE, FALSE, vtable->vt->sizeof_route);
-					g_array_append_vals (to_restore_routes, next_route, 1);
-					g_assert (next_route->rx.ifindex != ifindex);
+					g_array_append_vals (to_restore_routes, &next_entry->route, 1);
+					g_assert (next_entry->route.rx.ifindex != ifindex);
 				}
 			}
 
-			/* find the next @cur_ipx_route with matching ifindex. */
-			cur_ipx_route = _get_next_ipx_route (ipx_routes->index, FALSE, &i_ipx_routes, ifindex);
+			/* find the next @cur_ipx_entry with matching ifindex. */
+			ipx_iter = g_sequence_iter_next (ipx_iter);
+			cur_ipx_entry = _route_entry_at (ipx_iter);
 		}
-		if (   cur_ipx_route
+		if (   cur_ipx_entry
 		    && cur_known_route
 		    && route_id_cmp_result == 0) {
-			if (!_route_equals_ignoring_ifindex (vtable, cur_ipx_route, cur_known_route)) {
+			if (!_route_equals_ignoring_ifindex (vtable, &cur_ipx_entry->route, cur_known_route)) {
 				/* The routes match. Update the entry in place. As this is an exact match of primary
 				 * fields, this only updates possibly modified fields such as @gateway or @mss.
-				 * Modifiying @cur_ipx_route this way does not invalidate @ipx_routes->index. */
-				memcpy (cur_ipx_route, cur_known_route, vtable->vt->sizeof_route);
-				cur_ipx_route->rx.ifindex = ifindex;
-				cur_ipx_route->rx.metric = vtable->vt->metric_normalize (cur_ipx_route->rx.metric);
-				_LOGT (vtable->vt->addr_family, "%3d: STATE: update #%u - %s", ifindex, i_ipx_routes, vtable->vt->route_to_string (cur_ipx_route));
+				 * Modifiying @cur_ipx_entry this way does not change its position in @ipx_routes. */
+				memcpy (&cur_ipx_entry->route, cur_known_route, vtable->vt->sizeof_route);
+				cur_ipx_entry->route.rx.ifindex = ifindex;
+				cur_ipx_entry->route.rx.metric = vtable->vt->metric_normalize (cur_ipx_entry->route.rx.metric);
+				_LOGT (vtable->vt->addr_family, "%3d: STATE: update #%d - %s", ifindex,
+				       g_sequence_iter_get_position (cur_ipx_entry->iter), vtable->vt->route_to_string (&cur_ipx_entry->route));
 			}
 		} else if (cur_known_route) {
-			g_assert (!cur_ipx_route || route_id_cmp_result > 0);
+			g_assert (!cur_ipx_entry || route_id_cmp_result > 0);
 			/* @cur_known_route is new. We cannot immediately add @cur_known_route to @ipx_routes, because
-			 * it would invalidate @ipx_routes->index. Instead remember to add it later. */
+			 * we are still iterating over it. Instead remember to add it later. */
 			if (!to_add_routes)
 				to_add_routes = g_ptr_array_new ();
 			g_ptr_array_add (to_add_routes, (gpointer) cur_known_route);
 		}
 
-		if (cur_ipx_route && (!cur_known_route || route_id_cmp_result == 0))
-			cur_ipx_route = _get_next_ipx_route (ipx_routes->index, FALSE, &i_ipx_routes, ifindex);
+		if (cur_ipx_entry && (!cur_known_route || route_id_cmp_result == 0)) {
+			ipx_iter = g_sequence_iter_next (ipx_iter);
+			cur_ipx_entry = _route_entry_at (ipx_iter);
+		}
 		if (cur_known_route)
 			cur_known_route = _get_next_known_route (vtable, known_routes_idx, FALSE, &i_known_routes);
 	}
 
 	/* Update @ipx_routes with the just learned changes. */
-	if (to_delete_indexes || to_add_routes) {
-		if (to_delete_indexes) {
-			for (i = 0; i < to_delete_indexes->len; i++) {
-				guint idx = g_array_index (to_delete_indexes, guint, i);
+	if (to_delete_entries) {
+		for (i = 0; i < to_delete_entries->len; i++) {
+			RouteEntry *entry = to_delete_entries->pdata[i];
 
-				_LOGT (vtable->vt->addr_family, "%3d: STATE: delete #%u - %s", ifindex, idx, vtable->vt->route_to_string (ipx_routes->index->entries[idx]));
-				g_array_index (to_delete_indexes, guint, i) = _route_index_reverse_idx (vtable, ipx_routes->index, idx, ipx_routes->entries);
-			}
-			g_array_sort (to_delete_indexes, (GCompareFunc) _sort_indexes_cmp);
-			nm_utils_array_remove_at_indexes (ipx_routes->entries, &g_array_index (to_delete_indexes, guint, 0), to_delete_indexes->len);
-			g_array_unref (to_delete_indexes);
+			_LOGT (vtable->vt->addr_family, "%3d: STATE: delete #%d - %s", ifindex,
+			       g_sequence_iter_get_position (entry->iter), vtable->vt->route_to_string (&entry->route));
+			_route_entries_remove (ipx_routes, entry);
 		}
-		if (to_add_routes) {
-			for (i = 0; i < to_add_routes->len; i++) {
-				NMPlatformIPXRoute *ipx_route;
-
-				g_array_append_vals (ipx_routes->entries, g_ptr_array_index (to_add_routes, i), 1);
-
-				ipx_route = VTABLE_ROUTE_INDEX (vtable, ipx_routes->entries, ipx_routes->entries->len - 1);
-				ipx_route->rx.ifindex = ifindex;
-				ipx_route->rx.metric = vtable->vt->metric_normalize (ipx_route->rx.metric);
+		g_ptr_array_unref (to_delete_entries);
+	}
+	if (to_add_routes) {
+		for (i = 0; i < to_add_routes->len; i++) {
+			RouteEntry *entry;
 
-				_LOGT (vtable->vt->addr_family, "%3d: STATE: added  #%u - %s", ifindex, ipx_routes->entries->len - 1, vtable->vt->route_to_string (ipx_route));
-			}
-			g_ptr_array_unref (to_add_routes);
+			entry = _route_entries_add (vtable, ipx_routes, ifindex, g_ptr_array_index (to_add_routes, i));
+			_LOGT (vtable->vt->addr_family, "%3d: STATE: added  #%d - %s", ifindex,
+			       g_sequence_iter_get_position (entry->iter), vtable->vt->route_to_string (&entry->route));
 		}
-		g_free (ipx_routes->index);
-		ipx_routes->index = _route_index_create (vtable, ipx_routes->entries);
-		ASSERT_route_index_valid (vtable, ipx_routes->entries, ipx_routes->index, TRUE);
+		g_ptr_array_unref (to_add_routes);
 	}
+	ASSERT_route_entries_valid (vtable, ipx_routes);
+
+	/* Platform changes from here on are sent to the kernel as one batch. */
+	sync_data.vtable = vtable;
+	sync_data.self = self;
+	sync_data.ipx_routes = ipx_routes;
+	sync_data.ifindex = ifindex;
+	sync_data.success = TRUE;
+	nm_platform_transaction_begin (NM_PLATFORM_GET);
 
 	/***************************************************************************
 	 * Delete routes in platform, that no longer exist in @ipx_routes
@@ -478,22 +648,24 @@ _vx_route_sync (const VTableIP *vtable, NMRouteManager *self, int ifindex, const
 
 	/* iterate over @plat_routes and @ipx_routes */
 	cur_plat_route = _get_next_plat_route (plat_routes_idx, TRUE, &i_plat_routes);
-	cur_ipx_route = _get_next_ipx_route (ipx_routes->index, TRUE, &i_ipx_routes, ifindex);
+	ipx_iter = _route_entries_view_begin (ipx_routes, ifindex);
+	cur_ipx_entry = _route_entry_at (ipx_iter);
 	while (cur_plat_route) {
 		int route_id_cmp_result = 0;
 
 		g_assert (cur_plat_route->rx.ifindex == ifindex);
 
-		_LOGT (vtable->vt->addr_family, "%3d: platform rt   #%u - %s", ifindex, i_ipx_routes, vtable->vt->route_to_string (cur_plat_route));
+		_LOGT (vtable->vt->addr_family, "%3d: platform rt   #%u - %s", ifindex, i_plat_routes, vtable->vt->route_to_string (cur_plat_route));
 
-		/* skip over @cur_ipx_route that are ordered before @cur_plat_route */
-		while (   cur_ipx_route
-		       && ((route_id_cmp_result = vtable->route_id_cmp (cur_ipx_route, cur_plat_route)) < 0)) {
-			cur_ipx_route = _get_next_ipx_route (ipx_routes->index, FALSE, &i_ipx_routes, ifindex);
+		/* skip over @cur_ipx_entry that are ordered before @cur_plat_route */
+		while (   cur_ipx_entry
+		       && ((route_id_cmp_result = vtable->route_id_cmp (&cur_ipx_entry->route, cur_plat_route)) < 0)) {
+			ipx_iter = g_sequence_iter_next (ipx_iter);
+			cur_ipx_entry = _route_entry_at (ipx_iter);
 		}
 
-		/* if @cur_ipx_route is not equal to @plat_route, the route must be deleted. */
-		if (!(cur_ipx_route && route_id_cmp_result == 0))
+		/* if @cur_ipx_entry is not equal to @plat_route, the route must be deleted. */
+		if (!(cur_ipx_entry && route_id_cmp_result == 0))
 			vtable->vt->route_delete (NM_PLATFORM_GET, ifindex, cur_plat_route);
 
 		cur_plat_route = _get_next_plat_route (plat_routes_idx, FALSE, &i_plat_routes);
@@ -528,11 +700,13 @@ _vx_route_sync (const VTableIP *vtable, NMRouteManager *self, int ifindex, const
 	for (i_type = 0; i_type < 2; i_type++) {
 		/* iterate (twice) over @ipx_routes and @plat_routes */
 		cur_plat_route = _get_next_plat_route (plat_routes_idx, TRUE, &i_plat_routes);
-		cur_ipx_route = _get_next_ipx_route (ipx_routes->index, TRUE, &i_ipx_routes, ifindex);
 		/* Iterate here over @ipx_routes instead of @known_routes. That is done because
 		 * we need to know whether a route is shadowed by another route, and that
 		 * requires to look at @ipx_routes. */
-		for (; cur_ipx_route; cur_ipx_route = _get_next_ipx_route (ipx_routes->index, FALSE, &i_ipx_routes, ifindex)) {
+		for (ipx_iter = _route_entries_view_begin (ipx_routes, ifindex);
+		     (cur_ipx_entry = _route_entry_at (ipx_iter));
+		     ipx_iter = g_sequence_iter_next (ipx_iter)) {
+			const NMPlatformIPXRoute *cur_ipx_route = &cur_ipx_entry->route;
 			int route_id_cmp_result = -1;
 
 			if (   (i_type == 0 && !VTABLE_IS_DEVICE_ROUTE (vtable, cur_ipx_route))
@@ -542,8 +716,9 @@ _vx_route_sync (const VTableIP *vtable, NMRouteManager *self, int ifindex, const
 				continue;
 			}
 
-			if (   i_ipx_routes > 0
-			    && vtable->route_id_cmp (cur_ipx_route, ipx_routes->index->entries[i_ipx_routes - 1]) == 0) {
+			if (   !g_sequence_iter_is_begin (cur_ipx_entry->iter)
+			    && vtable->route_id_cmp (cur_ipx_route,
+			                             &((RouteEntry *) g_sequence_get (g_sequence_iter_prev (cur_ipx_entry->iter)))->route) == 0) {
 				/* @cur_ipx_route is shadewed by another route. */
 				continue;
 			}
@@ -558,26 +733,22 @@ _vx_route_sync (const VTableIP *vtable, NMRouteManager *self, int ifindex, const
 			if (   !cur_plat_route
 			    || route_id_cmp_result != 0
 			    || !_route_equals_ignoring_ifindex (vtable, cur_plat_route, cur_ipx_route)) {
-				gboolean s;
-
-				s = vtable->vt->route_add (NM_PLATFORM_GET, ifindex, cur_ipx_route, 0);
-				if (!s && cur_ipx_route->rx.source < NM_IP_CONFIG_SOURCE_USER) {
-					_LOGD (vtable->vt->addr_family, "ignore error adding IPv%c route to kernel: %s",
-					       vtable->vt->is_ip4 ? '4' : '6',
-					       vtable->vt->route_to_string (cur_ipx_route));
-					/* Remember that there was a failure, but for now continue trying to sync the
-					 * remaining routes. */
-					success = FALSE;
-				}
+				/* Within the transaction, platform may only report the failure
+				 * on commit. */
+				if (!vtable->vt->route_add (NM_PLATFORM_GET, ifindex, cur_ipx_route, 0))
+					_route_add_failed (&sync_data, cur_ipx_route);
 			}
 		}
 	}
 
+	nm_platform_transaction_commit (NM_PLATFORM_GET, _route_sync_transaction_failed, &sync_data);
+
 	g_free (known_routes_idx);
 	g_free (plat_routes_idx);
 	g_array_unref (plat_routes);
 
-	return success;
+	nm_stats_probe_time (NM_STATS_PROBE_ROUTE_SYNC, start);
+	return sync_data.success;
 }
 
 /**
@@ -644,10 +815,8 @@ nm_route_manager_init (NMRouteManager *self)
 {
 	NMRouteManagerPrivate *priv = NM_ROUTE_MANAGER_GET_PRIVATE (self);
 
-	priv->ip4_routes.entries = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP4Route));
-	priv->ip6_routes.entries = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP6Route));
-	priv->ip4_routes.index = _route_index_create (&vtable_v4, priv->ip4_routes.entries);
-	priv->ip6_routes.index = _route_index_create (&vtable_v6, priv->ip6_routes.entries);
+	_route_entries_init (&priv->ip4_routes);
+	_route_entries_init (&priv->ip6_routes);
 }
 
 static void
@@ -655,10 +824,8 @@ finalize (GObject *object)
 {
 	NMRouteManagerPrivate *priv = NM_ROUTE_MANAGER_GET_PRIVATE (object);
 
-	g_array_free (priv->ip4_routes.entries, TRUE);
-	g_array_free (priv->ip6_routes.entries, TRUE);
-	g_free (priv->ip4_routes.index);
-	g_free (priv->ip6_routes.index);
+	_route_entries_clear (&priv->ip4_routes);
+	_route_entries_clear (&priv->ip6_routes);
 
 	G_OBJECT_CLASS (nm_route_manager_parent_class)->finalize (object);
 }
@@ -0,0 +1,630 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "nm-stats.h"
+#include "nm-dbus-manager.h"
+#include "nm-dbus-interface.h"
+#include "nm-dbus-glib-types.h"
+#include "nm-logging.h"
+#include "nm-core-internal.h"
+#include "NetworkManagerUtils.h"
+#include "gsystem-local-alloc.h"
+
+static gboolean impl_stats_get_activation_stats (NMStats *self,
+                                                 GPtrArray **out_stats,
+                                                 GError **error);
+
+static gboolean impl_stats_get_counters (NMStats *self,
+                                         GPtrArray **out_counters,
+                                         GError **error);
+
+static gboolean impl_stats_get_scheduler_stats (NMStats *self,
+                                                GPtrArray **out_stats,
+                                                GError **error);
+
+#include "nm-stats-glue.h"
+
+typedef struct {
+	NMStatsHistogram stages[_NM_STATS_STAGE_NUM];
+} DeviceTypeStats;
+
+typedef struct {
+	GHashTable *activation;  /* device type :: DeviceTypeStats */
+} NMStatsPrivate;
+
+#define NM_STATS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NM_TYPE_STATS, NMStatsPrivate))
+
+G_DEFINE_TYPE (NMStats, nm_stats, G_TYPE_OBJECT)
+
+NM_DEFINE_SINGLETON_GETTER (NMStats, nm_stats_get, NM_TYPE_STATS);
+
+/*****************************************************************************/
+
+static const char *stage_names[_NM_STATS_STAGE_NUM] = {
+	[NM_STATS_STAGE_PREPARE]           = "prepare",
+	[NM_STATS_STAGE_CONFIG]            = "config",
+	[NM_STATS_STAGE_NEED_AUTH]         = "need-auth",
+	[NM_STATS_STAGE_IP_CONFIG]         = "ip-config",
+	[NM_STATS_STAGE_IP_CHECK]          = "ip-check",
+	[NM_STATS_STAGE_SECONDARIES]       = "secondaries",
+	[NM_STATS_STAGE_FIREWALL]          = "firewall",
+	[NM_STATS_STAGE_IP4_CONFIG]        = "ip4-config",
+	[NM_STATS_STAGE_IP6_CONFIG]        = "ip6-config",
+	[NM_STATS_STAGE_DISPATCHER_PRE_UP] = "dispatcher-pre-up",
+	[NM_STATS_STAGE_TOTAL]             = "total",
+};
+
+const char *
+nm_stats_stage_to_string (NMStatsStage stage)
+{
+	g_return_val_if_fail (stage < _NM_STATS_STAGE_NUM, NULL);
+
+	return stage_names[stage];
+}
+
+static void
+histogram_add (NMStatsHistogram *histogram, gint64 duration_us, gint64 unit_us)
+{
+	gint64 units;
+	guint i = 0;
+
+	duration_us = MAX (duration_us, 0);
+	for (units = duration_us / unit_us; units > 0 && i < NM_STATS_HISTOGRAM_BUCKETS - 1; units >>= 1)
+		i++;
+
+	histogram->buckets[i]++;
+	histogram->count++;
+	histogram->total_us += duration_us;
+	histogram->max_us = MAX (histogram->max_us, duration_us);
+}
+
+void
+nm_stats_histogram_add (NMStatsHistogram *histogram, gint64 duration_us)
+{
+	g_return_if_fail (histogram);
+
+	histogram_add (histogram, duration_us, 1000);
+}
+
+/*****************************************************************************/
+
+static const char *probe_names[_NM_STATS_PROBE_NUM] = {
+	[NM_STATS_PROBE_NETLINK_EVENT]           = "netlink-event",
+	[NM_STATS_PROBE_NETLINK_EVENT_IGNORED]   = "netlink-event-ignored",
+	[NM_STATS_PROBE_PLATFORM_ANNOUNCE]       = "platform-announce",
+	[NM_STATS_PROBE_CACHE_REPOPULATE]        = "cache-repopulate",
+	[NM_STATS_PROBE_ROUTE_SYNC]              = "route-sync",
+	[NM_STATS_PROBE_DNS_UPDATE]              = "dns-update",
+	[NM_STATS_PROBE_SETTINGS_ADD_CONNECTION] = "settings-add-connection",
+	[NM_STATS_PROBE_MAINLOOP_ITERATION]      = "mainloop-iteration",
+	[NM_STATS_PROBE_MAINLOOP_STALL]          = "mainloop-stall",
+};
+
+static NMStatsHistogram probes[_NM_STATS_PROBE_NUM];
+
+/* interface :: guint64 number of method calls */
+static GHashTable *dbus_calls;
+
+/* What ran during the current main loop iteration, for the watchdog */
+static struct {
+	GPollFunc poll_func;
+	gint64 threshold_us;
+	gint64 iteration_start;
+	NMStatsProbe slowest_probe;
+	gint64 slowest_us;
+	char dbus_call[128];
+} watchdog;
+
+const char *
+nm_stats_probe_to_string (NMStatsProbe probe)
+{
+	g_return_val_if_fail (probe < _NM_STATS_PROBE_NUM, NULL);
+
+	return probe_names[probe];
+}
+
+/**
+ * nm_stats_probe_hit:
+ * @probe: the probe
+ *
+ * Counts one occurrence of @probe without timing it.
+ */
+void
+nm_stats_probe_hit (NMStatsProbe probe)
+{
+	g_return_if_fail (probe < _NM_STATS_PROBE_NUM);
+
+	probes[probe].count++;
+}
+
+/**
+ * nm_stats_probe_time:
+ * @probe: the probe
+ * @start_us: the value of nm_utils_get_monotonic_timestamp_us() when the
+ *   measured operation began
+ *
+ * Counts one occurrence of @probe and records how long it took.
+ */
+void
+nm_stats_probe_time (NMStatsProbe probe, gint64 start_us)
+{
+	gint64 duration;
+
+	g_return_if_fail (probe < _NM_STATS_PROBE_NUM);
+
+	duration = nm_utils_get_monotonic_timestamp_us () - start_us;
+	histogram_add (&probes[probe], duration, 1);
+
+	if (duration > watchdog.slowest_us) {
+		watchdog.slowest_probe = probe;
+		watchdog.slowest_us = duration;
+	}
+}
+
+const NMStatsHistogram *
+nm_stats_probe_get (NMStatsProbe probe)
+{
+	g_return_val_if_fail (probe < _NM_STATS_PROBE_NUM, NULL);
+
+	return &probes[probe];
+}
+
+void
+nm_stats_dbus_method_call (const char *interface, const char *member)
+{
+	guint64 *count;
+
+	if (!interface)
+		interface = "(none)";
+
+	if (G_UNLIKELY (!dbus_calls))
+		dbus_calls = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	count = g_hash_table_lookup (dbus_calls, interface);
+	if (!count) {
+		count = g_new0 (guint64, 1);
+		g_hash_table_insert (dbus_calls, g_strdup (interface), count);
+	}
+	(*count)++;
+
+	if (watchdog.threshold_us)
+		g_snprintf (watchdog.dbus_call, sizeof (watchdog.dbus_call), "%s.%s", interface, member ? member : "");
+}
+
+/*****************************************************************************/
+
+/* GLib has no hook around source dispatch, but the poll function is called
+ * once per main loop iteration. The time between poll() returning and the
+ * next call is what the dispatched callbacks took.
+ */
+static gint
+watchdog_poll (GPollFD *ufds, guint nfds, gint timeout)
+{
+	gint64 now = nm_utils_get_monotonic_timestamp_us ();
+	gint ret;
+
+	if (watchdog.iteration_start) {
+		gint64 busy = now - watchdog.iteration_start;
+
+		histogram_add (&probes[NM_STATS_PROBE_MAINLOOP_ITERATION], busy, 1);
+		if (busy >= watchdog.threshold_us) {
+			probes[NM_STATS_PROBE_MAINLOOP_STALL].count++;
+			nm_log_warn (LOGD_CORE, "stats: main loop was blocked for %" G_GINT64_FORMAT " ms"
+			             " (slowest instrumented operation: %s, %" G_GINT64_FORMAT " ms; last D-Bus call: %s)",
+			             busy / 1000,
+			             watchdog.slowest_us ? probe_names[watchdog.slowest_probe] : "none",
+			             watchdog.slowest_us / 1000,
+			             watchdog.dbus_call[0] ? watchdog.dbus_call : "none");
+		}
+	}
+
+	watchdog.slowest_us = 0;
+	watchdog.dbus_call[0] = '\0';
+
+	ret = watchdog.poll_func (ufds, nfds, timeout);
+
+	watchdog.iteration_start = nm_utils_get_monotonic_timestamp_us ();
+	return ret;
+}
+
+/**
+ * nm_stats_watchdog_start:
+ * @threshold_ms: log a warning whenever a single iteration of the default
+ *   main loop takes at least this long; 0 disables the watchdog
+ *
+ * Hooks into the poll function of the default #GMainContext to measure
+ * how long dispatching took in each main loop iteration.
+ */
+void
+nm_stats_watchdog_start (guint threshold_ms)
+{
+	g_return_if_fail (!watchdog.poll_func);
+
+	if (!threshold_ms)
+		return;
+
+	watchdog.threshold_us = (gint64) threshold_ms * 1000;
+	watchdog.poll_func = g_main_context_get_poll_func (NULL);
+	g_main_context_set_poll_func (NULL, watchdog_poll);
+
+	nm_log_dbg (LOGD_CORE, "stats: main loop watchdog threshold is %u ms", threshold_ms);
+}
+
+/**
+ * nm_stats_record_activation_stage:
+ * @self: the #NMStats
+ * @device_type: a description of the device type, as returned by
+ *   nm_device_get_type_desc()
+ * @stage: the activation phase that completed
+ * @duration_us: how long it took, in microseconds
+ */
+void
+nm_stats_record_activation_stage (NMStats *self,
+                                  const char *device_type,
+                                  NMStatsStage stage,
+                                  gint64 duration_us)
+{
+	NMStatsPrivate *priv;
+	DeviceTypeStats *stats;
+
+	g_return_if_fail (NM_IS_STATS (self));
+	g_return_if_fail (device_type);
+	g_return_if_fail (stage < _NM_STATS_STAGE_NUM);
+
+	priv = NM_STATS_GET_PRIVATE (self);
+	stats = g_hash_table_lookup (priv->activation, device_type);
+	if (!stats) {
+		stats = g_slice_new0 (DeviceTypeStats);
+		g_hash_table_insert (priv->activation, g_strdup (device_type), stats);
+	}
+
+	nm_stats_histogram_add (&stats->stages[stage], duration_us);
+}
+
+const NMStatsHistogram *
+nm_stats_get_activation_stage (NMStats *self,
+                               const char *device_type,
+                               NMStatsStage stage)
+{
+	DeviceTypeStats *stats;
+
+	g_return_val_if_fail (NM_IS_STATS (self), NULL);
+	g_return_val_if_fail (device_type, NULL);
+	g_return_val_if_fail (stage < _NM_STATS_STAGE_NUM, NULL);
+
+	stats = g_hash_table_lookup (NM_STATS_GET_PRIVATE (self)->activation, device_type);
+	return stats ? &stats->stages[stage] : NULL;
+}
+
+/*****************************************************************************/
+
+static void
+gvalue_destroy (gpointer data)
+{
+	GValue *value = (GValue *) data;
+
+	g_value_unset (value);
+	g_slice_free (GValue, value);
+}
+
+static void
+hash_insert_string (GHashTable *hash, const char *key, const char *str)
+{
+	GValue *val = g_slice_new0 (GValue);
+
+	g_value_init (val, G_TYPE_STRING);
+	g_value_set_string (val, str);
+	g_hash_table_insert (hash, (char *) key, val);
+}
+
+static void
+hash_insert_uint (GHashTable *hash, const char *key, guint num)
+{
+	GValue *val = g_slice_new0 (GValue);
+
+	g_value_init (val, G_TYPE_UINT);
+	g_value_set_uint (val, num);
+	g_hash_table_insert (hash, (char *) key, val);
+}
+
+static void
+hash_insert_uint64 (GHashTable *hash, const char *key, guint64 num)
+{
+	GValue *val = g_slice_new0 (GValue);
+
+	g_value_init (val, G_TYPE_UINT64);
+	g_value_set_uint64 (val, num);
+	g_hash_table_insert (hash, (char *) key, val);
+}
+
+static GHashTable *
+histogram_to_hash (const char *device_type, NMStatsStage stage, const NMStatsHistogram *histogram)
+{
+	GHashTable *hash;
+	GArray *buckets;
+	GValue *val;
+
+	hash = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, gvalue_destroy);
+	hash_insert_string (hash, "device-type", device_type);
+	hash_insert_string (hash, "stage", stage_names[stage]);
+	hash_insert_uint64 (hash, "count", histogram->count);
+	hash_insert_uint64 (hash, "total-ms", histogram->total_us / 1000);
+	hash_insert_uint64 (hash, "max-ms", histogram->max_us / 1000);
+
+	buckets = g_array_sized_new (FALSE, FALSE, sizeof (guint32), NM_STATS_HISTOGRAM_BUCKETS);
+	g_array_append_vals (buckets, histogram->buckets, NM_STATS_HISTOGRAM_BUCKETS);
+	val = g_slice_new0 (GValue);
+	g_value_init (val, DBUS_TYPE_G_UINT_ARRAY);
+	g_value_take_boxed (val, buckets);
+	g_hash_table_insert (hash, "buckets", val);
+
+	return hash;
+}
+
+static gboolean
+impl_stats_get_activation_stats (NMStats *self,
+                                 GPtrArray **out_stats,
+                                 GError **error)
+{
+	NMStatsPrivate *priv = NM_STATS_GET_PRIVATE (self);
+	GList *types, *iter;
+
+	*out_stats = g_ptr_array_new ();
+
+	types = g_list_sort (g_hash_table_get_keys (priv->activation), (GCompareFunc) strcmp);
+	for (iter = types; iter; iter = iter->next) {
+		const char *device_type = iter->data;
+		DeviceTypeStats *stats = g_hash_table_lookup (priv->activation, device_type);
+		guint i;
+
+		for (i = 0; i < _NM_STATS_STAGE_NUM; i++) {
+			if (stats->stages[i].count)
+				g_ptr_array_add (*out_stats, histogram_to_hash (device_type, i, &stats->stages[i]));
+		}
+	}
+	g_list_free (types);
+
+	return TRUE;
+}
+
+static GHashTable *
+probe_to_hash (const char *name, const NMStatsHistogram *histogram, gboolean timed)
+{
+	GHashTable *hash;
+	GArray *buckets;
+	GValue *val;
+
+	hash = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, gvalue_destroy);
+	hash_insert_string (hash, "name", name);
+	hash_insert_uint64 (hash, "count", histogram->count);
+	if (!timed)
+		return hash;
+
+	hash_insert_uint64 (hash, "total-us", histogram->total_us);
+	hash_insert_uint64 (hash, "max-us", histogram->max_us);
+
+	buckets = g_array_sized_new (FALSE, FALSE, sizeof (guint32), NM_STATS_HISTOGRAM_BUCKETS);
+	g_array_append_vals (buckets, histogram->buckets, NM_STATS_HISTOGRAM_BUCKETS);
+	val = g_slice_new0 (GValue);
+	g_value_init (val, DBUS_TYPE_G_UINT_ARRAY);
+	g_value_take_boxed (val, buckets);
+	g_hash_table_insert (hash, "buckets", val);
+
+	return hash;
+}
+
+static gboolean
+probe_is_timed (NMStatsProbe probe)
+{
+	return    probe != NM_STATS_PROBE_NETLINK_EVENT_IGNORED
+	       && probe != NM_STATS_PROBE_MAINLOOP_STALL;
+}
+
+static gboolean
+impl_stats_get_counters (NMStats *self,
+                         GPtrArray **out_counters,
+                         GError **error)
+{
+	guint i;
+
+	*out_counters = g_ptr_array_new ();
+
+	for (i = 0; i < _NM_STATS_PROBE_NUM; i++)
+		g_ptr_array_add (*out_counters, probe_to_hash (probe_names[i], &probes[i], probe_is_timed (i)));
+
+	if (dbus_calls) {
+		GHashTableIter iter;
+		const char *interface;
+		guint64 *count;
+
+		g_hash_table_iter_init (&iter, dbus_calls);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &interface, (gpointer *) &count)) {
+			gs_free char *name = g_strdup_printf ("dbus-call:%s", interface);
+			NMStatsHistogram histogram = { .count = *count };
+
+			g_ptr_array_add (*out_counters, probe_to_hash (name, &histogram, FALSE));
+		}
+	}
+
+	return TRUE;
+}
+
+/* The activation scheduler is not part of nm-iface-helper, which shares
+ * this file; NetworkManager hooks it up at startup. */
+static NMStatsSchedulerFunc scheduler_func;
+
+void
+nm_stats_set_scheduler_func (NMStatsSchedulerFunc func)
+{
+	scheduler_func = func;
+}
+
+static gboolean
+impl_stats_get_scheduler_stats (NMStats *self,
+                                GPtrArray **out_stats,
+                                GError **error)
+{
+	NMActivationSchedulerStats stats;
+	const char *name;
+	guint i;
+
+	*out_stats = g_ptr_array_new ();
+
+	for (i = 0; scheduler_func && scheduler_func (i, &name, &stats); i++) {
+		GHashTable *hash;
+
+		hash = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, gvalue_destroy);
+		hash_insert_string (hash, "resource", name);
+		hash_insert_uint (hash, "limit", stats.limit);
+		hash_insert_uint (hash, "in-flight", stats.in_flight);
+		hash_insert_uint (hash, "queued", stats.queue_depth);
+		hash_insert_uint (hash, "queued-max", stats.queue_depth_max);
+		hash_insert_uint64 (hash, "granted", stats.granted);
+		hash_insert_uint64 (hash, "wait-total-us", stats.wait_total_us);
+		hash_insert_uint64 (hash, "wait-max-us", stats.wait_max_us);
+		hash_insert_uint64 (hash, "hold-total-us", stats.hold_total_us);
+		hash_insert_uint64 (hash, "hold-max-us", stats.hold_max_us);
+		g_ptr_array_add (*out_stats, hash);
+	}
+
+	return TRUE;
+}
+
+/*****************************************************************************/
+
+/**
+ * nm_stats_log_dump:
+ * @reset: whether to clear the counters afterwards
+ *
+ * Logs all counters and histogram summaries at info level. Triggered by
+ * SIGUSR1 (dump) and SIGUSR2 (dump and reset).
+ */
+void
+nm_stats_log_dump (gboolean reset)
+{
+	guint i;
+
+	nm_log_info (LOGD_CORE, "stats: dumping counters%s", reset ? " (and resetting them)" : "");
+
+	for (i = 0; i < _NM_STATS_PROBE_NUM; i++) {
+		const NMStatsHistogram *h = &probes[i];
+
+		if (!probe_is_timed (i)) {
+			nm_log_info (LOGD_CORE, "stats: %s: %" G_GUINT64_FORMAT, probe_names[i], h->count);
+			continue;
+		}
+		nm_log_info (LOGD_CORE, "stats: %s: %" G_GUINT64_FORMAT " times, avg %" G_GINT64_FORMAT " us, max %" G_GINT64_FORMAT " us",
+		             probe_names[i], h->count,
+		             h->count ? h->total_us / (gint64) h->count : 0,
+		             h->max_us);
+	}
+
+	if (dbus_calls) {
+		GHashTableIter iter;
+		const char *interface;
+		guint64 *count;
+
+		g_hash_table_iter_init (&iter, dbus_calls);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &interface, (gpointer *) &count))
+			nm_log_info (LOGD_CORE, "stats: dbus-call:%s: %" G_GUINT64_FORMAT, interface, *count);
+	}
+
+	if (singleton_instance) {
+		NMStatsPrivate *priv = NM_STATS_GET_PRIVATE (singleton_instance);
+		GHashTableIter iter;
+		const char *device_type;
+		DeviceTypeStats *stats;
+
+		g_hash_table_iter_init (&iter, priv->activation);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &device_type, (gpointer *) &stats)) {
+			for (i = 0; i < _NM_STATS_STAGE_NUM; i++) {
+				const NMStatsHistogram *h = &stats->stages[i];
+
+				if (!h->count)
+					continue;
+				nm_log_info (LOGD_CORE, "stats: activation %s %s: %" G_GUINT64_FORMAT " times, avg %" G_GINT64_FORMAT " ms, max %" G_GINT64_FORMAT " ms",
+				             device_type, stage_names[i], h->count,
+				             h->total_us / (gint64) h->count / 1000,
+				             h->max_us / 1000);
+			}
+		}
+		if (reset)
+			g_hash_table_remove_all (priv->activation);
+	}
+
+	if (reset) {
+		memset (probes, 0, sizeof (probes));
+		if (dbus_calls)
+			g_hash_table_remove_all (dbus_calls);
+	}
+}
+
+/*****************************************************************************/
+
+static void
+device_type_stats_free (gpointer data)
+{
+	g_slice_free (DeviceTypeStats, data);
+}
+
+static void
+nm_stats_init (NMStats *self)
+{
+	NMStatsPrivate *priv = NM_STATS_GET_PRIVATE (self);
+
+	priv->activation = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, device_type_stats_free);
+}
+
+static void
+constructed (GObject *object)
+{
+	G_OBJECT_CLASS (nm_stats_parent_class)->constructed (object);
+
+	nm_dbus_manager_register_object (nm_dbus_manager_get (), NM_DBUS_PATH_STATS, object);
+}
+
+static void
+finalize (GObject *object)
+{
+	NMStatsPrivate *priv = NM_STATS_GET_PRIVATE (object);
+
+	g_hash_table_unref (priv->activation);
+
+	G_OBJECT_CLASS (nm_stats_parent_class)->finalize (object);
+}
+
+static void
+nm_stats_class_init (NMStatsClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	g_type_class_add_private (klass, sizeof (NMStatsPrivate));
+
+	object_class->constructed = constructed;
+	object_class->finalize = finalize;
+
+	nm_dbus_manager_register_exported_type (nm_dbus_manager_get (),
+	                                        G_TYPE_FROM_CLASS (klass),
+	                                        &dbus_glib_nm_stats_object_info);
+}
@@ -0,0 +1,135 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#ifndef __NETWORKMANAGER_STATS_H__
+#define __NETWORKMANAGER_STATS_H__
+
+#include <glib-object.h>
+
+#include "nm-types.h"
+#include "nm-activation-scheduler.h"
+
+#define NM_TYPE_STATS            (nm_stats_get_type ())
+#define NM_STATS(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), NM_TYPE_STATS, NMStats))
+#define NM_STATS_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), NM_TYPE_STATS, NMStatsClass))
+#define NM_IS_STATS(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), NM_TYPE_STATS))
+#define NM_IS_STATS_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), NM_TYPE_STATS))
+#define NM_STATS_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), NM_TYPE_STATS, NMStatsClass))
+
+struct _NMStats {
+	GObject parent;
+};
+
+typedef struct {
+	GObjectClass parent;
+} NMStatsClass;
+
+/* Phases of a device activation whose duration is recorded. The first
+ * ones correspond to the time spent in the device state of the same name;
+ * the others measure specific waits that overlap with those states.
+ */
+typedef enum {
+	NM_STATS_STAGE_PREPARE,
+	NM_STATS_STAGE_CONFIG,
+	NM_STATS_STAGE_NEED_AUTH,
+	NM_STATS_STAGE_IP_CONFIG,
+	NM_STATS_STAGE_IP_CHECK,
+	NM_STATS_STAGE_SECONDARIES,
+	NM_STATS_STAGE_FIREWALL,          /* zone change, including queueing */
+	NM_STATS_STAGE_IP4_CONFIG,        /* stage 3 start to IPv4 commit */
+	NM_STATS_STAGE_IP6_CONFIG,        /* stage 3 start to IPv6 commit */
+	NM_STATS_STAGE_DISPATCHER_PRE_UP,
+	NM_STATS_STAGE_TOTAL,             /* PREPARE to ACTIVATED */
+
+	_NM_STATS_STAGE_NUM,
+} NMStatsStage;
+
+/* Bucket 0 counts durations below 1 ms, bucket i durations in
+ * [2^(i-1), 2^i) ms and the last bucket everything longer.
+ */
+#define NM_STATS_HISTOGRAM_BUCKETS 20
+
+typedef struct {
+	guint64 count;
+	gint64 total_us;
+	gint64 max_us;
+	guint32 buckets[NM_STATS_HISTOGRAM_BUCKETS];
+} NMStatsHistogram;
+
+void nm_stats_histogram_add (NMStatsHistogram *histogram, gint64 duration_us);
+
+/* Hot paths instrumented with a counter and, where timed, a latency
+ * histogram. Unlike the activation histograms these use microsecond
+ * buckets: bucket i counts durations in [2^(i-1), 2^i) us.
+ *
+ * Probes don't need the NMStats singleton and can be hit from code that
+ * is shared with nm-iface-helper.
+ */
+typedef enum {
+	NM_STATS_PROBE_NETLINK_EVENT,
+	NM_STATS_PROBE_NETLINK_EVENT_IGNORED,  /* collapsed or no-op events, count only */
+	NM_STATS_PROBE_PLATFORM_ANNOUNCE,
+	NM_STATS_PROBE_CACHE_REPOPULATE,
+	NM_STATS_PROBE_ROUTE_SYNC,
+	NM_STATS_PROBE_DNS_UPDATE,
+	NM_STATS_PROBE_SETTINGS_ADD_CONNECTION,
+	NM_STATS_PROBE_MAINLOOP_ITERATION,
+	NM_STATS_PROBE_MAINLOOP_STALL,         /* iterations above the watchdog threshold */
+
+	_NM_STATS_PROBE_NUM,
+} NMStatsProbe;
+
+const char *nm_stats_probe_to_string (NMStatsProbe probe);
+
+void nm_stats_probe_hit (NMStatsProbe probe);
+void nm_stats_probe_time (NMStatsProbe probe, gint64 start_us);
+
+const NMStatsHistogram *nm_stats_probe_get (NMStatsProbe probe);
+
+void nm_stats_dbus_method_call (const char *interface, const char *member);
+
+void nm_stats_watchdog_start (guint threshold_ms);
+
+void nm_stats_log_dump (gboolean reset);
+
+/* Reports the statistics of the activation scheduler's @resource; returns
+ * %FALSE once @resource is past the last one. */
+typedef gboolean (*NMStatsSchedulerFunc) (guint resource,
+                                          const char **out_name,
+                                          NMActivationSchedulerStats *out_stats);
+
+void nm_stats_set_scheduler_func (NMStatsSchedulerFunc func);
+
+GType nm_stats_get_type (void);
+
+NMStats *nm_stats_get (void);
+
+const char *nm_stats_stage_to_string (NMStatsStage stage);
+
+void nm_stats_record_activation_stage (NMStats *self,
+                                       const char *device_type,
+                                       NMStatsStage stage,
+                                       gint64 duration_us);
+
+const NMStatsHistogram *nm_stats_get_activation_stage (NMStats *self,
+                                                       const char *device_type,
+                                                       NMStatsStage stage);
+
+#endif /* __NETWORKMANAGER_STATS_H__ */
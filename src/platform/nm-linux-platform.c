@@ -21,6 +21,7 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <fcntl.h>
 #include <dlfcn.h>
@@ -61,12 +62,21 @@
 #include "NetworkManagerUtils.h"
 #include "nm-utils.h"
 #include "nm-logging.h"
+#include "nm-stats.h"
 #include "wifi/wifi-utils.h"
 #include "wifi/wifi-utils-wext.h"
 
 /* This is only included for the translation of VLAN flags */
 #include "nm-setting-vlan.h"
 
+#ifndef SOL_NETLINK
+#define SOL_NETLINK 270
+#endif
+
+#ifndef NETLINK_CAP_ACK
+#define NETLINK_CAP_ACK 10
+#endif
+
 #define debug(...) nm_log_dbg (LOGD_PLATFORM, __VA_ARGS__)
 #define warning(...) nm_log_warn (LOGD_PLATFORM, __VA_ARGS__)
 #define error(...) nm_log_err (LOGD_PLATFORM, __VA_ARGS__)
@@ -300,19 +310,15 @@ ethtool_get (const char *name, gpointer edata)
 	strncpy (ifr.ifr_name, name, IFNAMSIZ);
 	ifr.ifr_data = edata;
 
-	fd = socket (PF_INET, SOCK_DGRAM, 0);
-	if (fd < 0) {
-		error ("ethtool: Could not open socket.");
+	fd = nm_platform_ioctl_socket ();
+	if (fd < 0)
 		return FALSE;
-	}
 
 	if (ioctl (fd, SIOCETHTOOL, &ifr) < 0) {
 		debug ("ethtool: Request failed: %s", strerror (errno));
-		close (fd);
 		return FALSE;
 	}
 
-	close (fd);
 	return TRUE;
 }
 
@@ -471,6 +477,22 @@ typedef struct {
 	GUdevClient *udev_client;
 	GHashTable *udev_devices;
 
+	GHashTable *link_type_info;
+
+	GHashTable *ip6_devconf;
+	GHashTable *ip6_conf_dirs;
+
+	GHashTable *link_stats;
+
+	/* ifindex -> RouteIndexEntry */
+	GHashTable *route_index;
+	struct _RouteIndexEntry *route_index_default;
+
+	/* While a transaction is open: the queued TransactionOp and the
+	 * TransactionRefresh to reconcile on commit. */
+	GArray *transaction_ops;
+	GArray *transaction_refresh;
+
 	GHashTable *wifi_data;
 
 	int support_kernel_extended_ifa_flags;
@@ -949,41 +971,111 @@ link_extract_type (NMPlatform *platform, struct rtnl_link *rtnllink, const char
 	return_type (NM_LINK_TYPE_UNKNOWN, type);
 }
 
-static gboolean
-init_link (NMPlatform *platform, NMPlatformLink *info, struct rtnl_link *rtnllink)
+/* Determining the type and driver of a link is expensive: it may take
+ * ethtool ioctls, walking the udev parents or reading sysfs. The results
+ * are remembered per ifindex and only recomputed when one of their inputs
+ * changes.
+ */
+typedef struct {
+	char name[IFNAMSIZ];
+	const char *kind;          /* interned rtnl_link_get_type() */
+	int arptype;
+	GUdevDevice *udev_device;
+
+	NMLinkType type;
+	const char *type_name;     /* interned */
+	const char *driver;        /* interned */
+} LinkTypeInfo;
+
+static void
+link_type_info_free (LinkTypeInfo *info)
+{
+	g_clear_object (&info->udev_device);
+	g_slice_free (LinkTypeInfo, info);
+}
+
+static const LinkTypeInfo *
+link_get_type_info (NMPlatform *platform, struct rtnl_link *rtnllink)
 {
 	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	int ifindex = rtnl_link_get_ifindex (rtnllink);
+	const char *name = rtnl_link_get_name (rtnllink);
+	const char *kind = rtnl_link_get_type (rtnllink);
+	int arptype = rtnl_link_get_arptype (rtnllink);
 	GUdevDevice *udev_device;
+	LinkTypeInfo *info;
+	const char *type_name = NULL;
+
+	udev_device = g_hash_table_lookup (priv->udev_devices, GINT_TO_POINTER (ifindex));
+
+	info = g_hash_table_lookup (priv->link_type_info, GINT_TO_POINTER (ifindex));
+	if (   info
+	    && info->arptype == arptype
+	    && info->udev_device == udev_device
+	    && !g_strcmp0 (info->kind, kind)
+	    && !strcmp (info->name, name ? name : ""))
+		return info;
+
+	if (!info) {
+		info = g_slice_new0 (LinkTypeInfo);
+		g_hash_table_insert (priv->link_type_info, GINT_TO_POINTER (ifindex), info);
+	} else
+		g_clear_object (&info->udev_device);
+
+	g_strlcpy (info->name, name ? name : "", sizeof (info->name));
+	info->kind = g_intern_string (kind);
+	info->arptype = arptype;
+	info->udev_device = udev_device ? g_object_ref (udev_device) : NULL;
+
+	info->type = link_extract_type (platform, rtnllink, &type_name);
+	info->type_name = g_intern_string (type_name);
+
+	info->driver = NULL;
+	if (udev_device) {
+		info->driver = udev_get_driver (udev_device, ifindex);
+		if (!info->driver)
+			info->driver = info->kind;
+		if (!info->driver && name)
+			info->driver = ethtool_get_driver (name);
+		if (!info->driver)
+			info->driver = "unknown";
+	}
+
+	return info;
+}
+
+static gboolean
+init_link (NMPlatform *platform, NMPlatformLink *info, struct rtnl_link *rtnllink)
+{
+	const LinkTypeInfo *type_info;
 	const char *name;
+	guint flags;
 
 	g_return_val_if_fail (rtnllink, FALSE);
 
 	name = rtnl_link_get_name (rtnllink);
 	memset (info, 0, sizeof (*info));
 
+	type_info = link_get_type_info (platform, rtnllink);
+	flags = rtnl_link_get_flags (rtnllink);
+
 	info->ifindex = rtnl_link_get_ifindex (rtnllink);
 	if (name)
 		g_strlcpy (info->name, name, sizeof (info->name));
 	else
 		info->name[0] = '\0';
-	info->type = link_extract_type (platform, rtnllink, &info->type_name);
-	info->up = !!(rtnl_link_get_flags (rtnllink) & IFF_UP);
-	info->connected = !!(rtnl_link_get_flags (rtnllink) & IFF_LOWER_UP);
-	info->arp = !(rtnl_link_get_flags (rtnllink) & IFF_NOARP);
+	info->type = type_info->type;
+	info->type_name = type_info->type_name;
+	info->up = !!(flags & IFF_UP);
+	info->connected = !!(flags & IFF_LOWER_UP);
+	info->arp = !(flags & IFF_NOARP);
 	info->master = rtnl_link_get_master (rtnllink);
 	info->parent = rtnl_link_get_link (rtnllink);
 	info->mtu = rtnl_link_get_mtu (rtnllink);
 
-	udev_device = g_hash_table_lookup (priv->udev_devices, GINT_TO_POINTER (info->ifindex));
-	if (udev_device) {
-		info->driver = udev_get_driver (udev_device, info->ifindex);
-		if (!info->driver)
-			info->driver = g_intern_string (rtnl_link_get_type (rtnllink));
-		if (!info->driver)
-			info->driver = ethtool_get_driver (info->name);
-		if (!info->driver)
-			info->driver = "unknown";
-		info->udi = g_udev_device_get_sysfs_path (udev_device);
+	if (type_info->udev_device) {
+		info->driver = type_info->driver;
+		info->udi = g_udev_device_get_sysfs_path (type_info->udev_device);
 	}
 
 	return TRUE;
@@ -1481,6 +1573,212 @@ choose_cache (NMPlatform *platform, struct nl_object *object)
 	return choose_cache_by_type (platform, _nlo_get_object_type (object));
 }
 
+/******************************************************************/
+
+/* The routes of route_cache grouped by the interface of their (single)
+ * nexthop, in the same order as in the cache. This lets lookups that are
+ * scoped to one interface avoid walking the routes of all interfaces.
+ * Routes with multiple nexthops never match an ifindex and aren't indexed.
+ * The default routes of all interfaces are indexed separately, for the
+ * lookups of the default-route manager.
+ */
+typedef struct _RouteIndexEntry {
+	GQueue objects;
+	GHashTable *links;    /* struct nl_object * -> GList * in @objects */
+} RouteIndexEntry;
+
+static RouteIndexEntry *
+route_index_entry_new (void)
+{
+	RouteIndexEntry *entry;
+
+	entry = g_slice_new0 (RouteIndexEntry);
+	g_queue_init (&entry->objects);
+	entry->links = g_hash_table_new (NULL, NULL);
+	return entry;
+}
+
+static void
+route_index_entry_add (RouteIndexEntry *entry, struct nl_object *object)
+{
+	if (g_hash_table_contains (entry->links, object))
+		return;
+
+	nl_object_get (object);
+	g_queue_push_tail (&entry->objects, object);
+	g_hash_table_insert (entry->links, object, entry->objects.tail);
+}
+
+static void
+route_index_entry_remove (RouteIndexEntry *entry, struct nl_object *object)
+{
+	GList *link;
+
+	link = g_hash_table_lookup (entry->links, object);
+	if (!link)
+		return;
+
+	g_hash_table_remove (entry->links, object);
+	g_queue_delete_link (&entry->objects, link);
+	nl_object_put (object);
+}
+
+static void
+route_index_entry_clear (RouteIndexEntry *entry)
+{
+	g_queue_foreach (&entry->objects, (GFunc) nl_object_put, NULL);
+	g_queue_clear (&entry->objects);
+	g_hash_table_remove_all (entry->links);
+}
+
+static void
+route_index_entry_free (gpointer data)
+{
+	RouteIndexEntry *entry = data;
+
+	route_index_entry_clear (entry);
+	g_hash_table_unref (entry->links);
+	g_slice_free (RouteIndexEntry, entry);
+}
+
+static int
+route_index_get_ifindex (struct nl_object *object)
+{
+	struct rtnl_route *rtnlroute = (struct rtnl_route *) object;
+
+	if (rtnl_route_get_nnexthops (rtnlroute) != 1)
+		return 0;
+	return rtnl_route_nh_get_ifindex (rtnl_route_nexthop_n (rtnlroute, 0));
+}
+
+static void
+route_index_add (NMLinuxPlatformPrivate *priv, struct nl_object *object)
+{
+	RouteIndexEntry *entry;
+	int ifindex;
+
+	if (_rtnl_route_is_default ((struct rtnl_route *) object))
+		route_index_entry_add (priv->route_index_default, object);
+
+	ifindex = route_index_get_ifindex (object);
+	if (ifindex <= 0)
+		return;
+
+	entry = g_hash_table_lookup (priv->route_index, GINT_TO_POINTER (ifindex));
+	if (!entry) {
+		entry = route_index_entry_new ();
+		g_hash_table_insert (priv->route_index, GINT_TO_POINTER (ifindex), entry);
+	}
+	route_index_entry_add (entry, object);
+}
+
+static void
+route_index_remove (NMLinuxPlatformPrivate *priv, struct nl_object *object)
+{
+	RouteIndexEntry *entry;
+	int ifindex;
+
+	route_index_entry_remove (priv->route_index_default, object);
+
+	ifindex = route_index_get_ifindex (object);
+	if (ifindex <= 0)
+		return;
+
+	entry = g_hash_table_lookup (priv->route_index, GINT_TO_POINTER (ifindex));
+	if (!entry)
+		return;
+
+	route_index_entry_remove (entry, object);
+	if (g_queue_is_empty (&entry->objects))
+		g_hash_table_remove (priv->route_index, GINT_TO_POINTER (ifindex));
+}
+
+static void
+route_index_rebuild (NMLinuxPlatformPrivate *priv)
+{
+	struct nl_object *object;
+
+	g_hash_table_remove_all (priv->route_index);
+	route_index_entry_clear (priv->route_index_default);
+	for (object = nl_cache_get_first (priv->route_cache); object; object = nl_cache_get_next (object))
+		route_index_add (priv, object);
+}
+
+typedef struct {
+	gboolean indexed;
+	GList *link;
+	struct nl_cache *cache;
+	struct nl_object *object;
+} RouteCacheIter;
+
+/* Iterates the cached routes whose nexthop is @ifindex, or all cached
+ * routes if @ifindex is 0. With @only_default, the iteration may skip
+ * routes that are not default routes, but callers still have to check.
+ * The cache must not change while iterating. */
+static void
+route_cache_iter_init (RouteCacheIter *iter, NMLinuxPlatformPrivate *priv, int ifindex, gboolean only_default)
+{
+	memset (iter, 0, sizeof (*iter));
+	if (ifindex > 0) {
+		RouteIndexEntry *entry = g_hash_table_lookup (priv->route_index, GINT_TO_POINTER (ifindex));
+
+		iter->indexed = TRUE;
+		iter->link = entry ? entry->objects.head : NULL;
+	} else if (only_default) {
+		iter->indexed = TRUE;
+		iter->link = priv->route_index_default->objects.head;
+	} else
+		iter->cache = priv->route_cache;
+}
+
+static struct nl_object *
+route_cache_iter_next (RouteCacheIter *iter)
+{
+	if (iter->indexed) {
+		struct nl_object *object;
+
+		if (!iter->link)
+			return NULL;
+		object = iter->link->data;
+		iter->link = iter->link->next;
+		return object;
+	}
+
+	if (iter->cache) {
+		iter->object = nl_cache_get_first (iter->cache);
+		iter->cache = NULL;
+	} else if (iter->object)
+		iter->object = nl_cache_get_next (iter->object);
+	return iter->object;
+}
+
+/* Wrappers around nl_cache_add() and nl_cache_remove() that keep the
+ * route index up to date. */
+static int
+cache_add (NMLinuxPlatformPrivate *priv, struct nl_cache *cache, struct nl_object *object)
+{
+	int nle;
+
+	nle = nl_cache_add (cache, object);
+	if (!nle && cache == priv->route_cache) {
+		/* nl_cache_add() adds a clone if @object already belongs to another
+		 * cache. Then we don't know the added object and must start over. */
+		if (nl_object_get_cache (object) == cache)
+			route_index_add (priv, object);
+		else
+			route_index_rebuild (priv);
+	}
+	return nle;
+}
+
+static void
+cache_remove (NMLinuxPlatformPrivate *priv, struct nl_object *object)
+{
+	if (nl_object_get_cache (object) == priv->route_cache)
+		route_index_remove (priv, object);
+	nl_cache_remove (object);
+}
+
 static gboolean
 object_has_ifindex (struct nl_object *object, int ifindex)
 {
@@ -1506,20 +1804,33 @@ object_has_ifindex (struct nl_object *object, int ifindex)
 }
 
 static gboolean refresh_object (NMPlatform *platform, struct nl_object *object, gboolean removed, NMPlatformReason reason);
+static void link_msg_handle (NMLinuxPlatformPrivate *priv, struct nl_msg *msg);
 
 static void
 check_cache_items (NMPlatform *platform, struct nl_cache *cache, int ifindex)
 {
-	auto_nl_cache struct nl_cache *cloned_cache = nl_cache_clone (cache);
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
 	struct nl_object *object;
 	GPtrArray *objects_to_refresh = g_ptr_array_new_with_free_func ((GDestroyNotify) nl_object_put);
 	guint i;
 
-	for (object = nl_cache_get_first (cloned_cache); object; object = nl_cache_get_next (object)) {
-		if (object_has_ifindex (object, ifindex)) {
+	if (cache == priv->route_cache && ifindex > 0) {
+		RouteCacheIter iter;
+
+		route_cache_iter_init (&iter, priv, ifindex, FALSE);
+		while ((object = route_cache_iter_next (&iter))) {
 			nl_object_get (object);
 			g_ptr_array_add (objects_to_refresh, object);
 		}
+	} else {
+		auto_nl_cache struct nl_cache *cloned_cache = nl_cache_clone (cache);
+
+		for (object = nl_cache_get_first (cloned_cache); object; object = nl_cache_get_next (object)) {
+			if (object_has_ifindex (object, ifindex)) {
+				nl_object_get (object);
+				g_ptr_array_add (objects_to_refresh, object);
+			}
+		}
 	}
 
 	for (i = 0; i < objects_to_refresh->len; i++)
@@ -1529,7 +1840,7 @@ check_cache_items (NMPlatform *platform, struct nl_cache *cache, int ifindex)
 }
 
 static void
-announce_object (NMPlatform *platform, const struct nl_object *object, NMPlatformSignalChangeType change_type, NMPlatformReason reason)
+_announce_object (NMPlatform *platform, const struct nl_object *object, NMPlatformSignalChangeType change_type, NMPlatformReason reason)
 {
 	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
 	ObjectType object_type = _nlo_get_object_type (object);
@@ -1587,6 +1898,7 @@ announce_object (NMPlatform *platform, const struct nl_object *object, NMPlatfor
 				check_cache_items (platform, priv->address_cache, device.ifindex);
 				check_cache_items (platform, priv->route_cache, device.ifindex);
 				g_hash_table_remove (priv->wifi_data, GINT_TO_POINTER (device.ifindex));
+				g_hash_table_remove (priv->link_type_info, GINT_TO_POINTER (device.ifindex));
 				break;
 			default:
 				break;
@@ -1669,20 +1981,36 @@ announce_object (NMPlatform *platform, const struct nl_object *object, NMPlatfor
 	}
 }
 
+static void
+announce_object (NMPlatform *platform, const struct nl_object *object, NMPlatformSignalChangeType change_type, NMPlatformReason reason)
+{
+	gint64 start = nm_utils_get_monotonic_timestamp_us ();
+
+	_announce_object (platform, object, change_type, reason);
+	nm_stats_probe_time (NM_STATS_PROBE_PLATFORM_ANNOUNCE, start);
+}
+
 static struct nl_object * build_rtnl_link (int ifindex, const char *name, NMLinkType type);
 
+static gboolean refresh_object (NMPlatform *platform, struct nl_object *object, gboolean removed, NMPlatformReason reason);
+
+/* Updates the cache entry of @object to @kernel_object, which is what the
+ * kernel currently has (or %NULL if it has nothing) and must not belong to
+ * a cache. */
 static gboolean
-refresh_object (NMPlatform *platform, struct nl_object *object, gboolean removed, NMPlatformReason reason)
+refresh_object_from_kernel (NMPlatform *platform,
+                            struct nl_object *object,
+                            struct nl_object *kernel_object,
+                            gboolean removed,
+                            NMPlatformReason reason)
 {
 	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
 	auto_nl_object struct nl_object *cached_object = NULL;
-	auto_nl_object struct nl_object *kernel_object = NULL;
 	struct nl_cache *cache;
 	int nle;
 
 	cache = choose_cache (platform, object);
 	cached_object = nm_nl_cache_search (cache, object);
-	kernel_object = get_kernel_object (priv->nlh, object);
 
 	if (removed) {
 		if (kernel_object)
@@ -1690,7 +2018,7 @@ refresh_object (NMPlatform *platform, struct nl_object *object, gboolean removed
 
 		/* Only announce object if it was still in the cache. */
 		if (cached_object) {
-			nl_cache_remove (cached_object);
+			cache_remove (priv, cached_object);
 
 			announce_object (platform, cached_object, NM_PLATFORM_SIGNAL_REMOVED, reason);
 		}
@@ -1707,8 +2035,8 @@ refresh_object (NMPlatform *platform, struct nl_object *object, gboolean removed
 		hack_empty_master_iff_lower_up (platform, kernel_object);
 
 		if (cached_object)
-			nl_cache_remove (cached_object);
-		nle = nl_cache_add (cache, kernel_object);
+			cache_remove (priv, cached_object);
+		nle = cache_add (priv, cache, kernel_object);
 		if (nle) {
 			nm_log_dbg (LOGD_PLATFORM, "refresh_object(reason %d) failed during nl_cache_add with %d", reason, nle);
 			return FALSE;
@@ -1738,6 +2066,464 @@ refresh_object (NMPlatform *platform, struct nl_object *object, gboolean removed
 	return TRUE;
 }
 
+static gboolean
+refresh_object (NMPlatform *platform, struct nl_object *object, gboolean removed, NMPlatformReason reason)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	auto_nl_object struct nl_object *kernel_object = NULL;
+
+	kernel_object = get_kernel_object (priv->nlh, object);
+	return refresh_object_from_kernel (platform, object, kernel_object, removed, reason);
+}
+
+/******************************************************************/
+
+/* Address and route changes made inside nm_platform_transaction_begin()
+ * and nm_platform_transaction_commit() are only queued. The commit sends
+ * the requests back to back, with as few sendmsg() calls as the socket
+ * buffers allow, then reads the ACKs and updates the cache from a single
+ * dump per object type -- instead of one request/ACK round trip and one
+ * full dump per change.
+ *
+ * All ACKs of a batch must fit into the receive buffer of the request
+ * socket, or the kernel drops them. Batches are therefore limited in the
+ * number of requests as well; should ACKs get lost anyway, the kernel is
+ * asked whether the requests took effect. */
+
+#define TRANSACTION_BATCH_SIZE      32768
+#define TRANSACTION_BATCH_REQUESTS  64
+#define TRANSACTION_RCVBUF_SIZE     131072
+#define TRANSACTION_PENDING         1
+
+typedef struct {
+	struct nl_object *object;
+	struct nl_msg *msg;
+	gboolean add;
+	guint32 seq;
+	int nle;
+} TransactionOp;
+
+typedef struct {
+	struct nl_object *object;
+	gboolean removed;
+} TransactionRefresh;
+
+static void
+transaction_op_clear (TransactionOp *op)
+{
+	nl_object_put (op->object);
+	nlmsg_free (op->msg);
+}
+
+static void
+transaction_refresh_clear (TransactionRefresh *refresh)
+{
+	nl_object_put (refresh->object);
+}
+
+static gboolean
+transaction_accepts (NMLinuxPlatformPrivate *priv, struct nl_object *object)
+{
+	if (!priv->transaction_ops)
+		return FALSE;
+
+	switch (_nlo_get_object_type (object)) {
+	case OBJECT_TYPE_IP4_ADDRESS:
+	case OBJECT_TYPE_IP6_ADDRESS:
+	case OBJECT_TYPE_IP4_ROUTE:
+	case OBJECT_TYPE_IP6_ROUTE:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static void
+transaction_queue_refresh (NMLinuxPlatformPrivate *priv, struct nl_object *object, gboolean removed)
+{
+	TransactionRefresh refresh;
+
+	refresh.object = object;
+	refresh.removed = removed;
+	nl_object_get (object);
+	g_array_append_val (priv->transaction_refresh, refresh);
+}
+
+static gboolean
+transaction_queue (NMPlatform *platform, struct nl_object *object, gboolean add, gboolean do_refresh_object)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	TransactionOp op = { 0 };
+	int nle;
+
+	switch (_nlo_get_object_type (object)) {
+	case OBJECT_TYPE_IP4_ADDRESS:
+	case OBJECT_TYPE_IP6_ADDRESS:
+		if (add)
+			nle = rtnl_addr_build_add_request ((struct rtnl_addr *) object, NLM_F_CREATE | NLM_F_REPLACE, &op.msg);
+		else
+			nle = rtnl_addr_build_delete_request ((struct rtnl_addr *) object, 0, &op.msg);
+		break;
+	case OBJECT_TYPE_IP4_ROUTE:
+	case OBJECT_TYPE_IP6_ROUTE:
+		if (add)
+			nle = rtnl_route_build_add_request ((struct rtnl_route *) object, NLM_F_CREATE | NLM_F_REPLACE, &op.msg);
+		else
+			nle = rtnl_route_build_del_request ((struct rtnl_route *) object, 0, &op.msg);
+		break;
+	default:
+		g_return_val_if_reached (FALSE);
+	}
+
+	if (nle) {
+		error ("Netlink error %s %s: %s", add ? "adding" : "deleting",
+		       to_string_object (platform, object), nl_geterror (nle));
+		return FALSE;
+	}
+
+	op.object = object;
+	op.add = add;
+	op.nle = TRANSACTION_PENDING;
+	nl_object_get (object);
+	g_array_append_val (priv->transaction_ops, op);
+
+	if (do_refresh_object)
+		transaction_queue_refresh (priv, object, !add);
+	return TRUE;
+}
+
+/* Deleting an object that is already gone is not an error. */
+static gboolean
+delete_object_already_gone (ObjectType object_type, int nle)
+{
+	switch (nle) {
+	case -NLE_OBJ_NOTFOUND:
+		return TRUE;
+	case -NLE_FAILURE:
+		/* On RHEL7 kernel, deleting a non existing address fails with ENXIO (which libnl maps to NLE_FAILURE) */
+		return object_type == OBJECT_TYPE_IP6_ADDRESS;
+	case -NLE_NOADDR:
+		return object_type == OBJECT_TYPE_IP4_ADDRESS || object_type == OBJECT_TYPE_IP6_ADDRESS;
+	default:
+		return FALSE;
+	}
+}
+
+static gboolean
+transaction_op_succeeded (const TransactionOp *op)
+{
+	if (op->nle == -NLE_SUCCESS)
+		return TRUE;
+	if (op->add)
+		return op->nle == -NLE_EXIST;
+	return delete_object_already_gone (_nlo_get_object_type (op->object), op->nle);
+}
+
+/* Records the ACKs in @data. Returns: the number of requests answered. */
+static guint
+transaction_process_acks (GArray *ops, guint start, guint end, guint32 first_seq,
+                          const struct sockaddr_nl *nla, unsigned char *data, int n)
+{
+	struct nlmsghdr *hdr;
+	guint n_answered = 0;
+
+	/* Only ever accept messages from kernel */
+	for (hdr = (struct nlmsghdr *) data; nla->nl_pid == 0 && nlmsg_ok (hdr, n); hdr = nlmsg_next (hdr, &n)) {
+		struct nlmsgerr *e;
+		TransactionOp *op;
+		guint32 idx = hdr->nlmsg_seq - first_seq;
+
+		if (hdr->nlmsg_type != NLMSG_ERROR || idx >= end - start)
+			continue;
+
+		op = &g_array_index (ops, TransactionOp, start + idx);
+		if (op->seq != hdr->nlmsg_seq || op->nle != TRANSACTION_PENDING)
+			continue;
+
+		e = nlmsg_data (hdr);
+		op->nle = e->error ? -nl_syserr2nlerr (e->error) : -NLE_SUCCESS;
+		n_answered++;
+	}
+	return n_answered;
+}
+
+/* Reads the ACKs that are still queued on the socket, without blocking */
+static guint
+transaction_drain_acks (NMLinuxPlatformPrivate *priv, GArray *ops, guint start, guint end, guint32 first_seq)
+{
+	struct pollfd pfd = { .fd = nl_socket_get_fd (priv->nlh), .events = POLLIN };
+	guint n_answered = 0;
+
+	while (poll (&pfd, 1, 0) > 0) {
+		struct sockaddr_nl nla;
+		unsigned char *data = NULL;
+		int n;
+
+		n = nl_recv (priv->nlh, &nla, &data, NULL);
+		if (n == -NLE_NOMEM)
+			continue;
+		if (n <= 0)
+			break;
+
+		n_answered += transaction_process_acks (ops, start, end, first_seq, &nla, data, n);
+		free (data);
+	}
+	return n_answered;
+}
+
+/* The ACKs of some requests were dropped. Decide from the kernel's state
+ * whether they took effect, with one dump per object type. */
+static void
+transaction_check_pending (NMLinuxPlatformPrivate *priv, GArray *ops, guint start, guint end)
+{
+	struct nl_cache *address_dump = NULL, *route_dump = NULL;
+	guint i;
+	int nle;
+
+	for (i = start; i < end; i++) {
+		TransactionOp *op = &g_array_index (ops, TransactionOp, i);
+		ObjectType type = _nlo_get_object_type (op->object);
+		gboolean is_address = (type == OBJECT_TYPE_IP4_ADDRESS || type == OBJECT_TYPE_IP6_ADDRESS);
+		struct nl_cache **dump = is_address ? &address_dump : &route_dump;
+		struct nl_object *found;
+
+		if (op->nle != TRANSACTION_PENDING)
+			continue;
+
+		if (!*dump) {
+			nle = nl_cache_alloc_and_fill (nl_cache_ops_lookup (nl_object_get_type (op->object)),
+			                               priv->nlh, dump);
+			if (nle) {
+				*dump = NULL;
+				op->nle = nle;
+				continue;
+			}
+		}
+
+		found = nl_cache_search (*dump, op->object);
+		if (found)
+			nl_object_put (found);
+		op->nle = (!found == !op->add) ? -NLE_SUCCESS : -NLE_FAILURE;
+	}
+
+	if (address_dump)
+		nl_cache_free (address_dump);
+	if (route_dump)
+		nl_cache_free (route_dump);
+}
+
+/* Sends the requests starting at @start that fit into one batch and waits
+ * for their ACKs. The kernel processes the whole batch within sendmsg(), so
+ * all ACKs are already queued on the socket when it returns.
+ *
+ * Returns: the index of the first request of the next batch. */
+static guint
+transaction_send_batch (NMLinuxPlatformPrivate *priv, GArray *ops, guint start)
+{
+	static const guint8 padding[NLMSG_ALIGNTO] = { 0 };
+	GByteArray *buf;
+	guint end, n_pending;
+	guint32 first_seq = 0;
+	int nle;
+
+	buf = g_byte_array_sized_new (TRANSACTION_BATCH_SIZE);
+	for (end = start; end < ops->len && end - start < TRANSACTION_BATCH_REQUESTS; end++) {
+		TransactionOp *op = &g_array_index (ops, TransactionOp, end);
+		struct nlmsghdr *hdr = nlmsg_hdr (op->msg);
+
+		if (end > start && buf->len + NLMSG_ALIGN (hdr->nlmsg_len) > TRANSACTION_BATCH_SIZE)
+			break;
+
+		hdr->nlmsg_flags |= NLM_F_ACK;
+		nl_complete_msg (priv->nlh, op->msg);
+		op->seq = hdr->nlmsg_seq;
+		if (end == start)
+			first_seq = op->seq;
+
+		g_byte_array_append (buf, (const guint8 *) hdr, hdr->nlmsg_len);
+		g_byte_array_append (buf, padding, NLMSG_ALIGN (hdr->nlmsg_len) - hdr->nlmsg_len);
+	}
+
+	n_pending = end - start;
+	nle = nl_sendto (priv->nlh, buf->data, buf->len);
+	g_byte_array_free (buf, TRUE);
+
+	while (nle >= 0 && n_pending > 0) {
+		struct sockaddr_nl nla;
+		unsigned char *data = NULL;
+		int n;
+
+		n = nl_recv (priv->nlh, &nla, &data, NULL);
+		if (n <= 0) {
+			nle = n < 0 ? n : -NLE_FAILURE;
+			break;
+		}
+
+		n_pending -= transaction_process_acks (ops, start, end, first_seq, &nla, data, n);
+		free (data);
+	}
+
+	if (n_pending > 0 && nle == -NLE_NOMEM) {
+		/* ENOBUFS: the receive buffer overflowed and the kernel dropped some
+		 * ACKs. Consume the rest, so that they don't end up as replies to
+		 * later requests, and check the unanswered requests against the
+		 * kernel instead of failing them all. */
+		debug ("transaction: lost ACKs of a batch of %u requests, checking the kernel", end - start);
+		n_pending -= transaction_drain_acks (priv, ops, start, end, first_seq);
+		if (n_pending > 0)
+			transaction_check_pending (priv, ops, start, end);
+		n_pending = 0;
+	}
+
+	if (n_pending > 0) {
+		guint i;
+
+		error ("Netlink error sending batch of %u requests: %s (%d)", end - start, nl_geterror (nle), nle);
+		for (i = start; i < end; i++) {
+			TransactionOp *op = &g_array_index (ops, TransactionOp, i);
+
+			if (op->nle == TRANSACTION_PENDING)
+				op->nle = nle < 0 ? nle : -NLE_FAILURE;
+		}
+	}
+
+	return end;
+}
+
+/* Updates the cache for all objects touched by the transaction, requesting
+ * one dump of addresses and one of routes at most. */
+static void
+transaction_reconcile (NMPlatform *platform, GArray *refresh)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	struct nl_cache *address_dump = NULL, *route_dump = NULL;
+	guint i;
+	int nle;
+
+	for (i = 0; i < refresh->len; i++) {
+		TransactionRefresh *item = &g_array_index (refresh, TransactionRefresh, i);
+		ObjectType type = _nlo_get_object_type (item->object);
+		gboolean is_address = (type == OBJECT_TYPE_IP4_ADDRESS || type == OBJECT_TYPE_IP6_ADDRESS);
+		struct nl_cache **dump = is_address ? &address_dump : &route_dump;
+		struct nl_object *found;
+		auto_nl_object struct nl_object *kernel_object = NULL;
+
+		if (!*dump) {
+			nle = nl_cache_alloc_and_fill (nl_cache_ops_lookup (nl_object_get_type (item->object)),
+			                               priv->nlh, dump);
+			if (nle) {
+				error ("transaction: dumping type %d failed: %s (%d)", type, nl_geterror (nle), nle);
+				*dump = NULL;
+				refresh_object (platform, item->object, item->removed, NM_PLATFORM_REASON_INTERNAL);
+				continue;
+			}
+		}
+
+		/* Clone the found object, refresh_object_from_kernel() adds it
+		 * to our cache. */
+		found = nl_cache_search (*dump, item->object);
+		if (found) {
+			kernel_object = nl_object_clone (found);
+			nl_object_put (found);
+			if (is_address)
+				_rtnl_addr_hack_lifetimes_rel_to_abs ((struct rtnl_addr *) kernel_object);
+		}
+
+		refresh_object_from_kernel (platform, item->object, kernel_object, item->removed, NM_PLATFORM_REASON_INTERNAL);
+	}
+
+	if (address_dump)
+		nl_cache_free (address_dump);
+	if (route_dump)
+		nl_cache_free (route_dump);
+}
+
+static void
+transaction_report_failure (NMPlatform *platform, const TransactionOp *op,
+                            NMPlatformTransactionFailedFunc failed_func, gpointer user_data)
+{
+	union {
+		NMPlatformIP4Address a4;
+		NMPlatformIP6Address a6;
+		NMPlatformIP4Route r4;
+		NMPlatformIP6Route r6;
+	} obj;
+
+	switch (_nlo_get_object_type (op->object)) {
+	case OBJECT_TYPE_IP4_ADDRESS:
+		if (init_ip4_address (&obj.a4, (struct rtnl_addr *) op->object))
+			failed_func (platform, NM_PLATFORM_TRANSACTION_IP4_ADDRESS, op->add, &obj.a4, user_data);
+		break;
+	case OBJECT_TYPE_IP6_ADDRESS:
+		if (init_ip6_address (&obj.a6, (struct rtnl_addr *) op->object))
+			failed_func (platform, NM_PLATFORM_TRANSACTION_IP6_ADDRESS, op->add, &obj.a6, user_data);
+		break;
+	case OBJECT_TYPE_IP4_ROUTE:
+		if (init_ip4_route (&obj.r4, (struct rtnl_route *) op->object))
+			failed_func (platform, NM_PLATFORM_TRANSACTION_IP4_ROUTE, op->add, &obj.r4, user_data);
+		break;
+	case OBJECT_TYPE_IP6_ROUTE:
+		if (init_ip6_route (&obj.r6, (struct rtnl_route *) op->object))
+			failed_func (platform, NM_PLATFORM_TRANSACTION_IP6_ROUTE, op->add, &obj.r6, user_data);
+		break;
+	default:
+		g_return_if_reached ();
+	}
+}
+
+static void
+transaction_begin (NMPlatform *platform)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+
+	g_return_if_fail (!priv->transaction_ops);
+
+	priv->transaction_ops = g_array_new (FALSE, FALSE, sizeof (TransactionOp));
+	g_array_set_clear_func (priv->transaction_ops, (GDestroyNotify) transaction_op_clear);
+	priv->transaction_refresh = g_array_new (FALSE, FALSE, sizeof (TransactionRefresh));
+	g_array_set_clear_func (priv->transaction_refresh, (GDestroyNotify) transaction_refresh_clear);
+}
+
+static gboolean
+transaction_commit (NMPlatform *platform, NMPlatformTransactionFailedFunc failed_func, gpointer user_data)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	gs_unref_array GArray *ops = priv->transaction_ops;
+	gs_unref_array GArray *refresh = priv->transaction_refresh;
+	guint i, n_batches = 0, n_failed = 0;
+
+	g_return_val_if_fail (ops, FALSE);
+
+	priv->transaction_ops = NULL;
+	priv->transaction_refresh = NULL;
+
+	for (i = 0; i < ops->len; n_batches++)
+		i = transaction_send_batch (priv, ops, i);
+
+	/* Announce the changes before reporting failures, so that callers see
+	 * the resulting state. */
+	transaction_reconcile (platform, refresh);
+
+	for (i = 0; i < ops->len; i++) {
+		const TransactionOp *op = &g_array_index (ops, TransactionOp, i);
+
+		if (transaction_op_succeeded (op))
+			continue;
+
+		n_failed++;
+		error ("Netlink error %s %s: %s", op->add ? "adding" : "deleting",
+		       to_string_object (platform, op->object), nl_geterror (op->nle));
+		if (failed_func)
+			transaction_report_failure (platform, op, failed_func, user_data);
+	}
+
+	if (ops->len)
+		debug ("transaction: %u requests in %u batches, %u failed", ops->len, n_batches, n_failed);
+	return n_failed == 0;
+}
+
+/******************************************************************/
+
 /* Decreases the reference count if @obj for convenience */
 static gboolean
 add_object (NMPlatform *platform, struct nl_object *obj)
@@ -1748,6 +2534,9 @@ add_object (NMPlatform *platform, struct nl_object *obj)
 
 	g_return_val_if_fail (object, FALSE);
 
+	if (transaction_accepts (priv, object))
+		return transaction_queue (platform, object, TRUE, TRUE);
+
 	nle = add_kernel_object (priv->nlh, object);
 
 	/* NLE_EXIST is considered equivalent to success to avoid race conditions. You
@@ -1790,6 +2579,11 @@ delete_object (NMPlatform *platform, struct nl_object *object, gboolean do_refre
 	object_type = _nlo_get_object_type (object);
 	g_return_val_if_fail (object_type != OBJECT_TYPE_UNKNOWN, FALSE);
 
+	if (transaction_accepts (priv, object)) {
+		result = transaction_queue (platform, object, FALSE, do_refresh_object);
+		goto out;
+	}
+
 	switch (object_type) {
 	case OBJECT_TYPE_LINK:
 		nle = rtnl_link_delete (priv->nlh, (struct rtnl_link *) object);
@@ -1806,32 +2600,13 @@ delete_object (NMPlatform *platform, struct nl_object *object, gboolean do_refre
 		g_assert_not_reached ();
 	}
 
-	switch (nle) {
-	case -NLE_SUCCESS:
-		break;
-	case -NLE_OBJ_NOTFOUND:
-		debug("delete_object failed with \"%s\" (%d), meaning the object was already removed",
-		      nl_geterror (nle), nle);
-		break;
-	case -NLE_FAILURE:
-		if (object_type == OBJECT_TYPE_IP6_ADDRESS) {
-			/* On RHEL7 kernel, deleting a non existing address fails with ENXIO (which libnl maps to NLE_FAILURE) */
-			debug("delete_object for address failed with \"%s\" (%d), meaning the address was already removed",
-			      nl_geterror (nle), nle);
-			break;
-		}
-		goto DEFAULT;
-	case -NLE_NOADDR:
-		if (object_type == OBJECT_TYPE_IP4_ADDRESS || object_type == OBJECT_TYPE_IP6_ADDRESS) {
-			debug("delete_object for address failed with \"%s\" (%d), meaning the address was already removed",
-			      nl_geterror (nle), nle);
-			break;
+	if (nle != -NLE_SUCCESS) {
+		if (!delete_object_already_gone (object_type, nle)) {
+			error ("Netlink error deleting %s: %s (%d)", to_string_object (platform, object), nl_geterror (nle), nle);
+			goto out;
 		}
-		goto DEFAULT;
-	DEFAULT:
-	default:
-		error ("Netlink error deleting %s: %s (%d)", to_string_object (platform, object), nl_geterror (nle), nle);
-		goto out;
+		debug ("delete_object failed with \"%s\" (%d), meaning the object was already removed",
+		       nl_geterror (nle), nle);
 	}
 
 	if (do_refresh_object)
@@ -1934,7 +2709,7 @@ nm_nl_object_diff (ObjectType type, struct nl_object *_a, struct nl_object *_b)
  * cache manager instead of the one provided by libnl.
  */
 static int
-event_notification (struct nl_msg *msg, gpointer user_data)
+_event_notification (struct nl_msg *msg, gpointer user_data)
 {
 	NMPlatform *platform = NM_PLATFORM (user_data);
 	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
@@ -1948,6 +2723,9 @@ event_notification (struct nl_msg *msg, gpointer user_data)
 
 	event = nlmsg_hdr (msg)->nlmsg_type;
 
+	if (event == RTM_NEWLINK || event == RTM_DELLINK)
+		link_msg_handle (priv, msg);
+
 	if (priv->support_kernel_extended_ifa_flags == 0 && event == RTM_NEWADDR) {
 		/* if kernel support for extended ifa flags is still undecided, use the opportunity
 		 * now and use @msg to decide it. This saves a blocking net link request.
@@ -1988,13 +2766,17 @@ event_notification (struct nl_msg *msg, gpointer user_data)
 		 * Quick external deletion and addition can be occasionally
 		 * seen as just a change.
 		 */
-		if (kernel_object)
+		if (kernel_object) {
+			nm_stats_probe_hit (NM_STATS_PROBE_NETLINK_EVENT_IGNORED);
 			return NL_OK;
+		}
 		/* Ignore internal deletion */
-		if (!cached_object)
+		if (!cached_object) {
+			nm_stats_probe_hit (NM_STATS_PROBE_NETLINK_EVENT_IGNORED);
 			return NL_OK;
+		}
 
-		nl_cache_remove (cached_object);
+		cache_remove (priv, cached_object);
 		/* Don't announce removed interfaces that are not recognized by
 		 * udev. They were either not yet discovered or they have been
 		 * already removed and announced.
@@ -2015,8 +2797,10 @@ event_notification (struct nl_msg *msg, gpointer user_data)
 		 * collapsed to just one addition or deletion, depending of whether we
 		 * already have the object in cache.
 		 */
-		if (!kernel_object)
+		if (!kernel_object) {
+			nm_stats_probe_hit (NM_STATS_PROBE_NETLINK_EVENT_IGNORED);
 			return NL_OK;
+		}
 
 		/* Ignore unsupported object types (e.g. AF_PHONET family addresses) */
 		if (type == OBJECT_TYPE_UNKNOWN)
@@ -2024,7 +2808,7 @@ event_notification (struct nl_msg *msg, gpointer user_data)
 
 		/* Handle external addition */
 		if (!cached_object) {
-			nle = nl_cache_add (cache, kernel_object);
+			nle = cache_add (priv, cache, kernel_object);
 			if (nle) {
 				error ("netlink cache error: %s", nl_geterror (nle));
 				return NL_OK;
@@ -2037,12 +2821,14 @@ event_notification (struct nl_msg *msg, gpointer user_data)
 		 * This also catches notifications for internal addition or change, unless
 		 * another action occured very soon after it.
 		 */
-		if (!nm_nl_object_diff (type, kernel_object, cached_object))
+		if (!nm_nl_object_diff (type, kernel_object, cached_object)) {
+			nm_stats_probe_hit (NM_STATS_PROBE_NETLINK_EVENT_IGNORED);
 			return NL_OK;
+		}
 
 		/* Handle external change */
-		nl_cache_remove (cached_object);
-		nle = nl_cache_add (cache, kernel_object);
+		cache_remove (priv, cached_object);
+		nle = cache_add (priv, cache, kernel_object);
 		if (nle) {
 			error ("netlink cache error: %s", nl_geterror (nle));
 			return NL_OK;
@@ -2056,6 +2842,17 @@ event_notification (struct nl_msg *msg, gpointer user_data)
 	}
 }
 
+static int
+event_notification (struct nl_msg *msg, gpointer user_data)
+{
+	gint64 start = nm_utils_get_monotonic_timestamp_us ();
+	int ret;
+
+	ret = _event_notification (msg, user_data);
+	nm_stats_probe_time (NM_STATS_PROBE_NETLINK_EVENT, start);
+	return ret;
+}
+
 /******************************************************************/
 
 static void
@@ -2088,32 +2885,14 @@ _log_dbg_sysctl_set_impl (const char *path, const char *value)
 		} \
 	} G_STMT_END
 
-static gboolean
-sysctl_set (NMPlatform *platform, const char *path, const char *value)
-{
-	int fd, len, nwrote, tries;
-	char *actual;
-
-	g_return_val_if_fail (path != NULL, FALSE);
-	g_return_val_if_fail (value != NULL, FALSE);
-
-	/* Don't write outside known locations */
-	g_assert (g_str_has_prefix (path, "/proc/sys/")
-	          || g_str_has_prefix (path, "/sys/"));
-	/* Don't write to suspicious locations */
-	g_assert (!strstr (path, "/../"));
-
-	fd = open (path, O_WRONLY | O_TRUNC);
-	if (fd == -1) {
-		if (errno == ENOENT) {
-			debug ("sysctl: failed to open '%s': (%d) %s",
-			       path, errno, strerror (errno));
-		} else {
-			error ("sysctl: failed to open '%s': (%d) %s",
-			       path, errno, strerror (errno));
-		}
-		return FALSE;
-	}
+/* Writes @value to the sysctl opened as @fd, which is closed afterwards.
+ * @path is only used for logging.
+ */
+static gboolean
+sysctl_write (const char *path, int fd, const char *value)
+{
+	int len, nwrote, tries;
+	char *actual;
 
 	_log_dbg_sysctl_set (path, value);
 
@@ -2149,6 +2928,35 @@ sysctl_set (NMPlatform *platform, const char *path, const char *value)
 	return (nwrote == len);
 }
 
+static gboolean
+sysctl_set (NMPlatform *platform, const char *path, const char *value)
+{
+	int fd;
+
+	g_return_val_if_fail (path != NULL, FALSE);
+	g_return_val_if_fail (value != NULL, FALSE);
+
+	/* Don't write outside known locations */
+	g_assert (g_str_has_prefix (path, "/proc/sys/")
+	          || g_str_has_prefix (path, "/sys/"));
+	/* Don't write to suspicious locations */
+	g_assert (!strstr (path, "/../"));
+
+	fd = open (path, O_WRONLY | O_TRUNC);
+	if (fd == -1) {
+		if (errno == ENOENT) {
+			debug ("sysctl: failed to open '%s': (%d) %s",
+			       path, errno, strerror (errno));
+		} else {
+			error ("sysctl: failed to open '%s': (%d) %s",
+			       path, errno, strerror (errno));
+		}
+		return FALSE;
+	}
+
+	return sysctl_write (path, fd, value);
+}
+
 static GHashTable *sysctl_get_prev_values;
 
 static void
@@ -2397,17 +3205,461 @@ link_get_type (NMPlatform *platform, int ifindex)
 {
 	auto_nl_object struct rtnl_link *rtnllink = link_get (platform, ifindex);
 
-	return link_extract_type (platform, rtnllink, NULL);
+	if (!rtnllink)
+		return NM_LINK_TYPE_NONE;
+	return link_get_type_info (platform, rtnllink)->type;
 }
 
 static const char *
 link_get_type_name (NMPlatform *platform, int ifindex)
 {
 	auto_nl_object struct rtnl_link *rtnllink = link_get (platform, ifindex);
-	const char *type;
 
-	link_extract_type (platform, rtnllink, &type);
-	return type;
+	if (!rtnllink)
+		return NULL;
+	return link_get_type_info (platform, rtnllink)->type_name;
+}
+
+/******************************************************************
+ * Per-interface IPv6 settings
+ *
+ * The kernel reports all of /proc/sys/net/ipv6/conf/IFNAME/ in the
+ * IFLA_INET6_CONF attribute of RTM_NEWLINK, both in dumps and in change
+ * notifications. Keep the latest copy per ifindex so that reading a
+ * setting costs no syscall. The kernel does not announce every change of
+ * these settings, notably not writes to /proc by others, so the copy is
+ * never trusted to skip a write. Writes go through a directory fd kept per
+ * interface, and the written setting is read back into the copy.
+ ******************************************************************/
+
+/* Indices into IFLA_INET6_CONF: the DEVCONF_* enum of linux/ipv6.h, which
+ * is kernel ABI. The header itself clashes with netinet/in.h on older
+ * systems. Only settings that netlink reports in the same unit as /proc
+ * are listed; the router solicitation intervals, for example, are in
+ * milliseconds there but in seconds in /proc. hop_limit and mtu are left
+ * out as well: the kernel changes them on router advertisements and link
+ * MTU changes without announcing the new IFLA_INET6_CONF. So is
+ * accept_ra_rtr_pref, which netlink reports as 0 on kernels built without
+ * CONFIG_IPV6_ROUTER_PREF, where /proc does not have it at all.
+ */
+static const struct {
+	const char *property;
+	int index;
+} ip6_devconf_indices[] = {
+	{ "forwarding",           0 },
+	{ "accept_ra",            3 },
+	{ "accept_redirects",     4 },
+	{ "autoconf",             5 },
+	{ "dad_transmits",        6 },
+	{ "router_solicitations", 7 },
+	{ "use_tempaddr",         10 },
+	{ "max_addresses",        15 },
+	{ "accept_ra_defrtr",     17 },
+	{ "accept_ra_pinfo",      18 },
+	{ "disable_ipv6",         26 },
+	{ "accept_dad",           27 },
+};
+
+typedef struct {
+	guint n_values;
+	gint32 values[];
+} Ip6Devconf;
+
+typedef struct {
+	int fd;
+	char ifname[IFNAMSIZ];
+} Ip6ConfDir;
+
+static int
+ip6_devconf_index (const char *property)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (ip6_devconf_indices); i++) {
+		if (!strcmp (ip6_devconf_indices[i].property, property))
+			return ip6_devconf_indices[i].index;
+	}
+	return -1;
+}
+
+static void
+ip6_conf_dir_free (Ip6ConfDir *dir)
+{
+	close (dir->fd);
+	g_slice_free (Ip6ConfDir, dir);
+}
+
+static void
+ip6_devconf_update (NMLinuxPlatformPrivate *priv, struct nlmsghdr *hdr, const struct ifinfomsg *ifi)
+{
+	struct nlattr *attr;
+	Ip6Devconf *devconf;
+	guint n;
+
+	attr = nlmsg_find_attr (hdr, sizeof (*ifi), IFLA_AF_SPEC);
+	if (attr)
+		attr = nla_find (nla_data (attr), nla_len (attr), AF_INET6);
+	if (attr)
+		attr = nla_find (nla_data (attr), nla_len (attr), IFLA_INET6_CONF);
+	if (!attr)
+		return;
+
+	n = nla_len (attr) / sizeof (gint32);
+	devconf = g_malloc (sizeof (Ip6Devconf) + n * sizeof (gint32));
+	devconf->n_values = n;
+	memcpy (devconf->values, nla_data (attr), n * sizeof (gint32));
+	g_hash_table_insert (priv->ip6_devconf, GINT_TO_POINTER (ifi->ifi_index), devconf);
+}
+
+/* Opens @property in the IPv6 sysctl directory of @ifindex, through a
+ * directory fd that is kept open per interface.
+ */
+static int
+ip6_conf_open (NMPlatform *platform, int ifindex, const char *property, int flags)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	const char *ifname;
+	Ip6ConfDir *dir;
+	int fd, tries, errsv = 0;
+
+	/* Don't write outside known locations */
+	g_assert (!strchr (property, '/'));
+
+	ifname = link_get_name (platform, ifindex);
+	if (!ifname) {
+		platform->error = NM_PLATFORM_ERROR_NOT_FOUND;
+		return -1;
+	}
+
+	for (tries = 0; tries < 2; tries++) {
+		dir = g_hash_table_lookup (priv->ip6_conf_dirs, GINT_TO_POINTER (ifindex));
+		if (!dir || strcmp (dir->ifname, ifname)) {
+			gs_free char *path = g_strdup_printf ("/proc/sys/net/ipv6/conf/%s",
+			                                      ASSERT_VALID_PATH_COMPONENT (ifname));
+			int dirfd;
+
+			dirfd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (dirfd < 0) {
+				debug ("sysctl: failed to open '%s': (%d) %s", path, errno, strerror (errno));
+				return -1;
+			}
+			dir = g_slice_new (Ip6ConfDir);
+			dir->fd = dirfd;
+			g_strlcpy (dir->ifname, ifname, sizeof (dir->ifname));
+			g_hash_table_insert (priv->ip6_conf_dirs, GINT_TO_POINTER (ifindex), dir);
+		}
+
+		fd = openat (dir->fd, property, flags | O_CLOEXEC);
+		if (fd >= 0)
+			return fd;
+		errsv = errno;
+		if (errsv != ENOENT)
+			break;
+
+		/* The directory may belong to an interface that was renamed or
+		 * removed in the meantime; reopen it once.
+		 */
+		g_hash_table_remove (priv->ip6_conf_dirs, GINT_TO_POINTER (ifindex));
+	}
+
+	if (errsv == ENOENT) {
+		debug ("sysctl: failed to open '%s': (%d) %s",
+		       nm_utils_ip6_property_path (ifname, property), errsv, strerror (errsv));
+	} else {
+		error ("sysctl: failed to open '%s': (%d) %s",
+		       nm_utils_ip6_property_path (ifname, property), errsv, strerror (errsv));
+	}
+	return -1;
+}
+
+static char *
+ip6_conf_read (NMPlatform *platform, int ifindex, const char *property)
+{
+	char buf[64];
+	ssize_t len;
+	int fd;
+
+	fd = ip6_conf_open (platform, ifindex, property, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	do {
+		len = read (fd, buf, sizeof (buf) - 1);
+	} while (len < 0 && errno == EINTR);
+	close (fd);
+
+	if (len < 0) {
+		debug ("sysctl: error reading IPv6 '%s' of ifindex %d: (%d) %s",
+		       property, ifindex, errno, strerror (errno));
+		return NULL;
+	}
+
+	buf[len] = '\0';
+	return g_strstrip (g_strdup (buf));
+}
+
+static gboolean
+link_ip6_conf_set (NMPlatform *platform, int ifindex, const char *property, const char *value)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	Ip6Devconf *devconf;
+	gs_free char *current = NULL;
+	int idx, fd;
+	gint64 v;
+
+	fd = ip6_conf_open (platform, ifindex, property, O_WRONLY | O_TRUNC);
+	if (fd < 0)
+		return FALSE;
+
+	if (!sysctl_write (nm_utils_ip6_property_path (link_get_name (platform, ifindex), property), fd, value))
+		return FALSE;
+
+	idx = ip6_devconf_index (property);
+	devconf = g_hash_table_lookup (priv->ip6_devconf, GINT_TO_POINTER (ifindex));
+	if (!devconf || idx < 0 || idx >= devconf->n_values)
+		return TRUE;
+
+	/* The kernel may have clamped the value; take what it reports. If
+	 * that fails, forget the copy so that reads go to /proc until the
+	 * next RTM_NEWLINK.
+	 */
+	current = ip6_conf_read (platform, ifindex, property);
+	v = current ? _nm_utils_ascii_str_to_int64 (current, 10, G_MININT32, G_MAXINT32, G_MININT64) : G_MININT64;
+	if (v != G_MININT64)
+		devconf->values[idx] = v;
+	else
+		g_hash_table_remove (priv->ip6_devconf, GINT_TO_POINTER (ifindex));
+	return TRUE;
+}
+
+static char *
+link_ip6_conf_get (NMPlatform *platform, int ifindex, const char *property)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	Ip6Devconf *devconf;
+	int idx;
+
+	idx = ip6_devconf_index (property);
+	devconf = g_hash_table_lookup (priv->ip6_devconf, GINT_TO_POINTER (ifindex));
+	if (devconf && idx >= 0 && idx < devconf->n_values)
+		return g_strdup_printf ("%d", devconf->values[idx]);
+
+	return ip6_conf_read (platform, ifindex, property);
+}
+
+/******************************************************************
+ * Link statistics
+ *
+ * Every RTM_NEWLINK carries the traffic counters of the link. libnl
+ * parses them too, but does not treat a change of the counters as a
+ * change of the object, so its cache is not kept up to date. Instead,
+ * take them from the raw messages, both from events and from explicit
+ * requests, which also refresh the IPv6 settings above. The periodic
+ * refresh only requests the links somebody is interested in; the whole
+ * table is only dumped when the caches are repopulated.
+ ******************************************************************/
+
+static void
+link_stats_free (gpointer data)
+{
+	g_slice_free (NMPlatformLinkStats, data);
+}
+
+static void
+link_stats_update (NMLinuxPlatformPrivate *priv, struct nlmsghdr *hdr, const struct ifinfomsg *ifi)
+{
+	struct nlattr *attr;
+	NMPlatformLinkStats *stats;
+
+	stats = g_hash_table_lookup (priv->link_stats, GINT_TO_POINTER (ifi->ifi_index));
+	if (!stats) {
+		stats = g_slice_new0 (NMPlatformLinkStats);
+		g_hash_table_insert (priv->link_stats, GINT_TO_POINTER (ifi->ifi_index), stats);
+	}
+
+	/* Netlink attributes are only 4-byte aligned, so copy them out */
+	attr = nlmsg_find_attr (hdr, sizeof (*ifi), IFLA_STATS64);
+	if (attr && nla_len (attr) >= sizeof (struct rtnl_link_stats64)) {
+		struct rtnl_link_stats64 s;
+
+		memcpy (&s, nla_data (attr), sizeof (s));
+		stats->rx_packets = s.rx_packets;
+		stats->rx_bytes = s.rx_bytes;
+		stats->tx_packets = s.tx_packets;
+		stats->tx_bytes = s.tx_bytes;
+		return;
+	}
+
+	/* Kernels before 2.6.35 only report 32-bit counters */
+	attr = nlmsg_find_attr (hdr, sizeof (*ifi), IFLA_STATS);
+	if (attr && nla_len (attr) >= sizeof (struct rtnl_link_stats)) {
+		struct rtnl_link_stats s;
+
+		memcpy (&s, nla_data (attr), sizeof (s));
+		stats->rx_packets = s.rx_packets;
+		stats->rx_bytes = s.rx_bytes;
+		stats->tx_packets = s.tx_packets;
+		stats->tx_bytes = s.tx_bytes;
+	}
+}
+
+/* Updates the per-link data that libnl doesn't expose from a RTM_NEWLINK
+ * or RTM_DELLINK message.
+ */
+static void
+link_msg_handle (NMLinuxPlatformPrivate *priv, struct nl_msg *msg)
+{
+	struct nlmsghdr *hdr = nlmsg_hdr (msg);
+	const struct ifinfomsg *ifi;
+
+	if (   (hdr->nlmsg_type != RTM_NEWLINK && hdr->nlmsg_type != RTM_DELLINK)
+	    || !nlmsg_valid_hdr (hdr, sizeof (*ifi)))
+		return;
+
+	ifi = nlmsg_data (hdr);
+
+	/* AF_BRIDGE messages describe bridge ports, not the link itself */
+	if (ifi->ifi_family != AF_UNSPEC)
+		return;
+
+	if (hdr->nlmsg_type == RTM_DELLINK) {
+		g_hash_table_remove (priv->ip6_devconf, GINT_TO_POINTER (ifi->ifi_index));
+		g_hash_table_remove (priv->ip6_conf_dirs, GINT_TO_POINTER (ifi->ifi_index));
+		g_hash_table_remove (priv->link_stats, GINT_TO_POINTER (ifi->ifi_index));
+		return;
+	}
+
+	ip6_devconf_update (priv, hdr, ifi);
+	link_stats_update (priv, hdr, ifi);
+}
+
+static int
+link_dump_cb (struct nl_msg *msg, gpointer user_data)
+{
+	link_msg_handle (user_data, msg);
+	return NL_OK;
+}
+
+static struct nl_cb *
+link_dump_cb_new (NMLinuxPlatformPrivate *priv)
+{
+	struct nl_cb *orig_cb, *cb;
+
+	orig_cb = nl_socket_get_cb (priv->nlh);
+	cb = nl_cb_clone (orig_cb);
+	nl_cb_put (orig_cb);
+	if (cb)
+		nl_cb_set (cb, NL_CB_VALID, NL_CB_CUSTOM, link_dump_cb, priv);
+	return cb;
+}
+
+/* Refreshes the IPv6 settings and statistics of all links with a single
+ * link dump on the request socket.
+ */
+static gboolean
+link_dump_raw (NMPlatform *platform)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	GHashTable *old_ip6_devconf, *old_link_stats;
+	struct nl_cb *cb;
+	int nle;
+
+	cb = link_dump_cb_new (priv);
+	if (!cb)
+		return FALSE;
+
+	nle = nl_rtgen_request (priv->nlh, RTM_GETLINK, AF_UNSPEC, NLM_F_DUMP);
+	if (nle < 0) {
+		warning ("Netlink error: requesting RTM_GETLINK failed with %s", nl_geterror (nle));
+		nl_cb_put (cb);
+		return FALSE;
+	}
+
+	/* Fill new tables, so that links that vanished unnoticed go away, and
+	 * keep the old ones if the dump fails halfway. Events are not read
+	 * meanwhile, they arrive on the event socket.
+	 */
+	old_ip6_devconf = priv->ip6_devconf;
+	old_link_stats = priv->link_stats;
+	priv->ip6_devconf = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+	priv->link_stats = g_hash_table_new_full (NULL, NULL, NULL, link_stats_free);
+
+	nle = nl_recvmsgs (priv->nlh, cb);
+	nl_cb_put (cb);
+	if (nle < 0) {
+		warning ("Netlink error: reading link dump failed with %s", nl_geterror (nle));
+		g_hash_table_unref (priv->ip6_devconf);
+		g_hash_table_unref (priv->link_stats);
+		priv->ip6_devconf = old_ip6_devconf;
+		priv->link_stats = old_link_stats;
+		return FALSE;
+	}
+
+	g_hash_table_unref (old_ip6_devconf);
+	g_hash_table_unref (old_link_stats);
+	return TRUE;
+}
+
+/* Refreshes the statistics of the given links with one request each,
+ * instead of dumping all links. Returns whether any of them changed.
+ */
+static gboolean
+link_refresh_stats (NMPlatform *platform, const int *ifindexes, guint n_ifindexes)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	struct nl_cb *cb;
+	gboolean refreshed = FALSE;
+	guint i;
+
+	cb = link_dump_cb_new (priv);
+	if (!cb)
+		return FALSE;
+
+	for (i = 0; i < n_ifindexes; i++) {
+		struct nl_msg *msg = NULL;
+		int nle;
+
+		nle = rtnl_link_build_get_request (ifindexes[i], NULL, &msg);
+		if (nle >= 0) {
+			nle = nl_send_auto (priv->nlh, msg);
+			nlmsg_free (msg);
+		}
+		if (nle >= 0)
+			nle = nl_recvmsgs (priv->nlh, cb);
+
+		if (nle == -NLE_NODEV || nle == -NLE_OBJ_NOTFOUND) {
+			/* The link is gone; RTM_DELLINK will follow */
+			if (g_hash_table_remove (priv->link_stats, GINT_TO_POINTER (ifindexes[i])))
+				refreshed = TRUE;
+			continue;
+		}
+		if (nle < 0) {
+			debug ("Netlink error: refreshing statistics of ifindex %d failed with %s",
+			       ifindexes[i], nl_geterror (nle));
+			continue;
+		}
+		nl_wait_for_ack (priv->nlh);
+		refreshed = TRUE;
+	}
+
+	nl_cb_put (cb);
+	return refreshed;
+}
+
+static gboolean
+link_get_stats (NMPlatform *platform, int ifindex, NMPlatformLinkStats *stats)
+{
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
+	NMPlatformLinkStats *cached;
+
+	cached = g_hash_table_lookup (priv->link_stats, GINT_TO_POINTER (ifindex));
+	if (!cached) {
+		platform->error = NM_PLATFORM_ERROR_NOT_FOUND;
+		return FALSE;
+	}
+
+	*stats = *cached;
+	return TRUE;
 }
 
 static gboolean
@@ -2597,11 +3849,9 @@ supports_mii_carrier_detect (const char *ifname)
 	struct mii_ioctl_data *mii;
 	gboolean supports_mii = FALSE;
 
-	fd = socket (PF_INET, SOCK_DGRAM, 0);
-	if (fd < 0) {
-		nm_log_err (LOGD_PLATFORM, "couldn't open control socket.");
+	fd = nm_platform_ioctl_socket ();
+	if (fd < 0)
 		return FALSE;
-	}
 
 	memset (&ifr, 0, sizeof (struct ifreq));
 	strncpy (ifr.ifr_name, ifname, IFNAMSIZ);
@@ -2624,7 +3874,6 @@ supports_mii_carrier_detect (const char *ifname)
 	}
 
  out:
-	close (fd);
 	nm_log_dbg (LOGD_PLATFORM, "MII %s supported", supports_mii ? "is" : "not");
 	return supports_mii;	
 }
@@ -3479,6 +4728,22 @@ wifi_indicate_addressing_running (NMPlatform *platform, int ifindex, gboolean ru
 		wifi_utils_indicate_addressing_running (wifi_data, running);
 }
 
+static void
+wifi_station_changed_cb (int ifindex, gpointer user_data)
+{
+	g_signal_emit_by_name (user_data, NM_PLATFORM_SIGNAL_WIFI_STATION_CHANGED, ifindex);
+}
+
+static gboolean
+wifi_monitor_station (NMPlatform *platform, int ifindex, gboolean enable)
+{
+	WifiData *wifi_data = wifi_get_wifi_data (platform, ifindex);
+
+	if (!wifi_data)
+		return FALSE;
+	return wifi_utils_monitor_station (wifi_data, enable ? wifi_station_changed_cb : NULL, platform);
+}
+
 
 static guint32
 mesh_get_channel (NMPlatform *platform, int ifindex)
@@ -3821,12 +5086,14 @@ ip4_route_get_all (NMPlatform *platform, int ifindex, NMPlatformGetRouteMode mod
 	GArray *routes;
 	NMPlatformIP4Route route;
 	struct nl_object *object;
+	RouteCacheIter iter;
 
 	g_return_val_if_fail (NM_IN_SET (mode, NM_PLATFORM_GET_ROUTE_MODE_ALL, NM_PLATFORM_GET_ROUTE_MODE_NO_DEFAULT, NM_PLATFORM_GET_ROUTE_MODE_ONLY_DEFAULT), NULL);
 
 	routes = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP4Route));
 
-	for (object = nl_cache_get_first (priv->route_cache); object; object = nl_cache_get_next (object)) {
+	route_cache_iter_init (&iter, priv, ifindex, mode == NM_PLATFORM_GET_ROUTE_MODE_ONLY_DEFAULT);
+	while ((object = route_cache_iter_next (&iter))) {
 		if (_route_match ((struct rtnl_route *) object, AF_INET, ifindex, FALSE)) {
 			if (_rtnl_route_is_default ((struct rtnl_route *) object)) {
 				if (mode == NM_PLATFORM_GET_ROUTE_MODE_NO_DEFAULT)
@@ -3850,12 +5117,14 @@ ip6_route_get_all (NMPlatform *platform, int ifindex, NMPlatformGetRouteMode mod
 	GArray *routes;
 	NMPlatformIP6Route route;
 	struct nl_object *object;
+	RouteCacheIter iter;
 
 	g_return_val_if_fail (NM_IN_SET (mode, NM_PLATFORM_GET_ROUTE_MODE_ALL, NM_PLATFORM_GET_ROUTE_MODE_NO_DEFAULT, NM_PLATFORM_GET_ROUTE_MODE_ONLY_DEFAULT), NULL);
 
 	routes = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP6Route));
 
-	for (object = nl_cache_get_first (priv->route_cache); object; object = nl_cache_get_next (object)) {
+	route_cache_iter_init (&iter, priv, ifindex, mode == NM_PLATFORM_GET_ROUTE_MODE_ONLY_DEFAULT);
+	while ((object = route_cache_iter_next (&iter))) {
 		if (_route_match ((struct rtnl_route *) object, AF_INET6, ifindex, FALSE)) {
 			if (_rtnl_route_is_default ((struct rtnl_route *) object)) {
 				if (mode == NM_PLATFORM_GET_ROUTE_MODE_NO_DEFAULT)
@@ -3954,14 +5223,17 @@ ip6_route_add (NMPlatform *platform, int ifindex, NMIPConfigSource source,
 }
 
 static struct rtnl_route *
-route_search_cache (struct nl_cache *cache, int family, int ifindex, const void *network, int plen, guint32 metric)
+route_search_cache (NMPlatform *platform, int family, int ifindex, const void *network, int plen, guint32 metric)
 {
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
 	guint32 network_clean[4], dst_clean[4];
 	struct nl_object *object;
+	RouteCacheIter iter;
 
 	clear_host_address (family, network, plen, network_clean);
 
-	for (object = nl_cache_get_first (cache); object; object = nl_cache_get_next (object)) {
+	route_cache_iter_init (&iter, priv, ifindex, plen == 0);
+	while ((object = route_cache_iter_next (&iter))) {
 		struct nl_addr *dst;
 		struct rtnl_route *rtnlroute = (struct rtnl_route *) object;
 
@@ -3998,15 +5270,18 @@ route_search_cache (struct nl_cache *cache, int family, int ifindex, const void
 static gboolean
 refresh_route (NMPlatform *platform, int family, int ifindex, const void *network, int plen, guint32 metric)
 {
-	struct nl_cache *cache;
+	NMLinuxPlatformPrivate *priv = NM_LINUX_PLATFORM_GET_PRIVATE (platform);
 	auto_nl_object struct rtnl_route *cached_object = NULL;
 
-	cache = choose_cache_by_type (platform, family == AF_INET ? OBJECT_TYPE_IP4_ROUTE : OBJECT_TYPE_IP6_ROUTE);
-	cached_object = route_search_cache (cache, family, ifindex, network, plen, metric);
+	cached_object = route_search_cache (platform, family, ifindex, network, plen, metric);
 
-	if (cached_object)
-		return refresh_object (platform, (struct nl_object *) cached_object, TRUE, NM_PLATFORM_REASON_INTERNAL);
-	return TRUE;
+	if (!cached_object)
+		return TRUE;
+	if (transaction_accepts (priv, (struct nl_object *) cached_object)) {
+		transaction_queue_refresh (priv, (struct nl_object *) cached_object, TRUE);
+		return TRUE;
+	}
+	return refresh_object (platform, (struct nl_object *) cached_object, TRUE, NM_PLATFORM_REASON_INTERNAL);
 }
 
 static gboolean
@@ -4039,7 +5314,7 @@ ip4_route_delete (NMPlatform *platform, int ifindex, in_addr_t network, int plen
 	 * Lookup in the cache so that we hopefully get the right values. */
 	cached_object = (struct rtnl_route *) nl_cache_search (cache, route);
 	if (!cached_object)
-		cached_object = route_search_cache (cache, AF_INET, ifindex, &network, plen, metric);
+		cached_object = route_search_cache (platform, AF_INET, ifindex, &network, plen, metric);
 
 	if (!_nl_has_capability (1 /* NL_CAPABILITY_ROUTE_BUILD_MSG_SET_SCOPE */)) {
 		/* When searching for a matching IPv4 route to delete, the kernel
@@ -4103,7 +5378,7 @@ ip_route_exists (NMPlatform *platform, int family, int ifindex, gpointer network
 	auto_nl_object struct nl_object *cached_object = nl_cache_search (cache, object);
 
 	if (!cached_object)
-		cached_object = (struct nl_object *) route_search_cache (cache, family, ifindex, network, plen, metric);
+		cached_object = (struct nl_object *) route_search_cache (platform, family, ifindex, network, plen, metric);
 	return !!cached_object;
 }
 
@@ -4229,6 +5504,7 @@ cache_repopulate_all (NMPlatform *platform)
 	struct nl_cache *old_address_cache = priv->address_cache;
 	struct nl_cache *old_route_cache = priv->route_cache;
 	struct nl_object *object;
+	gint64 start = nm_utils_get_monotonic_timestamp_us ();
 
 	debug ("platform: %spopulate platform cache", old_link_cache ? "re" : "");
 
@@ -4242,15 +5518,22 @@ cache_repopulate_all (NMPlatform *platform)
 	cache_remove_unknown (priv->link_cache);
 	cache_remove_unknown (priv->address_cache);
 	cache_remove_unknown (priv->route_cache);
+	route_index_rebuild (priv);
 
 	for (object = nl_cache_get_first (priv->address_cache); object; object = nl_cache_get_next (object)) {
 		_rtnl_addr_hack_lifetimes_rel_to_abs ((struct rtnl_addr *) object);
 	}
 
+	/* libnl doesn't expose the IPv6 settings and statistics it parses from
+	 * the link dump */
+	link_dump_raw (platform);
+
 	/* Make sure all changes we've missed are announced. */
 	cache_announce_changes (platform, priv->link_cache, old_link_cache);
 	cache_announce_changes (platform, priv->address_cache, old_address_cache);
 	cache_announce_changes (platform, priv->route_cache, old_route_cache);
+
+	nm_stats_probe_time (NM_STATS_PROBE_CACHE_REPOPULATE, start);
 }
 
 /******************************************************************/
@@ -4391,6 +5674,7 @@ udev_device_added (NMPlatform *platform,
 
 	g_hash_table_insert (priv->udev_devices, GINT_TO_POINTER (ifindex),
 	                     g_object_ref (udev_device));
+	g_hash_table_remove (priv->link_type_info, GINT_TO_POINTER (ifindex));
 
 	/* Announce devices only if they also have been discovered via Netlink. */
 	if (rtnllink && link_is_announceable (platform, rtnllink))
@@ -4434,6 +5718,7 @@ udev_device_removed (NMPlatform *platform,
 		was_announceable = link_is_announceable (platform, rtnllink);
 
 	g_hash_table_remove (priv->udev_devices, GINT_TO_POINTER (ifindex));
+	g_hash_table_remove (priv->link_type_info, GINT_TO_POINTER (ifindex));
 
 	/* Announce device removal if it is no longer announceable. */
 	if (was_announceable && !link_is_announceable (platform, rtnllink))
@@ -4486,15 +5771,29 @@ setup (NMPlatform *platform)
 	int channel_flags;
 	gboolean status;
 	int nle;
+	int one = 1;
 #if HAVE_LIBNL_INET6_ADDR_GEN_MODE
 	struct nl_object *object;
 #endif
 
+	priv->link_type_info = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) link_type_info_free);
+	priv->ip6_devconf = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+	priv->ip6_conf_dirs = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) ip6_conf_dir_free);
+	priv->link_stats = g_hash_table_new_full (NULL, NULL, NULL, link_stats_free);
+	priv->route_index = g_hash_table_new_full (NULL, NULL, NULL, route_index_entry_free);
+	priv->route_index_default = route_index_entry_new ();
+
 	/* Initialize netlink socket for requests */
 	priv->nlh = setup_socket (FALSE, platform);
 	g_assert (priv->nlh);
 	debug ("Netlink socket for requests established: %d", nl_socket_get_local_port (priv->nlh));
 
+	/* Room for the ACKs of a transaction batch. Without the echoed request
+	 * in each ACK, more of them fit; older kernels don't know the option. */
+	nle = nl_socket_set_buffer_size (priv->nlh, TRANSACTION_RCVBUF_SIZE, 0);
+	g_assert (!nle);
+	(void) setsockopt (nl_socket_get_fd (priv->nlh), SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof (one));
+
 	/* Initialize netlink socket for events */
 	priv->nlh_event = setup_socket (TRUE, platform);
 	g_assert (priv->nlh_event);
@@ -4590,10 +5889,18 @@ nm_linux_platform_finalize (GObject *object)
 	nl_socket_free (priv->nlh_event);
 	nl_cache_free (priv->link_cache);
 	nl_cache_free (priv->address_cache);
+	g_hash_table_unref (priv->route_index);
+	route_index_entry_free (priv->route_index_default);
 	nl_cache_free (priv->route_cache);
+	g_clear_pointer (&priv->transaction_ops, g_array_unref);
+	g_clear_pointer (&priv->transaction_refresh, g_array_unref);
 
 	g_object_unref (priv->udev_client);
 	g_hash_table_unref (priv->udev_devices);
+	g_hash_table_unref (priv->link_type_info);
+	g_hash_table_unref (priv->ip6_devconf);
+	g_hash_table_unref (priv->ip6_conf_dirs);
+	g_hash_table_unref (priv->link_stats);
 	g_hash_table_unref (priv->wifi_data);
 
 	G_OBJECT_CLASS (nm_linux_platform_parent_class)->finalize (object);
@@ -4616,6 +5923,8 @@ nm_linux_platform_class_init (NMLinuxPlatformClass *klass)
 
 	platform_class->sysctl_set = sysctl_set;
 	platform_class->sysctl_get = sysctl_get;
+	platform_class->link_ip6_conf_set = link_ip6_conf_set;
+	platform_class->link_ip6_conf_get = link_ip6_conf_get;
 
 	platform_class->link_get = _nm_platform_link_get;
 	platform_class->link_get_all = link_get_all;
@@ -4628,6 +5937,8 @@ nm_linux_platform_class_init (NMLinuxPlatformClass *klass)
 	platform_class->link_get_unmanaged = link_get_unmanaged;
 
 	platform_class->link_refresh = link_refresh;
+	platform_class->link_refresh_stats = link_refresh_stats;
+	platform_class->link_get_stats = link_get_stats;
 
 	platform_class->link_set_up = link_set_up;
 	platform_class->link_set_down = link_set_down;
@@ -4686,6 +5997,7 @@ nm_linux_platform_class_init (NMLinuxPlatformClass *klass)
 	platform_class->wifi_set_powersave = wifi_set_powersave;
 	platform_class->wifi_find_frequency = wifi_find_frequency;
 	platform_class->wifi_indicate_addressing_running = wifi_indicate_addressing_running;
+	platform_class->wifi_monitor_station = wifi_monitor_station;
 
 	platform_class->mesh_get_channel = mesh_get_channel;
 	platform_class->mesh_set_channel = mesh_set_channel;
@@ -4711,6 +6023,9 @@ nm_linux_platform_class_init (NMLinuxPlatformClass *klass)
 	platform_class->ip4_route_exists = ip4_route_exists;
 	platform_class->ip6_route_exists = ip6_route_exists;
 
+	platform_class->transaction_begin = transaction_begin;
+	platform_class->transaction_commit = transaction_commit;
+
 	platform_class->check_support_kernel_extended_ifa_flags = check_support_kernel_extended_ifa_flags;
 	platform_class->check_support_user_ipv6ll = check_support_user_ipv6ll;
 }
@@ -26,6 +26,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <netlink/route/addr.h>
 
 #include "gsystem-local-alloc.h"
@@ -39,8 +40,20 @@
 
 #define debug(...) nm_log_dbg (LOGD_PLATFORM, __VA_ARGS__)
 
+typedef struct {
+	GHashTable *stats_subscribers;  /* subscriber :: LinkStatsSubscription */
+	guint stats_refresh_rate_ms;
+	guint stats_refresh_id;
+	guint transaction_depth;
+} NMPlatformPrivate;
+
 #define NM_PLATFORM_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NM_TYPE_PLATFORM, NMPlatformPrivate))
 
+typedef struct {
+	int ifindex;
+	guint refresh_rate_ms;
+} LinkStatsSubscription;
+
 G_DEFINE_TYPE (NMPlatform, nm_platform, G_TYPE_OBJECT)
 
 /* NMPlatform signals */
@@ -50,6 +63,8 @@ enum {
 	SIGNAL_IP6_ADDRESS_CHANGED,
 	SIGNAL_IP4_ROUTE_CHANGED,
 	SIGNAL_IP6_ROUTE_CHANGED,
+	SIGNAL_LINK_STATS_CHANGED,
+	SIGNAL_WIFI_STATION_CHANGED,
 	LAST_SIGNAL
 };
 
@@ -218,6 +233,29 @@ reset_error (NMPlatform *self)
 	self->error = NM_PLATFORM_ERROR_NONE;
 }
 
+/* One socket serves all interface ioctls of the process: SIOCETHTOOL,
+ * the MII and wireless extension requests and the like. It is only a
+ * handle for the ioctl and carries no per-request state.
+ */
+static int ioctl_fd = -1;
+
+/**
+ * nm_platform_ioctl_socket:
+ *
+ * Returns: the socket to use for interface ioctls, or -1 if it couldn't
+ *   be created. It is shared by all users and must not be closed.
+ */
+int
+nm_platform_ioctl_socket (void)
+{
+	if (G_UNLIKELY (ioctl_fd < 0)) {
+		ioctl_fd = socket (PF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		if (ioctl_fd < 0)
+			nm_log_err (LOGD_PLATFORM, "couldn't open control socket: %s", strerror (errno));
+	}
+	return ioctl_fd;
+}
+
 #define IFA_F_MANAGETEMPADDR_STR "mngtmpaddr"
 #define IFA_F_NOPREFIXROUTE_STR "noprefixroute"
 gboolean
@@ -364,6 +402,87 @@ nm_platform_sysctl_get_int_checked (NMPlatform *self, const char *path, guint ba
 	return ret;
 }
 
+/**
+ * nm_platform_link_ip6_conf_set:
+ * @self: platform instance
+ * @ifindex: interface index
+ * @property: name of the IPv6 setting, as in /proc/sys/net/ipv6/conf/IFNAME/
+ * @value: value to write
+ *
+ * Sets a per-interface IPv6 setting. The value is always written, even
+ * if the platform believes the kernel already has it.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+nm_platform_link_ip6_conf_set (NMPlatform *self, int ifindex, const char *property, const char *value)
+{
+	const char *ifname;
+
+	_CHECK_SELF (self, klass, FALSE);
+
+	g_return_val_if_fail (ifindex > 0, FALSE);
+	g_return_val_if_fail (property, FALSE);
+	g_return_val_if_fail (value, FALSE);
+
+	if (klass->link_ip6_conf_set) {
+		reset_error (self);
+		return klass->link_ip6_conf_set (self, ifindex, property, value);
+	}
+
+	ifname = nm_platform_link_get_name (self, ifindex);
+	if (!ifname)
+		return FALSE;
+	return nm_platform_sysctl_set (self, nm_utils_ip6_property_path (ifname, property), value);
+}
+
+/**
+ * nm_platform_link_ip6_conf_get:
+ * @self: platform instance
+ * @ifindex: interface index
+ * @property: name of the IPv6 setting, as in /proc/sys/net/ipv6/conf/IFNAME/
+ *
+ * Returns: (transfer full): the value of the per-interface IPv6 setting,
+ *   or %NULL if it could not be read.
+ */
+char *
+nm_platform_link_ip6_conf_get (NMPlatform *self, int ifindex, const char *property)
+{
+	const char *ifname;
+
+	_CHECK_SELF (self, klass, NULL);
+
+	g_return_val_if_fail (ifindex > 0, NULL);
+	g_return_val_if_fail (property, NULL);
+
+	if (klass->link_ip6_conf_get) {
+		reset_error (self);
+		return klass->link_ip6_conf_get (self, ifindex, property);
+	}
+
+	ifname = nm_platform_link_get_name (self, ifindex);
+	if (!ifname)
+		return NULL;
+	return nm_platform_sysctl_get (self, nm_utils_ip6_property_path (ifname, property));
+}
+
+gint32
+nm_platform_link_ip6_conf_get_int32 (NMPlatform *self, int ifindex, const char *property, gint32 fallback)
+{
+	char *value;
+	gint32 ret;
+
+	value = nm_platform_link_ip6_conf_get (self, ifindex, property);
+	if (!value) {
+		errno = EINVAL;
+		return fallback;
+	}
+
+	ret = _nm_utils_ascii_str_to_int64 (value, 10, G_MININT32, G_MAXINT32, fallback);
+	g_free (value);
+	return ret;
+}
+
 /******************************************************************/
 
 /**
@@ -784,6 +903,168 @@ nm_platform_link_refresh (NMPlatform *self, int ifindex)
 	return TRUE;
 }
 
+/**
+ * nm_platform_link_get_stats:
+ * @self: platform instance
+ * @ifindex: Interface index
+ * @stats: (out): the traffic counters of the interface
+ *
+ * Returns the counters as of the last refresh. They are only refreshed
+ * periodically for the links somebody subscribed to with
+ * nm_platform_link_stats_subscribe().
+ *
+ * Returns: %TRUE if statistics for @ifindex are known.
+ */
+gboolean
+nm_platform_link_get_stats (NMPlatform *self, int ifindex, NMPlatformLinkStats *stats)
+{
+	_CHECK_SELF (self, klass, FALSE);
+	reset_error (self);
+
+	g_return_val_if_fail (ifindex > 0, FALSE);
+	g_return_val_if_fail (stats, FALSE);
+
+	if (!klass->link_get_stats)
+		return FALSE;
+	return klass->link_get_stats (self, ifindex, stats);
+}
+
+static void
+link_stats_subscription_free (gpointer data)
+{
+	g_slice_free (LinkStatsSubscription, data);
+}
+
+static gboolean
+link_stats_refresh_cb (gpointer user_data)
+{
+	NMPlatform *self = NM_PLATFORM (user_data);
+	NMPlatformPrivate *priv = NM_PLATFORM_GET_PRIVATE (self);
+	GArray *ifindexes;
+	GHashTableIter iter;
+	LinkStatsSubscription *sub;
+	guint i;
+
+	ifindexes = g_array_new (FALSE, FALSE, sizeof (int));
+	g_hash_table_iter_init (&iter, priv->stats_subscribers);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &sub)) {
+		if (sub->ifindex <= 0)
+			continue;
+		for (i = 0; i < ifindexes->len; i++) {
+			if (g_array_index (ifindexes, int, i) == sub->ifindex)
+				break;
+		}
+		if (i == ifindexes->len)
+			g_array_append_val (ifindexes, sub->ifindex);
+	}
+
+	if (   ifindexes->len
+	    && NM_PLATFORM_GET_CLASS (self)->link_refresh_stats (self, (const int *) ifindexes->data, ifindexes->len))
+		g_signal_emit (self, signals[SIGNAL_LINK_STATS_CHANGED], 0);
+	g_array_free (ifindexes, TRUE);
+	return G_SOURCE_CONTINUE;
+}
+
+/* Refreshes at the fastest rate any subscriber asked for. All subscribed
+ * links are refreshed at once, so that a link with several subscribers is
+ * only queried once per refresh.
+ */
+static void
+link_stats_reschedule (NMPlatform *self)
+{
+	NMPlatformPrivate *priv = NM_PLATFORM_GET_PRIVATE (self);
+	GHashTableIter iter;
+	LinkStatsSubscription *sub;
+	guint rate_ms = 0;
+
+	if (!NM_PLATFORM_GET_CLASS (self)->link_refresh_stats)
+		return;
+
+	if (priv->stats_subscribers) {
+		g_hash_table_iter_init (&iter, priv->stats_subscribers);
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &sub)) {
+			if (!rate_ms || sub->refresh_rate_ms < rate_ms)
+				rate_ms = sub->refresh_rate_ms;
+		}
+	}
+
+	if (rate_ms == priv->stats_refresh_rate_ms)
+		return;
+
+	if (rate_ms)
+		debug ("link statistics: refresh every %u ms", rate_ms);
+	else
+		debug ("link statistics: stop refreshing");
+
+	priv->stats_refresh_rate_ms = rate_ms;
+	if (priv->stats_refresh_id) {
+		g_source_remove (priv->stats_refresh_id);
+		priv->stats_refresh_id = 0;
+	}
+	if (rate_ms)
+		priv->stats_refresh_id = g_timeout_add (rate_ms, link_stats_refresh_cb, self);
+}
+
+/**
+ * nm_platform_link_stats_subscribe:
+ * @self: platform instance
+ * @subscriber: an opaque key identifying the caller
+ * @ifindex: the interface whose statistics the caller wants, or 0 if it
+ *   currently has none
+ * @refresh_rate_ms: how often the caller wants fresh statistics, must be
+ *   greater than zero
+ *
+ * Starts, or changes the interface or rate of, the periodic refresh of the
+ * link statistics. %NM_PLATFORM_SIGNAL_LINK_STATS_CHANGED is emitted after
+ * each refresh.
+ */
+void
+nm_platform_link_stats_subscribe (NMPlatform *self, gconstpointer subscriber, int ifindex, guint refresh_rate_ms)
+{
+	NMPlatformPrivate *priv;
+	LinkStatsSubscription *sub;
+
+	_CHECK_SELF_VOID (self, klass);
+
+	g_return_if_fail (subscriber);
+	g_return_if_fail (ifindex >= 0);
+	g_return_if_fail (refresh_rate_ms > 0);
+
+	priv = NM_PLATFORM_GET_PRIVATE (self);
+	if (!priv->stats_subscribers)
+		priv->stats_subscribers = g_hash_table_new_full (NULL, NULL, NULL, link_stats_subscription_free);
+
+	sub = g_hash_table_lookup (priv->stats_subscribers, subscriber);
+	if (!sub) {
+		sub = g_slice_new (LinkStatsSubscription);
+		g_hash_table_insert (priv->stats_subscribers, (gpointer) subscriber, sub);
+	}
+	sub->ifindex = ifindex;
+	sub->refresh_rate_ms = refresh_rate_ms;
+	link_stats_reschedule (self);
+}
+
+/**
+ * nm_platform_link_stats_unsubscribe:
+ * @self: platform instance
+ * @subscriber: the key passed to nm_platform_link_stats_subscribe()
+ *
+ * Drops the subscription of @subscriber, if any. The refresh stops once
+ * nobody is subscribed anymore.
+ */
+void
+nm_platform_link_stats_unsubscribe (NMPlatform *self, gconstpointer subscriber)
+{
+	NMPlatformPrivate *priv;
+
+	_CHECK_SELF_VOID (self, klass);
+
+	priv = NM_PLATFORM_GET_PRIVATE (self);
+	if (   priv->stats_subscribers
+	    && g_hash_table_remove (priv->stats_subscribers, subscriber))
+		link_stats_reschedule (self);
+}
+
 /**
  * nm_platform_link_is_up:
  * @self: platform instance
@@ -1643,6 +1924,32 @@ nm_platform_wifi_indicate_addressing_running (NMPlatform *self, int ifindex, gbo
 	klass->wifi_indicate_addressing_running (self, ifindex, running);
 }
 
+/**
+ * nm_platform_wifi_monitor_station:
+ * @self: platform instance
+ * @ifindex: interface index of a Wi-Fi device
+ * @enable: whether to start or stop monitoring
+ *
+ * Starts having %NM_PLATFORM_SIGNAL_WIFI_STATION_CHANGED emitted for
+ * @ifindex when signal quality or bitrate of the current association
+ * change. While monitored, nm_platform_wifi_get_quality() and
+ * nm_platform_wifi_get_rate() are cheap.
+ *
+ * Returns: %FALSE if the device can't be monitored and has to be polled.
+ */
+gboolean
+nm_platform_wifi_monitor_station (NMPlatform *self, int ifindex, gboolean enable)
+{
+	_CHECK_SELF (self, klass, FALSE);
+	reset_error (self);
+
+	g_return_val_if_fail (ifindex > 0, FALSE);
+
+	if (!klass->wifi_monitor_station)
+		return FALSE;
+	return klass->wifi_monitor_station (self, ifindex, enable);
+}
+
 guint32
 nm_platform_mesh_get_channel (NMPlatform *self, int ifindex)
 {
@@ -1988,6 +2295,72 @@ nm_platform_ip4_check_reinstall_device_route (NMPlatform *self, int ifindex, con
 	return klass->ip4_check_reinstall_device_route (self, ifindex, address, device_route_metric);
 }
 
+/**
+ * nm_platform_transaction_begin:
+ * @self: platform instance
+ *
+ * Starts collecting address and route changes. Until the matching
+ * nm_platform_transaction_commit(), the add and delete functions for
+ * addresses and routes may only queue the request and return %TRUE; the
+ * kernel's verdict is reported by the commit.
+ *
+ * Transactions nest. Only the outermost commit sends the queued requests
+ * and reports failures.
+ */
+void
+nm_platform_transaction_begin (NMPlatform *self)
+{
+	NMPlatformPrivate *priv;
+
+	_CHECK_SELF_VOID (self, klass);
+
+	priv = NM_PLATFORM_GET_PRIVATE (self);
+	if (priv->transaction_depth++ == 0 && klass->transaction_begin)
+		klass->transaction_begin (self);
+}
+
+/**
+ * nm_platform_transaction_commit:
+ * @self: platform instance
+ * @failed_func: (allow-none): called for each queued request that failed
+ * @user_data: data for @failed_func
+ *
+ * Sends the requests queued since nm_platform_transaction_begin() and
+ * updates the cache once all of them are acknowledged. The change signals
+ * are emitted only then.
+ *
+ * Returns: %TRUE if all queued requests succeeded.
+ */
+gboolean
+nm_platform_transaction_commit (NMPlatform *self, NMPlatformTransactionFailedFunc failed_func, gpointer user_data)
+{
+	NMPlatformPrivate *priv;
+
+	_CHECK_SELF (self, klass, FALSE);
+
+	priv = NM_PLATFORM_GET_PRIVATE (self);
+	g_return_val_if_fail (priv->transaction_depth > 0, FALSE);
+
+	if (--priv->transaction_depth > 0 || !klass->transaction_commit)
+		return TRUE;
+	return klass->transaction_commit (self, failed_func, user_data);
+}
+
+static void
+address_sync_failed_cb (NMPlatform *self,
+                        NMPlatformTransactionObject object_type,
+                        gboolean add,
+                        gconstpointer object,
+                        gpointer user_data)
+{
+	/* Like with the immediate calls, only failing to add an address fails
+	 * the sync. */
+	if (   add
+	    && (   object_type == NM_PLATFORM_TRANSACTION_IP4_ADDRESS
+	        || object_type == NM_PLATFORM_TRANSACTION_IP6_ADDRESS))
+		*((gboolean *) user_data) = FALSE;
+}
+
 /**
  * nm_platform_ip4_address_sync:
  * @self: platform instance
@@ -2000,6 +2373,9 @@ nm_platform_ip4_check_reinstall_device_route (NMPlatform *self, int ifindex, con
  * with the least possible disturbance. It simply removes addresses that are
  * not listed and adds addresses that are.
  *
+ * Do not call it inside a transaction: replacing the kernel's device routes
+ * needs the addresses to be committed first.
+ *
  * Returns: %TRUE on success.
  */
 gboolean
@@ -2007,11 +2383,16 @@ nm_platform_ip4_address_sync (NMPlatform *self, int ifindex, const GArray *known
 {
 	GArray *addresses;
 	NMPlatformIP4Address *address;
+	GPtrArray *reinstall;
 	guint32 now = nm_utils_get_monotonic_timestamp_s ();
+	gboolean success = TRUE;
 	int i;
 
 	_CHECK_SELF (self, klass, FALSE);
 
+	reinstall = g_ptr_array_new ();
+	nm_platform_transaction_begin (self);
+
 	/* Delete unknown addresses */
 	addresses = nm_platform_ip4_address_get_all (self, ifindex);
 	for (i = 0; i < addresses->len; i++) {
@@ -2022,44 +2403,54 @@ nm_platform_ip4_address_sync (NMPlatform *self, int ifindex, const GArray *known
 	}
 	g_array_free (addresses, TRUE);
 
-	if (!known_addresses)
-		return TRUE;
-
 	/* Add missing addresses */
-	for (i = 0; i < known_addresses->len; i++) {
+	for (i = 0; known_addresses && i < known_addresses->len; i++) {
 		const NMPlatformIP4Address *known_address = &g_array_index (known_addresses, NMPlatformIP4Address, i);
 		guint32 lifetime, preferred;
-		guint32 network;
-		gboolean reinstall_device_route = FALSE;
 
 		/* add a padding of 5 seconds to avoid potential races. */
 		if (!_address_get_lifetime ((NMPlatformIPAddress *) known_address, now, 5, &lifetime, &preferred))
 			continue;
 
 		if (nm_platform_ip4_check_reinstall_device_route (self, ifindex, known_address, device_route_metric))
-			reinstall_device_route = TRUE;
+			g_ptr_array_add (reinstall, (gpointer) known_address);
 
-		if (!nm_platform_ip4_address_add (self, ifindex, known_address->address, known_address->peer_address, known_address->plen, lifetime, preferred, known_address->label))
-			return FALSE;
+		if (!nm_platform_ip4_address_add (self, ifindex, known_address->address, known_address->peer_address, known_address->plen, lifetime, preferred, known_address->label)) {
+			success = FALSE;
+			break;
+		}
+	}
+
+	nm_platform_transaction_commit (self, address_sync_failed_cb, &success);
+
+	/* Kernel automatically adds a device route for us with metric 0. That is not what we want.
+	 * Remove it, and re-add it.
+	 *
+	 * The kernel routes only exist once the addresses were committed; while the adds are
+	 * queued, deleting the metric 0 route would find nothing to delete.
+	 *
+	 * In face of having the same subnets on two different interfaces with the same metric,
+	 * this is a problem. Surprisingly, kernel is able to add two routes for the same subnet/prefix,metric
+	 * to different interfaces. We cannot. Adding one, would replace the other. This is avoided
+	 * by the above nm_platform_ip4_check_reinstall_device_route() check.
+	 */
+	if (reinstall->len) {
+		nm_platform_transaction_begin (self);
+		for (i = 0; i < reinstall->len; i++) {
+			const NMPlatformIP4Address *known_address = reinstall->pdata[i];
+			guint32 network;
 
-		if (reinstall_device_route) {
-			/* Kernel automatically adds a device route for us with metric 0. That is not what we want.
-			 * Remove it, and re-add it.
-			 *
-			 * In face of having the same subnets on two different interfaces with the same metric,
-			 * this is a problem. Surprisingly, kernel is able to add two routes for the same subnet/prefix,metric
-			 * to different interfaces. We cannot. Adding one, would replace the other. This is avoided
-			 * by the above nm_platform_ip4_check_reinstall_device_route() check.
-			 */
 			network = nm_utils_ip4_address_clear_host_address (known_address->address, known_address->plen);
 			(void) nm_platform_ip4_route_add (self, ifindex, NM_IP_CONFIG_SOURCE_KERNEL, network, known_address->plen,
 			                                  0, known_address->address, device_route_metric, 0);
 			(void) nm_platform_ip4_route_delete (self, ifindex, network, known_address->plen,
 			                                     NM_PLATFORM_ROUTE_METRIC_IP4_DEVICE_ROUTE);
 		}
+		nm_platform_transaction_commit (self, NULL, NULL);
 	}
 
-	return TRUE;
+	g_ptr_array_unref (reinstall);
+	return success;
 }
 
 /**
@@ -2081,8 +2472,11 @@ nm_platform_ip6_address_sync (NMPlatform *self, int ifindex, const GArray *known
 	GArray *addresses;
 	NMPlatformIP6Address *address;
 	guint32 now = nm_utils_get_monotonic_timestamp_s ();
+	gboolean success = TRUE;
 	int i;
 
+	nm_platform_transaction_begin (self);
+
 	/* Delete unknown addresses */
 	addresses = nm_platform_ip6_address_get_all (self, ifindex);
 	for (i = 0; i < addresses->len; i++) {
@@ -2097,11 +2491,8 @@ nm_platform_ip6_address_sync (NMPlatform *self, int ifindex, const GArray *known
 	}
 	g_array_free (addresses, TRUE);
 
-	if (!known_addresses)
-		return TRUE;
-
 	/* Add missing addresses */
-	for (i = 0; i < known_addresses->len; i++) {
+	for (i = 0; known_addresses && i < known_addresses->len; i++) {
 		const NMPlatformIP6Address *known_address = &g_array_index (known_addresses, NMPlatformIP6Address, i);
 		guint32 lifetime, preferred;
 
@@ -2111,11 +2502,14 @@ nm_platform_ip6_address_sync (NMPlatform *self, int ifindex, const GArray *known
 
 		if (!nm_platform_ip6_address_add (self, ifindex, known_address->address,
 		                                  known_address->peer_address, known_address->plen,
-		                                  lifetime, preferred, known_address->flags))
-			return FALSE;
+		                                  lifetime, preferred, known_address->flags)) {
+			success = FALSE;
+			break;
+		}
 	}
 
-	return TRUE;
+	nm_platform_transaction_commit (self, address_sync_failed_cb, &success);
+	return success;
 }
 
 gboolean
@@ -2897,6 +3291,20 @@ nm_platform_init (NMPlatform *object)
 {
 }
 
+static void
+dispose (GObject *object)
+{
+	NMPlatformPrivate *priv = NM_PLATFORM_GET_PRIVATE (object);
+
+	if (priv->stats_refresh_id) {
+		g_source_remove (priv->stats_refresh_id);
+		priv->stats_refresh_id = 0;
+	}
+	g_clear_pointer (&priv->stats_subscribers, g_hash_table_unref);
+
+	G_OBJECT_CLASS (nm_platform_parent_class)->dispose (object);
+}
+
 #define SIGNAL(signal_id, method) signals[signal_id] = \
 	g_signal_new_class_handler (NM_PLATFORM_ ## signal_id, \
 		G_OBJECT_CLASS_TYPE (object_class), \
@@ -2910,6 +3318,10 @@ nm_platform_class_init (NMPlatformClass *platform_class)
 {
 	GObjectClass *object_class = G_OBJECT_CLASS (platform_class);
 
+	g_type_class_add_private (platform_class, sizeof (NMPlatformPrivate));
+
+	object_class->dispose = dispose;
+
 	platform_class->wifi_set_powersave = wifi_set_powersave;
 
 	/* Signals */
@@ -2918,4 +3330,20 @@ nm_platform_class_init (NMPlatformClass *platform_class)
 	SIGNAL (SIGNAL_IP6_ADDRESS_CHANGED, log_ip6_address)
 	SIGNAL (SIGNAL_IP4_ROUTE_CHANGED, log_ip4_route)
 	SIGNAL (SIGNAL_IP6_ROUTE_CHANGED, log_ip6_route)
+
+	signals[SIGNAL_LINK_STATS_CHANGED] =
+		g_signal_new (NM_PLATFORM_SIGNAL_LINK_STATS_CHANGED,
+		              G_OBJECT_CLASS_TYPE (object_class),
+		              G_SIGNAL_RUN_FIRST,
+		              0,
+		              NULL, NULL, NULL,
+		              G_TYPE_NONE, 0);
+
+	signals[SIGNAL_WIFI_STATION_CHANGED] =
+		g_signal_new (NM_PLATFORM_SIGNAL_WIFI_STATION_CHANGED,
+		              G_OBJECT_CLASS_TYPE (object_class),
+		              G_SIGNAL_RUN_FIRST,
+		              0,
+		              NULL, NULL, NULL,
+		              G_TYPE_NONE, 1, G_TYPE_INT);
 }
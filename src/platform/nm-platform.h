@@ -96,6 +96,14 @@ struct _NMPlatformLink {
 	guint mtu;
 };
 
+/* Traffic counters of a link, as reported by the kernel */
+typedef struct {
+	guint64 rx_packets;
+	guint64 rx_bytes;
+	guint64 tx_packets;
+	guint64 tx_bytes;
+} NMPlatformLinkStats;
+
 typedef enum {
 	NM_PLATFORM_SIGNAL_ADDED,
 	NM_PLATFORM_SIGNAL_CHANGED,
@@ -104,6 +112,13 @@ typedef enum {
 
 #define NM_PLATFORM_LIFETIME_PERMANENT G_MAXUINT32
 
+typedef enum {
+	NM_PLATFORM_TRANSACTION_IP4_ADDRESS,
+	NM_PLATFORM_TRANSACTION_IP6_ADDRESS,
+	NM_PLATFORM_TRANSACTION_IP4_ROUTE,
+	NM_PLATFORM_TRANSACTION_IP6_ROUTE,
+} NMPlatformTransactionObject;
+
 typedef enum {
 	NM_PLATFORM_GET_ROUTE_MODE_ALL,
 	NM_PLATFORM_GET_ROUTE_MODE_NO_DEFAULT,
@@ -261,6 +276,15 @@ typedef struct {
 	guint32 (*metric_normalize) (guint32 metric);
 } NMPlatformVTableRoute;
 
+/* Reports an operation of a transaction that the kernel rejected. @object
+ * is a NMPlatformIP4Address, NMPlatformIP6Address, NMPlatformIP4Route or
+ * NMPlatformIP6Route, depending on @object_type. */
+typedef void (*NMPlatformTransactionFailedFunc) (NMPlatform *self,
+                                                 NMPlatformTransactionObject object_type,
+                                                 gboolean add,
+                                                 gconstpointer object,
+                                                 gpointer user_data);
+
 extern const NMPlatformVTableRoute nm_platform_vtable_route_v4;
 extern const NMPlatformVTableRoute nm_platform_vtable_route_v6;
 
@@ -362,6 +386,9 @@ typedef struct {
 	gboolean (*sysctl_set) (NMPlatform *, const char *path, const char *value);
 	char * (*sysctl_get) (NMPlatform *, const char *path);
 
+	gboolean (*link_ip6_conf_set) (NMPlatform *, int ifindex, const char *property, const char *value);
+	char * (*link_ip6_conf_get) (NMPlatform *, int ifindex, const char *property);
+
 	gboolean (*link_get) (NMPlatform *platform, int ifindex, NMPlatformLink *link);
 	GArray *(*link_get_all) (NMPlatform *);
 	gboolean (*link_add) (NMPlatform *, const char *name, NMLinkType type, const void *address, size_t address_len);
@@ -373,6 +400,8 @@ typedef struct {
 	gboolean (*link_get_unmanaged) (NMPlatform *, int ifindex, gboolean *managed);
 
 	gboolean (*link_refresh) (NMPlatform *, int ifindex);
+	gboolean (*link_refresh_stats) (NMPlatform *, const int *ifindexes, guint n_ifindexes);
+	gboolean (*link_get_stats) (NMPlatform *, int ifindex, NMPlatformLinkStats *stats);
 
 	gboolean (*link_set_up) (NMPlatform *, int ifindex);
 	gboolean (*link_set_down) (NMPlatform *, int ifindex);
@@ -431,6 +460,7 @@ typedef struct {
 	void        (*wifi_set_powersave)    (NMPlatform *, int ifindex, guint32 powersave);
 	guint32     (*wifi_find_frequency)   (NMPlatform *, int ifindex, const guint32 *freqs);
 	void        (*wifi_indicate_addressing_running) (NMPlatform *, int ifindex, gboolean running);
+	gboolean    (*wifi_monitor_station)  (NMPlatform *, int ifindex, gboolean enable);
 
 	guint32     (*mesh_get_channel)      (NMPlatform *, int ifindex);
 	gboolean    (*mesh_set_channel)      (NMPlatform *, int ifindex, guint32 channel);
@@ -465,6 +495,9 @@ typedef struct {
 	gboolean (*ip4_route_exists) (NMPlatform *, int ifindex, in_addr_t network, int plen, guint32 metric);
 	gboolean (*ip6_route_exists) (NMPlatform *, int ifindex, struct in6_addr network, int plen, guint32 metric);
 
+	void (*transaction_begin) (NMPlatform *);
+	gboolean (*transaction_commit) (NMPlatform *, NMPlatformTransactionFailedFunc failed_func, gpointer user_data);
+
 	gboolean (*check_support_kernel_extended_ifa_flags) (NMPlatform *);
 	gboolean (*check_support_user_ipv6ll) (NMPlatform *);
 } NMPlatformClass;
@@ -486,6 +519,13 @@ typedef struct {
 #define NM_PLATFORM_SIGNAL_IP4_ROUTE_CHANGED "ip4-route-changed"
 #define NM_PLATFORM_SIGNAL_IP6_ROUTE_CHANGED "ip6-route-changed"
 
+/* Emitted without arguments after the link statistics were refreshed. */
+#define NM_PLATFORM_SIGNAL_LINK_STATS_CHANGED "link-stats-changed"
+
+/* Emitted with the ifindex when signal quality or bitrate of a monitored
+ * Wi-Fi station changed, see nm_platform_wifi_monitor_station(). */
+#define NM_PLATFORM_SIGNAL_WIFI_STATION_CHANGED "wifi-station-changed"
+
 /******************************************************************/
 
 GType nm_platform_get_type (void);
@@ -509,6 +549,10 @@ char *nm_platform_sysctl_get (NMPlatform *self, const char *path);
 gint32 nm_platform_sysctl_get_int32 (NMPlatform *self, const char *path, gint32 fallback);
 gint64 nm_platform_sysctl_get_int_checked (NMPlatform *self, const char *path, guint base, gint64 min, gint64 max, gint64 fallback);
 
+gboolean nm_platform_link_ip6_conf_set (NMPlatform *self, int ifindex, const char *property, const char *value);
+char *nm_platform_link_ip6_conf_get (NMPlatform *self, int ifindex, const char *property);
+gint32 nm_platform_link_ip6_conf_get_int32 (NMPlatform *self, int ifindex, const char *property, gint32 fallback);
+
 gboolean nm_platform_link_get (NMPlatform *self, int ifindex, NMPlatformLink *link);
 GArray *nm_platform_link_get_all (NMPlatform *self);
 gboolean nm_platform_dummy_add (NMPlatform *self, const char *name);
@@ -526,6 +570,9 @@ gboolean nm_platform_link_is_software (NMPlatform *self, int ifindex);
 gboolean nm_platform_link_supports_slaves (NMPlatform *self, int ifindex);
 
 gboolean nm_platform_link_refresh (NMPlatform *self, int ifindex);
+gboolean nm_platform_link_get_stats (NMPlatform *self, int ifindex, NMPlatformLinkStats *stats);
+void nm_platform_link_stats_subscribe (NMPlatform *self, gconstpointer subscriber, int ifindex, guint refresh_rate_ms);
+void nm_platform_link_stats_unsubscribe (NMPlatform *self, gconstpointer subscriber);
 
 gboolean nm_platform_link_set_up (NMPlatform *self, int ifindex);
 gboolean nm_platform_link_set_down (NMPlatform *self, int ifindex);
@@ -584,6 +631,7 @@ void        nm_platform_wifi_set_mode         (NMPlatform *self, int ifindex, NM
 void        nm_platform_wifi_set_powersave    (NMPlatform *self, int ifindex, guint32 powersave);
 guint32     nm_platform_wifi_find_frequency   (NMPlatform *self, int ifindex, const guint32 *freqs);
 void        nm_platform_wifi_indicate_addressing_running (NMPlatform *self, int ifindex, gboolean running);
+gboolean    nm_platform_wifi_monitor_station  (NMPlatform *self, int ifindex, gboolean enable);
 
 guint32     nm_platform_mesh_get_channel      (NMPlatform *self, int ifindex);
 gboolean    nm_platform_mesh_set_channel      (NMPlatform *self, int ifindex, guint32 channel);
@@ -606,6 +654,9 @@ gboolean nm_platform_ip4_address_sync (NMPlatform *self, int ifindex, const GArr
 gboolean nm_platform_ip6_address_sync (NMPlatform *self, int ifindex, const GArray *known_addresses, gboolean keep_link_local);
 gboolean nm_platform_address_flush (NMPlatform *self, int ifindex);
 
+void nm_platform_transaction_begin (NMPlatform *self);
+gboolean nm_platform_transaction_commit (NMPlatform *self, NMPlatformTransactionFailedFunc failed_func, gpointer user_data);
+
 gboolean nm_platform_ip4_check_reinstall_device_route (NMPlatform *self, int ifindex, const NMPlatformIP4Address *address, guint32 device_route_metric);
 
 GArray *nm_platform_ip4_route_get_all (NMPlatform *self, int ifindex, NMPlatformGetRouteMode mode);
@@ -637,6 +688,8 @@ gboolean nm_platform_check_support_libnl_extended_ifa_flags (void);
 gboolean nm_platform_check_support_kernel_extended_ifa_flags (NMPlatform *self);
 gboolean nm_platform_check_support_user_ipv6ll (NMPlatform *self);
 
+int nm_platform_ioctl_socket (void);
+
 void nm_platform_addr_flags2str (int flags, char *buf, size_t size);
 
 int nm_platform_ip_address_cmp_expiry (const NMPlatformIPAddress *a, const NMPlatformIPAddress *b);
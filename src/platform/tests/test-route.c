@@ -311,6 +311,186 @@ test_ip6_route (void)
 	free_signal (route_removed);
 }
 
+static void
+ip4_transaction_failed (NMPlatform *platform,
+                        NMPlatformTransactionObject object_type,
+                        gboolean add,
+                        gconstpointer object,
+                        gpointer user_data)
+{
+	const NMPlatformIP4Route *route = object;
+
+	g_assert_cmpint (object_type, ==, NM_PLATFORM_TRANSACTION_IP4_ROUTE);
+	g_assert (add);
+	g_assert_cmpint (route->plen, ==, 24);
+	(*((guint *) user_data))++;
+}
+
+/* Whether a route that is added and deleted again within one transaction
+ * is signalled at all depends on the platform, so the transaction test
+ * counts the signals for the other routes only.
+ */
+typedef struct {
+	int ifindex;
+	guint32 metric;
+	in_addr_t transient;
+	guint added;
+	guint removed;
+} RouteSignalCounts;
+
+static void
+ip4_route_count_callback (NMPlatform *platform, int ifindex, NMPlatformIP4Route *received, NMPlatformSignalChangeType change_type, NMPlatformReason reason, RouteSignalCounts *counts)
+{
+	g_assert (received);
+	g_assert_cmpint (received->ifindex, ==, ifindex);
+
+	if (   ifindex != counts->ifindex
+	    || received->metric != counts->metric
+	    || received->network == counts->transient)
+		return;
+
+	if (change_type == NM_PLATFORM_SIGNAL_ADDED)
+		counts->added++;
+	else if (change_type == NM_PLATFORM_SIGNAL_REMOVED)
+		counts->removed++;
+}
+
+static void
+test_ip4_route_transaction (void)
+{
+	int ifindex = nm_platform_link_get_ifindex (NM_PLATFORM_GET, DEVICE_NAME);
+	RouteSignalCounts counts = { 0 };
+	gulong handler_id;
+	in_addr_t network1 = nmtst_inet4_from_string ("192.0.2.1");
+	in_addr_t network2 = nmtst_inet4_from_string ("192.0.2.2");
+	in_addr_t network3 = nmtst_inet4_from_string ("192.0.2.3");
+	in_addr_t network4 = nmtst_inet4_from_string ("198.51.100.0");
+	in_addr_t gateway = nmtst_inet4_from_string ("203.0.113.1");
+	guint32 metric = 22986;
+	guint n_failed = 0;
+
+	counts.ifindex = ifindex;
+	counts.metric = metric;
+	counts.transient = network2;
+	handler_id = g_signal_connect (NM_PLATFORM_GET, NM_PLATFORM_SIGNAL_IP4_ROUTE_CHANGED,
+	                               G_CALLBACK (ip4_route_count_callback), &counts);
+
+	nm_platform_transaction_begin (NM_PLATFORM_GET);
+
+	g_assert (nm_platform_ip4_route_add (NM_PLATFORM_GET, ifindex, NM_IP_CONFIG_SOURCE_USER, network1, 32, INADDR_ANY, 0, metric, 0));
+	g_assert (nm_platform_ip4_route_add (NM_PLATFORM_GET, ifindex, NM_IP_CONFIG_SOURCE_USER, network2, 32, INADDR_ANY, 0, metric, 0));
+	g_assert (nm_platform_ip4_route_add (NM_PLATFORM_GET, ifindex, NM_IP_CONFIG_SOURCE_USER, network3, 32, INADDR_ANY, 0, metric, 0));
+	g_assert (nm_platform_ip4_route_delete (NM_PLATFORM_GET, ifindex, network2, 32, metric));
+
+	/* Unreachable gateway. Depending on the platform the failure is reported
+	 * right away or on commit. */
+	if (!nm_platform_ip4_route_add (NM_PLATFORM_GET, ifindex, NM_IP_CONFIG_SOURCE_USER, network4, 24, gateway, 0, metric, 0))
+		n_failed++;
+
+	nm_platform_transaction_commit (NM_PLATFORM_GET, ip4_transaction_failed, &n_failed);
+	g_assert_cmpint (n_failed, ==, 1);
+
+	g_assert_cmpint (counts.added, ==, 2);
+	g_assert_cmpint (counts.removed, ==, 0);
+
+	assert_ip4_route_exists (TRUE,  DEVICE_NAME, network1, 32, metric);
+	assert_ip4_route_exists (FALSE, DEVICE_NAME, network2, 32, metric);
+	assert_ip4_route_exists (TRUE,  DEVICE_NAME, network3, 32, metric);
+	assert_ip4_route_exists (FALSE, DEVICE_NAME, network4, 24, metric);
+
+	/* Clean up, again as one transaction */
+	nm_platform_transaction_begin (NM_PLATFORM_GET);
+	g_assert (nm_platform_ip4_route_delete (NM_PLATFORM_GET, ifindex, network1, 32, metric));
+	g_assert (nm_platform_ip4_route_delete (NM_PLATFORM_GET, ifindex, network3, 32, metric));
+	g_assert (nm_platform_transaction_commit (NM_PLATFORM_GET, NULL, NULL));
+
+	g_assert_cmpint (counts.added, ==, 2);
+	g_assert_cmpint (counts.removed, ==, 2);
+
+	assert_ip4_route_exists (FALSE, DEVICE_NAME, network1, 32, metric);
+	assert_ip4_route_exists (FALSE, DEVICE_NAME, network3, 32, metric);
+
+	g_signal_handler_disconnect (NM_PLATFORM_GET, handler_id);
+}
+
+/* More requests than fit into one batch, and more ACKs than fit into the
+ * default socket receive buffer */
+static void
+test_ip4_route_transaction_large (void)
+{
+	int ifindex = nm_platform_link_get_ifindex (NM_PLATFORM_GET, DEVICE_NAME);
+	in_addr_t base = nmtst_inet4_from_string ("10.128.0.0");
+	guint32 metric = 22988;
+	const guint n_routes = 500;
+	guint n_failed = 0;
+	GArray *routes;
+	guint i, n_found;
+
+	nm_platform_transaction_begin (NM_PLATFORM_GET);
+	for (i = 0; i < n_routes; i++) {
+		g_assert (nm_platform_ip4_route_add (NM_PLATFORM_GET, ifindex, NM_IP_CONFIG_SOURCE_USER,
+		                                     htonl (ntohl (base) + i), 32, INADDR_ANY, 0, metric, 0));
+	}
+	nm_platform_transaction_commit (NM_PLATFORM_GET, ip4_transaction_failed, &n_failed);
+	g_assert_cmpint (n_failed, ==, 0);
+
+	routes = nm_platform_ip4_route_get_all (NM_PLATFORM_GET, ifindex, NM_PLATFORM_GET_ROUTE_MODE_NO_DEFAULT);
+	for (i = 0, n_found = 0; i < routes->len; i++) {
+		if (g_array_index (routes, NMPlatformIP4Route, i).metric == metric)
+			n_found++;
+	}
+	g_assert_cmpint (n_found, ==, n_routes);
+	g_array_unref (routes);
+
+	assert_ip4_route_exists (TRUE, DEVICE_NAME, base, 32, metric);
+	assert_ip4_route_exists (TRUE, DEVICE_NAME, htonl (ntohl (base) + n_routes - 1), 32, metric);
+
+	nm_platform_transaction_begin (NM_PLATFORM_GET);
+	for (i = 0; i < n_routes; i++)
+		g_assert (nm_platform_ip4_route_delete (NM_PLATFORM_GET, ifindex, htonl (ntohl (base) + i), 32, metric));
+	nm_platform_transaction_commit (NM_PLATFORM_GET, ip4_transaction_failed, &n_failed);
+	g_assert_cmpint (n_failed, ==, 0);
+
+	routes = nm_platform_ip4_route_get_all (NM_PLATFORM_GET, ifindex, NM_PLATFORM_GET_ROUTE_MODE_NO_DEFAULT);
+	for (i = 0; i < routes->len; i++)
+		g_assert_cmpint (g_array_index (routes, NMPlatformIP4Route, i).metric, !=, metric);
+	g_array_unref (routes);
+
+	assert_ip4_route_exists (FALSE, DEVICE_NAME, base, 32, metric);
+}
+
+static void
+test_ip4_address_sync_device_route (void)
+{
+	int ifindex = nm_platform_link_get_ifindex (NM_PLATFORM_GET, DEVICE_NAME);
+	in_addr_t addr = nmtst_inet4_from_string ("198.51.100.1");
+	in_addr_t network = nmtst_inet4_from_string ("198.51.100.0");
+	guint32 metric = 22987;
+	NMPlatformIP4Address address = { 0 };
+	GArray *addresses;
+
+	address.ifindex = ifindex;
+	address.address = addr;
+	address.plen = 24;
+	address.timestamp = 0;
+	address.lifetime = NM_PLATFORM_LIFETIME_PERMANENT;
+	address.preferred = NM_PLATFORM_LIFETIME_PERMANENT;
+
+	addresses = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP4Address));
+	g_array_append_val (addresses, address);
+
+	/* The kernel's metric 0 prefix route is replaced by one with our metric */
+	g_assert (nm_platform_ip4_address_sync (NM_PLATFORM_GET, ifindex, addresses, metric));
+	assert_ip4_route_exists (TRUE, DEVICE_NAME, network, 24, metric);
+	assert_ip4_route_exists (FALSE, DEVICE_NAME, network, 24, NM_PLATFORM_ROUTE_METRIC_IP4_DEVICE_ROUTE);
+
+	g_array_set_size (addresses, 0);
+	g_assert (nm_platform_ip4_address_sync (NM_PLATFORM_GET, ifindex, addresses, metric));
+	nm_platform_ip4_route_delete (NM_PLATFORM_GET, ifindex, network, 24, metric);
+
+	g_array_unref (addresses);
+}
+
 void
 init_tests (int *argc, char ***argv)
 {
@@ -333,4 +513,10 @@ setup_tests (void)
 	g_test_add_func ("/route/ip4", test_ip4_route);
 	g_test_add_func ("/route/ip6", test_ip6_route);
 	g_test_add_func ("/route/ip4_metric0", test_ip4_route_metric0);
+	g_test_add_func ("/route/ip4_transaction", test_ip4_route_transaction);
+	g_test_add_func ("/route/ip4_transaction_large", test_ip4_route_transaction_large);
+
+	/* The fake platform leaves the device routes alone */
+	if (strcmp (g_type_name (G_TYPE_FROM_INSTANCE (nm_platform_get ())), "NMFakePlatform"))
+		g_test_add_func ("/route/ip4_address_sync_device_route", test_ip4_address_sync_device_route);
 }
@@ -0,0 +1,344 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <net/ethernet.h>
+
+#include <netlink/genl/genl.h>
+#include <linux/nl80211.h>
+
+#include "wifi/wifi-utils.h"
+#include "wifi/wifi-utils-nl80211.h"
+
+#include "nm-test-utils.h"
+
+#define TEST_IFINDEX 42
+
+/* Answers nl80211 requests like the kernel would for a station associated
+ * to a single AP. */
+static struct {
+	gboolean associated;
+	gboolean cqm_supported;
+	int signal_dbm;
+	guint16 bitrate;        /* in 100 kbps */
+
+	int cqm_threshold;
+	int cqm_hysteresis;
+
+	guint n_scan;
+	guint n_station;
+	guint n_cqm;
+} fake;
+
+static const guint8 fake_bssid[ETH_ALEN] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+
+static struct nl_msg *
+fake_msg_new (guint8 cmd, int ifindex)
+{
+	struct nl_msg *msg;
+
+	msg = nlmsg_alloc ();
+	g_assert (msg);
+	genlmsg_put (msg, 0, 0, 0, 0, 0, cmd, 0);
+	g_assert_cmpint (nla_put_u32 (msg, NL80211_ATTR_IFINDEX, ifindex), ==, 0);
+	return msg;
+}
+
+static int
+fake_nl80211 (struct nl_msg *msg,
+              int (*valid_handler) (struct nl_msg *, void *),
+              void *valid_data)
+{
+	struct genlmsghdr *gnlh = nlmsg_data (nlmsg_hdr (msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct nlattr *cqm[NL80211_ATTR_CQM_MAX + 1];
+	struct nl_msg *reply = NULL;
+	struct nlattr *nest, *rate;
+
+	g_assert_cmpint (nla_parse (tb, NL80211_ATTR_MAX, genlmsg_attrdata (gnlh, 0),
+	                            genlmsg_attrlen (gnlh, 0), NULL), ==, 0);
+	g_assert (tb[NL80211_ATTR_IFINDEX]);
+	g_assert_cmpint (nla_get_u32 (tb[NL80211_ATTR_IFINDEX]), ==, TEST_IFINDEX);
+
+	switch (gnlh->cmd) {
+	case NL80211_CMD_GET_SCAN:
+		fake.n_scan++;
+		if (!fake.associated)
+			return 0;
+
+		reply = fake_msg_new (NL80211_CMD_NEW_SCAN_RESULTS, TEST_IFINDEX);
+		nest = nla_nest_start (reply, NL80211_ATTR_BSS);
+		NLA_PUT (reply, NL80211_BSS_BSSID, ETH_ALEN, fake_bssid);
+		NLA_PUT_U32 (reply, NL80211_BSS_FREQUENCY, 2412);
+		NLA_PUT_U32 (reply, NL80211_BSS_STATUS, NL80211_BSS_STATUS_ASSOCIATED);
+		NLA_PUT_U32 (reply, NL80211_BSS_SIGNAL_MBM, (guint32) (fake.signal_dbm * 100));
+		nla_nest_end (reply, nest);
+		break;
+	case NL80211_CMD_GET_STATION:
+		fake.n_station++;
+		if (!fake.associated)
+			return -ENOENT;
+
+		g_assert (tb[NL80211_ATTR_MAC]);
+		g_assert (memcmp (nla_data (tb[NL80211_ATTR_MAC]), fake_bssid, ETH_ALEN) == 0);
+
+		reply = fake_msg_new (NL80211_CMD_NEW_STATION, TEST_IFINDEX);
+		nest = nla_nest_start (reply, NL80211_ATTR_STA_INFO);
+		NLA_PUT_U8 (reply, NL80211_STA_INFO_SIGNAL, (guint8) fake.signal_dbm);
+		rate = nla_nest_start (reply, NL80211_STA_INFO_TX_BITRATE);
+		NLA_PUT_U16 (reply, NL80211_RATE_INFO_BITRATE, fake.bitrate);
+		nla_nest_end (reply, rate);
+		nla_nest_end (reply, nest);
+		break;
+	case NL80211_CMD_SET_CQM:
+		fake.n_cqm++;
+		if (!fake.cqm_supported)
+			return -EOPNOTSUPP;
+
+		g_assert (tb[NL80211_ATTR_CQM]);
+		g_assert_cmpint (nla_parse_nested (cqm, NL80211_ATTR_CQM_MAX, tb[NL80211_ATTR_CQM], NULL), ==, 0);
+		g_assert (cqm[NL80211_ATTR_CQM_RSSI_THOLD]);
+		g_assert (cqm[NL80211_ATTR_CQM_RSSI_HYST]);
+		fake.cqm_threshold = (gint32) nla_get_u32 (cqm[NL80211_ATTR_CQM_RSSI_THOLD]);
+		fake.cqm_hysteresis = nla_get_u32 (cqm[NL80211_ATTR_CQM_RSSI_HYST]);
+		return 0;
+	default:
+		g_assert_not_reached ();
+	}
+
+	valid_handler (reply, valid_data);
+	nlmsg_free (reply);
+	return 0;
+
+nla_put_failure:
+	g_assert_not_reached ();
+	return -ENOMEM;
+}
+
+static void
+send_event (guint8 cmd, int ifindex)
+{
+	struct nl_msg *msg;
+
+	msg = fake_msg_new (cmd, ifindex);
+	_wifi_nl80211_process_event (msg);
+	nlmsg_free (msg);
+}
+
+static void
+station_changed_cb (int ifindex, gpointer user_data)
+{
+	guint *count = user_data;
+
+	g_assert_cmpint (ifindex, ==, TEST_IFINDEX);
+	(*count)++;
+}
+
+/* Allow for rounding in the dBm to percent conversion */
+static void
+assert_qual (WifiData *data, int expected)
+{
+	int qual = wifi_utils_get_qual (data);
+
+	g_assert_cmpint (qual, >=, expected - 1);
+	g_assert_cmpint (qual, <=, expected + 1);
+}
+
+/*****************************************************************************/
+
+static void
+test_station_monitor (void)
+{
+	WifiData *data;
+	guint changed = 0;
+	guint n_station, n_scan;
+
+	memset (&fake, 0, sizeof (fake));
+	fake.associated = TRUE;
+	fake.cqm_supported = TRUE;
+	fake.signal_dbm = -50;
+	fake.bitrate = 540;
+
+	data = _wifi_nl80211_new_for_testing ("wlan0", TEST_IFINDEX, fake_nl80211);
+	g_assert (data);
+
+	/* Without monitoring, every call queries the kernel */
+	assert_qual (data, 70);
+	g_assert_cmpint (fake.n_station, ==, 1);
+
+	g_assert (wifi_utils_monitor_station (data, station_changed_cb, &changed));
+	g_assert_cmpint (fake.cqm_threshold, ==, -50);
+	g_assert_cmpint (fake.cqm_hysteresis, >, 0);
+	g_assert_cmpint (changed, ==, 0);
+
+	/* While monitored, the values are cached... */
+	n_station = fake.n_station;
+	assert_qual (data, 70);
+	g_assert_cmpint (wifi_utils_get_rate (data), ==, 54000);
+	g_assert_cmpint (fake.n_station, ==, n_station);
+
+	/* ...until the kernel reports a change */
+	fake.signal_dbm = -60;
+	fake.bitrate = 240;
+	assert_qual (data, 70);
+
+	send_event (NL80211_CMD_NOTIFY_CQM, TEST_IFINDEX);
+	g_assert_cmpint (changed, ==, 1);
+	g_assert_cmpint (fake.n_station, ==, n_station + 1);
+	assert_qual (data, 60);
+	g_assert_cmpint (wifi_utils_get_rate (data), ==, 24000);
+	g_assert_cmpint (fake.cqm_threshold, ==, -60);
+
+	/* Events of other interfaces and unrelated events are ignored */
+	send_event (NL80211_CMD_NOTIFY_CQM, TEST_IFINDEX + 1);
+	send_event (NL80211_CMD_TRIGGER_SCAN, TEST_IFINDEX);
+	g_assert_cmpint (changed, ==, 1);
+	g_assert_cmpint (fake.n_station, ==, n_station + 1);
+
+	fake.associated = FALSE;
+	send_event (NL80211_CMD_DISCONNECT, TEST_IFINDEX);
+	g_assert_cmpint (changed, ==, 2);
+	assert_qual (data, 0);
+	g_assert_cmpint (wifi_utils_get_rate (data), ==, 0);
+
+	fake.associated = TRUE;
+	fake.signal_dbm = -40;
+	send_event (NL80211_CMD_CONNECT, TEST_IFINDEX);
+	g_assert_cmpint (changed, ==, 3);
+	assert_qual (data, 80);
+	g_assert_cmpint (fake.cqm_threshold, ==, -40);
+
+	fake.signal_dbm = -70;
+	send_event (NL80211_CMD_ROAM, TEST_IFINDEX);
+	g_assert_cmpint (changed, ==, 4);
+	assert_qual (data, 50);
+	g_assert_cmpint (fake.cqm_threshold, ==, -70);
+
+	/* The bitrate has no event and is polled, without a scan dump */
+	n_scan = fake.n_scan;
+	n_station = fake.n_station;
+	_wifi_nl80211_poll_stations ();
+	g_assert_cmpint (changed, ==, 4);
+
+	fake.bitrate = 110;
+	_wifi_nl80211_poll_stations ();
+	g_assert_cmpint (changed, ==, 5);
+	g_assert_cmpint (wifi_utils_get_rate (data), ==, 11000);
+	g_assert_cmpint (fake.n_station, ==, n_station + 2);
+	g_assert_cmpint (fake.n_scan, ==, n_scan);
+
+	/* Stopping disarms the threshold and polling works again */
+	g_assert (wifi_utils_monitor_station (data, NULL, NULL));
+	g_assert_cmpint (fake.cqm_threshold, ==, 0);
+
+	send_event (NL80211_CMD_NOTIFY_CQM, TEST_IFINDEX);
+	g_assert_cmpint (changed, ==, 5);
+
+	n_station = fake.n_station;
+	fake.signal_dbm = -50;
+	assert_qual (data, 70);
+	g_assert_cmpint (fake.n_station, ==, n_station + 1);
+
+	wifi_utils_deinit (data);
+}
+
+static void
+test_station_monitor_unsupported (void)
+{
+	WifiData *data;
+	guint changed = 0;
+
+	memset (&fake, 0, sizeof (fake));
+	fake.associated = TRUE;
+	fake.signal_dbm = -50;
+	fake.bitrate = 540;
+
+	data = _wifi_nl80211_new_for_testing ("wlan0", TEST_IFINDEX, fake_nl80211);
+	g_assert (data);
+
+	/* The caller has to fall back to polling */
+	g_assert (!wifi_utils_monitor_station (data, station_changed_cb, &changed));
+	g_assert_cmpint (fake.n_cqm, ==, 1);
+
+	send_event (NL80211_CMD_NOTIFY_CQM, TEST_IFINDEX);
+	g_assert_cmpint (changed, ==, 0);
+
+	fake.signal_dbm = -60;
+	assert_qual (data, 60);
+
+	wifi_utils_deinit (data);
+}
+
+static void
+test_station_monitor_events_failed (void)
+{
+	WifiData *data;
+	guint changed = 0;
+
+	memset (&fake, 0, sizeof (fake));
+	fake.associated = TRUE;
+	fake.cqm_supported = TRUE;
+	fake.signal_dbm = -50;
+	fake.bitrate = 540;
+
+	data = _wifi_nl80211_new_for_testing ("wlan0", TEST_IFINDEX, fake_nl80211);
+	g_assert (data);
+
+	g_assert (wifi_utils_monitor_station (data, station_changed_cb, &changed));
+	g_assert_cmpint (fake.cqm_threshold, ==, -50);
+
+	/* Without events, the threshold is disarmed and the signal is polled too */
+	_wifi_nl80211_fail_events ();
+	g_assert_cmpint (fake.cqm_threshold, ==, 0);
+	g_assert_cmpint (changed, ==, 0);
+
+	fake.signal_dbm = -60;
+	_wifi_nl80211_poll_stations ();
+	g_assert_cmpint (changed, ==, 1);
+	assert_qual (data, 60);
+	g_assert_cmpint (fake.cqm_threshold, ==, 0);
+
+	/* Once monitoring stopped, it is set up from scratch */
+	g_assert (wifi_utils_monitor_station (data, NULL, NULL));
+	g_assert (wifi_utils_monitor_station (data, station_changed_cb, &changed));
+	g_assert_cmpint (fake.cqm_threshold, ==, -60);
+
+	g_assert (wifi_utils_monitor_station (data, NULL, NULL));
+	wifi_utils_deinit (data);
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	nmtst_init_with_logging (&argc, &argv, NULL, "DEFAULT");
+
+	g_test_add_func ("/wifi/nl80211/station-monitor", test_station_monitor);
+	g_test_add_func ("/wifi/nl80211/station-monitor-unsupported", test_station_monitor_unsupported);
+	g_test_add_func ("/wifi/nl80211/station-monitor-events-failed", test_station_monitor_events_failed);
+
+	return g_test_run ();
+}
@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <net/ethernet.h>
 #include <unistd.h>
 #include <math.h>
@@ -43,16 +44,133 @@
 #include "nm-logging.h"
 #include "nm-utils.h"
 
+/* All devices share one generic netlink socket. The nl80211 family and
+ * its multicast groups are resolved once, when the first device is set
+ * up. Requests are synchronous and never interleave on the socket.
+ */
 typedef struct {
-	WifiData parent;
+	guint refcount;
 	struct nl_sock *nl_sock;
-	int id;
 	struct nl_cb *nl_cb;
+	int id;
+
+	/* Multicast group id of MLME events, negative if the kernel doesn't have it */
+	int mlme_group;
+
+	/* Station monitoring, see wifi_nl80211_monitor_station() */
+	struct nl_sock *event_sock;
+	guint event_id;
+	gboolean events_failed;
+	guint poll_id;
+	GHashTable *monitored;
+} Nl80211Socket;
+
+static Nl80211Socket *nl80211_socket = NULL;
+
+static WifiNl80211TestResponder test_responder = NULL;
+
+typedef struct {
+	WifiData parent;
+	Nl80211Socket *sock;
 	guint32 *freqs;
 	int num_freqs;
 	int phy;
+
+	/* While the station is monitored, signal and bitrate are refreshed
+	 * on events and by the bitrate poll, and get_qual()/get_rate() return
+	 * these. */
+	gboolean monitored;
+	int station_qual;
+	guint32 station_rate;
+	guint8 station_bssid[ETH_ALEN];
+	gboolean station_bssid_valid;
+	int cqm_threshold;
 } WifiDataNl80211;
 
+static void nl80211_event_socket_teardown (Nl80211Socket *sock);
+static void nl80211_poll_stop (Nl80211Socket *sock);
+static gboolean wifi_nl80211_monitor_station (WifiData *data, gboolean enable);
+
+static void
+nl80211_socket_free (Nl80211Socket *sock)
+{
+	nl80211_event_socket_teardown (sock);
+	nl80211_poll_stop (sock);
+	if (sock->monitored)
+		g_hash_table_unref (sock->monitored);
+	if (sock->nl_sock)
+		nl_socket_free (sock->nl_sock);
+	if (sock->nl_cb)
+		nl_cb_put (sock->nl_cb);
+	g_slice_free (Nl80211Socket, sock);
+}
+
+static Nl80211Socket *
+nl80211_socket_ref (void)
+{
+	Nl80211Socket *sock;
+
+	if (nl80211_socket) {
+		nl80211_socket->refcount++;
+		return nl80211_socket;
+	}
+
+	sock = g_slice_new0 (Nl80211Socket);
+	sock->refcount = 1;
+
+	sock->nl_sock = nl_socket_alloc ();
+	if (sock->nl_sock == NULL)
+		goto error;
+
+	if (genl_connect (sock->nl_sock))
+		goto error;
+
+	sock->id = genl_ctrl_resolve (sock->nl_sock, "nl80211");
+	if (sock->id < 0)
+		goto error;
+
+	sock->nl_cb = nl_cb_alloc (NL_CB_DEFAULT);
+	if (sock->nl_cb == NULL)
+		goto error;
+
+	sock->mlme_group = genl_ctrl_resolve_grp (sock->nl_sock, "nl80211", "mlme");
+
+	nm_log_dbg (LOGD_HW | LOGD_WIFI, "nl80211: family %d, mlme group %d",
+	            sock->id, sock->mlme_group);
+
+	nl80211_socket = sock;
+	return sock;
+
+error:
+	nl80211_socket_free (sock);
+	return NULL;
+}
+
+static void
+nl80211_socket_unref (Nl80211Socket *sock)
+{
+	g_return_if_fail (sock && sock->refcount > 0);
+
+	if (--sock->refcount > 0)
+		return;
+
+	if (nl80211_socket == sock)
+		nl80211_socket = NULL;
+	nl80211_socket_free (sock);
+}
+
+/* Throw away whatever is left of a failed request, so that the next
+ * request on the shared socket doesn't receive it. */
+static void
+nl80211_socket_drain (struct nl_sock *nl_sock)
+{
+	char buf[4096];
+	int fd = nl_socket_get_fd (nl_sock);
+
+	while (recv (fd, buf, sizeof (buf), MSG_DONTWAIT) > 0)
+		;
+}
+
 static int
 ack_handler (struct nl_msg *msg, void *arg)
 {
@@ -99,7 +217,7 @@ _nl80211_alloc_msg (int id, int ifindex, int phy, guint32 cmd, guint32 flags)
 static struct nl_msg *
 nl80211_alloc_msg (WifiDataNl80211 *nl80211, guint32 cmd, guint32 flags)
 {
-	return _nl80211_alloc_msg (nl80211->id, nl80211->parent.ifindex, nl80211->phy, cmd, flags);
+	return _nl80211_alloc_msg (nl80211->sock->id, nl80211->parent.ifindex, nl80211->phy, cmd, flags);
 }
 
 /* NOTE: this function consumes 'msg' */
@@ -149,6 +267,7 @@ _nl80211_send_and_recv (struct nl_sock *nl_sock,
 
 			nm_log_warn (LOGD_WIFI, "nl_recvmsgs() error: (%d) %s",
 			             err, nl_geterror (err));
+			nl80211_socket_drain (nl_sock);
 			break;
 		}
 	}
@@ -167,7 +286,17 @@ nl80211_send_and_recv (WifiDataNl80211 *nl80211,
                        int (*valid_handler) (struct nl_msg *, void *),
                        void *valid_data)
 {
-	return _nl80211_send_and_recv (nl80211->nl_sock, nl80211->nl_cb, msg,
+	if (G_UNLIKELY (test_responder)) {
+		int err;
+
+		g_return_val_if_fail (msg != NULL, -ENOMEM);
+
+		err = test_responder (msg, valid_handler, valid_data);
+		nlmsg_free (msg);
+		return err;
+	}
+
+	return _nl80211_send_and_recv (nl80211->sock->nl_sock, nl80211->sock->nl_cb, msg,
 	                               valid_handler, valid_data);
 }
 
@@ -176,10 +305,10 @@ wifi_nl80211_deinit (WifiData *parent)
 {
 	WifiDataNl80211 *nl80211 = (WifiDataNl80211 *) parent;
 
-	if (nl80211->nl_sock)
-		nl_socket_free (nl80211->nl_sock);
-	if (nl80211->nl_cb)
-		nl_cb_put (nl80211->nl_cb);
+	if (nl80211->monitored)
+		wifi_nl80211_monitor_station (parent, FALSE);
+	if (nl80211->sock)
+		nl80211_socket_unref (nl80211->sock);
 	g_free (nl80211->freqs);
 }
 
@@ -479,6 +608,7 @@ struct nl80211_station_info {
 	gboolean txrate_valid;
 	guint8 signal;
 	gboolean signal_valid;
+	gint8 signal_dbm;
 };
 
 static int
@@ -537,7 +667,8 @@ nl80211_station_handler (struct nl_msg *msg, void *arg)
 	info->txrate_valid = TRUE;
 
 	if (sinfo[NL80211_STA_INFO_SIGNAL] != NULL) {
-		info->signal = nl80211_xbm_to_percent ((gint8) nla_get_u8 (sinfo[NL80211_STA_INFO_SIGNAL]), 1);
+		info->signal_dbm = (gint8) nla_get_u8 (sinfo[NL80211_STA_INFO_SIGNAL]);
+		info->signal = nl80211_xbm_to_percent (info->signal_dbm, 1);
 		info->signal_valid = TRUE;
 	}
 
@@ -545,27 +676,18 @@ nl80211_station_handler (struct nl_msg *msg, void *arg)
 }
 
 static void
-nl80211_get_ap_info (WifiDataNl80211 *nl80211,
-                     struct nl80211_station_info *sta_info)
+nl80211_get_station_info (WifiDataNl80211 *nl80211,
+                          const guint8 *bssid,
+                          struct nl80211_station_info *sta_info)
 {
 	struct nl_msg *msg;
-	struct nl80211_bss_info bss_info;
 
 	memset(sta_info, 0, sizeof (*sta_info));
 
-	nl80211_get_bss_info (nl80211, &bss_info);
-	if (!bss_info.valid)
-		return;
-
 	msg = nl80211_alloc_msg (nl80211, NL80211_CMD_GET_STATION, 0);
 	if (msg) {
-		NLA_PUT (msg, NL80211_ATTR_MAC, ETH_ALEN, bss_info.bssid);
-
+		NLA_PUT (msg, NL80211_ATTR_MAC, ETH_ALEN, bssid);
 		nl80211_send_and_recv (nl80211, msg, nl80211_station_handler, sta_info);
-		if (!sta_info->signal_valid) {
-			/* Fall back to bss_info signal quality (both are in percent) */
-			sta_info->signal = bss_info.beacon_signal;
-		}
 	}
 
 	return;
@@ -575,13 +697,35 @@ nl80211_get_ap_info (WifiDataNl80211 *nl80211,
 	return;
 }
 
+static void
+nl80211_get_ap_info (WifiDataNl80211 *nl80211,
+                     struct nl80211_bss_info *bss_info,
+                     struct nl80211_station_info *sta_info)
+{
+	memset(sta_info, 0, sizeof (*sta_info));
+
+	nl80211_get_bss_info (nl80211, bss_info);
+	if (!bss_info->valid)
+		return;
+
+	nl80211_get_station_info (nl80211, bss_info->bssid, sta_info);
+	if (!sta_info->signal_valid) {
+		/* Fall back to bss_info signal quality (both are in percent) */
+		sta_info->signal = bss_info->beacon_signal;
+	}
+}
+
 static guint32
 wifi_nl80211_get_rate (WifiData *data)
 {
 	WifiDataNl80211 *nl80211 = (WifiDataNl80211 *) data;
+	struct nl80211_bss_info bss_info;
 	struct nl80211_station_info sta_info;
 
-	nl80211_get_ap_info (nl80211, &sta_info);
+	if (nl80211->monitored)
+		return nl80211->station_rate;
+
+	nl80211_get_ap_info (nl80211, &bss_info, &sta_info);
 
 	return sta_info.txrate;
 }
@@ -590,12 +734,355 @@ static int
 wifi_nl80211_get_qual (WifiData *data)
 {
 	WifiDataNl80211 *nl80211 = (WifiDataNl80211 *) data;
+	struct nl80211_bss_info bss_info;
 	struct nl80211_station_info sta_info;
 
-	nl80211_get_ap_info (nl80211, &sta_info);
+	if (nl80211->monitored)
+		return nl80211->station_qual;
+
+	nl80211_get_ap_info (nl80211, &bss_info, &sta_info);
 	return sta_info.signal;
 }
 
+/* Station monitoring
+ *
+ * Instead of polling signal and bitrate every few seconds, a second socket
+ * listens to the nl80211 "mlme" multicast group. The kernel is asked with
+ * NL80211_CMD_SET_CQM to notify us when the RSSI moves more than
+ * CQM_RSSI_HYSTERESIS dB away from the last known value. On such a
+ * notification, and on connect and roam events, the station is queried
+ * once and the threshold is moved to the new value.
+ *
+ * nl80211 has no event for bitrate changes of a client, so the bitrate is
+ * still polled, with a single GET_STATION to the known BSSID instead of a
+ * scan dump. If the event socket fails, the signal is polled along with it.
+ */
+
+#define CQM_RSSI_HYSTERESIS        4
+#define CQM_RSSI_DEFAULT_THRESHOLD -70
+#define STATION_POLL_INTERVAL      6  /* seconds */
+
+/* A threshold of 0 disables RSSI monitoring */
+static gboolean
+nl80211_set_cqm (WifiDataNl80211 *nl80211, int threshold)
+{
+	struct nl_msg *msg;
+	struct nlattr *cqm;
+	int err;
+
+	msg = nl80211_alloc_msg (nl80211, NL80211_CMD_SET_CQM, 0);
+	if (!msg)
+		return FALSE;
+
+	cqm = nla_nest_start (msg, NL80211_ATTR_CQM);
+	if (!cqm)
+		goto nla_put_failure;
+	NLA_PUT_U32 (msg, NL80211_ATTR_CQM_RSSI_THOLD, (guint32) threshold);
+	NLA_PUT_U32 (msg, NL80211_ATTR_CQM_RSSI_HYST, threshold ? CQM_RSSI_HYSTERESIS : 0);
+	nla_nest_end (msg, cqm);
+
+	err = nl80211_send_and_recv (nl80211, msg, NULL, NULL);
+	if (err < 0) {
+		nm_log_dbg (LOGD_WIFI, "(%s): failed to set RSSI threshold %d: %d",
+		            nl80211->parent.iface, threshold, err);
+		return FALSE;
+	}
+
+	nl80211->cqm_threshold = threshold;
+	return TRUE;
+
+ nla_put_failure:
+	nlmsg_free (msg);
+	return FALSE;
+}
+
+static void
+nl80211_station_update (WifiDataNl80211 *nl80211)
+{
+	struct nl80211_bss_info bss_info;
+	struct nl80211_station_info sta_info;
+	int threshold;
+
+	nl80211_get_ap_info (nl80211, &bss_info, &sta_info);
+	nl80211->station_qual = sta_info.signal;
+	nl80211->station_rate = sta_info.txrate;
+	nl80211->station_bssid_valid = bss_info.valid;
+	if (bss_info.valid)
+		memcpy (nl80211->station_bssid, bss_info.bssid, ETH_ALEN);
+
+	/* Without events, there is nothing to arm */
+	if (nl80211->sock->events_failed)
+		return;
+
+	if (sta_info.signal_valid)
+		threshold = MIN (sta_info.signal_dbm, -1);
+	else
+		threshold = CQM_RSSI_DEFAULT_THRESHOLD;
+
+	if (threshold != nl80211->cqm_threshold)
+		nl80211_set_cqm (nl80211, threshold);
+}
+
+static void
+nl80211_station_changed (WifiDataNl80211 *nl80211)
+{
+	if (nl80211->parent.station_changed)
+		nl80211->parent.station_changed (nl80211->parent.ifindex, nl80211->parent.station_changed_data);
+}
+
+static int
+nl80211_event_handler (struct nl_msg *msg, void *arg)
+{
+	Nl80211Socket *sock = arg;
+	struct genlmsghdr *gnlh = nlmsg_data (nlmsg_hdr (msg));
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	WifiDataNl80211 *nl80211;
+
+	if (!sock->monitored)
+		return NL_SKIP;
+
+	if (nla_parse (tb, NL80211_ATTR_MAX, genlmsg_attrdata (gnlh, 0),
+	               genlmsg_attrlen (gnlh, 0), NULL) < 0)
+		return NL_SKIP;
+
+	if (!tb[NL80211_ATTR_IFINDEX])
+		return NL_SKIP;
+
+	nl80211 = g_hash_table_lookup (sock->monitored,
+	                               GINT_TO_POINTER (nla_get_u32 (tb[NL80211_ATTR_IFINDEX])));
+	if (!nl80211)
+		return NL_SKIP;
+
+	switch (gnlh->cmd) {
+	case NL80211_CMD_NOTIFY_CQM:
+	case NL80211_CMD_CONNECT:
+	case NL80211_CMD_ROAM:
+		nl80211_station_update (nl80211);
+		break;
+	case NL80211_CMD_DISCONNECT:
+		nl80211->station_qual = 0;
+		nl80211->station_rate = 0;
+		nl80211->station_bssid_valid = FALSE;
+		break;
+	default:
+		return NL_SKIP;
+	}
+
+	nl80211_station_changed (nl80211);
+	return NL_SKIP;
+}
+
+static void
+nl80211_station_poll (WifiDataNl80211 *nl80211)
+{
+	struct nl80211_station_info sta_info;
+	int old_qual = nl80211->station_qual;
+	guint32 old_rate = nl80211->station_rate;
+
+	if (nl80211->sock->events_failed)
+		nl80211_station_update (nl80211);
+	else if (nl80211->station_bssid_valid) {
+		nl80211_get_station_info (nl80211, nl80211->station_bssid, &sta_info);
+		nl80211->station_rate = sta_info.txrate;
+	}
+
+	if (   nl80211->station_qual != old_qual
+	    || nl80211->station_rate != old_rate)
+		nl80211_station_changed (nl80211);
+}
+
+static gboolean
+nl80211_poll_cb (gpointer user_data)
+{
+	Nl80211Socket *sock = user_data;
+	GList *list, *iter;
+
+	list = g_hash_table_get_values (sock->monitored);
+	for (iter = list; iter; iter = iter->next)
+		nl80211_station_poll (iter->data);
+	g_list_free (list);
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+nl80211_poll_start (Nl80211Socket *sock)
+{
+	if (!sock->poll_id)
+		sock->poll_id = g_timeout_add_seconds (STATION_POLL_INTERVAL, nl80211_poll_cb, sock);
+}
+
+static void
+nl80211_poll_stop (Nl80211Socket *sock)
+{
+	if (sock->poll_id) {
+		g_source_remove (sock->poll_id);
+		sock->poll_id = 0;
+	}
+}
+
+/* The event socket is gone; keep the monitored stations up to date by
+ * polling signal and bitrate until monitoring stops for all of them. */
+static void
+nl80211_events_failed (Nl80211Socket *sock)
+{
+	GList *list, *iter;
+
+	nm_log_warn (LOGD_WIFI, "nl80211: event socket failed, polling stations instead");
+
+	nl80211_event_socket_teardown (sock);
+	if (!sock->monitored || g_hash_table_size (sock->monitored) == 0)
+		return;
+	sock->events_failed = TRUE;
+
+	list = g_hash_table_get_values (sock->monitored);
+	for (iter = list; iter; iter = iter->next) {
+		WifiDataNl80211 *nl80211 = iter->data;
+
+		if (nl80211->cqm_threshold)
+			nl80211_set_cqm (nl80211, 0);
+		nl80211->cqm_threshold = 0;
+		nl80211_station_poll (nl80211);
+	}
+	g_list_free (list);
+}
+
+static gboolean
+nl80211_event_cb (GIOChannel *channel, GIOCondition condition, gpointer user_data)
+{
+	Nl80211Socket *sock = user_data;
+	GList *list, *iter;
+	int err;
+
+	if (condition & (G_IO_HUP | G_IO_ERR)) {
+		/* The watch is removed by the teardown */
+		sock->event_id = 0;
+		nl80211_events_failed (sock);
+		return G_SOURCE_REMOVE;
+	}
+
+	err = nl_recvmsgs_default (sock->event_sock);
+	if (err == 0 || err == -NLE_AGAIN)
+		return G_SOURCE_CONTINUE;
+
+	/* Events may have been lost (e.g. the socket buffer overflowed),
+	 * refresh all monitored stations. */
+	nm_log_dbg (LOGD_WIFI, "nl80211: error receiving events: (%d) %s",
+	            err, nl_geterror (err));
+
+	list = g_hash_table_get_values (sock->monitored);
+	for (iter = list; iter; iter = iter->next) {
+		nl80211_station_update (iter->data);
+		nl80211_station_changed (iter->data);
+	}
+	g_list_free (list);
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+nl80211_event_socket_setup (Nl80211Socket *sock)
+{
+	GIOChannel *channel;
+	int err;
+
+	if (sock->event_sock)
+		return TRUE;
+
+	if (sock->mlme_group < 0)
+		return FALSE;
+
+	sock->event_sock = nl_socket_alloc ();
+	if (!sock->event_sock)
+		return FALSE;
+
+	nl_socket_disable_seq_check (sock->event_sock);
+	nl_socket_modify_cb (sock->event_sock, NL_CB_VALID, NL_CB_CUSTOM,
+	                     nl80211_event_handler, sock);
+
+	err = genl_connect (sock->event_sock);
+	if (!err)
+		err = nl_socket_add_membership (sock->event_sock, sock->mlme_group);
+	if (!err)
+		err = nl_socket_set_nonblocking (sock->event_sock);
+	if (err) {
+		nm_log_warn (LOGD_WIFI, "nl80211: failed to set up event socket: (%d) %s",
+		             err, nl_geterror (err));
+		nl_socket_free (sock->event_sock);
+		sock->event_sock = NULL;
+		return FALSE;
+	}
+
+	channel = g_io_channel_unix_new (nl_socket_get_fd (sock->event_sock));
+	sock->event_id = g_io_add_watch (channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+	                                 nl80211_event_cb, sock);
+	g_io_channel_unref (channel);
+	return TRUE;
+}
+
+static void
+nl80211_event_socket_teardown (Nl80211Socket *sock)
+{
+	if (sock->event_id) {
+		g_source_remove (sock->event_id);
+		sock->event_id = 0;
+	}
+	if (sock->event_sock) {
+		nl_socket_free (sock->event_sock);
+		sock->event_sock = NULL;
+	}
+}
+
+static gboolean
+wifi_nl80211_monitor_station (WifiData *data, gboolean enable)
+{
+	WifiDataNl80211 *nl80211 = (WifiDataNl80211 *) data;
+	Nl80211Socket *sock = nl80211->sock;
+
+	if (!enable) {
+		if (!nl80211->monitored)
+			return TRUE;
+
+		nl80211->monitored = FALSE;
+		g_hash_table_remove (sock->monitored, GINT_TO_POINTER (data->ifindex));
+		if (nl80211->cqm_threshold)
+			nl80211_set_cqm (nl80211, 0);
+		nl80211->cqm_threshold = 0;
+		if (g_hash_table_size (sock->monitored) == 0) {
+			nl80211_event_socket_teardown (sock);
+			nl80211_poll_stop (sock);
+			sock->events_failed = FALSE;
+		}
+		return TRUE;
+	}
+
+	if (nl80211->monitored)
+		return TRUE;
+
+	/* Stations already monitored are polled until they are done; new
+	 * ones go back to the caller's polling. */
+	if (sock->events_failed)
+		return FALSE;
+
+	if (!test_responder && !nl80211_event_socket_setup (sock))
+		return FALSE;
+
+	/* Fetch the current values and arm the RSSI threshold. Drivers that
+	 * can't report RSSI changes must be polled. */
+	nl80211->cqm_threshold = 0;
+	nl80211_station_update (nl80211);
+	if (!nl80211->cqm_threshold) {
+		if (!sock->monitored || g_hash_table_size (sock->monitored) == 0)
+			nl80211_event_socket_teardown (sock);
+		return FALSE;
+	}
+
+	if (!sock->monitored)
+		sock->monitored = g_hash_table_new (NULL, NULL);
+	g_hash_table_insert (sock->monitored, GINT_TO_POINTER (data->ifindex), nl80211);
+	nl80211->monitored = TRUE;
+	nl80211_poll_start (sock);
+	return TRUE;
+}
+
 #if HAVE_NL80211_CRITICAL_PROTOCOL_CMDS
 static gboolean
 wifi_nl80211_indicate_addressing_running (WifiData *data, gboolean running)
@@ -861,12 +1348,10 @@ static int nl80211_wiphy_info_handler (struct nl_msg *msg, void *arg)
 	return NL_SKIP;
 }
 
-WifiData *
-wifi_nl80211_init (const char *iface, int ifindex)
+static WifiDataNl80211 *
+nl80211_data_new (const char *iface, int ifindex)
 {
 	WifiDataNl80211 *nl80211;
-	struct nl_msg *msg;
-	struct nl80211_device_info device_info = {};
 
 	nl80211 = wifi_data_new (iface, ifindex, sizeof (*nl80211));
 	nl80211->parent.get_mode = wifi_nl80211_get_mode;
@@ -878,28 +1363,29 @@ wifi_nl80211_init (const char *iface, int ifindex)
 	nl80211->parent.get_bssid = wifi_nl80211_get_bssid;
 	nl80211->parent.get_rate = wifi_nl80211_get_rate;
 	nl80211->parent.get_qual = wifi_nl80211_get_qual;
+	nl80211->parent.monitor_station = wifi_nl80211_monitor_station;
 #if HAVE_NL80211_CRITICAL_PROTOCOL_CMDS
 	nl80211->parent.indicate_addressing_running = wifi_nl80211_indicate_addressing_running;
 #endif
 	nl80211->parent.deinit = wifi_nl80211_deinit;
+	nl80211->phy = -1;
 
-	nl80211->nl_sock = nl_socket_alloc ();
-	if (nl80211->nl_sock == NULL)
-		goto error;
+	return nl80211;
+}
 
-	if (genl_connect (nl80211->nl_sock))
-		goto error;
+WifiData *
+wifi_nl80211_init (const char *iface, int ifindex)
+{
+	WifiDataNl80211 *nl80211;
+	struct nl_msg *msg;
+	struct nl80211_device_info device_info = {};
 
-	nl80211->id = genl_ctrl_resolve (nl80211->nl_sock, "nl80211");
-	if (nl80211->id < 0)
-		goto error;
+	nl80211 = nl80211_data_new (iface, ifindex);
 
-	nl80211->nl_cb = nl_cb_alloc (NL_CB_DEFAULT);
-	if (nl80211->nl_cb == NULL)
+	nl80211->sock = nl80211_socket_ref ();
+	if (nl80211->sock == NULL)
 		goto error;
 
-	nl80211->phy = -1;
-
 	msg = nl80211_alloc_msg (nl80211, NL80211_CMD_GET_WIPHY, 0);
 
 	if (nl80211_send_and_recv (nl80211, msg, nl80211_wiphy_info_handler,
@@ -964,3 +1450,63 @@ error:
 	return NULL;
 }
 
+
+/******************************************************************/
+/* Testing-only functions */
+
+/**
+ * _wifi_nl80211_new_for_testing:
+ * @iface: interface name
+ * @ifindex: interface index
+ * @responder: answers the requests instead of the kernel
+ *
+ * Returns: a #WifiData that sends all of its nl80211 requests to
+ * @responder. No netlink socket is opened and multicast events must be
+ * fed in with _wifi_nl80211_process_event().
+ */
+WifiData *
+_wifi_nl80211_new_for_testing (const char *iface, int ifindex, WifiNl80211TestResponder responder)
+{
+	WifiDataNl80211 *nl80211;
+
+	g_return_val_if_fail (responder, NULL);
+
+	test_responder = responder;
+
+	if (!nl80211_socket) {
+		nl80211_socket = g_slice_new0 (Nl80211Socket);
+		nl80211_socket->mlme_group = -1;
+	}
+	nl80211_socket->refcount++;
+
+	nl80211 = nl80211_data_new (iface, ifindex);
+	nl80211->sock = nl80211_socket;
+	return (WifiData *) nl80211;
+}
+
+void
+_wifi_nl80211_process_event (struct nl_msg *msg)
+{
+	g_return_if_fail (nl80211_socket);
+
+	nl80211_event_handler (msg, nl80211_socket);
+}
+
+/* Runs the periodic poll of the monitored stations right away */
+void
+_wifi_nl80211_poll_stations (void)
+{
+	g_return_if_fail (nl80211_socket);
+
+	if (nl80211_socket->monitored)
+		nl80211_poll_cb (nl80211_socket);
+}
+
+/* Acts as if the event socket hung up */
+void
+_wifi_nl80211_fail_events (void)
+{
+	g_return_if_fail (nl80211_socket);
+
+	nl80211_events_failed (nl80211_socket);
+}
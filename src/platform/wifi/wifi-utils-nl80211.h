@@ -25,4 +25,23 @@
 
 WifiData *wifi_nl80211_init (const char *iface, int ifindex);
 
+/******************************************************************/
+/* Testing-only functions */
+
+struct nl_msg;
+
+/* Called with each request instead of sending it to the kernel; calls
+ * @valid_handler with the replies and returns 0 or a negative errno. */
+typedef int (*WifiNl80211TestResponder) (struct nl_msg *msg,
+                                         int (*valid_handler) (struct nl_msg *, void *),
+                                         void *valid_data);
+
+WifiData *_wifi_nl80211_new_for_testing (const char *iface, int ifindex, WifiNl80211TestResponder responder);
+
+void _wifi_nl80211_process_event (struct nl_msg *msg);
+
+void _wifi_nl80211_poll_stations (void);
+
+void _wifi_nl80211_fail_events (void);
+
 #endif  /* __WIFI_UTILS_NL80211_H__ */
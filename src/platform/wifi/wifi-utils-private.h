@@ -72,6 +72,14 @@ struct WifiData {
 	gboolean (*set_mesh_ssid) (WifiData *data, const guint8 *ssid, gsize len);
 
 	gboolean (*indicate_addressing_running) (WifiData *data, gboolean running);
+
+	/* Start or stop calling station_changed() when the signal or bitrate
+	 * of the current association change; return FALSE if the driver
+	 * can't report that. */
+	gboolean (*monitor_station) (WifiData *data, gboolean enable);
+
+	WifiStationChangedFunc station_changed;
+	gpointer station_changed_data;
 };
 
 gpointer wifi_data_new (const char *iface, int ifindex, gsize len);
@@ -32,6 +32,7 @@
 
 #include "wifi-utils-private.h"
 #include "wifi-utils-wext.h"
+#include "nm-platform.h"
 #include "nm-logging.h"
 #include "nm-utils.h"
 
@@ -91,10 +92,7 @@ iw_freq_to_uint32 (struct iw_freq *freq)
 static void
 wifi_wext_deinit (WifiData *parent)
 {
-	WifiDataWext *wext = (WifiDataWext *) parent;
-
-	if (wext->fd >= 0)
-		close (wext->fd);
+	/* Nothing to do, wext->fd is the shared socket of the platform */
 }
 
 static NM80211Mode
@@ -610,7 +608,7 @@ wifi_wext_init (const char *iface, int ifindex, gboolean check_scan)
 	wext->parent.set_mesh_channel = wifi_wext_set_mesh_channel;
 	wext->parent.set_mesh_ssid = wifi_wext_set_mesh_ssid;
 
-	wext->fd = socket (PF_INET, SOCK_DGRAM, 0);
+	wext->fd = nm_platform_ioctl_socket ();
 	if (wext->fd < 0)
 		goto error;
 
@@ -695,12 +693,11 @@ wifi_wext_is_wifi (const char *iface)
 	struct iwreq iwr;
 	gboolean is_wifi = FALSE;
 
-	fd = socket (PF_INET, SOCK_DGRAM, 0);
+	fd = nm_platform_ioctl_socket ();
 	if (fd >= 0) {
 		strncpy (iwr.ifr_ifrn.ifrn_name, iface, IFNAMSIZ);
 		if (ioctl (fd, SIOCGIWNAME, &iwr) == 0)
 			is_wifi = TRUE;
-		close (fd);
 	}
 	return is_wifi;
 }
@@ -161,6 +161,29 @@ wifi_utils_get_wowlan (WifiData *data)
 	return data->get_wowlan (data);
 }
 
+gboolean
+wifi_utils_monitor_station (WifiData *data, WifiStationChangedFunc callback, gpointer user_data)
+{
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	if (!data->monitor_station)
+		return FALSE;
+
+	if (!callback) {
+		data->monitor_station (data, FALSE);
+		data->station_changed = NULL;
+		data->station_changed_data = NULL;
+		return TRUE;
+	}
+
+	if (!data->monitor_station (data, TRUE))
+		return FALSE;
+
+	data->station_changed = callback;
+	data->station_changed_data = user_data;
+	return TRUE;
+}
+
 void
 wifi_utils_deinit (WifiData *data)
 {
@@ -68,6 +68,13 @@ gboolean wifi_utils_get_wowlan (WifiData *data);
 
 gboolean wifi_utils_set_powersave (WifiData *data, guint32 powersave);
 
+typedef void (*WifiStationChangedFunc) (int ifindex, gpointer user_data);
+
+/* Calls @callback whenever signal quality or bitrate of the current
+ * association change, so that they don't need to be polled. Returns FALSE
+ * if that isn't supported. A NULL @callback stops monitoring. */
+gboolean wifi_utils_monitor_station (WifiData *data, WifiStationChangedFunc callback, gpointer user_data);
+
 
 /* OLPC Mesh-only functions */
 guint32 wifi_utils_get_mesh_channel (WifiData *data);
@@ -31,16 +31,9 @@
 
 #include <errno.h>
 #include <sys/socket.h>
-#include <sys/ioctl.h>
 #include <asm/types.h>
 #include <sys/stat.h>
 
-#include <linux/ppp_defs.h>
-#ifndef aligned_u64
-#define aligned_u64 unsigned long long __attribute__((aligned(8)))
-#endif
-#include <linux/if_ppp.h>
-
 #include "NetworkManagerUtils.h"
 #include "nm-glib-compat.h"
 #include "nm-ppp-manager.h"
@@ -86,10 +79,7 @@ typedef struct {
 	guint32 ppp_watch_id;
 	guint32 ppp_timeout_handler;
 
-	/* Monitoring */
 	char *ip_iface;
-	int monitor_fd;
-	guint monitor_id;
 } NMPPPManagerPrivate;
 
 #define NM_PPP_MANAGER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), NM_TYPE_PPP_MANAGER, NMPPPManagerPrivate))
@@ -100,7 +90,6 @@ enum {
 	STATE_CHANGED,
 	IP4_CONFIG,
 	IP6_CONFIG,
-	STATS,
 
 	LAST_SIGNAL
 };
@@ -116,7 +105,6 @@ enum {
 static void
 nm_ppp_manager_init (NMPPPManager *manager)
 {
-	NM_PPP_MANAGER_GET_PRIVATE (manager)->monitor_fd = -1;
 }
 
 static void
@@ -239,15 +227,6 @@ nm_ppp_manager_class_init (NMPPPManagerClass *manager_class)
 		              NULL, NULL, NULL,
 		              G_TYPE_NONE, 3, G_TYPE_STRING, G_TYPE_POINTER, G_TYPE_OBJECT);
 
-	signals[STATS] =
-		g_signal_new ("stats",
-		              G_OBJECT_CLASS_TYPE (object_class),
-		              G_SIGNAL_RUN_FIRST,
-		              G_STRUCT_OFFSET (NMPPPManagerClass, stats),
-		              NULL, NULL, NULL,
-		              G_TYPE_NONE, 2,
-		              G_TYPE_UINT, G_TYPE_UINT);
-
 	dbus_g_object_type_install_info (G_TYPE_FROM_CLASS (manager_class),
 	                                 &dbus_glib_nm_ppp_manager_object_info);
 }
@@ -264,52 +243,6 @@ nm_ppp_manager_new (const char *iface)
 
 /*******************************************/
 
-static gboolean
-monitor_cb (gpointer user_data)
-{
-	NMPPPManager *manager = NM_PPP_MANAGER (user_data);
-	NMPPPManagerPrivate *priv = NM_PPP_MANAGER_GET_PRIVATE (manager);
-	struct ifreq req;
-	struct ppp_stats stats;
-
-	memset (&req, 0, sizeof (req));
-	memset (&stats, 0, sizeof (stats));
-	req.ifr_data = (caddr_t) &stats;
-
-	strncpy (req.ifr_name, priv->ip_iface, sizeof (req.ifr_name));
-	if (ioctl (priv->monitor_fd, SIOCGPPPSTATS, &req) < 0) {
-		if (errno != ENODEV)
-			nm_log_warn (LOGD_PPP, "could not read ppp stats: %s", strerror (errno));
-	} else {
-		g_signal_emit (manager, signals[STATS], 0, 
-		               stats.p.ppp_ibytes,
-		               stats.p.ppp_obytes);
-	}
-
-	return TRUE;
-}
-
-static void
-monitor_stats (NMPPPManager *manager)
-{
-	NMPPPManagerPrivate *priv = NM_PPP_MANAGER_GET_PRIVATE (manager);
-
-	/* already monitoring */
-	if (priv->monitor_fd >= 0)
-		return;
-
-	priv->monitor_fd = socket (AF_INET, SOCK_DGRAM, 0);
-	if (priv->monitor_fd >= 0) {
-		g_warn_if_fail (priv->monitor_id == 0);
-		if (priv->monitor_id)
-			g_source_remove (priv->monitor_id);
-		priv->monitor_id = g_timeout_add_seconds (5, monitor_cb, manager);
-	} else
-		nm_log_warn (LOGD_PPP, "could not monitor PPP stats: %s", strerror (errno));
-}
-
-/*******************************************/
-
 static void
 remove_timeout_handler (NMPPPManager *manager)
 {
@@ -526,7 +459,6 @@ set_ip_config_common (NMPPPManager *self,
 	if (s_ppp && out_mtu)
 		*out_mtu = nm_setting_ppp_get_mtu (s_ppp);
 
-	monitor_stats (self);
 	return TRUE;
 }
 
@@ -1173,18 +1105,6 @@ _ppp_cleanup (NMPPPManager *manager)
 
 	cancel_get_secrets (manager);
 
-	if (priv->monitor_id) {
-		g_source_remove (priv->monitor_id);
-		priv->monitor_id = 0;
-	}
-
-	if (priv->monitor_fd >= 0) {
-		/* Get the stats one last time */
-		monitor_cb (manager);
-		close (priv->monitor_fd);
-		priv->monitor_fd = -1;
-	}
-
 	if (priv->ppp_timeout_handler) {
 		g_source_remove (priv->ppp_timeout_handler);
 		priv->ppp_timeout_handler = 0;
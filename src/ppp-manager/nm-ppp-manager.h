@@ -57,7 +57,6 @@ typedef struct {
 	                    const char *iface,
 	                    const NMUtilsIPv6IfaceId *iid,
 	                    NMIP6Config *config);
-	void (*stats) (NMPPPManager *manager, guint32 in_bytes, guint32 out_bytes);
 } NMPPPManagerClass;
 
 GType nm_ppp_manager_get_type (void);
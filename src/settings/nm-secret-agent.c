@@ -35,6 +35,7 @@
 #include "nm-logging.h"
 #include "nm-auth-subject.h"
 #include "nm-simple-connection.h"
+#include "nm-settings-connection.h"
 #include "NetworkManagerUtils.h"
 
 G_DEFINE_TYPE (NMSecretAgent, nm_secret_agent, G_TYPE_OBJECT)
@@ -395,7 +396,10 @@ agent_new_save_delete (NMSecretAgent *self,
 	Request *r;
 	const char *cpath = nm_connection_get_path (connection);
 
-	dict = nm_connection_to_dbus (connection, flags);
+	if (NM_IS_SETTINGS_CONNECTION (connection))
+		dict = nm_settings_connection_to_dbus (NM_SETTINGS_CONNECTION (connection), flags);
+	else
+		dict = nm_connection_to_dbus (connection, flags);
 	hash = nm_utils_connection_dict_to_hash (dict);
 	g_variant_unref (dict);
 
@@ -91,10 +91,13 @@ enum {
 	UPDATED,
 	REMOVED,
 	UPDATED_BY_USER,
+	SEEN_BSSID_ADDED,
 	LAST_SIGNAL
 };
 static guint signals[LAST_SIGNAL] = { 0 };
 
+#define DBUS_DICT_CACHE_SIZE (NM_CONNECTION_SERIALIZE_ONLY_SECRETS + 1)
+
 typedef struct {
 	NMAgentManager *agent_mgr;
 	guint session_changed_id;
@@ -104,6 +107,14 @@ typedef struct {
 
 	guint updated_idle_id;
 
+	/* The connection serialized with NM_CONNECTION_SERIALIZE_ALL,
+	 * _NO_SECRETS and _ONLY_SECRETS, and the reply to GetSettings().
+	 * Built on demand, dropped whenever the connection changes.
+	 */
+	GVariant *dbus_dicts[DBUS_DICT_CACHE_SIZE];
+	guint dbus_dicts_valid;
+	GHashTable *get_settings_reply;
+
 	GSList *pending_auths; /* List of pending authentication requests */
 	gboolean visible; /* Is this connection is visible by some session? */
 	GSList *reqs;  /* in-progress secrets requests */
@@ -128,7 +139,6 @@ typedef struct {
 	GHashTable *seen_bssids; /* Up-to-date BSSIDs that's been seen for the connection */
 
 	int autoconnect_retries;
-	gint32 autoconnect_retry_time;
 	NMDeviceStateReason autoconnect_blocked_reason;
 
 	char *filename;
@@ -430,6 +440,68 @@ set_unsaved (NMSettingsConnection *self, gboolean now_unsaved)
 	}
 }
 
+static void
+get_settings_reply_clear (NMSettingsConnection *self)
+{
+	NMSettingsConnectionPrivate *priv = NM_SETTINGS_CONNECTION_GET_PRIVATE (self);
+
+	g_clear_pointer (&priv->get_settings_reply, g_hash_table_unref);
+}
+
+static void
+dbus_dicts_clear (NMSettingsConnection *self)
+{
+	NMSettingsConnectionPrivate *priv = NM_SETTINGS_CONNECTION_GET_PRIVATE (self);
+	guint i;
+
+	for (i = 0; i < DBUS_DICT_CACHE_SIZE; i++)
+		g_clear_pointer (&priv->dbus_dicts[i], g_variant_unref);
+	priv->dbus_dicts_valid = 0;
+	get_settings_reply_clear (self);
+}
+
+/* Connected separately from changed_cb(), which is blocked at times */
+static void
+dbus_dicts_changed_cb (NMSettingsConnection *self, gpointer user_data)
+{
+	dbus_dicts_clear (self);
+}
+
+/**
+ * nm_settings_connection_to_dbus:
+ * @self: the #NMSettingsConnection
+ * @flags: serialization flags
+ *
+ * Like nm_connection_to_dbus(), but the result is cached until the
+ * connection changes, so that all callers share the same dictionary.
+ *
+ * Returns: (transfer full): a non-floating reference to the serialized
+ * connection, or %NULL if there is nothing to serialize.
+ */
+GVariant *
+nm_settings_connection_to_dbus (NMSettingsConnection *self,
+                                NMConnectionSerializationFlags flags)
+{
+	NMSettingsConnectionPrivate *priv;
+	GVariant *dict;
+
+	g_return_val_if_fail (NM_IS_SETTINGS_CONNECTION (self), NULL);
+
+	if (flags >= DBUS_DICT_CACHE_SIZE) {
+		dict = nm_connection_to_dbus (NM_CONNECTION (self), flags);
+		return dict ? g_variant_ref_sink (dict) : NULL;
+	}
+
+	priv = NM_SETTINGS_CONNECTION_GET_PRIVATE (self);
+	if (!(priv->dbus_dicts_valid & (1 << flags))) {
+		dict = nm_connection_to_dbus (NM_CONNECTION (self), flags);
+		priv->dbus_dicts[flags] = dict ? g_variant_ref_sink (dict) : NULL;
+		priv->dbus_dicts_valid |= (1 << flags);
+	}
+
+	return priv->dbus_dicts[flags] ? g_variant_ref (priv->dbus_dicts[flags]) : NULL;
+}
+
 static void
 changed_cb (NMSettingsConnection *self, gpointer user_data)
 {
@@ -1166,6 +1238,55 @@ check_writable (NMConnection *connection, GError **error)
 	return TRUE;
 }
 
+static GHashTable *
+get_settings_reply_build (NMSettingsConnection *self)
+{
+	GVariant *settings;
+	GHashTable *settings_hash;
+	NMConnection *dupl_con;
+	NMSettingConnection *s_con;
+	NMSettingWireless *s_wifi;
+	guint64 timestamp = 0;
+	char **bssids;
+
+	dupl_con = nm_simple_connection_new_clone (NM_CONNECTION (self));
+	g_assert (dupl_con);
+
+	/* Timestamp is not updated in connection's 'timestamp' property,
+	 * because it would force updating the connection and in turn
+	 * writing to /etc periodically, which we want to avoid. Rather real
+	 * timestamps are kept track of in a private variable. So, substitute
+	 * timestamp property with the real one here before returning the settings.
+	 */
+	nm_settings_connection_get_timestamp (self, &timestamp);
+	if (timestamp) {
+		s_con = nm_connection_get_setting_connection (NM_CONNECTION (dupl_con));
+		g_assert (s_con);
+		g_object_set (s_con, NM_SETTING_CONNECTION_TIMESTAMP, timestamp, NULL);
+	}
+	/* Seen BSSIDs are not updated in 802-11-wireless 'seen-bssids' property
+	 * from the same reason as timestamp. Thus we put it here to GetSettings()
+	 * return settings too.
+	 */
+	bssids = nm_settings_connection_get_seen_bssids (self);
+	s_wifi = nm_connection_get_setting_wireless (NM_CONNECTION (dupl_con));
+	if (bssids && bssids[0] && s_wifi)
+		g_object_set (s_wifi, NM_SETTING_WIRELESS_SEEN_BSSIDS, bssids, NULL);
+	g_free (bssids);
+
+	/* Secrets should *never* be returned by the GetSettings method, they
+	 * get returned by the GetSecrets method which can be better
+	 * protected against leakage of secrets to unprivileged callers.
+	 */
+	settings = nm_connection_to_dbus (NM_CONNECTION (dupl_con), NM_CONNECTION_SERIALIZE_NO_SECRETS);
+	g_assert (settings);
+	settings_hash = nm_utils_connection_dict_to_hash (settings);
+	g_variant_unref (settings);
+	g_object_unref (dupl_con);
+
+	return settings_hash;
+}
+
 static void
 get_settings_auth_cb (NMSettingsConnection *self, 
                       DBusGMethodInvocation *context,
@@ -1176,50 +1297,11 @@ get_settings_auth_cb (NMSettingsConnection *self,
 	if (error)
 		dbus_g_method_return_error (context, error);
 	else {
-		GVariant *settings;
-		GHashTable *settings_hash;
-		NMConnection *dupl_con;
-		NMSettingConnection *s_con;
-		NMSettingWireless *s_wifi;
-		guint64 timestamp = 0;
-		char **bssids;
-
-		dupl_con = nm_simple_connection_new_clone (NM_CONNECTION (self));
-		g_assert (dupl_con);
-
-		/* Timestamp is not updated in connection's 'timestamp' property,
-		 * because it would force updating the connection and in turn
-		 * writing to /etc periodically, which we want to avoid. Rather real
-		 * timestamps are kept track of in a private variable. So, substitute
-		 * timestamp property with the real one here before returning the settings.
-		 */
-		nm_settings_connection_get_timestamp (self, &timestamp);
-		if (timestamp) {
-			s_con = nm_connection_get_setting_connection (NM_CONNECTION (dupl_con));
-			g_assert (s_con);
-			g_object_set (s_con, NM_SETTING_CONNECTION_TIMESTAMP, timestamp, NULL);
-		}
-		/* Seen BSSIDs are not updated in 802-11-wireless 'seen-bssids' property
-		 * from the same reason as timestamp. Thus we put it here to GetSettings()
-		 * return settings too.
-		 */
-		bssids = nm_settings_connection_get_seen_bssids (self);
-		s_wifi = nm_connection_get_setting_wireless (NM_CONNECTION (dupl_con));
-		if (bssids && bssids[0] && s_wifi)
-			g_object_set (s_wifi, NM_SETTING_WIRELESS_SEEN_BSSIDS, bssids, NULL);
-		g_free (bssids);
-
-		/* Secrets should *never* be returned by the GetSettings method, they
-		 * get returned by the GetSecrets method which can be better
-		 * protected against leakage of secrets to unprivileged callers.
-		 */
-		settings = nm_connection_to_dbus (NM_CONNECTION (dupl_con), NM_CONNECTION_SERIALIZE_NO_SECRETS);
-		g_assert (settings);
-		settings_hash = nm_utils_connection_dict_to_hash (settings);
-		dbus_g_method_return (context, settings_hash);
-		g_hash_table_destroy (settings_hash);
-		g_variant_unref (settings);
-		g_object_unref (dupl_con);
+		NMSettingsConnectionPrivate *priv = NM_SETTINGS_CONNECTION_GET_PRIVATE (self);
+
+		if (!priv->get_settings_reply)
+			priv->get_settings_reply = get_settings_reply_build (self);
+		dbus_g_method_return (context, priv->get_settings_reply);
 	}
 }
 
@@ -1343,48 +1425,79 @@ con_update_cb (NMSettingsConnection *self,
 	update_complete (self, info, error);
 }
 
-static void
-update_auth_cb (NMSettingsConnection *self,
-                DBusGMethodInvocation *context,
-                NMAuthSubject *subject,
-                GError *error,
-                gpointer data)
+/**
+ * nm_settings_connection_update:
+ * @self: the #NMSettingsConnection
+ * @new_settings: the new settings
+ * @save_to_disk: whether to save the new settings to disk
+ * @callback: called when the update finished
+ * @user_data: data for @callback
+ *
+ * Replaces the settings of @self with @new_settings for a request that
+ * was already authorized (see nm_settings_connection_check_update()).
+ * If @new_settings has no secrets, the existing ones are kept.
+ */
+void
+nm_settings_connection_update (NMSettingsConnection *self,
+                               NMConnection *new_settings,
+                               gboolean save_to_disk,
+                               NMSettingsConnectionCommitFunc callback,
+                               gpointer user_data)
 {
-	UpdateInfo *info = data;
 	GError *local = NULL;
 
-	if (error) {
-		update_complete (self, info, error);
-		return;
-	}
+	g_return_if_fail (NM_IS_SETTINGS_CONNECTION (self));
+	g_return_if_fail (NM_IS_CONNECTION (new_settings));
+	g_return_if_fail (callback);
 
-	if (!any_secrets_present (info->new_settings)) {
+	if (!any_secrets_present (new_settings)) {
 		/* If the new connection has no secrets, we do not want to remove all
 		 * secrets, rather we keep all the existing ones. Do that by merging
 		 * them in to the new connection.
 		 */
-		cached_secrets_to_connection (self, info->new_settings);
+		cached_secrets_to_connection (self, new_settings);
 	} else {
 		/* Cache the new secrets from the agent, as stuff like inotify-triggered
 		 * changes to connection's backing config files will blow them away if
 		 * they're in the main connection.
 		 */
-		update_agent_secrets_cache (self, info->new_settings);
+		update_agent_secrets_cache (self, new_settings);
 	}
 
-	if (info->save_to_disk) {
+	if (save_to_disk) {
 		nm_settings_connection_replace_and_commit (self,
-		                                           info->new_settings,
-		                                           con_update_cb,
-		                                           info);
+		                                           new_settings,
+		                                           callback,
+		                                           user_data);
 	} else {
-		if (!nm_settings_connection_replace_settings (self, info->new_settings, TRUE, "replace-and-commit-memory", &local))
+		if (!nm_settings_connection_replace_settings (self, new_settings, TRUE, "replace-and-commit-memory", &local))
 			g_assert (local);
-		con_update_cb (self, local, info);
+		callback (self, local, user_data);
 		g_clear_error (&local);
 	}
 }
 
+static void
+update_auth_cb (NMSettingsConnection *self,
+                DBusGMethodInvocation *context,
+                NMAuthSubject *subject,
+                GError *error,
+                gpointer data)
+{
+	UpdateInfo *info = data;
+
+	if (error) {
+		update_complete (self, info, error);
+		return;
+	}
+
+	nm_settings_connection_update (self,
+	                               info->new_settings,
+	                               info->save_to_disk,
+	                               con_update_cb,
+	                               info);
+}
+
 static const char *
 get_update_modify_permission (NMConnection *old, NMConnection *new)
 {
@@ -1411,6 +1524,56 @@ get_update_modify_permission (NMConnection *old, NMConnection *new)
 	return NM_AUTH_PERMISSION_SETTINGS_MODIFY_SYSTEM;
 }
 
+/**
+ * nm_settings_connection_check_update:
+ * @self: the #NMSettingsConnection
+ * @new_settings: (allow-none): the new settings, or %NULL to save the
+ *   current ones
+ * @subject: the requester
+ * @error: on return, the reason why the update is not possible
+ *
+ * Checks that @subject may update @self to @new_settings, apart from the
+ * authorization itself.
+ *
+ * Returns: the permission needed for the update, or %NULL on error.
+ */
+const char *
+nm_settings_connection_check_update (NMSettingsConnection *self,
+                                     NMConnection *new_settings,
+                                     NMAuthSubject *subject,
+                                     GError **error)
+{
+	char *error_desc = NULL;
+
+	g_return_val_if_fail (NM_IS_SETTINGS_CONNECTION (self), NULL);
+	g_return_val_if_fail (NM_IS_AUTH_SUBJECT (subject), NULL);
+
+	/* If the connection is read-only, that has to be changed at the source of
+	 * the problem (ex a system settings plugin that can't write connections out)
+	 * instead of over D-Bus.
+	 */
+	if (!check_writable (NM_CONNECTION (self), error))
+		return NULL;
+
+	/* And that the new connection settings will be visible to the user
+	 * that's sending the update request.  You can't make a connection
+	 * invisible to yourself.
+	 */
+	if (!nm_auth_is_subject_in_acl (new_settings ? new_settings : NM_CONNECTION (self),
+	                                subject,
+	                                &error_desc)) {
+		g_set_error_literal (error,
+		                     NM_SETTINGS_ERROR,
+		                     NM_SETTINGS_ERROR_PERMISSION_DENIED,
+		                     error_desc);
+		g_free (error_desc);
+		return NULL;
+	}
+
+	return get_update_modify_permission (NM_CONNECTION (self),
+	                                     new_settings ? new_settings : NM_CONNECTION (self));
+}
+
 static void
 impl_settings_connection_update_helper (NMSettingsConnection *self,
                                         GHashTable *new_settings,
@@ -1423,17 +1586,9 @@ impl_settings_connection_update_helper (NMSettingsConnection *self,
 	GError *error = NULL;
 	UpdateInfo *info;
 	const char *permission;
-	char *error_desc = NULL;
 
 	g_assert (new_settings != NULL || save_to_disk == TRUE);
 
-	/* If the connection is read-only, that has to be changed at the source of
-	 * the problem (ex a system settings plugin that can't write connections out)
-	 * instead of over D-Bus.
-	 */
-	if (!check_writable (NM_CONNECTION (self), &error))
-		goto error;
-
 	/* Check if the settings are valid first */
 	if (new_settings) {
 		GVariant *new_settings_dict = nm_utils_connection_hash_to_dict (new_settings);
@@ -1450,19 +1605,9 @@ impl_settings_connection_update_helper (NMSettingsConnection *self,
 	if (!subject)
 		goto error;
 
-	/* And that the new connection settings will be visible to the user
-	 * that's sending the update request.  You can't make a connection
-	 * invisible to yourself.
-	 */
-	if (!nm_auth_is_subject_in_acl (tmp ? tmp : NM_CONNECTION (self),
-	                                subject,
-	                                &error_desc)) {
-		error = g_error_new_literal (NM_SETTINGS_ERROR,
-		                             NM_SETTINGS_ERROR_PERMISSION_DENIED,
-		                             error_desc);
-		g_free (error_desc);
+	permission = nm_settings_connection_check_update (self, tmp, subject, &error);
+	if (!permission)
 		goto error;
-	}
 
 	info = g_malloc0 (sizeof (*info));
 	info->context = context;
@@ -1471,8 +1616,6 @@ impl_settings_connection_update_helper (NMSettingsConnection *self,
 	info->save_to_disk = save_to_disk;
 	info->new_settings = tmp;
 
-	permission = get_update_modify_permission (NM_CONNECTION (self),
-	                                           tmp ? tmp : NM_CONNECTION (self));
 	auth_start (self, context, subject, permission, update_auth_cb, info);
 	return;
 
@@ -1606,7 +1749,7 @@ dbus_get_agent_secrets_cb (NMSettingsConnection *self,
 		 * secrets from backing storage and those returned from the agent
 		 * by the time we get here.
 		 */
-		dict = nm_connection_to_dbus (NM_CONNECTION (self), NM_CONNECTION_SERIALIZE_ONLY_SECRETS);
+		dict = nm_settings_connection_to_dbus (self, NM_CONNECTION_SERIALIZE_ONLY_SECRETS);
 		if (dict)
 			hash = nm_utils_connection_dict_to_hash (dict);
 		else
@@ -1853,6 +1996,7 @@ nm_settings_connection_update_timestamp (NMSettingsConnection *connection,
 	/* Update timestamp in private storage */
 	priv->timestamp = timestamp;
 	priv->timestamp_set = TRUE;
+	get_settings_reply_clear (connection);
 
 	if (flush_to_disk == FALSE)
 		return;
@@ -1915,6 +2059,7 @@ nm_settings_connection_read_and_fill_timestamp (NMSettingsConnection *connection
 	if (!err) {
 		priv->timestamp = timestamp;
 		priv->timestamp_set = TRUE;
+		get_settings_reply_clear (connection);
 	} else {
 		nm_log_dbg (LOGD_SETTINGS, "failed to read connection timestamp for '%s': (%d) %s",
 		            connection_uuid, err->code, err->message);
@@ -2000,6 +2145,7 @@ nm_settings_connection_add_seen_bssid (NMSettingsConnection *connection,
 	/* Add the new BSSID; let the hash take ownership of the allocated BSSID string */
 	bssid_str = g_strdup (seen_bssid);
 	g_hash_table_insert (priv->seen_bssids, bssid_str, bssid_str);
+	get_settings_reply_clear (connection);
 
 	/* Build up a list of all the BSSIDs in string form */
 	n = 0;
@@ -2035,6 +2181,8 @@ nm_settings_connection_add_seen_bssid (NMSettingsConnection *connection,
 		             SETTINGS_SEEN_BSSIDS_FILE, error->message);
 		g_error_free (error);
 	}
+
+	g_signal_emit (connection, signals[SEEN_BSSID_ADDED], 0, seen_bssid);
 }
 
 /**
@@ -2085,10 +2233,10 @@ nm_settings_connection_read_and_fill_seen_bssids (NMSettingsConnection *connecti
 			}
 		}
 	}
+	get_settings_reply_clear (connection);
 }
 
 #define AUTOCONNECT_RETRIES_DEFAULT 4
-#define AUTOCONNECT_RESET_RETRIES_TIMER 300
 
 int
 nm_settings_connection_get_autoconnect_retries (NMSettingsConnection *connection)
@@ -2103,10 +2251,6 @@ nm_settings_connection_set_autoconnect_retries (NMSettingsConnection *connection
 	NMSettingsConnectionPrivate *priv = NM_SETTINGS_CONNECTION_GET_PRIVATE (connection);
 
 	priv->autoconnect_retries = retries;
-	if (retries)
-		priv->autoconnect_retry_time = 0;
-	else
-		priv->autoconnect_retry_time = nm_utils_get_monotonic_timestamp_s () + AUTOCONNECT_RESET_RETRIES_TIMER;
 }
 
 void
@@ -2115,12 +2259,6 @@ nm_settings_connection_reset_autoconnect_retries (NMSettingsConnection *connecti
 	nm_settings_connection_set_autoconnect_retries (connection, AUTOCONNECT_RETRIES_DEFAULT);
 }
 
-gint32
-nm_settings_connection_get_autoconnect_retry_time (NMSettingsConnection *connection)
-{
-	return NM_SETTINGS_CONNECTION_GET_PRIVATE (connection)->autoconnect_retry_time;
-}
-
 NMDeviceStateReason
 nm_settings_connection_get_autoconnect_blocked_reason (NMSettingsConnection *connection)
 {
@@ -2269,6 +2407,7 @@ nm_settings_connection_init (NMSettingsConnection *self)
 
 	g_signal_connect (self, NM_CONNECTION_SECRETS_CLEARED, G_CALLBACK (secrets_cleared_cb), NULL);
 	g_signal_connect (self, NM_CONNECTION_CHANGED, G_CALLBACK (changed_cb), GUINT_TO_POINTER (TRUE));
+	g_signal_connect (self, NM_CONNECTION_CHANGED, G_CALLBACK (dbus_dicts_changed_cb), NULL);
 }
 
 static void
@@ -2289,8 +2428,10 @@ dispose (GObject *object)
 	 */
 	g_signal_handlers_disconnect_by_func (self, G_CALLBACK (secrets_cleared_cb), NULL);
 	g_signal_handlers_disconnect_by_func (self, G_CALLBACK (changed_cb), GUINT_TO_POINTER (TRUE));
+	g_signal_handlers_disconnect_by_func (self, G_CALLBACK (dbus_dicts_changed_cb), NULL);
 
 	nm_connection_clear_secrets (NM_CONNECTION (self));
+	dbus_dicts_clear (self);
 	g_clear_object (&priv->system_secrets);
 	g_clear_object (&priv->agent_secrets);
 
@@ -2455,6 +2596,14 @@ nm_settings_connection_class_init (NMSettingsConnectionClass *class)
 		              g_cclosure_marshal_VOID__VOID,
 		              G_TYPE_NONE, 0);
 
+	signals[SEEN_BSSID_ADDED] =
+		g_signal_new (NM_SETTINGS_CONNECTION_SEEN_BSSID_ADDED,
+		              G_TYPE_FROM_CLASS (class),
+		              G_SIGNAL_RUN_FIRST,
+		              0, NULL, NULL,
+		              g_cclosure_marshal_VOID__STRING,
+		              G_TYPE_NONE, 1, G_TYPE_STRING);
+
 	nm_dbus_manager_register_exported_type (nm_dbus_manager_get (),
 	                                        G_TYPE_FROM_CLASS (class),
 	                                        &dbus_glib_nm_settings_connection_object_info);
@@ -45,6 +45,9 @@ G_BEGIN_DECLS
 /* Emitted when connection is changed by a user action */
 #define NM_SETTINGS_CONNECTION_UPDATED_BY_USER "updated-by-user"
 
+/* Emitted when a BSSID is added to the connection's seen-bssids list */
+#define NM_SETTINGS_CONNECTION_SEEN_BSSID_ADDED "seen-bssid-added"
+
 /* Properties */
 #define NM_SETTINGS_CONNECTION_VISIBLE  "visible"
 #define NM_SETTINGS_CONNECTION_UNSAVED  "unsaved"
@@ -131,6 +134,17 @@ void nm_settings_connection_replace_and_commit (NMSettingsConnection *self,
                                                 NMSettingsConnectionCommitFunc callback,
                                                 gpointer user_data);
 
+const char *nm_settings_connection_check_update (NMSettingsConnection *self,
+                                                 NMConnection *new_settings,
+                                                 NMAuthSubject *subject,
+                                                 GError **error);
+
+void nm_settings_connection_update (NMSettingsConnection *self,
+                                    NMConnection *new_settings,
+                                    gboolean save_to_disk,
+                                    NMSettingsConnectionCommitFunc callback,
+                                    gpointer user_data);
+
 void nm_settings_connection_delete (NMSettingsConnection *connection,
                                     NMSettingsConnectionDeleteFunc callback,
                                     gpointer user_data);
@@ -193,8 +207,6 @@ void nm_settings_connection_set_autoconnect_retries (NMSettingsConnection *conne
                                                      int retries);
 void nm_settings_connection_reset_autoconnect_retries (NMSettingsConnection *connection);
 
-gint32 nm_settings_connection_get_autoconnect_retry_time (NMSettingsConnection *connection);
-
 NMDeviceStateReason nm_settings_connection_get_autoconnect_blocked_reason (NMSettingsConnection *connection);
 void nm_settings_connection_set_autoconnect_blocked_reason (NMSettingsConnection *connection,
                                                             NMDeviceStateReason reason);
@@ -212,6 +224,9 @@ void        nm_settings_connection_set_filename (NMSettingsConnection *connectio
                                                  const char *filename);
 const char *nm_settings_connection_get_filename (NMSettingsConnection *connection);
 
+GVariant *nm_settings_connection_to_dbus (NMSettingsConnection *self,
+                                          NMConnectionSerializationFlags flags);
+
 G_END_DECLS
 
 #endif /* __NETWORKMANAGER_SETTINGS_CONNECTION_H__ */
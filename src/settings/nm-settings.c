@@ -72,6 +72,7 @@
 #include "nm-connection-provider.h"
 #include "nm-config.h"
 #include "NetworkManagerUtils.h"
+#include "nm-stats.h"
 
 #define LOG(level, ...) \
 	G_STMT_START { \
@@ -114,6 +115,16 @@ static void impl_settings_add_connection_unsaved (NMSettings *self,
                                                   GHashTable *settings,
                                                   DBusGMethodInvocation *context);
 
+static void impl_settings_add_connections (NMSettings *self,
+                                           GPtrArray *connections,
+                                           gboolean save_to_disk,
+                                           DBusGMethodInvocation *context);
+
+static void impl_settings_update_connections (NMSettings *self,
+                                              GPtrArray *connections,
+                                              gboolean save_to_disk,
+                                              DBusGMethodInvocation *context);
+
 static void impl_settings_load_connections (NMSettings *self,
                                             char **filenames,
                                             DBusGMethodInvocation *context);
@@ -148,9 +159,11 @@ typedef struct {
 	GSList *plugins;
 	gboolean connections_loaded;
 	GHashTable *connections;
+	GHashTable *connections_by_uuid;  /* UUID :: NMSettingsConnection */
 	GSList *unmanaged_specs;
 	GSList *unrecognized_specs;
 	GSList *get_connections_cache;
+	GHashTable *seen_bssids;  /* BSSID :: GSList of NMSettingsConnection */
 
 	gboolean startup_complete;
 } NMSettingsPrivate;
@@ -296,20 +309,39 @@ NMSettingsConnection *
 nm_settings_get_connection_by_uuid (NMSettings *self, const char *uuid)
 {
 	NMSettingsPrivate *priv;
-	NMSettingsConnection *candidate;
-	GHashTableIter iter;
 
 	g_return_val_if_fail (NM_IS_SETTINGS (self), NULL);
 	g_return_val_if_fail (uuid != NULL, NULL);
 
 	priv = NM_SETTINGS_GET_PRIVATE (self);
 
-	g_hash_table_iter_init (&iter, priv->connections);
-	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &candidate)) {
-		if (g_strcmp0 (uuid, nm_connection_get_uuid (NM_CONNECTION (candidate))) == 0)
-			return candidate;
-	}
+	/* The UUID of a connection cannot change once it is exported */
+	return g_hash_table_lookup (priv->connections_by_uuid, uuid);
+}
+
+/**
+ * nm_settings_get_connection_by_seen_bssid:
+ * @self: the #NMSettings
+ * @bssid: the BSSID to look up
+ *
+ * Returns: (transfer none): a Wi-Fi connection that has seen @bssid, or %NULL.
+ *   If several connections did, the one that saw it first.
+ */
+NMSettingsConnection *
+nm_settings_get_connection_by_seen_bssid (NMSettings *self, const char *bssid)
+{
+	NMSettingsPrivate *priv;
+	GSList *iter;
+
+	g_return_val_if_fail (NM_IS_SETTINGS (self), NULL);
+	g_return_val_if_fail (bssid != NULL, NULL);
+
+	priv = NM_SETTINGS_GET_PRIVATE (self);
 
+	for (iter = g_hash_table_lookup (priv->seen_bssids, bssid); iter; iter = iter->next) {
+		if (nm_connection_get_setting_wireless (NM_CONNECTION (iter->data)))
+			return iter->data;
+	}
 	return NULL;
 }
 
@@ -789,10 +821,68 @@ connection_visibility_changed (NMSettingsConnection *connection,
 	               connection);
 }
 
+static void
+seen_bssids_index_add (NMSettings *self, NMSettingsConnection *connection, const char *bssid)
+{
+	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
+	GSList *list;
+
+	list = g_hash_table_lookup (priv->seen_bssids, bssid);
+	if (!list)
+		g_hash_table_insert (priv->seen_bssids, g_strdup (bssid), g_slist_prepend (NULL, connection));
+	else if (!g_slist_find (list, connection)) {
+		/* appending to a non-empty list keeps its head */
+		list = g_slist_append (list, connection);
+	}
+}
+
+static void
+seen_bssids_index_fill (NMSettings *self, NMSettingsConnection *connection)
+{
+	gs_free char **bssids = nm_settings_connection_get_seen_bssids (connection);
+	guint i;
+
+	for (i = 0; bssids[i]; i++)
+		seen_bssids_index_add (self, connection, bssids[i]);
+}
+
+static void
+seen_bssids_index_remove (NMSettings *self, NMSettingsConnection *connection)
+{
+	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
+	gs_free char **bssids = nm_settings_connection_get_seen_bssids (connection);
+	GSList *list;
+	guint i;
+
+	for (i = 0; bssids[i]; i++) {
+		list = g_hash_table_lookup (priv->seen_bssids, bssids[i]);
+		if (!list)
+			continue;
+
+		list = g_slist_remove (list, connection);
+		if (list)
+			g_hash_table_insert (priv->seen_bssids, g_strdup (bssids[i]), list);
+		else
+			g_hash_table_remove (priv->seen_bssids, bssids[i]);
+	}
+}
+
+static void
+connection_seen_bssid_added (NMSettingsConnection *connection,
+                             const char *bssid,
+                             gpointer user_data)
+{
+	seen_bssids_index_add (NM_SETTINGS (user_data), connection, bssid);
+}
+
 static void
 connection_removed (NMSettingsConnection *connection, gpointer user_data)
 {
 	NMSettings *self = NM_SETTINGS (user_data);
+	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
+	const char *uuid;
+	GHashTableIter iter;
+	gpointer data;
 
 	g_object_ref (connection);
 
@@ -806,11 +896,28 @@ connection_removed (NMSettingsConnection *connection, gpointer user_data)
 	g_signal_handlers_disconnect_by_func (connection, G_CALLBACK (connection_updated_by_user), self);
 	g_signal_handlers_disconnect_by_func (connection, G_CALLBACK (connection_visibility_changed), self);
 	g_signal_handlers_disconnect_by_func (connection, G_CALLBACK (connection_ready_changed), self);
+	g_signal_handlers_disconnect_by_func (connection, G_CALLBACK (connection_seen_bssid_added), self);
 
 	/* Forget about the connection internally */
-	g_hash_table_remove (NM_SETTINGS_GET_PRIVATE (user_data)->connections,
+	seen_bssids_index_remove (self, connection);
+	g_hash_table_remove (priv->connections,
 	                     (gpointer) nm_connection_get_path (NM_CONNECTION (connection)));
 
+	/* Plugins may provide several connections with the same UUID; the
+	 * index only points to one of them. */
+	uuid = nm_connection_get_uuid (NM_CONNECTION (connection));
+	if (g_hash_table_lookup (priv->connections_by_uuid, uuid) == connection) {
+		g_hash_table_remove (priv->connections_by_uuid, uuid);
+
+		g_hash_table_iter_init (&iter, priv->connections);
+		while (g_hash_table_iter_next (&iter, NULL, &data)) {
+			if (!g_strcmp0 (nm_connection_get_uuid (data), uuid)) {
+				g_hash_table_insert (priv->connections_by_uuid, g_strdup (uuid), data);
+				break;
+			}
+		}
+	}
+
 	/* Notify D-Bus */
 	g_signal_emit (self, signals[CONNECTION_REMOVED], 0, connection);
 
@@ -927,6 +1034,7 @@ claim_connection (NMSettings *self,
 
 	/* Read seen-bssids from look-aside file and put it into the connection's data */
 	nm_settings_connection_read_and_fill_seen_bssids (connection);
+	seen_bssids_index_fill (self, connection);
 
 	/* Ensure it's initial visibility is up-to-date */
 	nm_settings_connection_recheck_visibility (connection);
@@ -943,6 +1051,8 @@ claim_connection (NMSettings *self,
 	g_signal_connect (connection, "notify::" NM_SETTINGS_CONNECTION_VISIBLE,
 	                  G_CALLBACK (connection_visibility_changed),
 	                  self);
+	g_signal_connect (connection, NM_SETTINGS_CONNECTION_SEEN_BSSID_ADDED,
+	                  G_CALLBACK (connection_seen_bssid_added), self);
 	if (!priv->startup_complete) {
 		g_signal_connect (connection, "notify::" NM_SETTINGS_CONNECTION_READY,
 		                  G_CALLBACK (connection_ready_changed),
@@ -959,6 +1069,9 @@ claim_connection (NMSettings *self,
 	g_hash_table_insert (priv->connections,
 	                     (gpointer) nm_connection_get_path (NM_CONNECTION (connection)),
 	                     g_object_ref (connection));
+	g_hash_table_insert (priv->connections_by_uuid,
+	                     g_strdup (nm_connection_get_uuid (NM_CONNECTION (connection))),
+	                     connection);
 
 	nm_utils_log_connection_diff (NM_CONNECTION (connection), NULL, LOGL_DEBUG, LOGD_CORE, "new connection", "++ ");
 
@@ -976,43 +1089,24 @@ claim_connection (NMSettings *self,
 	}
 }
 
-/**
- * nm_settings_add_connection:
- * @self: the #NMSettings object
- * @connection: the source connection to create a new #NMSettingsConnection from
- * @save_to_disk: %TRUE to save the connection to disk immediately, %FALSE to
- * not save to disk
- * @error: on return, a location to store any errors that may occur
- *
- * Creates a new #NMSettingsConnection for the given source @connection.  
- * The returned object is owned by @self and the caller must reference
- * the object to continue using it.
- *
- * Returns: the new #NMSettingsConnection or %NULL
- */
-NMSettingsConnection *
-nm_settings_add_connection (NMSettings *self,
-                            NMConnection *connection,
-                            gboolean save_to_disk,
-                            GError **error)
+static NMSettingsConnection *
+_add_connection (NMSettings *self,
+                 NMConnection *connection,
+                 gboolean save_to_disk,
+                 GError **error)
 {
 	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
 	GSList *iter;
 	NMSettingsConnection *added = NULL;
-	GHashTableIter citer;
-	NMConnection *candidate = NULL;
 
 	/* Make sure a connection with this UUID doesn't already exist */
-	g_hash_table_iter_init (&citer, priv->connections);
-	while (g_hash_table_iter_next (&citer, NULL, (gpointer *) &candidate)) {
-		if (g_strcmp0 (nm_connection_get_uuid (connection),
-		               nm_connection_get_uuid (candidate)) == 0) {
-			g_set_error_literal (error,
-			                     NM_SETTINGS_ERROR,
-			                     NM_SETTINGS_ERROR_UUID_EXISTS,
-			                     "A connection with this UUID already exists.");
-			return NULL;
-		}
+	if (   nm_connection_get_uuid (connection)
+	    && nm_settings_get_connection_by_uuid (self, nm_connection_get_uuid (connection))) {
+		g_set_error_literal (error,
+		                     NM_SETTINGS_ERROR,
+		                     NM_SETTINGS_ERROR_UUID_EXISTS,
+		                     "A connection with this UUID already exists.");
+		return NULL;
 	}
 
 	/* 1) plugin writes the NMConnection to disk
@@ -1044,6 +1138,34 @@ nm_settings_add_connection (NMSettings *self,
 	return NULL;
 }
 
+/**
+ * nm_settings_add_connection:
+ * @self: the #NMSettings object
+ * @connection: the source connection to create a new #NMSettingsConnection from
+ * @save_to_disk: %TRUE to save the connection to disk immediately, %FALSE to
+ * not save to disk
+ * @error: on return, a location to store any errors that may occur
+ *
+ * Creates a new #NMSettingsConnection for the given source @connection.  
+ * The returned object is owned by @self and the caller must reference
+ * the object to continue using it.
+ *
+ * Returns: the new #NMSettingsConnection or %NULL
+ */
+NMSettingsConnection *
+nm_settings_add_connection (NMSettings *self,
+                            NMConnection *connection,
+                            gboolean save_to_disk,
+                            GError **error)
+{
+	gint64 start = nm_utils_get_monotonic_timestamp_us ();
+	NMSettingsConnection *added;
+
+	added = _add_connection (self, connection, save_to_disk, error);
+	nm_stats_probe_time (NM_STATS_PROBE_SETTINGS_ADD_CONNECTION, start);
+	return added;
+}
+
 static NMConnection *
 _nm_connection_provider_add_connection (NMConnectionProvider *provider,
                                         NMConnection *connection,
@@ -1345,6 +1467,398 @@ impl_settings_add_connection_unsaved (NMSettings *self,
 	impl_settings_add_connection_helper (self, settings, FALSE, context);
 }
 
+/**************************************************************/
+
+/* AddConnections() and UpdateConnections() authorize the whole batch at
+ * once and let the plugins make the written files durable only once. Each
+ * entry succeeds or fails on its own; entries that fail validation are not
+ * part of the authorization.
+ */
+
+typedef struct _BatchInfo BatchInfo;
+
+typedef struct {
+	BatchInfo *info;
+	NMConnection *connection;       /* the requested settings, NULL if rejected */
+	NMSettingsConnection *existing; /* for updates, the connection to update */
+	NMSettingsConnection *result;   /* the added or updated connection */
+	char *error;
+} BatchEntry;
+
+struct _BatchInfo {
+	NMSettings *self;
+	DBusGMethodInvocation *context;
+	NMAuthSubject *subject;
+	gboolean is_update;
+	gboolean save_to_disk;
+	guint pending;
+	guint n_entries;
+	BatchEntry *entries;
+};
+
+static void
+batch_info_free (BatchInfo *info)
+{
+	guint i;
+
+	for (i = 0; i < info->n_entries; i++) {
+		BatchEntry *entry = &info->entries[i];
+
+		g_clear_object (&entry->connection);
+		g_clear_object (&entry->existing);
+		g_clear_object (&entry->result);
+		g_free (entry->error);
+	}
+	g_free (info->entries);
+	g_clear_object (&info->subject);
+	g_slice_free (BatchInfo, info);
+}
+
+static void
+batch_entry_set_error (BatchEntry *entry, GError *error)
+{
+	g_clear_object (&entry->connection);
+	if (!entry->error)
+		entry->error = g_strdup (error && error->message ? error->message : "(unknown)");
+}
+
+static void
+batch_begin (NMSettings *self)
+{
+	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
+	GSList *iter;
+
+	/* Only the change notification of the Connections property is
+	 * coalesced. NewConnection and ConnectionAdded are still emitted for
+	 * each connection: they carry the connection, and clients track the
+	 * exported objects through them. */
+	g_object_freeze_notify (G_OBJECT (self));
+	for (iter = priv->plugins; iter; iter = iter->next)
+		nm_system_config_interface_begin_batch (NM_SYSTEM_CONFIG_INTERFACE (iter->data));
+}
+
+static void
+batch_end (NMSettings *self)
+{
+	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
+	GSList *iter;
+
+	for (iter = priv->plugins; iter; iter = iter->next)
+		nm_system_config_interface_end_batch (NM_SYSTEM_CONFIG_INTERFACE (iter->data));
+	g_object_thaw_notify (G_OBJECT (self));
+}
+
+static void
+batch_complete (BatchInfo *info, GError *error)
+{
+	GPtrArray *paths;
+	char **errors;
+	guint i, n_failed = 0;
+
+	if (error) {
+		dbus_g_method_return_error (info->context, error);
+		batch_info_free (info);
+		return;
+	}
+
+	paths = g_ptr_array_sized_new (info->n_entries);
+	errors = g_new0 (char *, info->n_entries + 1);
+	for (i = 0; i < info->n_entries; i++) {
+		BatchEntry *entry = &info->entries[i];
+
+		if (entry->result) {
+			g_ptr_array_add (paths, g_strdup (nm_connection_get_path (NM_CONNECTION (entry->result))));
+			errors[i] = g_strdup ("");
+
+			/* Send agent-owned secrets to the agents */
+			send_agent_owned_secrets (info->self, entry->result, info->subject);
+		} else {
+			g_ptr_array_add (paths, g_strdup ("/"));
+			errors[i] = g_strdup (entry->error ? entry->error : "(unknown)");
+			n_failed++;
+		}
+	}
+
+	LOG (LOGL_INFO, "%s %u connections (%u failed)",
+	     info->is_update ? "updated" : "added",
+	     info->n_entries - n_failed, n_failed);
+
+	if (info->is_update)
+		dbus_g_method_return (info->context, errors);
+	else
+		dbus_g_method_return (info->context, paths, errors);
+
+	g_ptr_array_free (paths, TRUE);
+	g_strfreev (errors);
+	batch_info_free (info);
+}
+
+static void
+batch_pending_done (BatchInfo *info)
+{
+	if (--info->pending > 0)
+		return;
+
+	batch_end (info->self);
+	batch_complete (info, NULL);
+}
+
+static void
+batch_update_cb (NMSettingsConnection *connection,
+                 GError *error,
+                 gpointer user_data)
+{
+	BatchEntry *entry = user_data;
+
+	if (error)
+		batch_entry_set_error (entry, error);
+	else
+		entry->result = g_object_ref (connection);
+
+	batch_pending_done (entry->info);
+}
+
+static void
+batch_apply (BatchInfo *info)
+{
+	guint i;
+
+	batch_begin (info->self);
+
+	/* Updates may be committed asynchronously; keep the batch open until
+	 * all of them finished. */
+	info->pending = 1;
+	for (i = 0; i < info->n_entries; i++) {
+		BatchEntry *entry = &info->entries[i];
+		GError *error = NULL;
+
+		if (!entry->connection)
+			continue;
+
+		if (info->is_update) {
+			/* The connection might have gone away during authorization */
+			if (nm_settings_get_connection_by_uuid (info->self, nm_connection_get_uuid (entry->connection)) != entry->existing) {
+				entry->error = g_strdup ("The connection was removed.");
+				g_clear_object (&entry->connection);
+				continue;
+			}
+
+			info->pending++;
+			nm_settings_connection_update (entry->existing,
+			                               entry->connection,
+			                               info->save_to_disk,
+			                               batch_update_cb,
+			                               entry);
+		} else {
+			entry->result = nm_settings_add_connection (info->self,
+			                                            entry->connection,
+			                                            info->save_to_disk,
+			                                            &error);
+			if (entry->result)
+				g_object_ref (entry->result);
+			else {
+				batch_entry_set_error (entry, error);
+				g_clear_error (&error);
+			}
+		}
+	}
+	batch_pending_done (info);
+}
+
+static void
+pk_batch_cb (NMAuthChain *chain,
+             GError *chain_error,
+             DBusGMethodInvocation *context,
+             gpointer user_data)
+{
+	NMSettings *self = NM_SETTINGS (user_data);
+	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
+	NMAuthCallResult result;
+	GError *error = NULL;
+	BatchInfo *info;
+	const char *perm;
+
+	priv->auths = g_slist_remove (priv->auths, chain);
+
+	info = nm_auth_chain_steal_data (chain, "batch");
+	g_assert (info);
+
+	perm = nm_auth_chain_get_data (chain, "perm");
+	g_assert (perm);
+	result = nm_auth_chain_get_result (chain, perm);
+
+	if (chain_error) {
+		error = g_error_new (NM_SETTINGS_ERROR,
+		                     NM_SETTINGS_ERROR_FAILED,
+		                     "Error checking authorization: %s",
+		                     chain_error->message ? chain_error->message : "(unknown)");
+	} else if (result != NM_AUTH_CALL_RESULT_YES) {
+		error = g_error_new_literal (NM_SETTINGS_ERROR,
+		                             NM_SETTINGS_ERROR_PERMISSION_DENIED,
+		                             "Insufficient privileges.");
+	}
+
+	if (error)
+		batch_complete (info, error);
+	else
+		batch_apply (info);
+
+	g_clear_error (&error);
+	nm_auth_chain_unref (chain);
+}
+
+static gboolean
+batch_check_entry (BatchInfo *info, BatchEntry *entry, const char **perm, GError **error)
+{
+	NMSettingConnection *s_con;
+	const char *entry_perm;
+	char *error_desc = NULL;
+
+	if (info->is_update) {
+		const char *uuid = nm_connection_get_uuid (entry->connection);
+
+		if (uuid)
+			entry->existing = nm_settings_get_connection_by_uuid (info->self, uuid);
+		if (!entry->existing) {
+			g_set_error (error, NM_SETTINGS_ERROR, NM_SETTINGS_ERROR_INVALID_CONNECTION,
+			             "No connection with the UUID '%s'", uuid ? uuid : "(null)");
+			return FALSE;
+		}
+		g_object_ref (entry->existing);
+
+		entry_perm = nm_settings_connection_check_update (entry->existing, entry->connection, info->subject, error);
+		if (!entry_perm)
+			return FALSE;
+	} else {
+		if (!nm_connection_verify (entry->connection, error))
+			return FALSE;
+
+		if (is_adhoc_wpa (entry->connection)) {
+			g_set_error_literal (error, NM_SETTINGS_ERROR, NM_SETTINGS_ERROR_INVALID_CONNECTION,
+			                     "WPA Ad-Hoc disabled due to kernel bugs");
+			return FALSE;
+		}
+
+		if (!nm_auth_is_subject_in_acl (entry->connection, info->subject, &error_desc)) {
+			g_set_error_literal (error, NM_SETTINGS_ERROR, NM_SETTINGS_ERROR_PERMISSION_DENIED,
+			                     error_desc);
+			g_free (error_desc);
+			return FALSE;
+		}
+
+		s_con = nm_connection_get_setting_connection (entry->connection);
+		if (nm_setting_connection_get_num_permissions (s_con) == 1)
+			entry_perm = NM_AUTH_PERMISSION_SETTINGS_MODIFY_OWN;
+		else
+			entry_perm = NM_AUTH_PERMISSION_SETTINGS_MODIFY_SYSTEM;
+	}
+
+	/* There is one request for the whole batch; 'modify.own' only
+	 * suffices if it suffices for every entry. */
+	if (!*perm || strcmp (entry_perm, NM_AUTH_PERMISSION_SETTINGS_MODIFY_SYSTEM) == 0)
+		*perm = entry_perm;
+	return TRUE;
+}
+
+static void
+impl_settings_batch_helper (NMSettings *self,
+                            GPtrArray *connections,
+                            gboolean is_update,
+                            gboolean save_to_disk,
+                            DBusGMethodInvocation *context)
+{
+	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
+	BatchInfo *info;
+	NMAuthChain *chain;
+	GError *error = NULL;
+	const char *perm = NULL;
+	guint i;
+
+	info = g_slice_new0 (BatchInfo);
+	info->self = self;
+	info->context = context;
+	info->is_update = is_update;
+	info->save_to_disk = save_to_disk;
+	info->n_entries = connections->len;
+	info->entries = g_new0 (BatchEntry, info->n_entries);
+
+	/* Do any of the plugins support adding? */
+	if (!get_plugin (self, NM_SYSTEM_CONFIG_INTERFACE_CAP_MODIFY_CONNECTIONS)) {
+		error = g_error_new_literal (NM_SETTINGS_ERROR,
+		                             NM_SETTINGS_ERROR_NOT_SUPPORTED,
+		                             "None of the registered plugins support add.");
+		goto error;
+	}
+
+	info->subject = nm_auth_subject_new_unix_process_from_context (context);
+	if (!info->subject) {
+		error = g_error_new_literal (NM_SETTINGS_ERROR,
+		                             NM_SETTINGS_ERROR_PERMISSION_DENIED,
+		                             "Unable to determine UID of request.");
+		goto error;
+	}
+
+	for (i = 0; i < info->n_entries; i++) {
+		BatchEntry *entry = &info->entries[i];
+		GError *entry_error = NULL;
+		GVariant *dict;
+
+		entry->info = info;
+
+		dict = nm_utils_connection_hash_to_dict (connections->pdata[i]);
+		entry->connection = nm_simple_connection_new_from_dbus (dict, &entry_error);
+		g_variant_unref (dict);
+
+		if (   !entry->connection
+		    || !batch_check_entry (info, entry, &perm, &entry_error)) {
+			batch_entry_set_error (entry, entry_error);
+			g_clear_error (&entry_error);
+		}
+	}
+
+	/* Nothing to authorize, every entry was rejected */
+	if (!perm) {
+		batch_complete (info, NULL);
+		return;
+	}
+
+	chain = nm_auth_chain_new_subject (info->subject, context, pk_batch_cb, self);
+	if (!chain) {
+		error = g_error_new_literal (NM_SETTINGS_ERROR,
+		                             NM_SETTINGS_ERROR_PERMISSION_DENIED,
+		                             "Unable to authenticate the request.");
+		goto error;
+	}
+
+	priv->auths = g_slist_append (priv->auths, chain);
+	nm_auth_chain_add_call (chain, perm, TRUE);
+	nm_auth_chain_set_data (chain, "perm", (gpointer) perm, NULL);
+	nm_auth_chain_set_data (chain, "batch", info, (GDestroyNotify) batch_info_free);
+	return;
+
+error:
+	batch_complete (info, error);
+	g_error_free (error);
+}
+
+static void
+impl_settings_add_connections (NMSettings *self,
+                               GPtrArray *connections,
+                               gboolean save_to_disk,
+                               DBusGMethodInvocation *context)
+{
+	impl_settings_batch_helper (self, connections, FALSE, save_to_disk, context);
+}
+
+static void
+impl_settings_update_connections (NMSettings *self,
+                                  GPtrArray *connections,
+                                  gboolean save_to_disk,
+                                  DBusGMethodInvocation *context)
+{
+	impl_settings_batch_helper (self, connections, TRUE, save_to_disk, context);
+}
+
 static gboolean
 ensure_root (NMDBusManager         *dbus_mgr,
              DBusGMethodInvocation *context)
@@ -1836,6 +2350,12 @@ cp_get_connection_by_uuid (NMConnectionProvider *provider, const char *uuid)
 	return NM_CONNECTION (nm_settings_get_connection_by_uuid (NM_SETTINGS (provider), uuid));
 }
 
+static NMConnection *
+cp_get_connection_by_seen_bssid (NMConnectionProvider *provider, const char *bssid)
+{
+	return (NMConnection *) nm_settings_get_connection_by_seen_bssid (NM_SETTINGS (provider), bssid);
+}
+
 /***************************************************************/
 
 gboolean
@@ -1881,6 +2401,7 @@ connection_provider_init (NMConnectionProvider *cp_class)
     cp_class->get_connections = get_connections;
     cp_class->add_connection = _nm_connection_provider_add_connection;
     cp_class->get_connection_by_uuid = cp_get_connection_by_uuid;
+    cp_class->get_connection_by_seen_bssid = cp_get_connection_by_seen_bssid;
 }
 
 static void
@@ -1889,6 +2410,8 @@ nm_settings_init (NMSettings *self)
 	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
 
 	priv->connections = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+	priv->connections_by_uuid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	priv->seen_bssids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
 	/* Hold a reference to the agent manager so it stays alive; the only
 	 * other holders are NMSettingsConnection objects which are often
@@ -1921,10 +2444,18 @@ finalize (GObject *object)
 {
 	NMSettings *self = NM_SETTINGS (object);
 	NMSettingsPrivate *priv = NM_SETTINGS_GET_PRIVATE (self);
+	GHashTableIter iter;
+	GSList *list;
 
+	g_hash_table_destroy (priv->connections_by_uuid);
 	g_hash_table_destroy (priv->connections);
 	g_slist_free (priv->get_connections_cache);
 
+	g_hash_table_iter_init (&iter, priv->seen_bssids);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer) &list))
+		g_slist_free (list);
+	g_hash_table_destroy (priv->seen_bssids);
+
 	g_slist_free_full (priv->unmanaged_specs, g_free);
 	g_slist_free_full (priv->unrecognized_specs, g_free);
 
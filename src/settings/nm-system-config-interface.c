@@ -214,3 +214,21 @@ nm_system_config_interface_add_connection (NMSystemConfigInterface *config,
 
 	return NULL;
 }
+
+void
+nm_system_config_interface_begin_batch (NMSystemConfigInterface *config)
+{
+	g_return_if_fail (config != NULL);
+
+	if (NM_SYSTEM_CONFIG_INTERFACE_GET_INTERFACE (config)->begin_batch)
+		NM_SYSTEM_CONFIG_INTERFACE_GET_INTERFACE (config)->begin_batch (config);
+}
+
+void
+nm_system_config_interface_end_batch (NMSystemConfigInterface *config)
+{
+	g_return_if_fail (config != NULL);
+
+	if (NM_SYSTEM_CONFIG_INTERFACE_GET_INTERFACE (config)->end_batch)
+		NM_SYSTEM_CONFIG_INTERFACE_GET_INTERFACE (config)->end_batch (config);
+}
@@ -129,6 +129,14 @@ struct _NMSystemConfigInterface {
 	                                          gboolean save_to_disk,
 	                                          GError **error);
 
+	/* Optional. Between begin_batch() and end_batch() connections are added
+	 * or saved in bulk, and the plugin may defer flushing them to backing
+	 * storage. end_batch() must not return before everything written since
+	 * the matching begin_batch() is durable. Calls may nest.
+	 */
+	void (*begin_batch) (NMSystemConfigInterface *config);
+	void (*end_batch)   (NMSystemConfigInterface *config);
+
 	/* Signals */
 
 	/* Emitted when a new connection has been found by the plugin */
@@ -161,6 +169,9 @@ NMSettingsConnection *nm_system_config_interface_add_connection (NMSystemConfigI
                                                                  gboolean save_to_disk,
                                                                  GError **error);
 
+void nm_system_config_interface_begin_batch (NMSystemConfigInterface *config);
+void nm_system_config_interface_end_batch (NMSystemConfigInterface *config);
+
 G_END_DECLS
 
 #endif	/* NM_SYSTEM_CONFIG_INTERFACE_H */
@@ -190,6 +190,7 @@ write_secret_file (const char *path,
 		goto out;
 	}
 	success = TRUE;
+	crypto_file_cache_invalidate (path);
 
 out:
 	g_free (tmppath);
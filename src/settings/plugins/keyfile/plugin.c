@@ -554,6 +554,18 @@ add_connection (NMSystemConfigInterface *config,
 	return NM_SETTINGS_CONNECTION (update_connection (self, connection, path, NULL, FALSE, NULL, error));
 }
 
+static void
+begin_batch (NMSystemConfigInterface *config)
+{
+	nm_keyfile_plugin_write_batch_begin ();
+}
+
+static void
+end_batch (NMSystemConfigInterface *config)
+{
+	nm_keyfile_plugin_write_batch_end ();
+}
+
 static gboolean
 parse_key_file_allow_none (SCPluginKeyfilePrivate  *priv,
                            GKeyFile                *key_file,
@@ -804,6 +816,8 @@ system_config_interface_init (NMSystemConfigInterface *system_config_interface_c
 	system_config_interface_class->load_connection = load_connection;
 	system_config_interface_class->reload_connections = reload_connections;
 	system_config_interface_class->add_connection = add_connection;
+	system_config_interface_class->begin_batch = begin_batch;
+	system_config_interface_class->end_batch = end_batch;
 	system_config_interface_class->get_unmanaged_specs = get_unmanaged_specs;
 }
 
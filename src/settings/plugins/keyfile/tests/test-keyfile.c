@@ -3578,6 +3578,53 @@ test_write_flags_property (void)
 	g_object_unref (connection);
 }
 
+static void
+test_write_batch (void)
+{
+	NMConnection *connections[5];
+	char *testfiles[G_N_ELEMENTS (connections)];
+	GError *error = NULL;
+	guint i;
+
+	nm_keyfile_plugin_write_batch_begin ();
+	for (i = 0; i < G_N_ELEMENTS (connections); i++) {
+		gs_free char *id = g_strdup_printf ("Test Write Batch %u", i);
+		gboolean success;
+
+		connections[i] = nmtst_create_minimal_connection (id, NULL, NM_SETTING_WIRED_SETTING_NAME, NULL);
+		nmtst_connection_normalize (connections[i]);
+
+		/* nested batches are only synced by the outermost end */
+		if (i == 2)
+			nm_keyfile_plugin_write_batch_begin ();
+
+		testfiles[i] = NULL;
+		success = nm_keyfile_plugin_write_test_connection (connections[i], TEST_SCRATCH_DIR, geteuid (), getegid (), &testfiles[i], &error);
+		g_assert_no_error (error);
+		g_assert (success);
+		g_assert (testfiles[i]);
+
+		if (i == 2)
+			nm_keyfile_plugin_write_batch_end ();
+	}
+	nm_keyfile_plugin_write_batch_end ();
+
+	for (i = 0; i < G_N_ELEMENTS (connections); i++) {
+		NMConnection *reread;
+
+		reread = nm_keyfile_plugin_connection_from_file (testfiles[i], &error);
+		g_assert_no_error (error);
+		g_assert (reread);
+
+		nmtst_assert_connection_equals (reread, FALSE, connections[i], FALSE);
+
+		unlink (testfiles[i]);
+		g_free (testfiles[i]);
+		g_object_unref (reread);
+		g_object_unref (connections[i]);
+	}
+}
+
 /*****************************************************************************/
 
 static void
@@ -3698,6 +3745,8 @@ int main (int argc, char **argv)
 	g_test_add_func ("/keyfile/test_read_flags_property ", test_read_flags_property);
 	g_test_add_func ("/keyfile/test_write_flags_property ", test_write_flags_property);
 
+	g_test_add_func ("/keyfile/test_write_batch", test_write_batch);
+
 	g_test_add_func ("/keyfile/test_nm_keyfile_plugin_utils_escape_filename ", test_nm_keyfile_plugin_utils_escape_filename);
 
 	return g_test_run ();
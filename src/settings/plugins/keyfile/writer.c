@@ -26,12 +26,15 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
 
+#include "gsystem-local-alloc.h"
 #include "nm-logging.h"
 #include "writer.h"
 #include "common.h"
 #include "utils.h"
 #include "nm-keyfile-internal.h"
+#include "crypto.h"
 
 
 typedef struct {
@@ -88,9 +91,10 @@ write_cert_key_file (const char *path,
 
 	/* Try to rename */
 	errno = 0;
-	if (rename (tmppath, path) == 0)
+	if (rename (tmppath, path) == 0) {
 		success = TRUE;
-	else {
+		crypto_file_cache_invalidate (path);
+	} else {
 		unlink (tmppath);
 		g_set_error (error, NM_SETTINGS_ERROR, NM_SETTINGS_ERROR_FAILED,
 		             "Could not rename temporary file to '%s': %d",
@@ -225,6 +229,112 @@ _handler_write (NMConnection *connection,
 	return FALSE;
 }
 
+/*****************************************************************************/
+
+/* While a batch is open, files are written without syncing each of them.
+ * The directories that got written to are synced once the batch ends. */
+static guint batch_depth;
+static GHashTable *batch_dirs;
+
+static gboolean
+_write_file_unsynced (const char *path, const char *data, gsize len, GError **error)
+{
+	gs_free char *tmp_path = NULL;
+	int fd, errsv;
+	gsize written = 0;
+
+	/* same suffix as g_file_set_contents(), so that the temporary file is
+	 * ignored by the monitor (see nm_keyfile_plugin_utils_should_ignore_file()) */
+	tmp_path = g_strdup_printf ("%s.XXXXXX", path);
+	fd = g_mkstemp_full (tmp_path, O_RDWR | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		errsv = errno;
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+		             "failed to create '%s': %s", tmp_path, g_strerror (errsv));
+		return FALSE;
+	}
+
+	while (written < len) {
+		ssize_t n = write (fd, data + written, len - written);
+
+		if (n < 0) {
+			errsv = errno;
+			if (errsv == EINTR)
+				continue;
+			g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+			             "failed to write '%s': %s", tmp_path, g_strerror (errsv));
+			goto fail;
+		}
+		written += n;
+	}
+
+	if (close (fd) < 0) {
+		fd = -1;
+		errsv = errno;
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+		             "failed to close '%s': %s", tmp_path, g_strerror (errsv));
+		goto fail;
+	}
+	fd = -1;
+
+	if (rename (tmp_path, path) < 0) {
+		errsv = errno;
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+		             "failed to rename '%s' to '%s': %s", tmp_path, path, g_strerror (errsv));
+		goto fail;
+	}
+	return TRUE;
+
+fail:
+	if (fd >= 0)
+		close (fd);
+	unlink (tmp_path);
+	return FALSE;
+}
+
+static void
+_sync_dir (const char *dir)
+{
+	int fd;
+
+	fd = open (dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		nm_log_warn (LOGD_SETTINGS, "keyfile: failed to open '%s' for syncing: %s", dir, g_strerror (errno));
+		return;
+	}
+
+	/* Flush the file contents written during the batch, then the renames */
+	if (syncfs (fd) < 0 || fsync (fd) < 0)
+		nm_log_warn (LOGD_SETTINGS, "keyfile: failed to sync '%s': %s", dir, g_strerror (errno));
+	close (fd);
+}
+
+void
+nm_keyfile_plugin_write_batch_begin (void)
+{
+	if (batch_depth++ == 0 && !batch_dirs)
+		batch_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+void
+nm_keyfile_plugin_write_batch_end (void)
+{
+	GHashTableIter iter;
+	const char *dir;
+
+	g_return_if_fail (batch_depth > 0);
+
+	if (--batch_depth > 0)
+		return;
+
+	g_hash_table_iter_init (&iter, batch_dirs);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &dir, NULL))
+		_sync_dir (dir);
+	g_hash_table_remove_all (batch_dirs);
+}
+
+/*****************************************************************************/
+
 static gboolean
 _internal_write_connection (NMConnection *connection,
                             const char *keyfile_dir,
@@ -326,7 +436,11 @@ _internal_write_connection (NMConnection *connection,
 	if (existing_path != NULL && strcmp (path, existing_path) != 0)
 		unlink (existing_path);
 
-	g_file_set_contents (path, data, len, &local_err);
+	if (batch_depth > 0) {
+		if (_write_file_unsynced (path, data, len, &local_err))
+			g_hash_table_add (batch_dirs, g_strdup (keyfile_dir));
+	} else
+		g_file_set_contents (path, data, len, &local_err);
 	if (local_err) {
 		g_set_error (error, NM_SETTINGS_ERROR, NM_SETTINGS_ERROR_FAILED,
 		             "%s.%d: error writing to file '%s': %s", __FILE__, __LINE__,
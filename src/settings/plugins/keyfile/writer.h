@@ -37,4 +37,7 @@ gboolean nm_keyfile_plugin_write_test_connection (NMConnection *connection,
                                                   char **out_path,
                                                   GError **error);
 
+void nm_keyfile_plugin_write_batch_begin (void);
+void nm_keyfile_plugin_write_batch_end (void);
+
 #endif /* _KEYFILE_PLUGIN_WRITER_H */
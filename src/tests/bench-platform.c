@@ -0,0 +1,453 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ *
+ */
+
+/* Benchmarks for the platform, route and IP configuration hot paths.
+ *
+ * The workloads run against NMFakePlatform: N links with M addresses and
+ * M routes each. Every benchmark is run for several rounds, doubling M
+ * in each round, and one line of JSON is printed per benchmark and round,
+ * see nm-bench-utils.h.
+ *
+ * With --max-growth the program exits with a failure if the growth of any
+ * benchmark exceeds the given factor.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "nm-platform.h"
+#include "nm-fake-platform.h"
+#include "nm-route-manager.h"
+#include "nm-default-route-manager.h"
+#include "nm-ip4-config.h"
+#include "nm-logging.h"
+
+#include "nm-test-utils.h"
+#include "nm-bench-utils.h"
+
+static struct {
+	guint links;
+	guint per_link;
+	guint rounds;
+	guint iterations;
+	double max_growth;
+} opts = {
+	.links = 16,
+	.per_link = 64,
+	.rounds = 4,
+	.iterations = 5,
+};
+
+static int *ifindexes;
+static NMBench bench;
+
+/*****************************************************************************/
+
+static void
+timing_report (const NMBenchTiming *t, guint round, guint per_link)
+{
+	nm_bench_timing_report (&bench, t, round, "\"links\": %u, \"per-link\": %u", opts.links, per_link);
+}
+
+static void
+drain_main_context (void)
+{
+	while (g_main_context_iteration (NULL, FALSE))
+		;
+}
+
+/*****************************************************************************/
+
+static in_addr_t
+address_nth (guint link, guint n)
+{
+	return htonl ((10u << 24) | (link << 16) | (n + 1));
+}
+
+static in_addr_t
+route_nth (guint link, guint n)
+{
+	return htonl ((172u << 24) | (link << 16) | (n + 1));
+}
+
+static GArray *
+build_addresses (guint link, guint per_link, guint offset)
+{
+	GArray *addresses = g_array_sized_new (FALSE, TRUE, sizeof (NMPlatformIP4Address), per_link);
+	guint i;
+
+	for (i = 0; i < per_link; i++) {
+		NMPlatformIP4Address a = { 0 };
+
+		a.ifindex = ifindexes[link];
+		a.source = NM_IP_CONFIG_SOURCE_USER;
+		a.address = address_nth (link, i + offset);
+		a.plen = 16;
+		a.lifetime = NM_PLATFORM_LIFETIME_PERMANENT;
+		a.preferred = NM_PLATFORM_LIFETIME_PERMANENT;
+		g_array_append_val (addresses, a);
+	}
+	return addresses;
+}
+
+static GArray *
+build_routes (guint link, guint per_link, guint offset)
+{
+	GArray *routes = g_array_sized_new (FALSE, TRUE, sizeof (NMPlatformIP4Route), per_link);
+	guint i;
+
+	for (i = 0; i < per_link; i++) {
+		NMPlatformIP4Route r = { 0 };
+
+		r.ifindex = ifindexes[link];
+		r.source = NM_IP_CONFIG_SOURCE_USER;
+		r.network = route_nth (link, i + offset);
+		r.plen = 32;
+		r.metric = 100;
+		g_array_append_val (routes, r);
+	}
+	return routes;
+}
+
+static NMIP4Config *
+build_config (guint link, guint per_link, guint offset)
+{
+	NMIP4Config *config = nm_ip4_config_new (ifindexes[link]);
+	gs_unref_array GArray *addresses = build_addresses (link, per_link, offset);
+	gs_unref_array GArray *routes = build_routes (link, per_link, offset);
+	guint i;
+
+	for (i = 0; i < addresses->len; i++)
+		nm_ip4_config_add_address (config, &g_array_index (addresses, NMPlatformIP4Address, i));
+	for (i = 0; i < routes->len; i++)
+		nm_ip4_config_add_route (config, &g_array_index (routes, NMPlatformIP4Route, i));
+	return config;
+}
+
+/*****************************************************************************/
+
+/* nm_platform_ip4_address_sync() from an empty link, with nothing to do,
+ * and with half of the addresses replaced.
+ */
+static void
+bench_address_sync (guint round, guint per_link)
+{
+	NMBenchTiming initial, noop, replace;
+	guint it, l;
+
+	nm_bench_timing_init (&initial, "ip4-address-sync-initial");
+	nm_bench_timing_init (&noop, "ip4-address-sync-noop");
+	nm_bench_timing_init (&replace, "ip4-address-sync-replace");
+
+	for (it = 0; it < opts.iterations; it++) {
+		gint64 start;
+
+		for (l = 0; l < opts.links; l++)
+			nm_platform_address_flush (NM_PLATFORM_GET, ifindexes[l]);
+		drain_main_context ();
+
+		for (l = 0; l < opts.links; l++) {
+			gs_unref_array GArray *addresses = build_addresses (l, per_link, 0);
+
+			start = g_get_monotonic_time ();
+			nm_platform_ip4_address_sync (NM_PLATFORM_GET, ifindexes[l], addresses, NM_PLATFORM_ROUTE_METRIC_IP4_DEVICE_ROUTE);
+			nm_bench_timing_add (&initial, start);
+
+			start = g_get_monotonic_time ();
+			nm_platform_ip4_address_sync (NM_PLATFORM_GET, ifindexes[l], addresses, NM_PLATFORM_ROUTE_METRIC_IP4_DEVICE_ROUTE);
+			nm_bench_timing_add (&noop, start);
+		}
+
+		for (l = 0; l < opts.links; l++) {
+			gs_unref_array GArray *addresses = build_addresses (l, per_link, per_link / 2);
+
+			start = g_get_monotonic_time ();
+			nm_platform_ip4_address_sync (NM_PLATFORM_GET, ifindexes[l], addresses, NM_PLATFORM_ROUTE_METRIC_IP4_DEVICE_ROUTE);
+			nm_bench_timing_add (&replace, start);
+		}
+		drain_main_context ();
+	}
+
+	/* Leave the addresses of the first set in place for the IP config benchmark */
+	for (l = 0; l < opts.links; l++) {
+		gs_unref_array GArray *addresses = build_addresses (l, per_link, 0);
+
+		nm_platform_ip4_address_sync (NM_PLATFORM_GET, ifindexes[l], addresses, NM_PLATFORM_ROUTE_METRIC_IP4_DEVICE_ROUTE);
+	}
+	drain_main_context ();
+
+	timing_report (&initial, round, per_link);
+	timing_report (&noop, round, per_link);
+	timing_report (&replace, round, per_link);
+}
+
+/* nm_route_manager_ip4_route_sync() from an empty link, with nothing to
+ * do, and with half of the routes replaced.
+ */
+static void
+bench_route_sync (guint round, guint per_link)
+{
+	NMRouteManager *route_manager = nm_route_manager_get ();
+	NMBenchTiming initial, noop, replace;
+	guint it, l;
+
+	nm_bench_timing_init (&initial, "ip4-route-sync-initial");
+	nm_bench_timing_init (&noop, "ip4-route-sync-noop");
+	nm_bench_timing_init (&replace, "ip4-route-sync-replace");
+
+	for (it = 0; it < opts.iterations; it++) {
+		gint64 start;
+
+		for (l = 0; l < opts.links; l++)
+			nm_route_manager_route_flush (route_manager, ifindexes[l]);
+		drain_main_context ();
+
+		for (l = 0; l < opts.links; l++) {
+			gs_unref_array GArray *routes = build_routes (l, per_link, 0);
+
+			start = g_get_monotonic_time ();
+			nm_route_manager_ip4_route_sync (route_manager, ifindexes[l], routes);
+			nm_bench_timing_add (&initial, start);
+
+			start = g_get_monotonic_time ();
+			nm_route_manager_ip4_route_sync (route_manager, ifindexes[l], routes);
+			nm_bench_timing_add (&noop, start);
+		}
+
+		for (l = 0; l < opts.links; l++) {
+			gs_unref_array GArray *routes = build_routes (l, per_link, per_link / 2);
+
+			start = g_get_monotonic_time ();
+			nm_route_manager_ip4_route_sync (route_manager, ifindexes[l], routes);
+			nm_bench_timing_add (&replace, start);
+		}
+		drain_main_context ();
+	}
+
+	for (l = 0; l < opts.links; l++) {
+		gs_unref_array GArray *routes = build_routes (l, per_link, 0);
+
+		nm_route_manager_ip4_route_sync (route_manager, ifindexes[l], routes);
+	}
+	drain_main_context ();
+
+	timing_report (&initial, round, per_link);
+	timing_report (&noop, round, per_link);
+	timing_report (&replace, round, per_link);
+}
+
+/* An event storm: default routes appear and disappear on every link, and
+ * the resync of NMDefaultRouteManager runs on the next idle. The time of
+ * the platform operations, including the signal handlers, and the time of
+ * the deferred resync are measured separately.
+ */
+static void
+bench_default_route_resync (guint round, guint per_link)
+{
+	NMBenchTiming storm, resync;
+	guint it, l;
+
+	/* Make sure the manager is listening for platform changes */
+	nm_default_route_manager_get ();
+
+	nm_bench_timing_init (&storm, "default-route-event-storm");
+	nm_bench_timing_init (&resync, "default-route-resync");
+
+	for (it = 0; it < opts.iterations; it++) {
+		gint64 start;
+
+		start = g_get_monotonic_time ();
+		for (l = 0; l < opts.links; l++) {
+			nm_platform_ip4_route_add (NM_PLATFORM_GET, ifindexes[l], NM_IP_CONFIG_SOURCE_USER,
+			                           0, 0, 0, 0, 1000 + l, 0);
+		}
+		nm_bench_timing_add (&storm, start);
+
+		start = g_get_monotonic_time ();
+		drain_main_context ();
+		nm_bench_timing_add (&resync, start);
+
+		for (l = 0; l < opts.links; l++)
+			nm_platform_ip4_route_delete (NM_PLATFORM_GET, ifindexes[l], 0, 0, 1000 + l);
+		drain_main_context ();
+	}
+
+	timing_report (&storm, round, per_link);
+	timing_report (&resync, round, per_link);
+}
+
+/* nm_ip4_config_merge() and nm_ip4_config_subtract() of configurations
+ * holding the objects of all links.
+ */
+static void
+bench_config_merge_subtract (guint round, guint per_link)
+{
+	gs_unref_object NMIP4Config *src = nm_ip4_config_new (1);
+	NMBenchTiming merge, subtract;
+	guint it, l;
+
+	for (l = 0; l < opts.links; l++) {
+		gs_unref_object NMIP4Config *config = build_config (l, per_link, 0);
+
+		nm_ip4_config_merge (src, config);
+	}
+
+	nm_bench_timing_init (&merge, "ip4-config-merge");
+	nm_bench_timing_init (&subtract, "ip4-config-subtract");
+
+	for (it = 0; it < opts.iterations; it++) {
+		gs_unref_object NMIP4Config *dst = nm_ip4_config_new (1);
+		gint64 start;
+
+		start = g_get_monotonic_time ();
+		nm_ip4_config_merge (dst, src);
+		nm_bench_timing_add (&merge, start);
+
+		start = g_get_monotonic_time ();
+		nm_ip4_config_subtract (dst, src);
+		nm_bench_timing_add (&subtract, start);
+
+		g_assert_cmpint (nm_ip4_config_get_num_addresses (dst), ==, 0);
+	}
+
+	timing_report (&merge, round, per_link);
+	timing_report (&subtract, round, per_link);
+}
+
+/* What NMDevice's update_ip_config() does for IPv4 on an external change:
+ * capture the configuration of the link, intersect the internal
+ * configuration with it, subtract the internal parts from the captured one
+ * and merge both into the composite configuration.
+ */
+static void
+bench_update_ip_config (guint round, guint per_link)
+{
+	NMIP4Config **con;
+	NMBenchTiming update;
+	guint it, l;
+
+	con = g_new0 (NMIP4Config *, opts.links);
+	for (l = 0; l < opts.links; l++)
+		con[l] = build_config (l, per_link, 0);
+
+	nm_bench_timing_init (&update, "update-ip-config");
+
+	for (it = 0; it < opts.iterations; it++) {
+		gint64 start;
+
+		for (l = 0; l < opts.links; l++) {
+			gs_unref_object NMIP4Config *ext = NULL;
+			gs_unref_object NMIP4Config *composite = NULL;
+
+			start = g_get_monotonic_time ();
+			ext = nm_ip4_config_capture (ifindexes[l], FALSE);
+			nm_ip4_config_intersect (con[l], ext);
+			nm_ip4_config_subtract (ext, con[l]);
+			composite = nm_ip4_config_new (ifindexes[l]);
+			nm_ip4_config_merge (composite, con[l]);
+			nm_ip4_config_merge (composite, ext);
+			nm_bench_timing_add (&update, start);
+		}
+	}
+
+	for (l = 0; l < opts.links; l++)
+		g_object_unref (con[l]);
+	g_free (con);
+
+	timing_report (&update, round, per_link);
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	GOptionEntry entries[] = {
+		{ "links", 0, 0, G_OPTION_ARG_INT, &opts.links, "Number of links (default 16)", "N" },
+		{ "per-link", 0, 0, G_OPTION_ARG_INT, &opts.per_link, "Addresses and routes per link in the first round (default 64)", "M" },
+		{ "rounds", 0, 0, G_OPTION_ARG_INT, &opts.rounds, "Number of rounds, doubling the objects per link each time (default 4)", "R" },
+		{ "iterations", 0, 0, G_OPTION_ARG_INT, &opts.iterations, "Iterations per benchmark and round (default 5)", "I" },
+		{ "max-growth", 0, 0, G_OPTION_ARG_DOUBLE, &opts.max_growth, "Fail if a benchmark slows down by more than this factor per round", "F" },
+		{ NULL }
+	};
+	GOptionContext *context;
+	GError *error = NULL;
+	guint round, l;
+
+	nmtst_init_with_logging (&argc, &argv, "ERR", "DEFAULT");
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context, "Benchmark platform, route and IP configuration hot paths on the fake platform.");
+	g_option_context_add_main_entries (context, entries, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("bench-platform: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (   opts.links < 1 || opts.links > 255
+	    || opts.per_link < 2 || opts.rounds < 1 || opts.iterations < 1
+	    || ((guint64) opts.per_link << (opts.rounds - 1)) * 2 > 0xFF00) {
+		g_printerr ("bench-platform: invalid workload size\n");
+		return EXIT_FAILURE;
+	}
+
+	nm_fake_platform_setup ();
+
+	ifindexes = g_new0 (int, opts.links);
+	for (l = 0; l < opts.links; l++) {
+		gs_free char *name = g_strdup_printf ("bench%u", l);
+
+		g_assert (nm_platform_dummy_add (NM_PLATFORM_GET, name));
+		ifindexes[l] = nm_platform_link_get_ifindex (NM_PLATFORM_GET, name);
+		g_assert (ifindexes[l] > 0);
+		g_assert (nm_platform_link_set_up (NM_PLATFORM_GET, ifindexes[l]));
+	}
+
+	nm_bench_init (&bench, opts.max_growth);
+
+	for (round = 0; round < opts.rounds; round++) {
+		guint per_link = opts.per_link << round;
+
+		bench_address_sync (round, per_link);
+		bench_route_sync (round, per_link);
+		bench_default_route_resync (round, per_link);
+		bench_config_merge_subtract (round, per_link);
+		bench_update_ip_config (round, per_link);
+
+		for (l = 0; l < opts.links; l++) {
+			nm_route_manager_route_flush (nm_route_manager_get (), ifindexes[l]);
+			nm_platform_address_flush (NM_PLATFORM_GET, ifindexes[l]);
+		}
+		drain_main_context ();
+	}
+
+	nm_bench_clear (&bench);
+	g_free (ifindexes);
+	nm_platform_free ();
+
+	return bench.growth_exceeded ? EXIT_FAILURE : EXIT_SUCCESS;
+}
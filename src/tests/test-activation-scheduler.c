@@ -0,0 +1,207 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "nm-activation-scheduler.h"
+
+#include "nm-test-utils.h"
+
+/* Owners of queued requests, in the order their slots were granted */
+static GString *granted;
+
+static void
+granted_cb (gpointer user_data)
+{
+	g_string_append (granted, user_data);
+}
+
+static NMActivationScheduler *
+scheduler_new (guint dhcp_limit)
+{
+	guint limits[_NM_ACTIVATION_RESOURCE_NUM] = { 0 };
+
+	limits[NM_ACTIVATION_RESOURCE_DHCP] = dhcp_limit;
+	g_string_truncate (granted, 0);
+	return _nm_activation_scheduler_new_for_testing (limits);
+}
+
+static gboolean
+acquire (NMActivationScheduler *scheduler, NMActivationResource resource, const char *owner, guint *handle)
+{
+	return nm_activation_scheduler_acquire (scheduler, resource, owner, granted_cb, (gpointer) owner, handle);
+}
+
+/* Grants happen from an idle handler after a release */
+static void
+dispatch (void)
+{
+	while (g_main_context_iteration (NULL, FALSE))
+		;
+}
+
+static void
+assert_stats (NMActivationScheduler *scheduler, guint in_flight, guint queue_depth, guint64 granted_count)
+{
+	NMActivationSchedulerStats stats;
+
+	nm_activation_scheduler_get_stats (scheduler, NM_ACTIVATION_RESOURCE_DHCP, &stats);
+	g_assert_cmpint (stats.in_flight, ==, in_flight);
+	g_assert_cmpint (stats.queue_depth, ==, queue_depth);
+	g_assert_cmpint (stats.granted, ==, granted_count);
+}
+
+/*****************************************************************************/
+
+static void
+test_unlimited (void)
+{
+	NMActivationScheduler *scheduler = scheduler_new (0);
+	guint handles[5];
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (handles); i++)
+		g_assert (acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "a", &handles[i]));
+	assert_stats (scheduler, 5, 0, 5);
+
+	for (i = 0; i < G_N_ELEMENTS (handles); i++)
+		nm_activation_scheduler_release (scheduler, handles[i]);
+	dispatch ();
+	assert_stats (scheduler, 0, 0, 5);
+	g_assert_cmpstr (granted->str, ==, "");
+
+	g_object_unref (scheduler);
+}
+
+static void
+test_throttle (void)
+{
+	NMActivationScheduler *scheduler = scheduler_new (2);
+	NMActivationSchedulerStats stats;
+	guint a, b, c, d, e, fw;
+
+	g_assert (acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "a", &a));
+	g_assert (acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "b", &b));
+	g_assert (!acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "c", &c));
+	g_assert (!acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "d", &d));
+	g_assert (!acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "e", &e));
+	assert_stats (scheduler, 2, 3, 2);
+
+	/* Other resources have their own limit */
+	g_assert (acquire (scheduler, NM_ACTIVATION_RESOURCE_FIREWALL, "f", &fw));
+
+	/* Each release lets exactly one queued request through, in order */
+	nm_activation_scheduler_release (scheduler, a);
+	g_assert_cmpstr (granted->str, ==, "");
+	dispatch ();
+	g_assert_cmpstr (granted->str, ==, "c");
+	assert_stats (scheduler, 2, 2, 3);
+
+	nm_activation_scheduler_release (scheduler, c);
+	nm_activation_scheduler_release (scheduler, b);
+	dispatch ();
+	g_assert_cmpstr (granted->str, ==, "cde");
+	assert_stats (scheduler, 2, 0, 5);
+
+	nm_activation_scheduler_get_stats (scheduler, NM_ACTIVATION_RESOURCE_DHCP, &stats);
+	g_assert_cmpint (stats.limit, ==, 2);
+	g_assert_cmpint (stats.queue_depth_max, ==, 3);
+
+	nm_activation_scheduler_release (scheduler, d);
+	nm_activation_scheduler_release (scheduler, e);
+	nm_activation_scheduler_release (scheduler, fw);
+	dispatch ();
+	assert_stats (scheduler, 0, 0, 5);
+
+	g_object_unref (scheduler);
+}
+
+static void
+test_fifo (void)
+{
+	NMActivationScheduler *scheduler = scheduler_new (1);
+	guint a, b, c;
+
+	g_assert (acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "a", &a));
+	g_assert (!acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "b", &b));
+
+	/* A slot freed but not yet handed out does not let newcomers jump
+	 * the queue.
+	 */
+	nm_activation_scheduler_release (scheduler, a);
+	g_assert (!acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "c", &c));
+	dispatch ();
+	g_assert_cmpstr (granted->str, ==, "b");
+
+	nm_activation_scheduler_release (scheduler, b);
+	dispatch ();
+	g_assert_cmpstr (granted->str, ==, "bc");
+
+	nm_activation_scheduler_release (scheduler, c);
+	g_object_unref (scheduler);
+}
+
+static void
+test_cancel (void)
+{
+	NMActivationScheduler *scheduler = scheduler_new (1);
+	guint a, b, c;
+
+	g_assert (acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "a", &a));
+	g_assert (!acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "b", &b));
+	g_assert (!acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "c", &c));
+
+	/* Releasing a queued request cancels it without calling back */
+	nm_activation_scheduler_release (scheduler, b);
+	assert_stats (scheduler, 1, 1, 1);
+
+	nm_activation_scheduler_release (scheduler, a);
+	dispatch ();
+	g_assert_cmpstr (granted->str, ==, "c");
+	assert_stats (scheduler, 1, 0, 2);
+
+	/* Pending dispatches are dropped with the scheduler */
+	g_assert (!acquire (scheduler, NM_ACTIVATION_RESOURCE_DHCP, "d", &a));
+	nm_activation_scheduler_release (scheduler, c);
+	g_object_unref (scheduler);
+	dispatch ();
+	g_assert_cmpstr (granted->str, ==, "c");
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	nmtst_init_with_logging (&argc, &argv, NULL, "DEFAULT");
+
+	granted = g_string_new (NULL);
+
+	g_test_add_func ("/activation-scheduler/unlimited", test_unlimited);
+	g_test_add_func ("/activation-scheduler/throttle", test_throttle);
+	g_test_add_func ("/activation-scheduler/fifo", test_fifo);
+	g_test_add_func ("/activation-scheduler/cancel", test_cancel);
+
+	return g_test_run ();
+}
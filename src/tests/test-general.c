@@ -27,6 +27,8 @@
 #include "NetworkManagerUtils.h"
 #include "nm-logging.h"
 #include "nm-core-internal.h"
+#include "nm-default-route-manager-private.h"
+#include "nm-retry-queue.h"
 
 #include "nm-test-utils.h"
 
@@ -710,6 +712,857 @@ test_nm_match_spec_interface_name (void)
 
 /*******************************************/
 
+static GSList *
+iptables_rules_new (const char *const *table_rules)
+{
+	GSList *rules = NULL;
+
+	for (; table_rules[0]; table_rules += 2) {
+		NMUtilsIPTablesRule *rule = g_new0 (NMUtilsIPTablesRule, 1);
+
+		rule->table = g_strdup (table_rules[0]);
+		rule->rule = g_strdup (table_rules[1]);
+		rules = g_slist_append (rules, rule);
+	}
+	return rules;
+}
+
+static void
+iptables_rule_free (NMUtilsIPTablesRule *rule)
+{
+	g_free (rule->table);
+	g_free (rule->rule);
+	g_free (rule);
+}
+
+/* Replays the per-rule iptables commands for @rules against a model of the
+ * chains and checks that executing @script yields the same chains.
+ */
+static void
+assert_script_matches_commands (const char *script, GSList *rules, gboolean add)
+{
+	gs_unref_hashtable GHashTable *by_cmd = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+	gs_unref_hashtable GHashTable *by_script = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+	gs_strfreev char **lines = NULL;
+	GSList *list, *iter;
+	const char *table = NULL;
+	GHashTableIter hiter;
+	const char *key;
+	GPtrArray *cmd_ops, *script_ops;
+	guint i, n_commits = 0;
+
+	/* Each table maps to the ordered list of operations executed on it */
+	list = g_slist_copy (rules);
+	if (!add)
+		list = g_slist_reverse (list);
+	for (iter = list; iter; iter = iter->next) {
+		NMUtilsIPTablesRule *rule = iter->data;
+		gs_free char *cmd = nm_utils_iptables_rule_to_cmd (rule, add);
+		gs_free char *prefix = g_strdup_printf ("%s --table %s ", IPTABLES_PATH, rule->table);
+		GPtrArray *ops;
+
+		g_assert (g_str_has_prefix (cmd, prefix));
+		ops = g_hash_table_lookup (by_cmd, rule->table);
+		if (!ops) {
+			ops = g_ptr_array_new_with_free_func (g_free);
+			g_hash_table_insert (by_cmd, g_strdup (rule->table), ops);
+		}
+		g_ptr_array_add (ops, g_strdup (cmd + strlen (prefix)));
+	}
+	g_slist_free (list);
+
+	lines = g_strsplit (script, "\n", -1);
+	for (i = 0; lines[i]; i++) {
+		const char *line = lines[i];
+
+		if (!lines[i + 1]) {
+			/* the script ends with a newline */
+			g_assert_cmpstr (line, ==, "");
+		} else if (line[0] == '*') {
+			g_assert (!table);
+			table = line + 1;
+			g_assert (!g_hash_table_contains (by_script, table));
+			g_hash_table_insert (by_script, g_strdup (table), g_ptr_array_new_with_free_func (g_free));
+		} else if (!strcmp (line, "COMMIT")) {
+			g_assert (table);
+			table = NULL;
+			n_commits++;
+		} else {
+			g_assert (table);
+			g_ptr_array_add (g_hash_table_lookup (by_script, table), g_strdup (line));
+		}
+	}
+	g_assert (!table);
+	g_assert_cmpint (n_commits, ==, g_hash_table_size (by_cmd));
+
+	g_assert_cmpint (g_hash_table_size (by_script), ==, g_hash_table_size (by_cmd));
+	g_hash_table_iter_init (&hiter, by_cmd);
+	while (g_hash_table_iter_next (&hiter, (gpointer *) &key, (gpointer *) &cmd_ops)) {
+		script_ops = g_hash_table_lookup (by_script, key);
+		g_assert (script_ops);
+		g_assert_cmpint (script_ops->len, ==, cmd_ops->len);
+		for (i = 0; i < cmd_ops->len; i++)
+			g_assert_cmpstr (script_ops->pdata[i], ==, cmd_ops->pdata[i]);
+	}
+}
+
+static void
+test_iptables_restore_script (void)
+{
+	/* The rule set NMDevice installs for a shared connection */
+	static const char *const share_rules[] = {
+		"filter", "INPUT --in-interface eth1 --protocol tcp --destination-port 53 --jump ACCEPT",
+		"filter", "INPUT --in-interface eth1 --protocol udp --destination-port 53 --jump ACCEPT",
+		"filter", "INPUT --in-interface eth1 --protocol tcp --destination-port 67 --jump ACCEPT",
+		"filter", "INPUT --in-interface eth1 --protocol udp --destination-port 67 --jump ACCEPT",
+		"filter", "FORWARD --in-interface eth1 --jump REJECT",
+		"filter", "FORWARD --out-interface eth1 --jump REJECT",
+		"filter", "FORWARD --in-interface eth1 --out-interface eth1 --jump ACCEPT",
+		"filter", "FORWARD --source 10.42.0.0/255.255.255.0 --in-interface eth1 --jump ACCEPT",
+		"filter", "FORWARD --destination 10.42.0.0/255.255.255.0 --out-interface eth1 --match state --state ESTABLISHED,RELATED --jump ACCEPT",
+		"nat", "POSTROUTING --source 10.42.0.0/255.255.255.0 ! --destination 10.42.0.0/255.255.255.0 --jump MASQUERADE",
+		NULL,
+	};
+	/* Tables interleaved, to check grouping keeps the order within a table */
+	static const char *const mixed_rules[] = {
+		"nat", "POSTROUTING --source 10.0.0.0/255.0.0.0 --jump MASQUERADE",
+		"filter", "FORWARD --in-interface a --jump ACCEPT",
+		"nat", "PREROUTING --in-interface a --jump ACCEPT",
+		"filter", "FORWARD --out-interface a --jump ACCEPT",
+		"mangle", "FORWARD --in-interface a --jump ACCEPT",
+		NULL,
+	};
+	GSList *rules;
+	char *script;
+
+	rules = iptables_rules_new (share_rules);
+
+	script = nm_utils_iptables_rules_to_restore_script (rules, TRUE);
+	g_assert (g_str_has_prefix (script,
+	                            "*filter\n"
+	                            "--insert INPUT --in-interface eth1 --protocol tcp --destination-port 53 --jump ACCEPT\n"));
+	g_assert (g_str_has_suffix (script,
+	                            "COMMIT\n"
+	                            "*nat\n"
+	                            "--insert POSTROUTING --source 10.42.0.0/255.255.255.0 ! --destination 10.42.0.0/255.255.255.0 --jump MASQUERADE\n"
+	                            "COMMIT\n"));
+	assert_script_matches_commands (script, rules, TRUE);
+	g_free (script);
+
+	script = nm_utils_iptables_rules_to_restore_script (rules, FALSE);
+	g_assert (g_str_has_prefix (script,
+	                            "*nat\n"
+	                            "--delete POSTROUTING --source 10.42.0.0/255.255.255.0 ! --destination 10.42.0.0/255.255.255.0 --jump MASQUERADE\n"
+	                            "COMMIT\n"
+	                            "*filter\n"
+	                            "--delete FORWARD --destination 10.42.0.0/255.255.255.0"));
+	assert_script_matches_commands (script, rules, FALSE);
+	g_free (script);
+
+	g_slist_free_full (rules, (GDestroyNotify) iptables_rule_free);
+
+	rules = iptables_rules_new (mixed_rules);
+	script = nm_utils_iptables_rules_to_restore_script (rules, TRUE);
+	g_assert_cmpstr (script, ==,
+	                 "*nat\n"
+	                 "--insert POSTROUTING --source 10.0.0.0/255.0.0.0 --jump MASQUERADE\n"
+	                 "--insert PREROUTING --in-interface a --jump ACCEPT\n"
+	                 "COMMIT\n"
+	                 "*filter\n"
+	                 "--insert FORWARD --in-interface a --jump ACCEPT\n"
+	                 "--insert FORWARD --out-interface a --jump ACCEPT\n"
+	                 "COMMIT\n"
+	                 "*mangle\n"
+	                 "--insert FORWARD --in-interface a --jump ACCEPT\n"
+	                 "COMMIT\n");
+	assert_script_matches_commands (script, rules, TRUE);
+	g_free (script);
+
+	script = nm_utils_iptables_rules_to_restore_script (rules, FALSE);
+	assert_script_matches_commands (script, rules, FALSE);
+	g_free (script);
+	g_slist_free_full (rules, (GDestroyNotify) iptables_rule_free);
+
+	script = nm_utils_iptables_rules_to_restore_script (NULL, TRUE);
+	g_assert_cmpstr (script, ==, "");
+	g_free (script);
+}
+
+/*******************************************/
+
+#define DRM_N_IFINDEX 6
+
+static NMDefaultRouteEntry *
+_drm_entry_new (GRand *r, int ifindex)
+{
+	NMDefaultRouteEntry *entry = g_new0 (NMDefaultRouteEntry, 1);
+
+	entry->route.r4.ifindex = ifindex;
+	entry->route.r4.source = NM_IP_CONFIG_SOURCE_USER;
+
+	switch (g_rand_int_range (r, 0, 5)) {
+	case 0:
+		/* assumed */
+		entry->route.r4.metric = g_rand_int_range (r, 0, 8) * 10;
+		break;
+	case 1:
+		/* managed without default route */
+		entry->route.r4.metric = G_MAXUINT32;
+		entry->synced = TRUE;
+		entry->never_default = TRUE;
+		break;
+	default:
+		entry->route.r4.metric = g_rand_int_range (r, 0, 8) * 10;
+		entry->synced = TRUE;
+		break;
+	}
+	entry->effective_metric = entry->route.r4.metric;
+	return entry;
+}
+
+static GPtrArray *
+_drm_entries_copy (GPtrArray *entries, GHashTable *ids)
+{
+	GPtrArray *copy = g_ptr_array_new_with_free_func (g_free);
+	guint i;
+
+	for (i = 0; i < entries->len; i++) {
+		NMDefaultRouteEntry *e = g_memdup (entries->pdata[i], sizeof (NMDefaultRouteEntry));
+
+		g_hash_table_insert (ids, e, g_hash_table_lookup (ids, entries->pdata[i]));
+		g_ptr_array_add (copy, e);
+	}
+	return copy;
+}
+
+/* The default routes the platform has once the entries are synced: the
+ * ones of the synced entries and those of unmanaged interfaces. */
+static GArray *
+_drm_routes_synced (GPtrArray *entries, const GArray *unmanaged_routes)
+{
+	GArray *routes = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP4Route));
+	GHashTable *managed = g_hash_table_new (NULL, NULL);
+	guint i;
+
+	for (i = 0; i < entries->len; i++) {
+		const NMDefaultRouteEntry *e = entries->pdata[i];
+
+		if (e->synced)
+			g_hash_table_add (managed, GINT_TO_POINTER (e->route.r4.ifindex));
+	}
+
+	for (i = 0; i < entries->len; i++) {
+		const NMDefaultRouteEntry *e = entries->pdata[i];
+		NMPlatformIP4Route route = e->route.r4;
+
+		if (e->never_default)
+			continue;
+		if (!e->synced && g_hash_table_contains (managed, GINT_TO_POINTER (route.ifindex)))
+			continue;
+		route.metric = e->effective_metric;
+		g_array_append_val (routes, route);
+	}
+
+	for (i = 0; i < unmanaged_routes->len; i++) {
+		const NMPlatformIP4Route *route = &g_array_index (unmanaged_routes, NMPlatformIP4Route, i);
+
+		if (!g_hash_table_contains (managed, GINT_TO_POINTER (route->ifindex)))
+			g_array_append_val (routes, *route);
+	}
+
+	g_hash_table_unref (managed);
+	return routes;
+}
+
+static int
+_drm_cmp_uint32 (gconstpointer a, gconstpointer b)
+{
+	guint32 m_a = *((const guint32 *) a);
+	guint32 m_b = *((const guint32 *) b);
+
+	return m_a < m_b ? -1 : (m_a == m_b ? 0 : 1);
+}
+
+static void
+_drm_changed_metrics_normalize (GArray *metrics)
+{
+	guint i, j;
+
+	g_array_sort (metrics, _drm_cmp_uint32);
+	for (i = 0, j = 0; i < metrics->len; i++) {
+		if (j == 0 || g_array_index (metrics, guint32, j - 1) != g_array_index (metrics, guint32, i))
+			g_array_index (metrics, guint32, j++) = g_array_index (metrics, guint32, i);
+	}
+	g_array_set_size (metrics, j);
+}
+
+/* A copy of the resort and metric assignment that NMDefaultRouteManager ran
+ * for every change before it learned to resync incrementally. Both the
+ * incremental and the full resync are checked against it, so that a change
+ * in behavior of the shared code shows up too. The only difference is the
+ * lookup of the entry's own route while skipping assumed metrics, which
+ * indexed the routes with the entry index; test_default_route_entries_assumed()
+ * covers that with fixed results. */
+static int
+_drm_ref_sort_cmp (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const NMDefaultRouteEntry *e_a = *((const NMDefaultRouteEntry **) a);
+	const NMDefaultRouteEntry *e_b = *((const NMDefaultRouteEntry **) b);
+	guint32 m_a = e_a->route.rx.metric;
+	guint32 m_b = e_b->route.rx.metric;
+
+	if (m_a != m_b)
+		return (m_a < m_b) ? -1 : 1;
+	if (!!e_a->never_default != !!e_b->never_default)
+		return e_a->never_default ? 1 : -1;
+	if (!!e_a->synced != !!e_b->synced)
+		return e_a->synced ? 1 : -1;
+	return 0;
+}
+
+static gboolean
+_drm_ref_routes_has_entry (const GArray *routes, const NMDefaultRouteEntry *entry)
+{
+	NMPlatformIP4Route route = entry->route.r4;
+	guint i;
+
+	route.metric = entry->effective_metric;
+	for (i = 0; i < routes->len; i++) {
+		const NMPlatformIP4Route *r = &g_array_index (routes, NMPlatformIP4Route, i);
+
+		route.source = r->source;
+		if (nm_platform_ip4_route_cmp (r, &route) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static gboolean
+_drm_ref_resync (GPtrArray *entries,
+                 const GArray *routes,
+                 const NMDefaultRouteEntry *changed_entry,
+                 const NMDefaultRouteEntry *old_entry,
+                 GArray *changed_metrics)
+{
+	gs_unref_hashtable GHashTable *assumed_metrics = g_hash_table_new (NULL, NULL);
+	NMDefaultRouteEntry *entry;
+	gint64 last_metric = -1;
+	guint32 expected_metric;
+	gboolean changed = FALSE;
+	guint i, j;
+
+	/* an entry is added or updated, rather than removed */
+	if (changed_entry)
+		g_ptr_array_sort_with_data (entries, _drm_ref_sort_cmp, NULL);
+
+	for (i = 0; i < routes->len; i++) {
+		const NMPlatformIP4Route *route = &g_array_index (routes, NMPlatformIP4Route, i);
+		gboolean ifindex_has_synced_entry = FALSE;
+
+		for (j = 0; j < entries->len; j++) {
+			const NMDefaultRouteEntry *e = entries->pdata[j];
+
+			if (e->synced && e->route.rx.ifindex == route->ifindex) {
+				ifindex_has_synced_entry = TRUE;
+				break;
+			}
+		}
+		if (!ifindex_has_synced_entry)
+			g_hash_table_add (assumed_metrics, GUINT_TO_POINTER (route->metric));
+	}
+
+	if (old_entry && old_entry->synced && !old_entry->never_default)
+		g_array_append_val (changed_metrics, old_entry->effective_metric);
+
+	for (i = 0; i < entries->len; i++) {
+		entry = entries->pdata[i];
+
+		if (entry->never_default)
+			continue;
+
+		if (!entry->synced) {
+			gboolean has_synced_entry = FALSE;
+
+			for (j = 0; j < entries->len; j++) {
+				const NMDefaultRouteEntry *e = entries->pdata[j];
+
+				if (e->synced && e->route.rx.ifindex == entry->route.rx.ifindex) {
+					has_synced_entry = TRUE;
+					break;
+				}
+			}
+			if (!has_synced_entry)
+				last_metric = MAX (last_metric, (gint64) entry->effective_metric);
+			continue;
+		}
+
+		expected_metric = entry->route.rx.metric;
+		if ((gint64) expected_metric <= last_metric)
+			expected_metric = last_metric == G_MAXUINT32 ? G_MAXUINT32 : last_metric + 1;
+
+		while (   expected_metric < G_MAXUINT32
+		       && g_hash_table_contains (assumed_metrics, GUINT_TO_POINTER (expected_metric))) {
+			gboolean has_metric_for_ifindex = FALSE;
+
+			for (j = 0; j < routes->len; j++) {
+				const NMPlatformIP4Route *r = &g_array_index (routes, NMPlatformIP4Route, j);
+
+				if (r->metric == expected_metric && r->ifindex == entry->route.rx.ifindex) {
+					has_metric_for_ifindex = TRUE;
+					break;
+				}
+			}
+			if (has_metric_for_ifindex)
+				break;
+			expected_metric++;
+		}
+
+		if (changed_entry == entry)
+			g_array_append_val (changed_metrics, expected_metric);
+		else if (entry->effective_metric != expected_metric) {
+			g_array_append_val (changed_metrics, entry->effective_metric);
+			g_array_append_val (changed_metrics, expected_metric);
+		} else if (!_drm_ref_routes_has_entry (routes, entry))
+			g_array_append_val (changed_metrics, entry->effective_metric);
+
+		if (entry->effective_metric != expected_metric) {
+			entry->effective_metric = expected_metric;
+			changed = TRUE;
+		}
+		last_metric = expected_metric;
+	}
+
+	return changed;
+}
+
+static gboolean
+_drm_setup (GRand *r, GPtrArray *entries, GHashTable *ids, GArray **out_routes)
+{
+	gs_unref_array GArray *unmanaged_routes = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP4Route));
+	guint n, i, idx;
+	int ifindex;
+
+	for (n = g_rand_int_range (r, 0, 6); n > 0; n--) {
+		NMPlatformIP4Route route = { 0 };
+
+		route.ifindex = g_rand_int_range (r, 1, DRM_N_IFINDEX + 3);
+		route.source = NM_IP_CONFIG_SOURCE_KERNEL;
+		route.metric = g_rand_int_range (r, 0, 8) * 10;
+		g_array_append_val (unmanaged_routes, route);
+	}
+
+	/* add the entries one by one, like the manager does */
+	for (ifindex = 1; ifindex <= DRM_N_IFINDEX; ifindex++) {
+		gs_unref_array GArray *changed_metrics = g_array_new (FALSE, FALSE, sizeof (guint32));
+		NMDefaultRouteEntry *entry;
+		GArray *routes;
+
+		/* occasionally, a VPN shares the interface of its parent */
+		for (n = g_rand_int_range (r, 0, 8) == 0 ? 2 : 1; n > 0; n--) {
+			entry = _drm_entry_new (r, ifindex);
+			g_hash_table_insert (ids, entry, GUINT_TO_POINTER (g_hash_table_size (ids) + 1));
+			g_ptr_array_add (entries, entry);
+
+			routes = _drm_routes_synced (entries, unmanaged_routes);
+			idx = entries->len - 1;
+			_nm_default_route_entries_update (TRUE, entries, routes, &idx, NULL, FALSE, changed_metrics);
+			g_array_unref (routes);
+		}
+	}
+
+	/* the scenario is only meaningful if syncing the routes is stable. */
+	for (i = 0; i < 5; i++) {
+		gs_unref_array GArray *routes = _drm_routes_synced (entries, unmanaged_routes);
+		gs_unref_array GArray *changed_metrics = g_array_new (FALSE, FALSE, sizeof (guint32));
+		NMDefaultRouteEntry old_entry;
+
+		idx = 0;
+		old_entry = *((NMDefaultRouteEntry *) entries->pdata[0]);
+		if (!_nm_default_route_entries_update (TRUE, entries, routes, &idx, &old_entry, FALSE, changed_metrics)) {
+			*out_routes = g_array_ref (routes);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+static void
+_drm_assert_equal (GPtrArray *entries1, GArray *changed_metrics1,
+                   GPtrArray *entries2, GArray *changed_metrics2,
+                   GHashTable *ids, gboolean check_last_metric)
+{
+	guint i;
+
+	g_assert_cmpint (entries1->len, ==, entries2->len);
+	for (i = 0; i < entries1->len; i++) {
+		const NMDefaultRouteEntry *e1 = entries1->pdata[i];
+		const NMDefaultRouteEntry *e2 = entries2->pdata[i];
+
+		g_assert (g_hash_table_lookup (ids, e1) == g_hash_table_lookup (ids, e2));
+		if (!e1->never_default)
+			g_assert_cmpint (e1->effective_metric, ==, e2->effective_metric);
+		if (check_last_metric)
+			g_assert_cmpint (e1->last_metric, ==, e2->last_metric);
+	}
+
+	_drm_changed_metrics_normalize (changed_metrics1);
+	_drm_changed_metrics_normalize (changed_metrics2);
+	g_assert_cmpint (changed_metrics1->len, ==, changed_metrics2->len);
+	for (i = 0; i < changed_metrics1->len; i++)
+		g_assert_cmpint (g_array_index (changed_metrics1, guint32, i), ==, g_array_index (changed_metrics2, guint32, i));
+}
+
+static void
+test_default_route_entries_incremental (void)
+{
+	GRand *r = nmtst_get_rand ();
+	guint run, n_tested = 0;
+
+	for (run = 0; run < 2000; run++) {
+		gs_unref_hashtable GHashTable *ids = g_hash_table_new (NULL, NULL);
+		gs_unref_ptrarray GPtrArray *entries = g_ptr_array_new_with_free_func (g_free);
+		gs_unref_ptrarray GPtrArray *entries_inc = NULL;
+		gs_unref_ptrarray GPtrArray *entries_full = NULL;
+		gs_unref_ptrarray GPtrArray *entries_ref = NULL;
+		gs_unref_array GArray *routes = NULL;
+		gs_unref_array GArray *changed_inc = g_array_new (FALSE, FALSE, sizeof (guint32));
+		gs_unref_array GArray *changed_full = g_array_new (FALSE, FALSE, sizeof (guint32));
+		gs_unref_array GArray *changed_ref = g_array_new (FALSE, FALSE, sizeof (guint32));
+		gboolean result_inc, result_full, result_ref;
+		guint idx, idx_inc, idx_full;
+
+		if (!_drm_setup (r, entries, ids, &routes))
+			continue;
+		n_tested++;
+
+		entries_inc = _drm_entries_copy (entries, ids);
+		entries_full = _drm_entries_copy (entries, ids);
+		entries_ref = _drm_entries_copy (entries, ids);
+		idx = g_rand_int_range (r, 0, entries->len);
+
+		switch (g_rand_int_range (r, 0, 3)) {
+		case 0: {
+			/* add */
+			NMDefaultRouteEntry *entry = _drm_entry_new (r, g_rand_int_range (r, 1, DRM_N_IFINDEX + 3));
+
+			g_hash_table_insert (ids, entry, GUINT_TO_POINTER (g_hash_table_size (ids) + 1));
+			g_ptr_array_add (entries_inc, entry);
+			g_ptr_array_add (entries_full, g_memdup (entry, sizeof (*entry)));
+			g_hash_table_insert (ids, entries_full->pdata[entries_full->len - 1], g_hash_table_lookup (ids, entry));
+			g_ptr_array_add (entries_ref, g_memdup (entry, sizeof (*entry)));
+			g_hash_table_insert (ids, entries_ref->pdata[entries_ref->len - 1], g_hash_table_lookup (ids, entry));
+
+			idx_inc = idx_full = entries_inc->len - 1;
+			result_inc = _nm_default_route_entries_update (TRUE, entries_inc, routes, &idx_inc, NULL, TRUE, changed_inc);
+			result_full = _nm_default_route_entries_update (TRUE, entries_full, routes, &idx_full, NULL, FALSE, changed_full);
+			result_ref = _drm_ref_resync (entries_ref, routes, entries_ref->pdata[entries_ref->len - 1], NULL, changed_ref);
+			g_assert_cmpint (idx_inc, ==, idx_full);
+			break;
+		}
+		case 1: {
+			/* update */
+			NMDefaultRouteEntry *e_inc = entries_inc->pdata[idx];
+			NMDefaultRouteEntry *e_full = entries_full->pdata[idx];
+			NMDefaultRouteEntry *e_ref = entries_ref->pdata[idx];
+			NMDefaultRouteEntry old_entry = *e_inc;
+			gs_free NMDefaultRouteEntry *changed = _drm_entry_new (r, e_inc->route.r4.ifindex);
+
+			e_inc->route = e_full->route = e_ref->route = changed->route;
+			e_inc->synced = e_full->synced = e_ref->synced = changed->synced;
+			e_inc->never_default = e_full->never_default = e_ref->never_default = changed->never_default;
+			if (!changed->synced && !changed->never_default)
+				e_inc->effective_metric = e_full->effective_metric = e_ref->effective_metric = changed->route.r4.metric;
+
+			idx_inc = idx_full = idx;
+			result_inc = _nm_default_route_entries_update (TRUE, entries_inc, routes, &idx_inc, &old_entry, TRUE, changed_inc);
+			result_full = _nm_default_route_entries_update (TRUE, entries_full, routes, &idx_full, &old_entry, FALSE, changed_full);
+			result_ref = _drm_ref_resync (entries_ref, routes, e_ref, &old_entry, changed_ref);
+			g_assert_cmpint (idx_inc, ==, idx_full);
+			break;
+		}
+		default: {
+			/* remove */
+			NMDefaultRouteEntry removed = *((NMDefaultRouteEntry *) entries_inc->pdata[idx]);
+
+			g_ptr_array_remove_index (entries_inc, idx);
+			g_ptr_array_remove_index (entries_full, idx);
+			g_ptr_array_remove_index (entries_ref, idx);
+			result_inc = _nm_default_route_entries_remove (TRUE, entries_inc, routes, idx, &removed, TRUE, changed_inc);
+			result_full = _nm_default_route_entries_remove (TRUE, entries_full, routes, idx, &removed, FALSE, changed_full);
+			result_ref = _drm_ref_resync (entries_ref, routes, NULL, &removed, changed_ref);
+			break;
+		}
+		}
+
+		g_assert_cmpint (!result_full, ==, !result_ref);
+		_drm_assert_equal (entries_full, changed_full, entries_ref, changed_ref, ids, FALSE);
+		g_assert_cmpint (!result_inc, ==, !result_full);
+		_drm_assert_equal (entries_inc, changed_inc, entries_full, changed_full, ids, TRUE);
+	}
+
+	g_assert_cmpint (n_tested, >, 0);
+}
+
+static void
+_drm_route_add (GArray *routes, int ifindex, guint32 metric)
+{
+	NMPlatformIP4Route route = { 0 };
+
+	route.ifindex = ifindex;
+	route.source = NM_IP_CONFIG_SOURCE_KERNEL;
+	route.metric = metric;
+	g_array_append_val (routes, route);
+}
+
+static NMDefaultRouteEntry *
+_drm_entry_add (GPtrArray *entries, const GArray *routes, int ifindex, guint32 metric, gboolean synced)
+{
+	gs_unref_array GArray *changed_metrics = g_array_new (FALSE, FALSE, sizeof (guint32));
+	NMDefaultRouteEntry *entry = g_new0 (NMDefaultRouteEntry, 1);
+	guint idx;
+
+	entry->route.r4.ifindex = ifindex;
+	entry->route.r4.source = NM_IP_CONFIG_SOURCE_USER;
+	entry->route.r4.metric = metric;
+	entry->effective_metric = metric;
+	entry->synced = synced;
+	g_ptr_array_add (entries, entry);
+
+	idx = entries->len - 1;
+	_nm_default_route_entries_update (TRUE, entries, routes, &idx, NULL, FALSE, changed_metrics);
+	return entry;
+}
+
+static void
+test_default_route_entries_assumed (void)
+{
+	gs_unref_ptrarray GPtrArray *entries = NULL;
+	gs_unref_array GArray *routes = NULL;
+	NMDefaultRouteEntry *e1, *e2;
+
+	/* The metric of an assumed interface's route is skipped... */
+	entries = g_ptr_array_new_with_free_func (g_free);
+	routes = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP4Route));
+	_drm_route_add (routes, 2, 10);
+	e1 = _drm_entry_add (entries, routes, 1, 10, TRUE);
+	g_assert_cmpint (e1->effective_metric, ==, 11);
+	g_ptr_array_unref (entries);
+	g_array_unref (routes);
+
+	/* ...unless the entry's own interface already has a route with that
+	 * metric, wherever that is in the list of routes. */
+	entries = g_ptr_array_new_with_free_func (g_free);
+	routes = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP4Route));
+	_drm_route_add (routes, 2, 10);
+	_drm_route_add (routes, 1, 10);
+	e1 = _drm_entry_add (entries, routes, 1, 10, TRUE);
+	g_assert_cmpint (e1->effective_metric, ==, 10);
+	g_ptr_array_unref (entries);
+	g_array_unref (routes);
+
+	/* An assumed entry goes first and keeps its metric */
+	entries = g_ptr_array_new_with_free_func (g_free);
+	routes = g_array_new (FALSE, FALSE, sizeof (NMPlatformIP4Route));
+	_drm_route_add (routes, 3, 20);
+	e1 = _drm_entry_add (entries, routes, 1, 20, TRUE);
+	e2 = _drm_entry_add (entries, routes, 3, 20, FALSE);
+	g_assert (entries->pdata[0] == e2);
+	g_assert (entries->pdata[1] == e1);
+	g_assert_cmpint (e2->effective_metric, ==, 20);
+	g_assert_cmpint (e1->effective_metric, ==, 21);
+}
+
+/*******************************************/
+
+typedef struct {
+	gint64 now;
+	GPtrArray *expired;
+	NMRetryQueue *queue;
+	gboolean *reblocked;
+} RetryQueueData;
+
+static gint64
+_rq_clock (gpointer user_data)
+{
+	return ((RetryQueueData *) user_data)->now;
+}
+
+static void
+_rq_expired (gpointer item, gpointer user_data)
+{
+	RetryQueueData *data = user_data;
+
+	g_assert (!nm_retry_queue_is_blocked (data->queue, item));
+	g_ptr_array_add (data->expired, item);
+
+	/* odd items fail once more; blocking again from the callback must not
+	 * expire the item in the same dispatch */
+	if (   data->reblocked
+	    && GPOINTER_TO_UINT (item) % 2
+	    && !data->reblocked[GPOINTER_TO_UINT (item)]) {
+		data->reblocked[GPOINTER_TO_UINT (item)] = TRUE;
+		nm_retry_queue_block (data->queue, item);
+	}
+}
+
+static NMRetryQueue *
+_rq_new (RetryQueueData *data, guint delay_s, guint max_delay_s, guint jitter_percent)
+{
+	memset (data, 0, sizeof (*data));
+	data->now = 1000;
+	data->expired = g_ptr_array_new ();
+	data->queue = nm_retry_queue_new (delay_s, max_delay_s, jitter_percent, _rq_expired, data);
+	_nm_retry_queue_set_clock (data->queue, _rq_clock, data);
+	return data->queue;
+}
+
+static void
+_rq_free (RetryQueueData *data)
+{
+	nm_retry_queue_free (data->queue);
+	g_ptr_array_free (data->expired, TRUE);
+}
+
+static void
+test_retry_queue_backoff (void)
+{
+	RetryQueueData data;
+	NMRetryQueue *queue = _rq_new (&data, 10, 40, 0);
+	gpointer item = GUINT_TO_POINTER (1);
+
+	g_assert_cmpint (nm_retry_queue_get_next_deadline (queue), ==, 0);
+	g_assert_cmpint (nm_retry_queue_block (queue, item), ==, 11000);
+	g_assert (nm_retry_queue_is_blocked (queue, item));
+
+	data.now = 10999;
+	g_assert_cmpint (nm_retry_queue_dispatch (queue), ==, 0);
+	g_assert_cmpint (data.expired->len, ==, 0);
+
+	data.now = 11000;
+	g_assert_cmpint (nm_retry_queue_dispatch (queue), ==, 1);
+	g_assert_cmpint (data.expired->len, ==, 1);
+	g_assert (data.expired->pdata[0] == item);
+	g_assert (!nm_retry_queue_is_blocked (queue, item));
+
+	/* the delay doubles until it reaches the maximum */
+	g_assert_cmpint (nm_retry_queue_block (queue, item), ==, 11000 + 20000);
+	g_assert_cmpint (nm_retry_queue_block (queue, item), ==, 11000 + 40000);
+	g_assert_cmpint (nm_retry_queue_block (queue, item), ==, 11000 + 40000);
+	g_assert_cmpint (nm_retry_queue_get_length (queue), ==, 1);
+
+	/* forgetting resets the delay */
+	nm_retry_queue_forget (queue, item);
+	g_assert (!nm_retry_queue_is_blocked (queue, item));
+	g_assert_cmpint (nm_retry_queue_get_length (queue), ==, 0);
+	g_assert_cmpint (nm_retry_queue_block (queue, item), ==, 11000 + 10000);
+
+	data.now = G_MAXINT64 / 2;
+	g_assert_cmpint (nm_retry_queue_dispatch (queue), ==, 1);
+	g_assert_cmpint (data.expired->len, ==, 2);
+
+	_rq_free (&data);
+}
+
+static void
+test_retry_queue_jitter (void)
+{
+	RetryQueueData data;
+	NMRetryQueue *queue = _rq_new (&data, 100, 100, 20);
+	guint i;
+
+	for (i = 1; i <= 200; i++) {
+		gint64 deadline = nm_retry_queue_block (queue, GUINT_TO_POINTER (i));
+
+		g_assert_cmpint (deadline, >=, 1000 + 80000);
+		g_assert_cmpint (deadline, <=, 1000 + 120000);
+	}
+	g_assert_cmpint (nm_retry_queue_get_length (queue), ==, 200);
+	g_assert_cmpint (nm_retry_queue_get_next_deadline (queue), >=, 1000 + 80000);
+
+	_rq_free (&data);
+}
+
+static void
+test_retry_queue_many (void)
+{
+	RetryQueueData data;
+	NMRetryQueue *queue = _rq_new (&data, 1, 2, 0);
+	GRand *r = nmtst_get_rand ();
+	const guint n_items = 1000;
+	gint64 *deadlines;
+	guint i, n_blocked, n_expired = 0;
+
+	deadlines = g_new0 (gint64, n_items + 1);
+	data.reblocked = g_new0 (gboolean, n_items + 1);
+
+	/* items fail one after another, 10 ms apart and in random order of
+	 * their ids, so that the heap has to order them */
+	for (i = 0; i < n_items; i++) {
+		guint id;
+
+		do {
+			id = g_rand_int_range (r, 1, n_items + 1);
+		} while (deadlines[id]);
+		deadlines[id] = nm_retry_queue_block (queue, GUINT_TO_POINTER (id));
+		g_assert_cmpint (deadlines[id], ==, data.now + 1000);
+		data.now += 10;
+	}
+	n_blocked = n_items;
+	g_assert_cmpint (nm_retry_queue_get_length (queue), ==, n_blocked);
+
+	data.now = 1000;
+	while (n_blocked > 0) {
+		guint n, expected = 0;
+
+		data.now += g_rand_int_range (r, 0, 100);
+
+		for (i = 1; i <= n_items; i++) {
+			if (deadlines[i] && deadlines[i] <= data.now)
+				expected++;
+		}
+
+		g_ptr_array_set_size (data.expired, 0);
+		n = nm_retry_queue_dispatch (queue);
+
+		/* only the expired items are touched, earliest first */
+		g_assert_cmpint (n, ==, expected);
+		g_assert_cmpint (data.expired->len, ==, expected);
+		for (i = 0; i < data.expired->len; i++) {
+			guint id = GPOINTER_TO_UINT (data.expired->pdata[i]);
+
+			g_assert_cmpint (deadlines[id], <=, data.now);
+			if (i > 0)
+				g_assert_cmpint (deadlines[GPOINTER_TO_UINT (data.expired->pdata[i - 1])], <=, deadlines[id]);
+		}
+		for (i = 0; i < data.expired->len; i++) {
+			guint id = GPOINTER_TO_UINT (data.expired->pdata[i]);
+
+			if (nm_retry_queue_is_blocked (queue, GUINT_TO_POINTER (id))) {
+				/* the second failure gets the doubled delay */
+				deadlines[id] = data.now + 2000;
+			} else {
+				deadlines[id] = 0;
+				n_blocked--;
+			}
+		}
+		n_expired += n;
+
+		g_assert_cmpint (nm_retry_queue_get_length (queue), ==, n_blocked);
+		if (n_blocked)
+			g_assert_cmpint (nm_retry_queue_get_next_deadline (queue), >, data.now);
+		else
+			g_assert_cmpint (nm_retry_queue_get_next_deadline (queue), ==, 0);
+	}
+
+	g_assert_cmpint (n_expired, ==, n_items + n_items / 2);
+
+	g_free (deadlines);
+	g_free (data.reblocked);
+	_rq_free (&data);
+}
+
+/*******************************************/
+
 NMTST_DEFINE ();
 
 int
@@ -733,6 +1586,15 @@ main (int argc, char **argv)
 
 	g_test_add_func ("/general/nm_match_spec_interface_name", test_nm_match_spec_interface_name);
 
+	g_test_add_func ("/general/iptables-restore-script", test_iptables_restore_script);
+
+	g_test_add_func ("/general/default-route-entries/incremental", test_default_route_entries_incremental);
+	g_test_add_func ("/general/default-route-entries/assumed", test_default_route_entries_assumed);
+
+	g_test_add_func ("/general/retry-queue/backoff", test_retry_queue_backoff);
+	g_test_add_func ("/general/retry-queue/jitter", test_retry_queue_jitter);
+	g_test_add_func ("/general/retry-queue/many", test_retry_queue_many);
+
 	return g_test_run ();
 }
 
@@ -0,0 +1,392 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include "nm-hostname-resolver.h"
+
+#include "nm-test-utils.h"
+
+#define ADDR_FOUND     "192.0.2.1"
+#define ADDR_NOT_FOUND "192.0.2.2"
+#define ADDR_SILENT    "192.0.2.3"
+
+/* Answers reverse lookups from a fixed table. Addresses missing from the
+ * table are never answered, like by an unreachable server, until the lookup
+ * is cancelled. */
+static struct {
+	GHashTable *names;      /* address :: hostname, "" if not found */
+	guint n_calls;
+	guint n_cancelled;
+	guint n_finished;       /* completions delivered to the resolver */
+} stub;
+
+typedef struct {
+	GResolver parent;
+} StubResolver;
+
+typedef struct {
+	GResolverClass parent;
+} StubResolverClass;
+
+static GType stub_resolver_get_type (void);
+
+G_DEFINE_TYPE (StubResolver, stub_resolver, G_TYPE_RESOLVER)
+
+static void
+stub_cancelled_cb (GCancellable *cancellable, gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+
+	stub.n_cancelled++;
+	g_simple_async_result_set_error (simple, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Operation was cancelled");
+	g_simple_async_result_complete_in_idle (simple);
+}
+
+static void
+stub_lookup_by_address_async (GResolver *resolver,
+                              GInetAddress *address,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer user_data)
+{
+	GSimpleAsyncResult *simple;
+	gs_free char *addr_str = NULL;
+	const char *hostname;
+
+	stub.n_calls++;
+
+	simple = g_simple_async_result_new (G_OBJECT (resolver), callback, user_data,
+	                                    stub_lookup_by_address_async);
+	addr_str = g_inet_address_to_string (address);
+	hostname = g_hash_table_lookup (stub.names, addr_str);
+	if (!hostname) {
+		g_assert (cancellable);
+		g_cancellable_connect (cancellable, G_CALLBACK (stub_cancelled_cb), simple, g_object_unref);
+		return;
+	}
+
+	if (hostname[0])
+		g_simple_async_result_set_op_res_gpointer (simple, g_strdup (hostname), g_free);
+	else {
+		g_simple_async_result_set_error (simple, G_RESOLVER_ERROR, G_RESOLVER_ERROR_NOT_FOUND,
+		                                 "No name for %s", addr_str);
+	}
+	g_simple_async_result_complete_in_idle (simple);
+	g_object_unref (simple);
+}
+
+static char *
+stub_lookup_by_address_finish (GResolver *resolver, GAsyncResult *result, GError **error)
+{
+	GSimpleAsyncResult *simple = G_SIMPLE_ASYNC_RESULT (result);
+
+	stub.n_finished++;
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+	return g_strdup (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+static void
+stub_resolver_init (StubResolver *self)
+{
+}
+
+static void
+stub_resolver_class_init (StubResolverClass *klass)
+{
+	GResolverClass *resolver_class = G_RESOLVER_CLASS (klass);
+
+	resolver_class->lookup_by_address_async = stub_lookup_by_address_async;
+	resolver_class->lookup_by_address_finish = stub_lookup_by_address_finish;
+}
+
+static NMHostnameResolver *
+resolver_new (guint timeout_ms, guint negative_ttl_ms)
+{
+	GResolver *stub_resolver;
+	NMHostnameResolver *resolver;
+
+	memset (&stub, 0, sizeof (stub));
+	stub.names = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_insert (stub.names, ADDR_FOUND, "host.example.com");
+	g_hash_table_insert (stub.names, ADDR_NOT_FOUND, "");
+
+	stub_resolver = g_object_new (stub_resolver_get_type (), NULL);
+	resolver = nm_hostname_resolver_new (stub_resolver, timeout_ms, negative_ttl_ms);
+	g_object_unref (stub_resolver);
+	return resolver;
+}
+
+/* Pending lookups keep the resolver alive, make sure none is left over */
+static void
+resolver_free (NMHostnameResolver *resolver)
+{
+	g_object_add_weak_pointer (G_OBJECT (resolver), (gpointer *) &resolver);
+	g_object_unref (resolver);
+	while (resolver)
+		g_main_context_iteration (NULL, TRUE);
+
+	g_hash_table_unref (stub.names);
+}
+
+/*****************************************************************************/
+
+typedef struct {
+	gboolean done;
+	char *hostname;
+	GError *error;
+} Result;
+
+static void
+lookup_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	Result *result = user_data;
+
+	g_assert (!result->done);
+	result->done = TRUE;
+	result->hostname = nm_hostname_resolver_lookup_finish (NM_HOSTNAME_RESOLVER (source), res, &result->error);
+	g_assert (!result->hostname != !result->error);
+}
+
+static void
+lookup_start (NMHostnameResolver *resolver,
+              const char *address,
+              const char *dns_hash,
+              GCancellable *cancellable,
+              Result *result)
+{
+	GInetAddress *addr;
+
+	memset (result, 0, sizeof (*result));
+	addr = g_inet_address_new_from_string (address);
+	nm_hostname_resolver_lookup_async (resolver, addr, dns_hash, cancellable, lookup_cb, result);
+	g_object_unref (addr);
+}
+
+static void
+lookup_wait (Result *result)
+{
+	while (!result->done)
+		g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+result_clear (Result *result)
+{
+	g_free (result->hostname);
+	g_clear_error (&result->error);
+	memset (result, 0, sizeof (*result));
+}
+
+static void
+assert_lookup (NMHostnameResolver *resolver,
+               const char *address,
+               const char *dns_hash,
+               const char *expected_hostname,
+               GQuark expected_domain,
+               int expected_code)
+{
+	Result result;
+
+	lookup_start (resolver, address, dns_hash, NULL, &result);
+	g_assert (!result.done);
+	lookup_wait (&result);
+
+	if (expected_hostname) {
+		g_assert_no_error (result.error);
+		g_assert_cmpstr (result.hostname, ==, expected_hostname);
+	} else
+		g_assert_error (result.error, expected_domain, expected_code);
+	result_clear (&result);
+}
+
+/*****************************************************************************/
+
+static void
+test_cache (void)
+{
+	NMHostnameResolver *resolver = resolver_new (0, 1000);
+
+	assert_lookup (resolver, ADDR_FOUND, "hash1", "host.example.com", 0, 0);
+	g_assert_cmpint (stub.n_calls, ==, 1);
+
+	assert_lookup (resolver, ADDR_FOUND, "hash1", "host.example.com", 0, 0);
+	g_assert_cmpint (stub.n_calls, ==, 1);
+
+	/* A different DNS configuration may give a different answer */
+	assert_lookup (resolver, ADDR_FOUND, "hash2", "host.example.com", 0, 0);
+	g_assert_cmpint (stub.n_calls, ==, 2);
+
+	assert_lookup (resolver, ADDR_FOUND, "hash1", "host.example.com", 0, 0);
+	g_assert_cmpint (stub.n_calls, ==, 3);
+
+	resolver_free (resolver);
+}
+
+static void
+test_negative_cache (void)
+{
+	NMHostnameResolver *resolver = resolver_new (0, 1000);
+
+	assert_lookup (resolver, ADDR_NOT_FOUND, "hash1", NULL, G_RESOLVER_ERROR, G_RESOLVER_ERROR_NOT_FOUND);
+	g_assert_cmpint (stub.n_calls, ==, 1);
+
+	assert_lookup (resolver, ADDR_NOT_FOUND, "hash1", NULL, G_RESOLVER_ERROR, G_RESOLVER_ERROR_NOT_FOUND);
+	g_assert_cmpint (stub.n_calls, ==, 1);
+
+	resolver_free (resolver);
+
+	/* Failures are not cached without a negative TTL */
+	resolver = resolver_new (0, 0);
+
+	assert_lookup (resolver, ADDR_NOT_FOUND, "hash1", NULL, G_RESOLVER_ERROR, G_RESOLVER_ERROR_NOT_FOUND);
+	assert_lookup (resolver, ADDR_NOT_FOUND, "hash1", NULL, G_RESOLVER_ERROR, G_RESOLVER_ERROR_NOT_FOUND);
+	g_assert_cmpint (stub.n_calls, ==, 2);
+
+	resolver_free (resolver);
+}
+
+static void
+test_timeout (void)
+{
+	NMHostnameResolver *resolver = resolver_new (50, 200);
+
+	assert_lookup (resolver, ADDR_SILENT, "hash1", NULL, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+	g_assert_cmpint (stub.n_calls, ==, 1);
+	g_assert_cmpint (stub.n_cancelled, ==, 1);
+
+	assert_lookup (resolver, ADDR_SILENT, "hash1", NULL, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+	g_assert_cmpint (stub.n_calls, ==, 1);
+
+	/* Retried once the negative TTL expired */
+	g_usleep (250 * 1000);
+	assert_lookup (resolver, ADDR_SILENT, "hash1", NULL, G_IO_ERROR, G_IO_ERROR_TIMED_OUT);
+	g_assert_cmpint (stub.n_calls, ==, 2);
+	g_assert_cmpint (stub.n_cancelled, ==, 2);
+
+	resolver_free (resolver);
+}
+
+static void
+test_dedup (void)
+{
+	NMHostnameResolver *resolver = resolver_new (0, 1000);
+	Result r1, r2;
+
+	lookup_start (resolver, ADDR_FOUND, "hash1", NULL, &r1);
+	lookup_start (resolver, ADDR_FOUND, "hash1", NULL, &r2);
+	lookup_wait (&r1);
+	lookup_wait (&r2);
+
+	g_assert_cmpint (stub.n_calls, ==, 1);
+	g_assert_cmpstr (r1.hostname, ==, "host.example.com");
+	g_assert_cmpstr (r2.hostname, ==, "host.example.com");
+	result_clear (&r1);
+	result_clear (&r2);
+
+	resolver_free (resolver);
+}
+
+static void
+test_cancel (void)
+{
+	NMHostnameResolver *resolver = resolver_new (0, 1000);
+	GCancellable *c1, *c2;
+	Result r1, r2;
+
+	/* A cancelled caller does not affect the others... */
+	c1 = g_cancellable_new ();
+	lookup_start (resolver, ADDR_FOUND, "hash1", c1, &r1);
+	lookup_start (resolver, ADDR_FOUND, "hash1", NULL, &r2);
+	g_cancellable_cancel (c1);
+	lookup_wait (&r1);
+	lookup_wait (&r2);
+
+	g_assert_error (r1.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_assert_cmpstr (r2.hostname, ==, "host.example.com");
+	g_assert_cmpint (stub.n_calls, ==, 1);
+	result_clear (&r1);
+	result_clear (&r2);
+	g_object_unref (c1);
+
+	/* ...nor does restarting a lookup right after cancelling it */
+	c1 = g_cancellable_new ();
+	c2 = g_cancellable_new ();
+	lookup_start (resolver, ADDR_SILENT, "hash1", c1, &r1);
+	g_cancellable_cancel (c1);
+	lookup_start (resolver, ADDR_SILENT, "hash1", c2, &r2);
+	lookup_wait (&r1);
+
+	g_assert_error (r1.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_assert (!r2.done);
+	g_assert_cmpint (stub.n_calls, ==, 1);
+	g_assert_cmpint (stub.n_cancelled, ==, 0);
+
+	/* Once nobody waits anymore, the lookup is cancelled */
+	g_cancellable_cancel (c2);
+	lookup_wait (&r2);
+	g_assert_error (r2.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+	/* The resolver must have seen the cancelled lookup complete, or the
+	 * next step would pass even if it was cached. */
+	while (stub.n_finished < stub.n_calls)
+		g_main_context_iteration (NULL, TRUE);
+	g_assert_cmpint (stub.n_cancelled, ==, 1);
+	g_assert_cmpint (stub.n_calls, ==, 1);
+
+	result_clear (&r1);
+	result_clear (&r2);
+	g_object_unref (c1);
+	g_object_unref (c2);
+
+	/* Cancelled lookups are not cached */
+	c1 = g_cancellable_new ();
+	lookup_start (resolver, ADDR_SILENT, "hash1", c1, &r1);
+	g_assert_cmpint (stub.n_calls, ==, 2);
+	g_cancellable_cancel (c1);
+	lookup_wait (&r1);
+	g_assert_error (r1.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	result_clear (&r1);
+	g_object_unref (c1);
+
+	resolver_free (resolver);
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	nmtst_init_with_logging (&argc, &argv, NULL, "DEFAULT");
+
+	g_test_add_func ("/hostname-resolver/cache", test_cache);
+	g_test_add_func ("/hostname-resolver/negative-cache", test_negative_cache);
+	g_test_add_func ("/hostname-resolver/timeout", test_timeout);
+	g_test_add_func ("/hostname-resolver/dedup", test_dedup);
+	g_test_add_func ("/hostname-resolver/cancel", test_cancel);
+
+	return g_test_run ();
+}
@@ -0,0 +1,216 @@
+/* -*- Mode: C; tab-width: 4; indent-tabs-mode: t; c-basic-offset: 4 -*- */
+/* NetworkManager -- Network link manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Copyright (C) 2015 Red Hat, Inc.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "nm-iface-helper-control.h"
+
+#include "nm-test-utils.h"
+
+/* The two ends of a control connection. The replies of the "helper" end
+ * are queued before the command is sent, so that no second thread is needed.
+ */
+static int client_fd;
+static int helper_fd;
+
+static void
+connection_new (void)
+{
+	struct timeval timeout = { .tv_usec = 50000 };
+	int fds[2];
+
+	g_assert_cmpint (socketpair (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds), ==, 0);
+	client_fd = fds[0];
+	helper_fd = fds[1];
+	g_assert_cmpint (setsockopt (client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout)), ==, 0);
+}
+
+static void
+connection_free (void)
+{
+	close (client_fd);
+	if (helper_fd >= 0)
+		close (helper_fd);
+}
+
+static void
+helper_reply (const char *reply)
+{
+	g_assert_cmpint (send (helper_fd, reply, strlen (reply), 0), ==, strlen (reply));
+}
+
+static void
+helper_assert_received (const char *expected)
+{
+	char buf[NMIH_CONTROL_MSG_MAX + 1];
+	ssize_t len;
+
+	len = recv (helper_fd, buf, NMIH_CONTROL_MSG_MAX, MSG_DONTWAIT);
+	g_assert_cmpint (len, >, 0);
+	buf[len] = '\0';
+	g_assert_cmpstr (buf, ==, expected);
+}
+
+/*****************************************************************************/
+
+static void
+test_parse (void)
+{
+	NMIfaceHelperCommand command;
+	const char *arg;
+	GError *error = NULL;
+
+	g_assert (nm_iface_helper_control_parse ("add --ifname eth0 --uuid abc", &command, &arg, &error));
+	g_assert_no_error (error);
+	g_assert_cmpint (command, ==, NMIH_CONTROL_COMMAND_ADD);
+	g_assert_cmpstr (arg, ==, "--ifname eth0 --uuid abc");
+
+	g_assert (nm_iface_helper_control_parse ("remove eth0", &command, &arg, &error));
+	g_assert_no_error (error);
+	g_assert_cmpint (command, ==, NMIH_CONTROL_COMMAND_REMOVE);
+	g_assert_cmpstr (arg, ==, "eth0");
+
+	g_assert (!nm_iface_helper_control_parse ("remove ", &command, &arg, &error));
+	g_assert_error (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED);
+	g_clear_error (&error);
+
+	g_assert (!nm_iface_helper_control_parse ("removeeth0", &command, &arg, &error));
+	g_assert_error (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED);
+	g_clear_error (&error);
+
+	g_assert (!nm_iface_helper_control_parse ("frobnicate eth0", &command, &arg, &error));
+	g_assert_error (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED);
+	g_clear_error (&error);
+}
+
+static void
+test_reply (void)
+{
+	GError *error = NULL;
+	char *reply;
+
+	reply = nm_iface_helper_control_reply (NULL);
+	g_assert_cmpstr (reply, ==, "ok");
+	g_free (reply);
+
+	g_set_error_literal (&error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED, "Interface eth9 is not managed");
+	reply = nm_iface_helper_control_reply (error);
+	g_assert_cmpstr (reply, ==, "error Interface eth9 is not managed");
+	g_free (reply);
+	g_error_free (error);
+}
+
+static void
+test_send (void)
+{
+	char *message = NULL;
+
+	connection_new ();
+
+	helper_reply ("ok");
+	g_assert_cmpint (nm_iface_helper_control_send (client_fd, NMIH_CONTROL_COMMAND_ADD,
+	                                               "--ifname eth0 --uuid abc", &message),
+	                 ==, NMIH_CONTROL_RESULT_OK);
+	g_assert (!message);
+	helper_assert_received ("add --ifname eth0 --uuid abc");
+
+	/* A rejected command is not taken as success */
+	helper_reply ("error Interface eth9 is not managed");
+	g_assert_cmpint (nm_iface_helper_control_send (client_fd, NMIH_CONTROL_COMMAND_REMOVE,
+	                                               "eth9", &message),
+	                 ==, NMIH_CONTROL_RESULT_REJECTED);
+	g_assert_cmpstr (message, ==, "Interface eth9 is not managed");
+	g_clear_pointer (&message, g_free);
+	helper_assert_received ("remove eth9");
+
+	/* A helper that does not answer in time */
+	g_assert_cmpint (nm_iface_helper_control_send (client_fd, NMIH_CONTROL_COMMAND_ADD,
+	                                               "--ifname eth1 --uuid def", &message),
+	                 ==, NMIH_CONTROL_RESULT_FAILED);
+	g_assert (message);
+	g_clear_pointer (&message, g_free);
+	helper_assert_received ("add --ifname eth1 --uuid def");
+
+	/* A helper that went away */
+	close (helper_fd);
+	helper_fd = -1;
+	g_assert_cmpint (nm_iface_helper_control_send (client_fd, NMIH_CONTROL_COMMAND_ADD,
+	                                               "--ifname eth1 --uuid def", NULL),
+	                 ==, NMIH_CONTROL_RESULT_FAILED);
+
+	connection_free ();
+}
+
+static void
+test_round_trip (void)
+{
+	char buf[NMIH_CONTROL_MSG_MAX + 1];
+	NMIfaceHelperCommand command;
+	const char *arg;
+	char *reply;
+	ssize_t len;
+
+	connection_new ();
+
+	/* What the client sends parses back on the helper side */
+	helper_reply ("ok");
+	g_assert_cmpint (nm_iface_helper_control_send (client_fd, NMIH_CONTROL_COMMAND_REMOVE,
+	                                               "eth0", NULL),
+	                 ==, NMIH_CONTROL_RESULT_OK);
+	len = recv (helper_fd, buf, NMIH_CONTROL_MSG_MAX, MSG_DONTWAIT);
+	g_assert_cmpint (len, >, 0);
+	buf[len] = '\0';
+	g_assert (nm_iface_helper_control_parse (buf, &command, &arg, NULL));
+	g_assert_cmpint (command, ==, NMIH_CONTROL_COMMAND_REMOVE);
+	g_assert_cmpstr (arg, ==, "eth0");
+
+	/* And the helper's replies parse on the client side */
+	reply = nm_iface_helper_control_reply (NULL);
+	helper_reply (reply);
+	g_free (reply);
+	g_assert_cmpint (nm_iface_helper_control_send (client_fd, NMIH_CONTROL_COMMAND_REMOVE,
+	                                               "eth0", NULL),
+	                 ==, NMIH_CONTROL_RESULT_OK);
+
+	connection_free ();
+}
+
+/*****************************************************************************/
+
+NMTST_DEFINE ();
+
+int
+main (int argc, char **argv)
+{
+	nmtst_init_with_logging (&argc, &argv, NULL, "DEFAULT");
+
+	g_test_add_func ("/iface-helper-control/parse", test_parse);
+	g_test_add_func ("/iface-helper-control/reply", test_reply);
+	g_test_add_func ("/iface-helper-control/send", test_send);
+	g_test_add_func ("/iface-helper-control/round-trip", test_round_trip);
+
+	return g_test_run ();
+}